@@ -7,13 +7,49 @@
 //
 
 #import "REMEditorViewController.h"
-#import "REMHollerithNumber.h"
+#import "cardtext.h"
+#import "cardrender.h"
 
-#define LINE_HEIGHT 17.0f
+// The card being edited, drawn from a card_view's bitmap; only the part
+// the view is told needs display is drawn again.
+@interface REMCardBitmapView : UIView
+@property (nonatomic) const struct card_view *card;
+@end
+
+@implementation REMCardBitmapView
+
+- (void)drawRect:(CGRect)rect
+{
+    if (self.card == NULL) {
+        return;
+    }
+    const struct card_atlas *atlas = self.card->atlas;
+    size_t width = atlas->width, height = atlas->height;
+    CGDataProviderRef provider = CGDataProviderCreateWithData(NULL, self.card->rgba, width * height * 4, NULL);
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGImageRef image = CGImageCreate(width, height, 8, 32, width * 4, colorSpace,
+                                     kCGBitmapByteOrderDefault | kCGImageAlphaLast,
+                                     provider, NULL, false, kCGRenderingIntentDefault);
+    UIRectClip(rect);
+    [[UIImage imageWithCGImage:image scale:atlas->zoom orientation:UIImageOrientationUp] drawAtPoint:CGPointZero];
+    CGImageRelease(image);
+    CGColorSpaceRelease(colorSpace);
+    CGDataProviderRelease(provider);
+}
+
+@end
 
-@interface REMEditorViewController ()
+@interface REMEditorViewController () {
+    struct card_codec _codec;
+    struct card_text _text;     // the editor's text, punched a line at a time
+    struct card_atlas _atlas;
+    struct card_view _card;     // the card under the cursor, as drawn
+    BOOL _editing;              // between an edit and the text view's change
+    NSUInteger _edited;         // where the edit leaves the cursor
+}
 @property (weak, nonatomic) IBOutlet UITextView *editor;
 @property (weak, nonatomic) IBOutlet UIView *cardView;
+@property (strong, nonatomic) REMCardBitmapView *bitmapView;
 
 @end
 
@@ -23,56 +59,113 @@
 - (void)viewDidLoad
 {
     [super viewDidLoad];
-	// Do any additional setup after loading the view.
+    struct card_options options;
+    card_options_init(&options);    // the 029, as HollerithEncodingIBMModel029
+    card_codec_init(&_codec, &options);
+    card_text_init(&_text, &_codec);
+    NSData *bytes = [self cardBytes:self.editor.text];
+    card_text_replace(&_text, 0, 0, bytes.bytes, bytes.length);
+
+    // The card is drawn over the blank one in the storyboard, from the
+    // assets at the screen's scale.
+    int zoom = ([UIScreen mainScreen].scale >= 2.0f) ? 2 : 1;
+    const char *assets = [[NSBundle mainBundle] resourcePath].fileSystemRepresentation;
+    if (card_atlas_load(&_atlas, assets, zoom) != CARD_OK) {
+        NSLog(@"Card assets not loaded");
+        return;
+    }
+    if (card_view_init(&_card, &_atlas, NULL) != CARD_OK) {
+        card_atlas_free(&_atlas);
+        return;
+    }
+    self.bitmapView = [[REMCardBitmapView alloc] initWithFrame:self.cardView.bounds];
+    self.bitmapView.autoresizingMask = UIViewAutoresizingFlexibleWidth | UIViewAutoresizingFlexibleHeight;
+    self.bitmapView.opaque = NO;
+    self.bitmapView.backgroundColor = [UIColor clearColor];
+    self.bitmapView.card = &_card;
+    [self.cardView addSubview:self.bitmapView];
+}
+
+- (void)dealloc
+{
+    if (self.bitmapView != nil) {
+        self.bitmapView.card = NULL;
+        card_view_free(&_card);
+        card_atlas_free(&_atlas);
+    }
+    card_text_free(&_text);
+}
+
+// One byte for each UTF-16 unit, so ranges in the text view are offsets in
+// the card text; anything not ASCII punches as an illegal character.
+- (NSData *)cardBytes:(NSString *)string
+{
+    NSMutableData *data = [NSMutableData dataWithLength:string.length];
+    unsigned char *bytes = data.mutableBytes;
+    for (NSUInteger idx = 0; idx < string.length; idx++) {
+        unichar character = [string characterAtIndex:idx];
+        bytes[idx] = (character < 128) ? character : 0xff;
+    }
+    return data;
 }
 
 - (void)viewDidAppear:(BOOL)animated
 {
     [super viewDidAppear:animated];
-    [self updatePunchedCard];
+    [self updatePunchedCardAt:self.editor.selectedRange.location];
+}
+
+- (void)updatePunchedCardAt:(NSUInteger)location
+{
+    // Only the line with the cursor is punched again, if it changed, so a
+    // keystroke costs the same however long the program is.
+    int col, column, ncards;
+    long line = card_text_line_at(&_text, location, &col);
+    const unsigned char *cards = card_text_card(&_text, line, &ncards);
+    if (self.bitmapView == nil) {
+        return;
+    }
+
+    // A line longer than the card goes on to more cards, tabs filling to
+    // the next stop as cardmake fills them; show the one the cursor is on,
+    // or a blank card for a line with none.
+    uint16_t columns[80] = { 0 };
+    if (cards != NULL && ncards > 0) {
+        int card = card_text_card_at(&_text, line, col, &column);
+        card_text_columns(&_text, line, MIN(card, ncards - 1), columns);
+    }
+
+    // Only the columns that differ from the card as drawn are drawn again,
+    // and only the strip they span is put on the screen.
+    if (card_view_update(&_card, columns) > 0) {
+        CGFloat zoom = _atlas.zoom;
+        [self.bitmapView setNeedsDisplayInRect:CGRectMake(_card.x / zoom, _card.y / zoom,
+                                                          _card.width / zoom, _card.height / zoom)];
+    }
+}
+
+- (BOOL)textView:(UITextView *)textView shouldChangeTextInRange:(NSRange)range replacementText:(NSString *)text
+{
+    NSData *bytes = [self cardBytes:text];
+    card_text_replace(&_text, range.location, range.length, bytes.bytes, bytes.length);
+    _editing = YES;
+    _edited = range.location + bytes.length;
+    return YES;
 }
 
-- (void)updatePunchedCard
+// An edit moves the cursor as well; the card is drawn once for both, when
+// the text has changed, on the line the edit left the cursor in.
+- (void)textViewDidChangeSelection:(UITextView *)textView
 {
-    NSString *text = [self.editor.text uppercaseString];
-    NSMutableArray *hollerithRepresentation = [NSMutableArray arrayWithCapacity:80];
-    for (int idx = 0; idx < text.length; idx++) {
-        NSString *character = [NSString stringWithFormat:@"%C", [text characterAtIndex:idx]];
-        REMHollerithNumber *number = [REMHollerithNumber HollerithWithString:character encoding:HollerithEncodingIBMModel029];
-        [hollerithRepresentation addObject:number];
+    if (!_editing) {
+        [self updatePunchedCardAt:textView.selectedRange.location];
     }
-    NSAssert([hollerithRepresentation count] == text.length, nil);
-    
-    // Add graphics
-    [self.cardView.subviews makeObjectsPerformSelector:@selector(removeFromSuperview)];
-    
-    __block CGFloat xPosition = 17.0f;
-    UIImage *punchImage = [UIImage imageNamed:@"Punch.png"];
-    
-    [hollerithRepresentation enumerateObjectsUsingBlock:^(id obj, NSUInteger idx, BOOL *stop) {
-        NSArray *punchesArray = ((REMHollerithNumber *) obj).arrayValue;
-        NSLog(@"H: %@", punchesArray);
-        
-        CGFloat yPos = 3.0f + LINE_HEIGHT;
-        for (NSString *punch in punchesArray) {
-            if ([punch isEqualToString:@"X"]) {
-                UIImageView *imageView = [[UIImageView alloc] initWithImage:punchImage];
-                [self.cardView addSubview:imageView];
-                CGPoint origin = CGPointMake(xPosition, yPos);
-                CGRect frame = imageView.frame;
-                frame.origin = origin;
-                imageView.frame = frame;
-            }
-            yPos += LINE_HEIGHT;
-        }
-        xPosition += 6.0f;
-        // Print *, "Hello World!"
-    }];
 }
 
 - (void)textViewDidChange:(UITextView *)textView
 {
-    [self updatePunchedCard];
+    _editing = NO;
+    [self updatePunchedCardAt:_edited];
 }
 
 @end
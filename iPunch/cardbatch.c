@@ -0,0 +1,485 @@
+/* cardbatch.c -- run cardmake or cardlist over a whole tree of files.
+ *
+ * operation:  run cardbatch -help for instructions
+ *
+ * build: cc -o cardbatch cardbatch.c cardio.c cardconv.c cardcodec.c
+ *        -lpthread
+ *
+ * input  -- a directory tree, or a list of files within one
+ * output -- a mirrored directory tree of converted files
+ *
+ * Forking cardmake or cardlist once per file costs more than the
+ * conversion itself when the files are small.  This does the same
+ * conversions in one process, on a fixed pool of worker threads, each
+ * of which keeps its own input and output buffers from file to file.
+ * The bytes held in those buffers by files in flight are kept under a
+ * budget set with -mem; a file bigger than the whole budget is still
+ * converted, but only while nothing else is in flight.
+ *
+ * Reads and writes go through cardio, so with -io uring each worker keeps
+ * up to -qd requests in flight on its own io_uring, splitting big files
+ * into chunks; where io_uring is missing this falls back to pread.
+ *
+ * An error in one file is reported on stderr and the batch goes on; the
+ * exit status is nonzero if any file failed.
+ *
+ * see the README file for details of the card image file format!
+ *
+ */
+
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "cardconv.h"
+#include "cardio.h"
+
+#define QUEUE_SIZE	256	/* paths waiting for a worker */
+#define MAX_WORKERS	64
+#define IO_CHUNK	(128 << 10) /* bytes per queued request */
+
+struct worker {
+	pthread_t thread;
+	struct cardio *io;	/* this thread's request queue */
+	struct card_buf in;	/* the file being converted */
+	struct card_buf out;	/* its conversion */
+	long files;
+	long errors;
+};
+
+static char *progname;
+static int listing = 0;		/* 0 for cardmake, 1 for cardlist */
+static struct card_options options;
+static struct card_codec codec;	/* built from options, shared by workers */
+static const char *src_root;
+static const char *dst_root;
+static const char *suffix = NULL; /* replaces the input suffix, if set */
+static size_t budget = 64 << 20; /* bytes in flight across all workers */
+static size_t trim_limit;	/* per-worker buffer size kept between files */
+static int io_backend = CARDIO_ANY;
+static unsigned io_depth = 8;	/* requests in flight per worker */
+
+/* the work queue, filled by the tree walk, drained by the workers */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t not_empty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t not_full = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t budget_free = PTHREAD_COND_INITIALIZER;
+static char *queue[QUEUE_SIZE];
+static int queue_head = 0;
+static int queue_count = 0;
+static int queue_done = 0;	/* no more paths will be queued */
+static size_t in_flight = 0;	/* bytes charged against the budget */
+
+static void queue_put( char *path )
+{
+	pthread_mutex_lock( &lock );
+	while (queue_count == QUEUE_SIZE)
+		pthread_cond_wait( &not_full, &lock );
+	queue[(queue_head + queue_count) % QUEUE_SIZE] = path;
+	queue_count++;
+	pthread_cond_signal( &not_empty );
+	pthread_mutex_unlock( &lock );
+}
+
+static char *queue_get( void )
+{
+	char *path = NULL;
+	pthread_mutex_lock( &lock );
+	while ((queue_count == 0) && !queue_done)
+		pthread_cond_wait( &not_empty, &lock );
+	if (queue_count > 0) {
+		path = queue[queue_head];
+		queue_head = (queue_head + 1) % QUEUE_SIZE;
+		queue_count--;
+		pthread_cond_signal( &not_full );
+	}
+	pthread_mutex_unlock( &lock );
+	return path;
+}
+
+static void queue_close( void )
+{
+	pthread_mutex_lock( &lock );
+	queue_done = 1;
+	pthread_cond_broadcast( &not_empty );
+	pthread_mutex_unlock( &lock );
+}
+
+/* wait until size more bytes fit in the budget, or nothing is in flight */
+static void budget_acquire( size_t size )
+{
+	pthread_mutex_lock( &lock );
+	while ((in_flight > 0) && (in_flight + size > budget))
+		pthread_cond_wait( &budget_free, &lock );
+	in_flight += size;
+	pthread_mutex_unlock( &lock );
+}
+
+static void budget_release( size_t size )
+{
+	pthread_mutex_lock( &lock );
+	in_flight -= size;
+	pthread_cond_broadcast( &budget_free );
+	pthread_mutex_unlock( &lock );
+}
+
+/* make every directory leading up to path; the last component is a file */
+static int make_parents( char *path )
+{
+	char *slash;
+	for (slash = strchr( path + 1, '/' ); slash != NULL;
+	     slash = strchr( slash + 1, '/' )) {
+		*slash = '\0';
+		if ((mkdir( path, 0777 ) != 0) && (errno != EEXIST)) {
+			*slash = '/';
+			return -1;
+		}
+		*slash = '/';
+	}
+	return 0;
+}
+
+/* the output path for rel, with its suffix replaced if -suffix was given */
+static char *output_path( const char *rel )
+{
+	size_t len = strlen( rel );
+	const char *dot = NULL;
+	char *path;
+
+	if (suffix != NULL) {
+		const char *base = strrchr( rel, '/' );
+		dot = strrchr( base ? base : rel, '.' );
+		if (dot != NULL) len = dot - rel;
+	}
+	path = malloc( strlen( dst_root ) + len + 2
+		     + (suffix ? strlen( suffix ) : 0) );
+	if (path == NULL) return NULL;
+	sprintf( path, "%s/%.*s%s", dst_root, (int)len, rel,
+		 suffix ? suffix : "" );
+	return path;
+}
+
+static int read_file( struct cardio *io, const char *path,
+		      struct card_buf *buf, size_t *charge,
+		      size_t (*bound)( size_t ) )
+{
+	struct stat st;
+	long got;
+	int fd = open( path, O_RDONLY );
+	if (fd < 0) return CARD_EIO;
+	if (fstat( fd, &st ) != 0) {
+		close( fd );
+		return CARD_EIO;
+	}
+
+	/* charge the input and the worst case output before reading */
+	*charge = st.st_size + bound( st.st_size );
+	budget_acquire( *charge );
+
+	buf->len = 0;
+	if (card_buf_reserve( buf, st.st_size + 1 ) != CARD_OK) {
+		close( fd );
+		return CARD_ENOMEM;
+	}
+	got = cardio_read_all( io, fd, buf->data, st.st_size, IO_CHUNK );
+	close( fd );
+	if (got < 0) {
+		errno = -got;
+		return CARD_EIO;
+	}
+	buf->len = got;
+	return CARD_OK;
+}
+
+static int write_file( struct cardio *io, char *path,
+		       const struct card_buf *buf )
+{
+	long put;
+	int fd;
+
+	if (make_parents( path ) != 0) return CARD_EIO;
+	fd = open( path, O_WRONLY | O_CREAT | O_TRUNC, 0666 );
+	if (fd < 0) return CARD_EIO;
+	put = cardio_write_all( io, fd, buf->data, buf->len, IO_CHUNK );
+	if (put < 0) {
+		close( fd );
+		errno = -put;
+		return CARD_EIO;
+	}
+	if (close( fd ) != 0) return CARD_EIO;
+	return CARD_OK;
+}
+
+static size_t make_bound( size_t len )
+{
+	return card_make_bound( &codec, len );
+}
+
+/* convert one file, relative to src_root, into the mirror tree */
+static int convert( struct worker *w, const char *rel, const char **what )
+{
+	char *src, *dst;
+	size_t charge = 0;
+	int err;
+
+	src = malloc( strlen( src_root ) + strlen( rel ) + 2 );
+	dst = output_path( rel );
+	if ((src == NULL) || (dst == NULL)) {
+		free( src );
+		free( dst );
+		*what = "";
+		return CARD_ENOMEM;
+	}
+	sprintf( src, "%s/%s", src_root, rel );
+
+	*what = "read";
+	err = read_file( w->io, src, &w->in, &charge,
+			 listing ? card_list_bound : make_bound );
+	if (err == CARD_OK) {
+		*what = "convert";
+		if (listing) {
+			err = card_list_buffer( &codec, w->in.data,
+						w->in.len, &w->out );
+		} else {
+			err = card_make_buffer( &codec, w->in.data,
+						w->in.len, &w->out );
+		}
+	}
+	if (err == CARD_OK) {
+		*what = "write";
+		err = write_file( w->io, dst, &w->out );
+	}
+	if (charge != 0) budget_release( charge );
+
+	card_buf_trim( &w->in, trim_limit );
+	card_buf_trim( &w->out, trim_limit );
+	free( src );
+	free( dst );
+	return err;
+}
+
+static void *work( void *arg )
+{
+	struct worker *w = arg;
+	char *rel;
+
+	while ((rel = queue_get()) != NULL) {
+		const char *what;
+		int saved;
+		int err = convert( w, rel, &what );
+		saved = errno;
+		w->files++;
+		if (err != CARD_OK) {
+			w->errors++;
+			if (err == CARD_EIO) {
+				fprintf( stderr, "%s %s: %s failed: %s\n",
+					 progname, rel, what,
+					 strerror( saved ) );
+			} else {
+				fprintf( stderr, "%s %s: %s\n",
+					 progname, rel, card_strerror( err ) );
+			}
+		}
+		free( rel );
+	}
+	return NULL;
+}
+
+/* nftw callback, queues each regular file under src_root */
+static int visit( const char *path, const struct stat *st, int type,
+		  struct FTW *ftw )
+{
+	char *rel;
+	(void)st;
+	(void)ftw;
+	if (type == FTW_DNR) {
+		fprintf( stderr, "%s %s: unreadable directory\n",
+			 progname, path );
+		return 0;
+	}
+	if (type != FTW_F) return 0;
+	rel = strdup( path + strlen( src_root ) + 1 );
+	if (rel == NULL) return -1;
+	queue_put( rel );
+	return 0;
+}
+
+/* queue each line of list, naming a file relative to src_root */
+static int read_list( const char *list )
+{
+	char line[4096];
+	FILE *list_fd = (strcmp( list, "-" ) == 0) ? stdin : fopen( list, "r" );
+	if (list_fd == NULL) {
+		fprintf( stderr, "%s %s: invalid file list\n", progname, list );
+		return -1;
+	}
+	while (fgets( line, sizeof line, list_fd ) != NULL) {
+		char *rel;
+		size_t len = strcspn( line, "\r\n" );
+		line[len] = '\0';
+		if (len == 0) continue;
+		rel = strdup( line );
+		if (rel == NULL) return -1;
+		queue_put( rel );
+	}
+	if (list_fd != stdin) fclose( list_fd );
+	return 0;
+}
+
+static void usage( void )
+{
+	fprintf( stderr, "\n%s -make [cardmake options] [batch options]"
+			 " srcdir dstdir\n", progname );
+	fprintf( stderr, "%s -list [cardlist options] [batch options]"
+			 " srcdir dstdir\n\n", progname );
+	fprintf( stderr,
+	"Convert every file under srcdir as cardmake (-make) or cardlist\n"
+	"(-list) would, writing each result to the same relative path\n"
+	"under dstdir.  Any cardmake or cardlist option may be given,\n"
+	"and applies to every file.  The batch options are:\n\n"
+	" -j n            worker threads (default: one per processor)\n\n"
+	" -mem megabytes  bound on input and output buffered at once\n"
+	"                 (default 64)\n\n"
+	" -files list     convert only the files named in list, one\n"
+	"                 per line relative to srcdir; - for stdin\n\n"
+	" -suffix .ext    replace the suffix of each output file\n\n"
+	" -io uring       queue reads and writes on io_uring\n"
+	" -io pread       plain pread and pwrite\n"
+	" -io any         io_uring if available (default)\n\n"
+	" -qd n           requests in flight per worker (default 8)\n\n"
+	);
+	exit(-1);
+}
+
+int main( int argc, char *argv[] )
+{
+	struct worker *workers;
+	const char *list = NULL;
+	long files = 0, errors = 0;
+	int nworkers = 0;
+	int arg = 1;
+	int i;
+
+	progname = argv[0];
+	card_options_init( &options );
+	if ((arg < argc) && (strcmp(argv[arg],"-make") == 0)) {
+		listing = 0;
+	} else if ((arg < argc) && (strcmp(argv[arg],"-list") == 0)) {
+		listing = 1;
+	} else {
+		usage();
+	}
+	arg++;
+
+	while ((arg < argc) && (argv[arg][0] == '-')) { /* command line arg */
+		if ((strcmp(argv[arg],"-j") == 0) && (arg + 1 < argc)) {
+			nworkers = atoi( argv[++arg] );
+		} else if ((strcmp(argv[arg],"-mem") == 0) && (arg + 1 < argc)) {
+			budget = (size_t)atol( argv[++arg] ) << 20;
+		} else if ((strcmp(argv[arg],"-files") == 0)
+			&& (arg + 1 < argc)) {
+			list = argv[++arg];
+		} else if ((strcmp(argv[arg],"-suffix") == 0)
+			&& (arg + 1 < argc)) {
+			suffix = argv[++arg];
+		} else if ((strcmp(argv[arg],"-io") == 0) && (arg + 1 < argc)) {
+			arg++;
+			if (strcmp(argv[arg],"uring") == 0) {
+				io_backend = CARDIO_URING;
+			} else if (strcmp(argv[arg],"pread") == 0) {
+				io_backend = CARDIO_PREAD;
+			} else if (strcmp(argv[arg],"any") == 0) {
+				io_backend = CARDIO_ANY;
+			} else {
+				fprintf( stderr, "%s: unknown -io %s\n",
+					 argv[0], argv[arg] );
+				exit(-1);
+			}
+		} else if ((strcmp(argv[arg],"-qd") == 0) && (arg + 1 < argc)) {
+			io_depth = atoi( argv[++arg] );
+		} else if (strcmp(argv[arg],"-help") == 0) {
+			usage();
+		} else if (listing ? card_list_option( &options, argv[arg] )
+				   : card_make_option( &options, argv[arg] )) {
+			/* conversion option, recorded in options */
+		} else {
+			fprintf( stderr, "%s: unknown option %s;"
+					 " -help available\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+		arg++;
+	}
+
+	if ( (argc - arg) != 2 ) {
+		fprintf( stderr, "%s: need srcdir and dstdir; -help available\n",
+			 argv[0] );
+		exit(-1);
+	}
+	src_root = argv[arg];
+	dst_root = argv[arg + 1];
+	for (i = strlen( argv[arg] ) - 1; (i > 0) && (argv[arg][i] == '/'); i--)
+		argv[arg][i] = '\0'; /* nftw paths are src_root + "/" + rel */
+
+	if (nworkers <= 0) nworkers = (int)sysconf( _SC_NPROCESSORS_ONLN );
+	if (nworkers <= 0) nworkers = 1;
+	if (nworkers > MAX_WORKERS) nworkers = MAX_WORKERS;
+	if (budget == 0) budget = 1 << 20;
+	trim_limit = budget / nworkers;
+
+	card_codec_init( &codec, &options );
+	if ((mkdir( dst_root, 0777 ) != 0) && (errno != EEXIST)) {
+		fprintf( stderr, "%s %s: invalid output directory\n",
+			 argv[0], dst_root );
+		exit(-1);
+	}
+
+	workers = calloc( nworkers, sizeof *workers );
+	if (workers == NULL) {
+		fprintf( stderr, "%s: out of memory\n", argv[0] );
+		exit(-1);
+	}
+	for (i = 0; i < nworkers; i++) {
+		workers[i].io = cardio_open( io_depth, io_backend );
+		if (workers[i].io == NULL) {
+			fprintf( stderr, "%s: cannot open %s i/o\n", argv[0],
+				 (io_backend == CARDIO_URING) ? "io_uring"
+							      : "file" );
+			exit(-1);
+		}
+		if (pthread_create( &workers[i].thread, NULL,
+				    work, &workers[i] ) != 0) {
+			fprintf( stderr, "%s: cannot start workers\n", argv[0] );
+			exit(-1);
+		}
+	}
+
+	/* the main thread feeds the queue while the workers drain it */
+	if (list != NULL) {
+		if (read_list( list ) != 0) errors++;
+	} else if (nftw( src_root, visit, 32, FTW_PHYS ) != 0) {
+		fprintf( stderr, "%s %s: invalid source directory\n",
+			 argv[0], src_root );
+		errors++;
+	}
+	queue_close();
+
+	for (i = 0; i < nworkers; i++) {
+		pthread_join( workers[i].thread, NULL );
+		files += workers[i].files;
+		errors += workers[i].errors;
+		card_buf_free( &workers[i].in );
+		card_buf_free( &workers[i].out );
+		cardio_close( workers[i].io );
+	}
+	free( workers );
+
+	fprintf( stderr, "%s: %ld files, %ld errors\n", argv[0], files, errors );
+	exit( (errors == 0) ? 0 : -1 );
+}
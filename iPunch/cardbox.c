@@ -0,0 +1,400 @@
+/* cardbox.c -- read boxes of scanned cards into decks, on many threads.
+ *
+ * operation:  run cardbox -help for instructions
+ *
+ * build: cc -o cardbox cardbox.c cardscan.c cardimage.c cardconv.c
+ *        cardcodec.c -lz -lm -lpthread
+ *
+ * input  -- directories of pictures of cards, one directory for each
+ *           box, one card in each picture, PNG or PNM
+ * output -- a card-image file for each box, with its cards in the order
+ *           of their pictures' names, and beside it a list of how sure
+ *           each card's reading was
+ *
+ * This is cardphoto for a flatbed scanner's output, thousands of
+ * pictures to a box.  The pictures of a box are taken in the order of
+ * their names, with runs of digits compared as numbers, so scan2 comes
+ * before scan10, and the deck for box dir is written as dir.h80 in the
+ * -out directory, the current one by default.  dir.txt beside it has a
+ * line for each picture: its card number in the deck, its name, the
+ * confidence and doubtful positions of cardscan.h, whether it was
+ * turned over, and "check" if its confidence is under -check, 0.5 by
+ * default.  With -print, the printing of interpreted cards is checked
+ * against their holes too, and -correct punches what it says where
+ * they differ, as in cardphoto; the line then ends with the columns
+ * that differ and those corrected, and a card with any that differ is
+ * marked "check" whatever its confidence.  A picture with no card to be read in it is listed with
+ * the reason and left out of the deck, and the exit status is then 1.
+ *
+ * The pictures go to a pool of worker threads, by default one for each
+ * processor online, each taking the next picture not yet taken.  Each
+ * worker has its own card_image_work and card_scan_work, the scratch
+ * space for a file, the decoding of it and the reading of the card in
+ * it, so once it has seen the biggest picture a worker allocates
+ * nothing more; pictures go straight from the file to gray.
+ *
+ * At the end, the cards read, the time taken and cards a second go to
+ * stdout.  -bench reads the boxes on one worker and then on all of them
+ * and reports cards a second for each, writing nothing.
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "cardconv.h"
+#include "cardscan.h"
+
+#define MAX_WORKERS	256
+
+/* a picture, and what was read from it */
+struct picture {
+	char *path;
+	const char *name;	/* in path */
+	int box;
+	int err;
+	struct card_scan scan;
+};
+
+struct worker {
+	pthread_t thread;
+	struct card_image_work image;
+	struct card_scan_work scan;
+	long pictures;
+};
+
+static char *progname;
+static const struct card_geometry *geometry = &card_geometry_ibm;
+static struct card_codec codec;		/* shared by the workers, read only */
+static int print, correct;
+
+static struct picture *pictures;
+static long npictures, maxpictures;
+
+/* the next picture to read, taken under the lock */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static long next;
+
+static double now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* names in order, with runs of digits compared as numbers */
+static int name_order( const char *a, const char *b )
+{
+	while (*a && *b) {
+		if ((*a >= '0') && (*a <= '9') && (*b >= '0') && (*b <= '9')) {
+			const char *da = a, *db = b;
+			size_t la, lb;
+			while (*da == '0') da++;
+			while (*db == '0') db++;
+			for (a = da; (*a >= '0') && (*a <= '9'); a++);
+			for (b = db; (*b >= '0') && (*b <= '9'); b++);
+			la = a - da;
+			lb = b - db;
+			if (la != lb) return (la < lb) ? -1 : 1;
+			if (strncmp( da, db, la ) != 0) return strncmp( da, db, la );
+		} else {
+			if (*a != *b) return (unsigned char)*a - (unsigned char)*b;
+			a++;
+			b++;
+		}
+	}
+	return (unsigned char)*a - (unsigned char)*b;
+}
+
+static int picture_order( const void *a, const void *b )
+{
+	const struct picture *pa = a, *pb = b;
+
+	if (pa->box != pb->box) return pa->box - pb->box;
+	return name_order( pa->name, pb->name );
+}
+
+static int is_picture( const char *name )
+{
+	static const char *kinds[] = { ".png", ".pnm", ".pgm", ".ppm" };
+	size_t n = strlen( name ), k;
+
+	for (k = 0; k < sizeof kinds / sizeof kinds[0]; k++)
+		if ((n > 4) && (strcasecmp( name + n - 4, kinds[k] ) == 0)) return 1;
+	return 0;
+}
+
+/* add the pictures in a box's directory; returns how many */
+static long add_box( const char *dir, int box )
+{
+	DIR *d = opendir( dir );
+	struct dirent *e;
+	long added = 0;
+
+	if (d == NULL) {
+		fprintf( stderr, "%s %s: %s\n", progname, dir, strerror( errno ) );
+		exit(-1);
+	}
+	while ((e = readdir( d )) != NULL) {
+		struct picture *p;
+		size_t n;
+
+		if ((e->d_name[0] == '.') || !is_picture( e->d_name )) continue;
+		if (npictures == maxpictures) {
+			maxpictures = maxpictures ? 2 * maxpictures : 1024;
+			pictures = realloc( pictures, maxpictures * sizeof *pictures );
+			if (pictures == NULL) {
+				fprintf( stderr, "%s: out of memory\n", progname );
+				exit(-1);
+			}
+		}
+		p = &pictures[npictures++];
+		memset( p, 0, sizeof *p );
+		n = strlen( dir );
+		p->path = malloc( n + strlen( e->d_name ) + 2 );
+		if (p->path == NULL) {
+			fprintf( stderr, "%s: out of memory\n", progname );
+			exit(-1);
+		}
+		sprintf( p->path, "%s/%s", dir, e->d_name );
+		p->name = p->path + n + 1;
+		p->box = box;
+		added++;
+	}
+	closedir( d );
+	return added;
+}
+
+static void read_picture( struct worker *w, struct picture *p )
+{
+	struct card_image gray;
+
+	p->err = card_image_load( &gray, p->path, 1, &w->image );
+	if (p->err == CARD_OK)
+		p->err = card_scan_image( &gray, geometry, &p->scan, &w->scan );
+	if ((p->err == CARD_OK) && print)
+		card_scan_print( &gray, geometry, &codec, correct, &p->scan );
+	w->pictures++;
+}
+
+static void *work( void *arg )
+{
+	struct worker *w = arg;
+
+	for (;;) {
+		long i;
+		pthread_mutex_lock( &lock );
+		i = next++;
+		pthread_mutex_unlock( &lock );
+		if (i >= npictures) break;
+		read_picture( w, &pictures[i] );
+	}
+	return NULL;
+}
+
+/* read every picture on n workers */
+static void read_all( int n )
+{
+	static struct worker workers[MAX_WORKERS];
+	int i;
+
+	next = 0;
+	for (i = 0; i < n; i++) {
+		memset( &workers[i], 0, sizeof workers[i] );
+		if (pthread_create( &workers[i].thread, NULL, work,
+				    &workers[i] ) != 0) {
+			fprintf( stderr, "%s: cannot start worker %d\n",
+				 progname, i + 1 );
+			exit(-1);
+		}
+	}
+	for (i = 0; i < n; i++) {
+		pthread_join( workers[i].thread, NULL );
+		card_image_work_free( &workers[i].image );
+		card_scan_work_free( &workers[i].scan );
+	}
+}
+
+/* the deck and the list for one box; returns nonzero if a picture
+   could not be read */
+static int write_box( const char *dir, int box, const char *out_dir,
+		      const struct card_options *opt, double check )
+{
+	char *base, *name;
+	const char *slash;
+	FILE *deck, *list;
+	long i, cards = 0;
+	int failed = 0;
+
+	/* the box's name is the last part of its directory's */
+	base = strdup( dir );
+	if (base == NULL) {
+		fprintf( stderr, "%s: out of memory\n", progname );
+		exit(-1);
+	}
+	while ((strlen( base ) > 1) && (base[strlen( base ) - 1] == '/'))
+		base[strlen( base ) - 1] = '\0';
+	slash = strrchr( base, '/' );
+	slash = (slash == NULL) ? base : slash + 1;
+	name = malloc( strlen( out_dir ) + strlen( slash ) + 8 );
+	if (name == NULL) {
+		fprintf( stderr, "%s: out of memory\n", progname );
+		exit(-1);
+	}
+	sprintf( name, "%s/%s.h8%c", out_dir, slash, (opt->format == 80) ? '0' : '2' );
+	deck = fopen( name, "wb" );
+	sprintf( name, "%s/%s.txt", out_dir, slash );
+	list = fopen( name, "w" );
+	if ((deck == NULL) || (list == NULL)) {
+		fprintf( stderr, "%s %s: cannot create\n", progname, name );
+		exit(-1);
+	}
+
+	fputs( (opt->format == 80) ? "H80" : "H82", deck );
+	for (i = 0; i < npictures; i++) {
+		const struct picture *p = &pictures[i];
+		unsigned char card[3 + 123];
+
+		if (p->box != box) continue;
+		if (p->err != CARD_OK) {
+			fprintf( list, "     - %-24s %s\n", p->name,
+				 card_strerror( p->err ) );
+			failed = 1;
+			continue;
+		}
+		fwrite( card, 1, card_scan_card( &p->scan, opt, card ), deck );
+		fprintf( list, "%6ld %-24s %4.2f %3d%s%s", ++cards, p->name,
+			 p->scan.confidence, p->scan.doubtful,
+			 p->scan.turned ? " turned" : "",
+			 ((p->scan.confidence < check) || p->scan.differ)
+			 ? " check" : "" );
+		if (print)
+			fprintf( list, " %s %d %d", p->scan.interpreted
+				 ? "printed" : "unprinted", p->scan.differ,
+				 p->scan.corrected );
+		putc( '\n', list );
+	}
+	if ((fclose( deck ) != 0) || (fclose( list ) != 0)) {
+		fprintf( stderr, "%s %s: error writing\n", progname, dir );
+		exit(-1);
+	}
+	free( base );
+	free( name );
+	return failed;
+}
+
+static void usage( void )
+{
+	fprintf( stderr, "\n%s [options] box ...\n\n", progname );
+	fprintf( stderr,
+	"Read the pictures of cards in each box's directory into a deck.\n"
+	"The options are:\n\n"
+	" -out dir        put the decks and lists of confidence in dir (.)\n"
+	" -workers n      pictures read at once (one per processor)\n"
+	" -ipunch         the cards are drawn as the editor draws them\n"
+	" -check c        mark cards read with less confidence (0.5)\n"
+	" -print          check the printing of interpreted cards\n"
+	" -correct        and punch what it says where they differ\n"
+	" -bench          time reading on one worker and on all instead\n\n"
+	" -H80 -H82       columns per card (H80 default)\n"
+	" -026comm        the keypunch, for -print\n"
+	" -029 -026ftn    (029 default)\n"
+	" -EBCDIC\n\n"
+	"and the card colors and the like of cardmake.\n\n"
+	);
+	exit(-1);
+}
+
+int main( int argc, char *argv[] )
+{
+	struct card_options opt;
+	const char *out_dir = ".";
+	double check = 0.5, start, took;
+	int nworkers = (int)sysconf( _SC_NPROCESSORS_ONLN );
+	int arg = 1, first, box, failed = 0, bench = 0;
+	long i, read = 0;
+
+	progname = argv[0];
+	card_options_init( &opt );
+	while ((arg < argc) && (argv[arg][0] == '-')) { /* command line arg */
+		if (card_make_option( &opt, argv[arg] )) {
+			/* a card header option */
+		} else if ((strcmp(argv[arg],"-out") == 0) && (arg + 1 < argc)) {
+			out_dir = argv[++arg];
+		} else if ((strcmp(argv[arg],"-workers") == 0) && (arg + 1 < argc)) {
+			nworkers = atoi( argv[++arg] );
+		} else if (strcmp(argv[arg],"-ipunch") == 0) {
+			geometry = &card_geometry_ipunch;
+		} else if ((strcmp(argv[arg],"-check") == 0) && (arg + 1 < argc)) {
+			check = atof( argv[++arg] );
+		} else if (strcmp(argv[arg],"-print") == 0) {
+			print = 1;
+		} else if (strcmp(argv[arg],"-correct") == 0) {
+			print = correct = 1;
+		} else if (strcmp(argv[arg],"-bench") == 0) {
+			bench = 1;
+		} else if (strcmp(argv[arg],"-help") == 0) {
+			usage();
+		} else {
+			fprintf( stderr, "%s: unknown option %s;"
+					 " -help available\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+		arg++;
+	}
+	if (nworkers < 1) nworkers = 1;
+	if (nworkers > MAX_WORKERS) nworkers = MAX_WORKERS;
+	if (arg == argc) {
+		fprintf( stderr, "%s: no boxes; -help available\n", argv[0] );
+		exit(-1);
+	}
+
+	card_codec_init( &codec, &opt );
+	first = arg;
+	for (box = 0; arg < argc; arg++, box++) add_box( argv[arg], box );
+	qsort( pictures, npictures, sizeof *pictures, picture_order );
+
+	if (bench) {
+		double rate[2];
+		int pass;
+		for (pass = 0; pass < 2; pass++) {
+			int workers = (pass == 0) ? 1 : nworkers;
+			start = now();
+			read_all( workers );
+			rate[pass] = npictures / (now() - start);
+			printf( "%3d workers: %8.1f cards/s\n", workers, rate[pass] );
+		}
+		printf( "%.2f times the throughput of one worker\n",
+			rate[1] / rate[0] );
+		exit(0);
+	}
+
+	if ((mkdir( out_dir, 0777 ) != 0) && (errno != EEXIST)) {
+		fprintf( stderr, "%s %s: %s\n", argv[0], out_dir, strerror( errno ) );
+		exit(-1);
+	}
+	start = now();
+	read_all( nworkers );
+	took = now() - start;
+	for (box = 0; first + box < argc; box++)
+		if (write_box( argv[first + box], box, out_dir, &opt, check ) != 0)
+			failed = 1;
+	for (i = 0; i < npictures; i++) {
+		if (pictures[i].err == CARD_OK) read++;
+		free( pictures[i].path );
+	}
+	free( pictures );
+	printf( "%ld cards of %ld pictures in %d boxes on %d workers in %.3f s,"
+		" %.1f cards/s\n", read, npictures, box, nworkers, took,
+		npictures / took );
+	exit(failed ? 1 : 0);
+}
@@ -0,0 +1,202 @@
+/* cardcache.c -- cards already drawn, kept in memory by content.
+ *
+ * see cardcache.h
+ *
+ * The hash is 64-bit FNV-1a over the key, finished with a mixing step,
+ * as in ftncache.c; its low bits pick a bucket, and the entries in a
+ * bucket are chained.  There are at least twice as many buckets as
+ * entries, so chains are short.  The entries are also on a doubly
+ * linked list, newest first, that a hit moves its entry to the front
+ * of and an eviction takes from the back of.  Entries, chains and list
+ * are indices into arrays made at the start, so nothing is allocated
+ * while drawing.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "cardconv.h"
+#include "cardcache.h"
+
+#define FNV_PRIME	0x100000001b3ULL
+#define FNV_OFFSET	0xcbf29ce484222325ULL
+
+struct card_cache_entry {
+	uint64_t hash;
+	uint16_t cols[80];
+	unsigned char look;	/* color, stripe, corner and cut */
+	unsigned char form;
+	const struct card_codec *print;
+	int32_t chain;		/* next in the bucket */
+	int32_t newer, older;	/* on the LRU list */
+};
+
+static uint64_t fnv( uint64_t h, const void *data, size_t len )
+{
+	const unsigned char *p = data;
+
+	while (len-- > 0) {
+		h ^= *p++;
+		h *= FNV_PRIME;
+	}
+	return h;
+}
+
+/* the finishing step of splitmix64 */
+static uint64_t mix( uint64_t h )
+{
+	h ^= h >> 30;
+	h *= 0xbf58476d1ce4e5b9ULL;
+	h ^= h >> 27;
+	h *= 0x94d049bb133111ebULL;
+	return h ^ (h >> 31);
+}
+
+int card_cache_init( struct card_cache *cache, const struct card_atlas *atlas,
+		     int shrink, size_t budget )
+{
+	size_t each;
+	uint32_t buckets = 1;
+
+	memset( cache, 0, sizeof *cache );
+	cache->atlas = atlas;
+	cache->shrink = shrink;
+	cache->width = atlas->width;
+	cache->height = atlas->height;
+	for (; (shrink > 0) && (cache->width > 1) && (cache->height > 1); shrink--) {
+		cache->width /= 2;
+		cache->height /= 2;
+	}
+	cache->bitmap = (size_t)cache->width * cache->height * 4;
+	each = cache->bitmap + sizeof (struct card_cache_entry) + 2 * sizeof (int32_t);
+	cache->capacity = (long)(budget / each);
+	if (cache->capacity < 1) cache->capacity = 1;
+	if (cache->capacity > (1L << 24)) cache->capacity = 1L << 24;
+	while (buckets < 2 * (uint32_t)cache->capacity) buckets *= 2;
+	cache->mask = buckets - 1;
+
+	cache->entries = malloc( cache->capacity * sizeof *cache->entries );
+	cache->pixels = malloc( cache->capacity * cache->bitmap );
+	if (cache->shrink > 0)
+		cache->scratch = malloc( (size_t)atlas->width * atlas->height * 4 );
+	cache->buckets = malloc( buckets * sizeof *cache->buckets );
+	if ((cache->entries == NULL) || (cache->pixels == NULL)
+	 || ((cache->shrink > 0) && (cache->scratch == NULL))
+	 || (cache->buckets == NULL)) {
+		card_cache_free( cache );
+		return CARD_ENOMEM;
+	}
+	card_cache_clear( cache );
+	return CARD_OK;
+}
+
+void card_cache_free( struct card_cache *cache )
+{
+	free( cache->entries );
+	free( cache->pixels );
+	free( cache->scratch );
+	free( cache->buckets );
+	memset( cache, 0, sizeof *cache );
+}
+
+void card_cache_clear( struct card_cache *cache )
+{
+	memset( cache->buckets, 0xff, (cache->mask + 1) * sizeof *cache->buckets );
+	cache->newest = cache->oldest = -1;
+	cache->cards = 0;
+}
+
+static void unlink_lru( struct card_cache *cache, int32_t i )
+{
+	struct card_cache_entry *e = cache->entries + i;
+
+	if (e->newer >= 0) cache->entries[e->newer].older = e->older;
+	else cache->newest = e->older;
+	if (e->older >= 0) cache->entries[e->older].newer = e->newer;
+	else cache->oldest = e->newer;
+}
+
+static void push_lru( struct card_cache *cache, int32_t i )
+{
+	struct card_cache_entry *e = cache->entries + i;
+
+	e->newer = -1;
+	e->older = cache->newest;
+	if (cache->newest >= 0) cache->entries[cache->newest].newer = i;
+	else cache->oldest = i;
+	cache->newest = i;
+}
+
+/* take entry i out of its bucket's chain */
+static void unchain( struct card_cache *cache, int32_t i )
+{
+	int32_t *p = cache->buckets + (cache->entries[i].hash & cache->mask);
+
+	while (*p != i) p = &cache->entries[*p].chain;
+	*p = cache->entries[i].chain;
+}
+
+const unsigned char *card_cache_draw( struct card_cache *cache,
+				      const uint16_t *cols,
+				      const unsigned char *header,
+				      const struct card_codec *print )
+{
+	const struct card_atlas *a = cache->atlas;
+	unsigned char key[2];
+	struct card_cache_entry *e;
+	uint64_t h;
+	int32_t *bucket, i;
+
+	key[0] = (header != NULL) ? header[0] & 0x7f : 0;
+	key[1] = (header != NULL) ? header[1] & 0x07 : 0;
+	h = fnv( FNV_OFFSET, cols, 80 * sizeof *cols );
+	h = fnv( h, key, sizeof key );
+	h = fnv( h, &print, sizeof print );
+	h = mix( h );
+
+	bucket = cache->buckets + (h & cache->mask);
+	for (i = *bucket; i >= 0; i = e->chain) {
+		e = cache->entries + i;
+		if ((e->hash == h) && (e->look == key[0]) && (e->form == key[1])
+		 && (e->print == print)
+		 && (memcmp( e->cols, cols, sizeof e->cols ) == 0)) {
+			cache->hits++;
+			if (cache->newest != i) {
+				unlink_lru( cache, i );
+				push_lru( cache, i );
+			}
+			return cache->pixels + (size_t)i * cache->bitmap;
+		}
+	}
+
+	/* a miss: draw it into a free entry, or the oldest */
+	cache->misses++;
+	if (cache->cards < cache->capacity) {
+		i = (int32_t)cache->cards++;
+	} else {
+		i = cache->oldest;
+		unlink_lru( cache, i );
+		unchain( cache, i );
+		cache->evictions++;
+		cache->evicted_bytes += cache->bitmap;
+	}
+	e = cache->entries + i;
+	e->hash = h;
+	memcpy( e->cols, cols, sizeof e->cols );
+	e->look = key[0];
+	e->form = key[1];
+	e->print = print;
+	e->chain = *bucket;
+	*bucket = i;
+	push_lru( cache, i );
+
+	if (cache->shrink == 0) {
+		card_render( a, cols, print, cache->pixels + (size_t)i * cache->bitmap );
+	} else {
+		card_render( a, cols, print, cache->scratch );
+		card_render_shrink( cache->scratch, a->width, a->height, cache->shrink );
+		memcpy( cache->pixels + (size_t)i * cache->bitmap, cache->scratch,
+			cache->bitmap );
+	}
+	return cache->pixels + (size_t)i * cache->bitmap;
+}
@@ -0,0 +1,68 @@
+/* cardcache.h -- cards already drawn, kept in memory by content.
+ *
+ * A deck scrolled through a view draws the same cards again and again:
+ * those scrolled back to, and in most decks many cards that are alike,
+ * blank cards, continuation cards, the cards of a data set.  The cache
+ * keys a drawing by a hash of the card's 80 12-bit columns and the
+ * header bits it is drawn from, the color and stripe, corner and cut
+ * of the first header byte and the form of the second, and whether and
+ * how it is printed; a card that is in it costs a hash and a compare
+ * of its key, not a drawing.  The key is kept whole beside the drawing,
+ * so two cards with the same hash are never confused.
+ *
+ * The drawings are those of card_render from one atlas, shrunk shrink
+ * times, each width by height RGBA.  The cache holds as many as fit in
+ * its byte budget, drawings and keys, all allocated when it is made;
+ * when a new card will not fit, the card drawn least recently is
+ * dropped for it.  card_cache_draw returns the card's drawing, good
+ * until the next card_cache_draw.  A codec is known by its address, so
+ * one changed in place, as when another keypunch is chosen, needs a
+ * card_cache_clear, which drops every drawing.
+ *
+ * card_cache_init returns CARD_OK or CARD_ENOMEM, and holds at least
+ * one card whatever the budget.  A cache is not safe to share between
+ * threads; each may have its own of the one atlas.
+ *
+ */
+
+#ifndef CARDCACHE_H
+#define CARDCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cardrender.h"
+
+struct card_cache_entry;
+
+struct card_cache {
+	const struct card_atlas *atlas;
+	int shrink;
+	int width, height;	/* of a drawing, shrunk */
+	size_t bitmap;		/* bytes in a drawing */
+	long capacity;		/* drawings the budget holds */
+
+	/* what this cache has seen */
+	long hits, misses;
+	long evictions;		/* drawings dropped to keep to the budget */
+	long long evicted_bytes;
+	long cards;		/* drawings held now */
+
+	/* the drawings, and the lists they are found by */
+	struct card_cache_entry *entries;
+	unsigned char *pixels;	/* capacity drawings */
+	unsigned char *scratch;	/* a drawing before it is shrunk */
+	int32_t *buckets;	/* first entry with each hash, or -1 */
+	uint32_t mask;		/* buckets - 1 */
+	int32_t newest, oldest;	/* the LRU list, or -1 */
+};
+
+int card_cache_init( struct card_cache *cache, const struct card_atlas *atlas,
+		     int shrink, size_t budget );
+void card_cache_free( struct card_cache *cache );
+const unsigned char *card_cache_draw( struct card_cache *cache,
+				      const uint16_t *cols,
+				      const unsigned char *header,
+				      const struct card_codec *print );
+void card_cache_clear( struct card_cache *cache );
+
+#endif /* CARDCACHE_H */
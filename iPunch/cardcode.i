@@ -8,6 +8,10 @@
  * card code (on conversion from ASCII to card codes) or as
  * a code with a bit set outside the least significant 12.
  *
+ * The arrays are static const uint16_t, so <stdint.h> must be
+ * included first; cardcodec.c is the one file that includes this,
+ * and everything else reaches the tables through a struct card_codec.
+ *
  * author:  Douglas Jones, jones@cs.uiowa.edu
  * revisions:
  *	    March 5, 1996
@@ -19,7 +23,7 @@
    to Digital's "Small Computer Handbook, 1973", and augmented to
    translate lower case to upper case.  As a result of this modification,
    inversion of this table should be done with care! */
-int o29_code[] = {
+static const uint16_t o29_code[128] = {
 		ERROR,ERROR,ERROR,ERROR,ERROR,ERROR,ERROR,ERROR, /* control */
 		ERROR,ERROR,ERROR,ERROR,ERROR,ERROR,ERROR,ERROR, /* chars   */
 		ERROR,ERROR,ERROR,ERROR,ERROR,ERROR,ERROR,ERROR, /* control */
@@ -39,7 +43,7 @@ int o29_code[] = {
 	};
 
 /* Bare bones 026 kepunch encodings */
-int o26_ftn_code[] = {
+static const uint16_t o26_ftn_code[128] = {
 		ERROR,ERROR,ERROR,ERROR,ERROR,ERROR,ERROR,ERROR, /* control */
 		ERROR,ERROR,ERROR,ERROR,ERROR,ERROR,ERROR,ERROR, /* chars   */
 		ERROR,ERROR,ERROR,ERROR,ERROR,ERROR,ERROR,ERROR, /* control */
@@ -58,7 +62,7 @@ int o26_ftn_code[] = {
 		01004,01002,01001,ERROR,ERROR,ERROR,ERROR,ERROR  /* xyz{|}~  */
 	};
 
-int o26_comm_code[] = {
+static const uint16_t o26_comm_code[128] = {
 		ERROR,ERROR,ERROR,ERROR,ERROR,ERROR,ERROR,ERROR, /* control */
 		ERROR,ERROR,ERROR,ERROR,ERROR,ERROR,ERROR,ERROR, /* chars   */
 		ERROR,ERROR,ERROR,ERROR,ERROR,ERROR,ERROR,ERROR, /* control */
@@ -81,7 +85,7 @@ int o26_comm_code[] = {
    1977, Reinhart Press, San Francisco.  Codes not in that table have been
    left compatable with DEC's 029 table.  Some control codes have been
    left out */
-int EBCDIC_code[] = {
+static const uint16_t EBCDIC_code[128] = {
 		05403,ERROR,ERROR,ERROR,ERROR,ERROR,ERROR,ERROR, /* control */
 		02011,04021,01021,ERROR,04041,02021,ERROR,ERROR, /* chars   */
 		ERROR,ERROR,ERROR,ERROR,ERROR,ERROR,ERROR,ERROR, /* control */
@@ -0,0 +1,144 @@
+/* cardcodec.c -- card code translation context.
+ *
+ * The tables come from cardcode.i; cardcodec.c is the only file that
+ * includes it, and every tool that converts text to or from card codes
+ * does so through a struct card_codec.
+ * The decoding rules in card_codec_init are those cardlist.c used to
+ * apply to its own global table.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "cardcodec.h"
+#define ERROR CARD_ILLEGAL
+#include "cardcode.i"
+
+void card_options_init( struct card_options *opt )
+{
+	/* defaults are those of cardmake */
+	opt->format = 80;
+	opt->color = 0;
+	opt->corner = 0;
+	opt->cut = 2;
+	opt->interp = 0;
+	opt->punch = 4;
+	opt->table = CARD_029;
+	opt->form = 1;
+	opt->logo = 0;
+}
+
+/* accept one cardmake option; returns 1 if arg was recognized */
+int card_make_option( struct card_options *opt, const char *arg )
+{
+	static const char *colors[] = {
+		"-cream", "-white", "-yellow", "-pink",
+		"-blue", "-green", "-orange", "-brown"
+	};
+	static const char *cuts[] = {
+		"-uncut", "-right", "-left", "-both"
+	};
+	static const char *forms[] = {
+		"-blank", "-5081", "-507536", "-5280",
+		"-327", "-733727", "-888157"
+	};
+	int i;
+
+	for ( i = 0; i < 8; i++ ) {
+		if (strcmp(arg,colors[i]) == 0) {
+			opt->color |= i;
+			return 1;
+		}
+	}
+	for ( i = 0; i < 4; i++ ) {
+		if (strcmp(arg,cuts[i]) == 0) {
+			opt->cut = i;
+			return 1;
+		}
+	}
+	for ( i = 0; i < 7; i++ ) {
+		if (strcmp(arg,forms[i]) == 0) {
+			opt->form = i;
+			opt->logo = 0;
+			return 1;
+		}
+	}
+	if (strcmp(arg,"-H80") == 0) {
+		opt->format = 80;
+	} else if (strcmp(arg,"-H82") == 0) {
+		opt->format = 82;
+	} else if (strcmp(arg,"-stripe") == 0) {
+		opt->color |= 8;
+	} else if (strcmp(arg,"-round") == 0) {
+		opt->corner = 0;
+	} else if (strcmp(arg,"-square") == 0) {
+		opt->corner = 1;
+	} else if (strcmp(arg,"-interp") == 0) {
+		opt->interp = 1;
+	} else if (strcmp(arg,"-noprint") == 0) {
+		opt->punch = 0;
+	} else if (strcmp(arg,"-026comm") == 0) {
+		opt->punch = opt->table = CARD_026COMM;
+	} else if (strcmp(arg,"-026ftn") == 0) {
+		opt->punch = opt->table = CARD_026FTN;
+	} else if (strcmp(arg,"-029") == 0) {
+		opt->punch = opt->table = CARD_029;
+	} else if (strcmp(arg,"-EBCDIC") == 0) {
+		opt->punch = 0;
+		opt->table = CARD_EBCDIC;
+	} else if (strcmp(arg,"-FORTRAN") == 0) {
+		opt->form = 6;
+		opt->logo = 0;
+	} else {
+		return 0;
+	}
+	return 1;
+}
+
+/* accept one cardlist option; returns 1 if arg was recognized */
+int card_list_option( struct card_options *opt, const char *arg )
+{
+	if (strcmp(arg,"-026comm") == 0) {
+		opt->table = CARD_026COMM;
+	} else if (strcmp(arg,"-026ftn") == 0) {
+		opt->table = CARD_026FTN;
+	} else if ((strcmp(arg,"-029") == 0)
+		|| (strcmp(arg,"-029ftn") == 0)) {
+		opt->table = CARD_029;
+	} else if (strcmp(arg,"-EBCDIC") == 0) {
+		opt->table = CARD_EBCDIC;
+	} else {
+		return 0;
+	}
+	return 1;
+}
+
+/* fill in a codec; after this it is read only, and may be shared */
+void card_codec_init( struct card_codec *codec,
+		      const struct card_options *opt )
+{
+	const uint16_t *code;
+	int i;
+
+	codec->opt = *opt;
+	if (opt->table == CARD_026COMM) {
+		code = o26_comm_code;
+	} else if (opt->table == CARD_026FTN) {
+		code = o26_ftn_code;
+	} else if (opt->table == CARD_029) {
+		code = o29_code;
+	} else { /* CARD_EBCDIC */
+		code = EBCDIC_code;
+	}
+	memcpy( codec->encode, code, sizeof codec->encode );
+
+	/* make appropriate card to ascii translation table */
+	memset( codec->decode, '~', sizeof codec->decode );
+	if (opt->table == CARD_EBCDIC) {
+		for ( i = 0; i <= 0177; i++ )
+			codec->decode[ code[i] ] = i;
+	} else {
+		for ( i = ' '; i < '`'; i++ )
+			codec->decode[ code[i] ] = i;
+	}
+}
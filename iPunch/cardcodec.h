@@ -0,0 +1,59 @@
+/* cardcodec.h -- card code translation context.
+ *
+ * A codec holds everything needed to translate between ASCII and card
+ * columns for one keypunch: the encoding and decoding tables, and the
+ * format and card header options they go with.  It is filled in once by
+ * card_codec_init and never written again, so any number of threads may
+ * share one through a const pointer without locking.  The tables are
+ * 16 and 8 bits wide so that a codec fits in well under 5K.
+ *
+ */
+
+#ifndef CARDCODEC_H
+#define CARDCODEC_H
+
+#include <stdint.h>
+
+/* the card code for characters the keypunch cannot punch */
+#define CARD_ILLEGAL	00404
+
+/* translation tables, numbered as in cardmake */
+#define CARD_026COMM	1
+#define CARD_026FTN	2
+#define CARD_029	4
+#define CARD_EBCDIC	8
+
+/* everything cardmake puts in the card header, plus table and format */
+struct card_options {
+	int format;	/* 80 or 82 columns */
+	int color;
+	int corner;
+	int cut;
+	int interp;
+	int punch;
+	int table;	/* one of CARD_026COMM .. CARD_EBCDIC */
+	int form;
+	int logo;
+};
+
+struct card_codec {
+	struct card_options opt;
+	uint16_t encode[128];	/* 7-bit ASCII to 12-bit card code */
+	uint8_t decode[4096];	/* 12-bit card code to ASCII, ~ if illegal */
+};
+
+/* the card code for one character; non-ASCII cannot be punched */
+#define card_encode( codec, ch ) \
+	(((ch) & ~0177) ? CARD_ILLEGAL : (codec)->encode[(ch)])
+
+/* the character for one 12-bit column */
+#define card_decode( codec, col ) ((codec)->decode[(col) & 07777])
+
+void card_options_init( struct card_options *opt );
+int card_make_option( struct card_options *opt, const char *arg );
+int card_list_option( struct card_options *opt, const char *arg );
+
+void card_codec_init( struct card_codec *codec,
+		      const struct card_options *opt );
+
+#endif /* CARDCODEC_H */
@@ -0,0 +1,333 @@
+/* cardconv.c -- in-memory conversion between ASCII text and card images.
+ *
+ * card_make_buffer follows the main loop of cardmake.c and
+ * card_list_buffer follows the main loop of cardlist.c; any change in
+ * the output of either tool must be made here as well.
+ *
+ * The translation tables and options come from a struct card_codec, which
+ * is never written here, so many threads may convert at once sharing a
+ * single codec.
+ *
+ * see the README file for details of the card image file format!
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cardconv.h"
+
+int card_buf_reserve( struct card_buf *buf, size_t size )
+{
+	unsigned char *data;
+	size_t cap;
+
+	if (size <= buf->cap) return CARD_OK;
+	cap = buf->cap ? buf->cap : 4096;
+	while (cap < size) cap *= 2;
+	data = realloc( buf->data, cap );
+	if (data == NULL) return CARD_ENOMEM;
+	buf->data = data;
+	buf->cap = cap;
+	return CARD_OK;
+}
+
+/* give back storage when one big file has inflated a buffer */
+void card_buf_trim( struct card_buf *buf, size_t limit )
+{
+	if (buf->cap > limit) card_buf_free( buf );
+	buf->len = 0;
+}
+
+void card_buf_free( struct card_buf *buf )
+{
+	free( buf->data );
+	buf->data = NULL;
+	buf->len = buf->cap = 0;
+}
+
+/* bytes per card image, including the 3 byte card header */
+static size_t card_size( int format )
+{
+	return (format == 80) ? 3 + 120 : 3 + 123;
+}
+
+/* worst case output of card_make_buffer; an empty line is one card */
+size_t card_make_bound( const struct card_codec *codec, size_t text_len )
+{
+	return 3 + (text_len + 1) * card_size( codec->opt.format );
+}
+
+/* worst case output of card_list_buffer; 81 columns plus newline per card */
+size_t card_list_bound( size_t deck_len )
+{
+	return (deck_len / (3 + 120) + 1) * 83;
+}
+
+int card_make_buffer( const struct card_codec *codec,
+		      const unsigned char *text, size_t len,
+		      struct card_buf *out )
+{
+	return card_make_buffer_opt( codec, &codec->opt, text, len, out );
+}
+
+/* as card_make_buffer, with codec's tables but the format and card
+   header of opt, so a shared codec serves any options */
+int card_make_buffer_opt( const struct card_codec *codec,
+			  const struct card_options *opt,
+			  const unsigned char *text, size_t len,
+			  struct card_buf *out )
+{
+	const unsigned char *end = text + len;
+	unsigned char *dst;
+	int err;
+
+	err = card_buf_reserve( out, 3 + (len + 1) * card_size( opt->format ) );
+	if (err != CARD_OK) return err;
+	dst = out->data;
+
+	/* output file prefix */
+	*dst++ = 'H';
+	*dst++ = '8';
+	*dst++ = (opt->format == 80) ? '0' : '2';
+
+	for (;;) {
+		unsigned char line[82]; /* size allows for H82 format */
+		int src_col = 1;
+		int max_col;
+		line[0] = ' ';
+		line[81] = ' ';
+		while (src_col < 81) {
+			int cur_char = (text < end) ? *text++ : EOF;
+			if ((cur_char == EOF) && (src_col == 1)) break;
+			if ((cur_char == EOF) || (cur_char == '\n')) {
+				while (src_col < 81) { /* blank out card */
+					line[src_col] = ' ';
+					src_col++;
+				}
+			} else if (cur_char == '\t') {
+				do {
+					line[src_col] = ' ';
+					src_col++;
+				} while(((src_col & 07) != 1)&&(src_col < 81));
+			} else {
+				line[src_col] = cur_char;
+				src_col++;
+			}
+		}
+		if (src_col == 1) break; /* avoid blank card for early EOF */
+
+		/* put out prefix on card */
+		*dst++ = 0x80 | (opt->color << 3) | (opt->corner << 2)
+		       | opt->cut;
+		*dst++ = 0x80 | (opt->interp << 6) | (opt->punch << 3)
+		       | opt->form;
+		*dst++ = 0x80 | opt->logo;
+
+		if (opt->format == 80) {
+			src_col = 1;
+			max_col = 80;
+		} else { /* H82 */
+			src_col = 0;
+			max_col = 81;
+		}
+		while (src_col <= max_col) {
+			int even_col, odd_col; /* corresponding 12 bit codes */
+
+			/* convert two columns, non-ASCII is illegal */
+			even_col = card_encode( codec, line[src_col] );
+			src_col++;
+			odd_col = card_encode( codec, line[src_col] );
+			src_col++;
+
+			/* divide 2 columns into 3 bytes */
+			*dst++ = even_col >> 4;
+			*dst++ = ((even_col & 017) << 4) | (odd_col >> 8);
+			*dst++ = odd_col & 00377;
+		}
+		if (text >= end) break; /* cardmake stops on feof */
+	}
+	out->len = dst - out->data;
+	return CARD_OK;
+}
+
+int card_list_buffer( const struct card_codec *codec,
+		      const unsigned char *deck, size_t len,
+		      struct card_buf *out )
+{
+	const unsigned char *end = deck + len;
+	size_t card_bytes;
+	int format;
+	unsigned char *dst;
+	int err;
+
+	/* check for prefix on input */
+	if ((len < 3) || (deck[0] != 'H') || (deck[1] != '8')) {
+		return CARD_ENOTCARD;
+	} else if (deck[2] == '0') {
+		format = 80;
+	} else if (deck[2] == '2') {
+		format = 82;
+	} else {
+		return CARD_ENOTCARD;
+	}
+	deck += 3;
+	card_bytes = card_size( format );
+
+	err = card_buf_reserve( out, card_list_bound( len ) );
+	if (err != CARD_OK) return err;
+	dst = out->data;
+
+	while (deck < end) {
+		unsigned char line[83];
+		int cur_col, max_col;
+
+		/* verify that we have a whole card */
+		if (((size_t)(end - deck) < card_bytes)
+		||  ((deck[0] & 0x80)==0)
+		||  ((deck[1] & 0x80)==0)
+		||  ((deck[2] & 0x80)==0)) {
+			return CARD_ECORRUPT;
+		}
+		deck += 3;
+
+		if (format == 80) {
+			cur_col = 1;
+			max_col = 80;
+		} else { /* format == 82 */
+			cur_col = 0;
+			max_col = 81;
+		}
+		while ( cur_col < max_col ) {
+			int even_col, odd_col;
+
+			/* convert 3 bytes to 2 columns */
+			even_col = (deck[0] << 4) | (deck[1] >> 4);
+			odd_col = ((deck[1] & 0017) << 8) | deck[2];
+			deck += 3;
+
+			/* pack result into line */
+			line[cur_col] = card_decode( codec, even_col );
+			cur_col++;
+			line[cur_col] = card_decode( codec, odd_col );
+			cur_col++;
+		}
+		line[cur_col] = (char)0;
+
+		/* truncate trailing blanks */
+		cur_col = max_col;
+		while ((cur_col >= 1) && (line[cur_col] == ' ')) {
+			line[cur_col] = (char)0;
+			cur_col--;
+		}
+
+		/* like fputs, stop at an embedded NUL */
+		for (cur_col = 1; line[cur_col] != 0; cur_col++)
+			*dst++ = line[cur_col];
+		*dst++ = '\n';
+	}
+	out->len = dst - out->data;
+	return CARD_OK;
+}
+
+/* check the prefix and every card header, counting the cards */
+int card_validate_buffer( const unsigned char *deck, size_t len,
+			  long *ncards )
+{
+	const unsigned char *end = deck + len;
+	size_t card_bytes;
+
+	*ncards = 0;
+	if ((len < 3) || (deck[0] != 'H') || (deck[1] != '8')
+	||  ((deck[2] != '0') && (deck[2] != '2'))) {
+		return CARD_ENOTCARD;
+	}
+	card_bytes = card_size( (deck[2] == '0') ? 80 : 82 );
+	for (deck += 3; deck < end; deck += card_bytes) {
+		if (((size_t)(end - deck) < card_bytes)
+		||  ((deck[0] & 0x80)==0)
+		||  ((deck[1] & 0x80)==0)
+		||  ((deck[2] & 0x80)==0)) {
+			return CARD_ECORRUPT;
+		}
+		(*ncards)++;
+	}
+	return CARD_OK;
+}
+
+/* append one deck to out as cardcat would; out is always H82 */
+int card_concat_buffer( const unsigned char *deck, size_t len,
+			struct card_buf *out )
+{
+	const unsigned char *end = deck + len;
+	size_t card_bytes;
+	long ncards;
+	unsigned char *dst;
+	int inform, err;
+
+	err = card_validate_buffer( deck, len, &ncards );
+	if (err != CARD_OK) return err;
+	inform = (deck[2] == '0') ? 80 : 82;
+	card_bytes = card_size( inform );
+	if (card_buf_reserve( out, out->len + 3 + ncards * card_size( 82 ) )
+	    != CARD_OK) {
+		return CARD_ENOMEM;
+	}
+	dst = out->data + out->len;
+	if (out->len == 0) { /* output always in H82 format */
+		*dst++ = 'H';
+		*dst++ = '8';
+		*dst++ = '2';
+	}
+
+	for (deck += 3; deck < end; deck += card_bytes) {
+		int line[82];  /* the 12-bit data columns */
+		const unsigned char *src = deck + 3;
+		int cur_col, first_col, last_col;
+
+		if (inform == 80) {
+			first_col = 1;
+			last_col = 80;
+			line[0] = line[81] = 0;
+		} else { /* inform == 82 */
+			first_col = 0;
+			last_col = 81;
+		}
+
+		/* read the data from the card */
+		for (cur_col = first_col; cur_col < last_col; src += 3) {
+			line[cur_col] = (src[0] << 4) | (src[1] >> 4);
+			cur_col++;
+			line[cur_col] = ((src[1] & 017) << 8) | src[2];
+			cur_col++;
+		}
+
+		/* the card header, then the data as 82 columns */
+		*dst++ = deck[0];
+		*dst++ = deck[1];
+		*dst++ = deck[2];
+		for (cur_col = 0; cur_col < 81; cur_col += 2) {
+			*dst++ = line[cur_col] >> 4;
+			*dst++ = ((line[cur_col] & 017) << 4)
+			       | (line[cur_col + 1] >> 8);
+			*dst++ = line[cur_col + 1] & 0377;
+		}
+	}
+	out->len = dst - out->data;
+	return CARD_OK;
+}
+
+const char *card_strerror( int err )
+{
+	switch (err) {
+		case CARD_OK:		return "no error";
+		case CARD_ENOMEM:	return "out of memory";
+		case CARD_ENOTCARD:	return "not a card file";
+		case CARD_ECORRUPT:	return "input corrupt";
+		case CARD_EIO:		return "i/o error";
+		case CARD_EPROTO:	return "protocol error";
+		case CARD_EIMAGE:	return "not a PNG or PNM image";
+		case CARD_ENOCARD:	return "no whole card found in the image";
+	}
+	return "unknown error";
+}
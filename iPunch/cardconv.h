@@ -0,0 +1,63 @@
+/* cardconv.h -- in-memory conversion between ASCII text and card images.
+ *
+ * These routines do the same work as the main loops of cardmake and
+ * cardlist, but on buffers instead of stdio streams, so that one process
+ * can convert many files without paying process startup for each one.
+ * Output is byte-for-byte what cardmake and cardlist would produce.
+ * card_make_buffer_opt takes the format and card header from its own
+ * options rather than the codec's, so one codec's tables can serve
+ * callers wanting different cards.
+ *
+ * see the README file for details of the card image file format!
+ *
+ */
+
+#ifndef CARDCONV_H
+#define CARDCONV_H
+
+#include <stddef.h>
+#include "cardcodec.h"
+
+/* error returns; all routines return CARD_OK or one of these */
+#define CARD_OK		0
+#define CARD_ENOMEM	-1	/* buffer could not be grown */
+#define CARD_ENOTCARD	-2	/* missing H80 or H82 prefix */
+#define CARD_ECORRUPT	-3	/* card header lacks 0x80 bits, or short */
+#define CARD_EIO	-4	/* read or write failed, see errno */
+#define CARD_EPROTO	-5	/* malformed request to carddaemon */
+#define CARD_EIMAGE	-6	/* not an image cardimage can read */
+#define CARD_ENOCARD	-7	/* no whole card to be seen in the image */
+
+/* a growable byte buffer; workers keep one of these per thread */
+struct card_buf {
+	unsigned char *data;
+	size_t len;	/* bytes in use */
+	size_t cap;	/* bytes allocated */
+};
+
+int card_buf_reserve( struct card_buf *buf, size_t size );
+void card_buf_trim( struct card_buf *buf, size_t limit );
+void card_buf_free( struct card_buf *buf );
+
+size_t card_make_bound( const struct card_codec *codec, size_t text_len );
+size_t card_list_bound( size_t deck_len );
+
+int card_make_buffer( const struct card_codec *codec,
+		      const unsigned char *text, size_t len,
+		      struct card_buf *out );
+int card_make_buffer_opt( const struct card_codec *codec,
+			  const struct card_options *opt,
+			  const unsigned char *text, size_t len,
+			  struct card_buf *out );
+int card_list_buffer( const struct card_codec *codec,
+		      const unsigned char *deck, size_t len,
+		      struct card_buf *out );
+
+int card_validate_buffer( const unsigned char *deck, size_t len,
+			  long *ncards );
+int card_concat_buffer( const unsigned char *deck, size_t len,
+			struct card_buf *out );
+
+const char *card_strerror( int err );
+
+#endif /* CARDCONV_H */
@@ -0,0 +1,173 @@
+/* cardd.c -- client library for the card conversion daemon.
+ *
+ * One client is one connection, used by one thread at a time; each
+ * call sends a request and waits for its reply.  Threads that want
+ * requests in parallel should each connect.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include "cardd.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0	/* macOS: the caller ignores SIGPIPE instead */
+#endif
+
+struct cardd_client {
+	int fd;
+	uint32_t next_id;
+};
+
+struct cardd_client *cardd_connect( const char *path )
+{
+	struct cardd_client *client;
+	struct sockaddr_un addr;
+
+	if (path == NULL) path = CARDD_SOCKET;
+	if (strlen( path ) >= sizeof addr.sun_path) {
+		errno = ENAMETOOLONG;
+		return NULL;
+	}
+	client = calloc( 1, sizeof *client );
+	if (client == NULL) return NULL;
+
+	memset( &addr, 0, sizeof addr );
+	addr.sun_family = AF_UNIX;
+	strcpy( addr.sun_path, path );
+	client->fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+	if ((client->fd < 0)
+	||  (connect( client->fd, (struct sockaddr *)&addr, sizeof addr ) != 0)) {
+		int saved = errno;
+		if (client->fd >= 0) close( client->fd );
+		free( client );
+		errno = saved;
+		return NULL;
+	}
+	return client;
+}
+
+void cardd_disconnect( struct cardd_client *client )
+{
+	if (client == NULL) return;
+	close( client->fd );
+	free( client );
+}
+
+/* send the header and payload with one gather write where possible */
+static int send_frame( int fd, struct cardd_header *h, const void *payload )
+{
+	struct iovec iov[2], *v = iov;
+	struct msghdr msg;
+	int n = 2;
+
+	iov[0].iov_base = h;
+	iov[0].iov_len = sizeof *h;
+	iov[1].iov_base = (void *)payload;
+	iov[1].iov_len = h->length;
+	memset( &msg, 0, sizeof msg );
+	while (n > 0) {
+		ssize_t put;
+		msg.msg_iov = v;
+		msg.msg_iovlen = n;
+		put = sendmsg( fd, &msg, MSG_NOSIGNAL );
+		if (put < 0) {
+			if (errno == EINTR) continue;
+			return -1;
+		}
+		while ((n > 0) && ((size_t)put >= v->iov_len)) {
+			put -= v->iov_len;
+			v++;
+			n--;
+		}
+		if (n > 0) {
+			v->iov_base = (char *)v->iov_base + put;
+			v->iov_len -= put;
+		}
+	}
+	return 0;
+}
+
+static int recv_all( int fd, void *buf, size_t len )
+{
+	char *p = buf;
+	while (len > 0) {
+		ssize_t got = read( fd, p, len );
+		if (got < 0) {
+			if (errno == EINTR) continue;
+			return -1;
+		}
+		if (got == 0) {
+			errno = ECONNRESET;
+			return -1;
+		}
+		p += got;
+		len -= got;
+	}
+	return 0;
+}
+
+/* one round trip; returns the reply status, or CARD_EIO if the
+   connection failed, in which case the client should be dropped */
+int cardd_request( struct cardd_client *client, int op,
+		   const struct card_options *opt,
+		   const void *payload, size_t len,
+		   struct card_buf *reply )
+{
+	struct card_options defaults;
+	struct cardd_header h;
+
+	memset( &h, 0, sizeof h );
+	h.length = len;
+	h.id = ++client->next_id;
+	h.magic = CARDD_MAGIC;
+	h.op = op;
+	if (opt == NULL) { /* cardmake defaults */
+		card_options_init( &defaults );
+		opt = &defaults;
+	}
+	h.table = opt->table;
+	h.format = opt->format;
+	h.color = opt->color;
+	h.corner = opt->corner;
+	h.cut = opt->cut;
+	h.interp = opt->interp;
+	h.punch = opt->punch;
+	h.form = opt->form;
+	h.logo = opt->logo;
+	if (send_frame( client->fd, &h, payload ) != 0) return CARD_EIO;
+
+	for (;;) {
+		if (recv_all( client->fd, &h, sizeof h ) != 0) return CARD_EIO;
+		if (h.magic != CARDD_MAGIC) return CARD_EPROTO;
+		reply->len = 0;
+		if (card_buf_reserve( reply, h.length ) != CARD_OK)
+			return CARD_ENOMEM;
+		if (recv_all( client->fd, reply->data, h.length ) != 0)
+			return CARD_EIO;
+		reply->len = h.length;
+		if (h.id == client->next_id) break;
+		/* a late reply to an abandoned request; skip it */
+	}
+	return h.status;
+}
+
+/* add one deck to a CARDD_CONCAT payload */
+int cardd_concat_add( struct card_buf *payload, const void *deck,
+		      size_t len )
+{
+	uint32_t n = len;
+	if (card_buf_reserve( payload, payload->len + sizeof n + len )
+	    != CARD_OK) {
+		return CARD_ENOMEM;
+	}
+	memcpy( payload->data + payload->len, &n, sizeof n );
+	memcpy( payload->data + payload->len + sizeof n, deck, len );
+	payload->len += sizeof n + len;
+	return CARD_OK;
+}
@@ -0,0 +1,66 @@
+/* cardd.h -- protocol and client library for the card conversion daemon.
+ *
+ * carddaemon listens on a Unix domain socket.  Every request and every
+ * reply is one frame: a fixed header, in host byte order since both ends
+ * share a machine, followed by length bytes of payload.
+ *
+ *   CARDD_ENCODE    payload is ASCII text, reply is a deck, as cardmake
+ *   CARDD_DECODE    payload is a deck, reply is ASCII text, as cardlist
+ *   CARDD_VALIDATE  payload is a deck, reply is its card count, as a
+ *                   uint32_t, and a status saying whether it is sound
+ *   CARDD_CONCAT    payload is a series of decks, each preceded by its
+ *                   length as a uint32_t; reply is one H82 deck, as
+ *                   cardcat (which, unlike cardcat, deletes nothing)
+ *
+ * A reply carries the id and op of its request, and a status that is
+ * CARD_OK or one of the CARD_Exxx errors from cardconv.h.  Requests on
+ * one connection may be answered out of order; match them by id.
+ *
+ */
+
+#ifndef CARDD_H
+#define CARDD_H
+
+#include <stdint.h>
+#include "cardconv.h"
+
+#define CARDD_SOCKET	"/tmp/carddaemon.sock"
+#define CARDD_MAGIC	0xCA7D
+
+#define CARDD_ENCODE	1
+#define CARDD_DECODE	2
+#define CARDD_VALIDATE	3
+#define CARDD_CONCAT	4
+
+struct cardd_header {
+	uint32_t length;	/* payload bytes following the header */
+	uint32_t id;		/* chosen by the client, echoed in the reply */
+	uint16_t magic;		/* CARDD_MAGIC */
+	uint16_t op;		/* CARDD_ENCODE .. CARDD_CONCAT */
+	int16_t status;		/* replies only */
+	uint8_t table;		/* CARD_026COMM .. CARD_EBCDIC */
+	uint8_t format;		/* 80 or 82, for CARDD_ENCODE */
+	uint8_t color;		/* card header fields, for CARDD_ENCODE */
+	uint8_t corner;
+	uint8_t cut;
+	uint8_t interp;
+	uint8_t punch;
+	uint8_t form;
+	uint8_t logo;
+	uint8_t spare;
+};
+
+struct cardd_client;
+
+struct cardd_client *cardd_connect( const char *path );
+void cardd_disconnect( struct cardd_client *client );
+
+int cardd_request( struct cardd_client *client, int op,
+		   const struct card_options *opt,
+		   const void *payload, size_t len,
+		   struct card_buf *reply );
+
+int cardd_concat_add( struct card_buf *payload, const void *deck,
+		      size_t len );
+
+#endif /* CARDD_H */
@@ -0,0 +1,594 @@
+/* carddaemon.c -- serve card conversions over a Unix domain socket.
+ *
+ * operation:  run carddaemon -help for instructions
+ *
+ * build: cc -o carddaemon carddaemon.c cardconv.c cardcodec.c -lpthread
+ *
+ * One thread polls the listening socket and every connection, reading
+ * frames (see cardd.h) into request buffers.  A finished request is
+ * handed to the worker pool by pointer; the worker converts straight
+ * out of that buffer into its own reply buffer and sends the header and
+ * reply with one gather write, so the payload is never copied on the
+ * way through.  Request buffers are then recycled, so a steady load of
+ * small requests does no allocation at all.
+ *
+ * A connection with CONN_QUEUE requests waiting or being served, or any
+ * connection while the requests waiting hold QUEUE_BYTES of payload, is
+ * not read until a worker makes room, so a client sending faster than
+ * the workers convert is held back by its socket, not queued without
+ * end; the worker making room wakes the poll thread through a pipe.
+ *
+ * The translation tables are built once, at startup, and shared; a
+ * request's format and card header are options of its own.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include "cardd.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define MAX_CONNS	1024
+#define MAX_WORKERS	64
+#define FREE_KEEP	256		/* recycled request buffers kept */
+#define BUF_KEEP	(1 << 20)	/* largest buffer kept for reuse */
+#define CONN_QUEUE	64		/* requests in hand, per connection */
+#define QUEUE_BYTES	(256 << 20)	/* payload waiting, in all */
+
+struct conn {
+	int fd;
+	int refs;		/* the poll loop, plus requests in flight */
+	int queued;		/* requests in flight */
+	pthread_mutex_t wlock;	/* replies are written one at a time */
+	struct request *req;	/* frame being read, poll thread only */
+	size_t got;		/* bytes of it read so far */
+};
+
+struct request {
+	struct request *next;
+	struct conn *conn;
+	struct cardd_header h;
+	struct card_buf payload;
+};
+
+struct worker {
+	pthread_t thread;
+	struct card_buf out;
+	long served;
+};
+
+static char *progname;
+static const char *sock_path = CARDD_SOCKET;
+static size_t max_frame = 64 << 20;
+static struct card_codec codecs[4];	/* 026comm, 026ftn, 029, EBCDIC */
+static volatile sig_atomic_t stopping = 0;
+
+/* the request queue and free list, and connection reference counts */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t not_empty = PTHREAD_COND_INITIALIZER;
+static struct request *queue_head = NULL, *queue_tail = NULL;
+static struct request *free_list = NULL;
+static int nfree = 0;
+static int queue_done = 0;
+static size_t queue_bytes = 0;		/* payload of the requests in flight */
+static int held = 0;			/* a connection is not being read */
+static int wake_fd[2];			/* to the poll thread, for room made */
+
+static struct request *request_get( void )
+{
+	struct request *req;
+	pthread_mutex_lock( &lock );
+	req = free_list;
+	if (req != NULL) {
+		free_list = req->next;
+		nfree--;
+	}
+	pthread_mutex_unlock( &lock );
+	if (req == NULL) req = calloc( 1, sizeof *req );
+	return req;
+}
+
+static void request_put( struct request *req )
+{
+	card_buf_trim( &req->payload, BUF_KEEP );
+	pthread_mutex_lock( &lock );
+	if (nfree < FREE_KEEP) {
+		req->next = free_list;
+		free_list = req;
+		nfree++;
+		req = NULL;
+	}
+	pthread_mutex_unlock( &lock );
+	if (req != NULL) {
+		card_buf_free( &req->payload );
+		free( req );
+	}
+}
+
+/* queue a request; returns whether its connection may send more */
+static int queue_put( struct request *req )
+{
+	int room;
+
+	pthread_mutex_lock( &lock );
+	req->conn->refs++;
+	req->conn->queued++;
+	queue_bytes += req->h.length;
+	room = (req->conn->queued < CONN_QUEUE) && (queue_bytes < QUEUE_BYTES);
+	req->next = NULL;
+	if (queue_tail != NULL) {
+		queue_tail->next = req;
+	} else {
+		queue_head = req;
+	}
+	queue_tail = req;
+	pthread_cond_signal( &not_empty );
+	pthread_mutex_unlock( &lock );
+	return room;
+}
+
+static struct request *queue_get( void )
+{
+	struct request *req;
+	pthread_mutex_lock( &lock );
+	while ((queue_head == NULL) && !queue_done)
+		pthread_cond_wait( &not_empty, &lock );
+	req = queue_head;
+	if (req != NULL) {
+		queue_head = req->next;
+		if (queue_head == NULL) queue_tail = NULL;
+	}
+	pthread_mutex_unlock( &lock );
+	return req;
+}
+
+/* a request of length bytes served; if a connection is being held
+   back, wake the poll thread to see whether it may be read again */
+static void queue_room( struct conn *c, size_t length )
+{
+	int wake;
+
+	pthread_mutex_lock( &lock );
+	c->queued--;
+	queue_bytes -= length;
+	wake = held;
+	held = 0;
+	pthread_mutex_unlock( &lock );
+	if (wake) {
+		char b = 0;
+		while ((write( wake_fd[1], &b, 1 ) < 0) && (errno == EINTR))
+			;
+	}
+}
+
+/* whether a connection may be read from now */
+static int may_read( struct conn *c )
+{
+	int room;
+
+	pthread_mutex_lock( &lock );
+	room = (c->queued < CONN_QUEUE) && (queue_bytes < QUEUE_BYTES);
+	if (!room) held = 1;
+	pthread_mutex_unlock( &lock );
+	return room;
+}
+
+static void conn_release( struct conn *c )
+{
+	int last;
+	pthread_mutex_lock( &lock );
+	last = (--c->refs == 0);
+	pthread_mutex_unlock( &lock );
+	if (last) {
+		close( c->fd );
+		pthread_mutex_destroy( &c->wlock );
+		free( c );
+	}
+}
+
+/* gather write that waits out a full socket buffer */
+static int send_reply( int fd, struct cardd_header *h, const void *payload )
+{
+	struct iovec iov[2], *v = iov;
+	struct msghdr msg;
+	int n = 2;
+
+	iov[0].iov_base = h;
+	iov[0].iov_len = sizeof *h;
+	iov[1].iov_base = (void *)payload;
+	iov[1].iov_len = h->length;
+	memset( &msg, 0, sizeof msg );
+	while (n > 0) {
+		ssize_t put;
+		msg.msg_iov = v;
+		msg.msg_iovlen = n;
+		put = sendmsg( fd, &msg, MSG_NOSIGNAL );
+		if (put < 0) {
+			struct pollfd p;
+			if (errno == EINTR) continue;
+			if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+				return -1;
+			p.fd = fd;
+			p.events = POLLOUT;
+			if (poll( &p, 1, 30000 ) <= 0) return -1;
+			continue;
+		}
+		while ((n > 0) && ((size_t)put >= v->iov_len)) {
+			put -= v->iov_len;
+			v++;
+			n--;
+		}
+		if (n > 0) {
+			v->iov_base = (char *)v->iov_base + put;
+			v->iov_len -= put;
+		}
+	}
+	return 0;
+}
+
+/* the shared codec for a request's table, and its options in opt */
+static const struct card_codec *codec_for( const struct cardd_header *h,
+					   struct card_options *opt )
+{
+	int which;
+
+	switch (h->table) {
+		case CARD_026COMM:	which = 0; break;
+		case CARD_026FTN:	which = 1; break;
+		case CARD_029:		which = 2; break;
+		case CARD_EBCDIC:	which = 3; break;
+		default:		return NULL;
+	}
+	if (((h->format != 80) && (h->format != 82))
+	||  (h->color > 15) || (h->corner > 1) || (h->cut > 3)
+	||  (h->interp > 1) || (h->punch > 7) || (h->form > 7)
+	||  (h->logo > 0177)) {
+		return NULL;
+	}
+	opt->table = h->table;
+	opt->format = h->format;
+	opt->color = h->color;
+	opt->corner = h->corner;
+	opt->cut = h->cut;
+	opt->interp = h->interp;
+	opt->punch = h->punch;
+	opt->form = h->form;
+	opt->logo = h->logo;
+	return &codecs[which];
+}
+
+static int concat( const unsigned char *p, size_t len, struct card_buf *out )
+{
+	const unsigned char *end = p + len;
+	while (p < end) {
+		uint32_t n;
+		int err;
+		if ((size_t)(end - p) < sizeof n) return CARD_EPROTO;
+		memcpy( &n, p, sizeof n );
+		p += sizeof n;
+		if ((size_t)(end - p) < n) return CARD_EPROTO;
+		err = card_concat_buffer( p, n, out );
+		if (err != CARD_OK) return err;
+		p += n;
+	}
+	return CARD_OK;
+}
+
+static void serve( struct worker *w, struct request *req )
+{
+	struct cardd_header reply = req->h;
+	struct card_options opt;
+	const struct card_codec *codec;
+	const unsigned char *in = req->payload.data;
+	size_t len = req->h.length;
+	uint32_t ncards = 0;
+	const void *payload = w->out.data;
+	int err = CARD_OK;
+
+	w->out.len = 0;
+	codec = codec_for( &req->h, &opt );
+	if (codec == NULL) {
+		err = CARD_EPROTO;
+	} else if (req->h.op == CARDD_ENCODE) {
+		err = card_make_buffer_opt( codec, &opt, in, len, &w->out );
+	} else if (req->h.op == CARDD_DECODE) {
+		err = card_list_buffer( codec, in, len, &w->out );
+	} else if (req->h.op == CARDD_VALIDATE) {
+		long n;
+		err = card_validate_buffer( in, len, &n );
+		ncards = n;
+		payload = &ncards;
+	} else if (req->h.op == CARDD_CONCAT) {
+		err = concat( in, len, &w->out );
+	} else {
+		err = CARD_EPROTO;
+	}
+
+	reply.status = err;
+	if (req->h.op == CARDD_VALIDATE) {
+		reply.length = sizeof ncards;
+	} else {
+		reply.length = (err == CARD_OK) ? w->out.len : 0;
+		payload = w->out.data;
+	}
+
+	pthread_mutex_lock( &req->conn->wlock );
+	send_reply( req->conn->fd, &reply, payload );
+	pthread_mutex_unlock( &req->conn->wlock );
+	card_buf_trim( &w->out, BUF_KEEP );
+	w->served++;
+}
+
+static void *work( void *arg )
+{
+	struct worker *w = arg;
+	struct request *req;
+
+	while ((req = queue_get()) != NULL) {
+		struct conn *c = req->conn;
+		size_t length = req->h.length;
+		serve( w, req );
+		request_put( req );
+		queue_room( c, length );
+		conn_release( c );
+	}
+	return NULL;
+}
+
+/* read what is waiting on a connection; returns -1 when it is done */
+static int conn_read( struct conn *c )
+{
+	for (;;) {
+		struct request *req = c->req;
+		size_t want;
+		char *into;
+		ssize_t got;
+
+		if (req == NULL) {
+			req = c->req = request_get();
+			if (req == NULL) return -1;
+			req->conn = c;
+			c->got = 0;
+		}
+		if (c->got < sizeof req->h) {
+			into = (char *)&req->h + c->got;
+			want = sizeof req->h - c->got;
+		} else {
+			into = (char *)req->payload.data
+			     + (c->got - sizeof req->h);
+			want = sizeof req->h + req->h.length - c->got;
+		}
+		got = (want > 0) ? read( c->fd, into, want ) : 0;
+		if (got < 0) {
+			if (errno == EINTR) continue;
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+				return 0;
+			return -1;
+		}
+		if ((got == 0) && (want > 0)) return -1; /* closed */
+		c->got += got;
+
+		if (c->got == sizeof req->h) { /* header complete */
+			if ((req->h.magic != CARDD_MAGIC)
+			||  (req->h.length > max_frame)) {
+				struct cardd_header bad = req->h;
+				bad.magic = CARDD_MAGIC;
+				bad.status = CARD_EPROTO;
+				bad.length = 0;
+				pthread_mutex_lock( &c->wlock );
+				send_reply( c->fd, &bad, NULL );
+				pthread_mutex_unlock( &c->wlock );
+				return -1; /* cannot find the next frame */
+			}
+			req->payload.len = 0;
+			if (card_buf_reserve( &req->payload, req->h.length )
+			    != CARD_OK) {
+				return -1;
+			}
+		}
+		if ((c->got >= sizeof req->h)
+		&&  (c->got == sizeof req->h + req->h.length)) {
+			req->payload.len = req->h.length;
+			c->req = NULL;
+			if (!queue_put( req )) /* hand off, no copy */
+				return 0; /* and read no more until there is room */
+		}
+	}
+}
+
+static void stop( int sig )
+{
+	(void)sig;
+	stopping = 1;
+}
+
+static void usage( void )
+{
+	fprintf( stderr, "\n%s [options]\n\n", progname );
+	fprintf( stderr,
+	"Serve encode, decode, validate and concatenate requests on a\n"
+	"Unix domain socket, so that callers converting many small decks\n"
+	"need not start cardmake or cardlist for each one.  The options\n"
+	"are:\n\n"
+	" -socket path    where to listen (default " CARDD_SOCKET ")\n\n"
+	" -j n            worker threads (default: one per processor)\n\n"
+	" -max megabytes  largest request accepted (default 64)\n\n"
+	);
+	exit(-1);
+}
+
+int main( int argc, char *argv[] )
+{
+	static struct conn *conns[MAX_CONNS];
+	static struct pollfd fds[MAX_CONNS + 2];
+	struct worker *workers;
+	struct sockaddr_un addr;
+	struct card_options opt;
+	static const int tables[4] = {
+		CARD_026COMM, CARD_026FTN, CARD_029, CARD_EBCDIC
+	};
+	int nconns = 0, nworkers = 0;
+	long served = 0;
+	int listen_fd, arg = 1, i;
+
+	progname = argv[0];
+	while ((arg < argc) && (argv[arg][0] == '-')) { /* command line arg */
+		if ((strcmp(argv[arg],"-socket") == 0) && (arg + 1 < argc)) {
+			sock_path = argv[++arg];
+		} else if ((strcmp(argv[arg],"-j") == 0) && (arg + 1 < argc)) {
+			nworkers = atoi( argv[++arg] );
+		} else if ((strcmp(argv[arg],"-max") == 0) && (arg + 1 < argc)) {
+			max_frame = (size_t)atol( argv[++arg] ) << 20;
+		} else if (strcmp(argv[arg],"-help") == 0) {
+			usage();
+		} else {
+			fprintf( stderr, "%s: unknown option %s;"
+					 " -help available\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+		arg++;
+	}
+	if (arg < argc) {
+		fprintf( stderr, "%s: too many arguments\n", argv[0] );
+		exit(-1);
+	}
+
+	for (i = 0; i < 4; i++) {
+		card_options_init( &opt );
+		opt.table = tables[i];
+		card_codec_init( &codecs[i], &opt );
+	}
+
+	memset( &addr, 0, sizeof addr );
+	addr.sun_family = AF_UNIX;
+	if (strlen( sock_path ) >= sizeof addr.sun_path) {
+		fprintf( stderr, "%s %s: socket path too long\n",
+			 argv[0], sock_path );
+		exit(-1);
+	}
+	strcpy( addr.sun_path, sock_path );
+	listen_fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+	unlink( sock_path ); /* a stale socket from an earlier run */
+	if ((listen_fd < 0)
+	||  (bind( listen_fd, (struct sockaddr *)&addr, sizeof addr ) != 0)
+	||  (listen( listen_fd, 128 ) != 0)) {
+		fprintf( stderr, "%s %s: %s\n", argv[0], sock_path,
+			 strerror( errno ) );
+		exit(-1);
+	}
+	fcntl( listen_fd, F_SETFL, O_NONBLOCK );
+	if (pipe( wake_fd ) != 0) {
+		fprintf( stderr, "%s: %s\n", argv[0], strerror( errno ) );
+		exit(-1);
+	}
+	fcntl( wake_fd[0], F_SETFL, O_NONBLOCK );
+	fcntl( wake_fd[1], F_SETFL, O_NONBLOCK );
+
+	signal( SIGPIPE, SIG_IGN );
+	signal( SIGINT, stop );
+	signal( SIGTERM, stop );
+
+	if (nworkers <= 0) nworkers = (int)sysconf( _SC_NPROCESSORS_ONLN );
+	if (nworkers <= 0) nworkers = 1;
+	if (nworkers > MAX_WORKERS) nworkers = MAX_WORKERS;
+	workers = calloc( nworkers, sizeof *workers );
+	if (workers == NULL) {
+		fprintf( stderr, "%s: out of memory\n", argv[0] );
+		exit(-1);
+	}
+	for (i = 0; i < nworkers; i++) {
+		if (pthread_create( &workers[i].thread, NULL,
+				    work, &workers[i] ) != 0) {
+			fprintf( stderr, "%s: cannot start workers\n", argv[0] );
+			exit(-1);
+		}
+	}
+
+	while (!stopping) {
+		int ready;
+
+		fds[0].fd = listen_fd;
+		fds[0].events = POLLIN;
+		fds[1].fd = wake_fd[0];
+		fds[1].events = POLLIN;
+		for (i = 0; i < nconns; i++) {
+			fds[i + 2].fd = conns[i]->fd;
+			fds[i + 2].events = may_read( conns[i] ) ? POLLIN : 0;
+		}
+		ready = poll( fds, nconns + 2, 250 );
+		if (ready <= 0) continue;
+		if (fds[1].revents & POLLIN) {
+			char b[64];
+			while (read( wake_fd[0], b, sizeof b ) > 0)
+				;
+		}
+
+		/* service connections, dropping those that are done */
+		for (i = nconns - 1; i >= 0; i--) {
+			if (fds[i + 2].revents == 0) continue;
+			if (conn_read( conns[i] ) != 0) {
+				struct conn *c = conns[i];
+				if (c->req != NULL) request_put( c->req );
+				c->req = NULL;
+				shutdown( c->fd, SHUT_RD );
+				conns[i] = conns[--nconns];
+				conn_release( c );
+			}
+		}
+
+		if (fds[0].revents & POLLIN) for (;;) {
+			struct conn *c;
+			int fd = accept( listen_fd, NULL, NULL );
+			if (fd < 0) break;
+			if (nconns == MAX_CONNS) {
+				close( fd );
+				continue;
+			}
+			c = calloc( 1, sizeof *c );
+			if (c == NULL) {
+				close( fd );
+				continue;
+			}
+			fcntl( fd, F_SETFL, O_NONBLOCK );
+			c->fd = fd;
+			c->refs = 1;
+			pthread_mutex_init( &c->wlock, NULL );
+			conns[nconns++] = c;
+		}
+	}
+
+	/* shut down: finish what is queued, then stop the workers */
+	close( listen_fd );
+	unlink( sock_path );
+	pthread_mutex_lock( &lock );
+	queue_done = 1;
+	pthread_cond_broadcast( &not_empty );
+	pthread_mutex_unlock( &lock );
+	for (i = 0; i < nworkers; i++) {
+		pthread_join( workers[i].thread, NULL );
+		served += workers[i].served;
+		card_buf_free( &workers[i].out );
+	}
+	close( wake_fd[0] );
+	close( wake_fd[1] );
+	for (i = 0; i < nconns; i++) {
+		if (conns[i]->req != NULL) request_put( conns[i]->req );
+		conn_release( conns[i] );
+	}
+	fprintf( stderr, "%s: %ld requests served\n", argv[0], served );
+	exit(0);
+}
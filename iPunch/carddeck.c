@@ -0,0 +1,353 @@
+/* carddeck.c -- a deck of any length, scrolled through a view of cards.
+ *
+ * see carddeck.h
+ *
+ * Each slot of a scroll is empty, being drawn, or holds the drawing of
+ * the card it names.  The card a slot is for changes only under the
+ * lock, and a slot being drawn is left alone by everyone but its
+ * drawer, who draws with the lock released; the view's cards and the
+ * ahead cards are never more than rows + ahead apart, so the thread,
+ * which draws only ahead cards, never has the slot of a card in the
+ * view.  A card wanted while its slot is being drawn, for it or for a
+ * card since scrolled out of reach, waits for the drawing to finish.
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cardconv.h"
+#include "carddeck.h"
+
+/* the state of a slot */
+#define EMPTY	0
+#define BUSY	1	/* being drawn */
+#define READY	2
+
+struct slot {
+	long card;		/* or -1 */
+	int state;
+};
+
+struct card_scroll {
+	const struct card_deck *deck;
+	const struct card_atlas *atlas;
+	const struct card_codec *codec;
+	int print, shrink;
+	int rows, ahead, nslots;
+	int width, height;	/* of a drawing, shrunk */
+	size_t bitmap;
+	struct slot *slots;
+	unsigned char *pixels;	/* nslots drawings */
+	unsigned char *scratch[2];	/* the view's and the thread's */
+	struct card_cache *cache[2];	/* the same, or NULL */
+
+	pthread_mutex_t lock;
+	pthread_cond_t work;	/* the view moved, or the scroll is closing */
+	pthread_cond_t done;	/* a slot was drawn */
+	pthread_t thread;
+	long top;
+	int down;		/* the way the view last moved */
+	int stop;
+	struct card_scroll_figures figures;
+};
+
+int card_deck_open( struct card_deck *deck, FILE *f )
+{
+	struct stat st;
+	int fd = fileno( f );
+
+	memset( deck, 0, sizeof *deck );
+	if ((fstat( fd, &st ) == 0) && S_ISREG( st.st_mode ) && (st.st_size > 0)) {
+		void *map = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+		if (map != MAP_FAILED) {
+			posix_madvise( map, st.st_size, POSIX_MADV_RANDOM );
+			deck->map = map;
+			deck->data = map;
+			deck->len = st.st_size;
+		}
+	}
+	if (deck->map == NULL) {
+		size_t cap = 1 << 16, got;
+		unsigned char *buf = malloc( cap );
+		while ((buf != NULL) && ((got = fread( buf + deck->len, 1,
+						       cap - deck->len, f )) > 0)) {
+			deck->len += got;
+			if (deck->len == cap) buf = realloc( buf, cap *= 2 );
+		}
+		if (buf == NULL) return CARD_ENOMEM;
+		if (ferror( f )) {
+			free( buf );
+			return CARD_EIO;
+		}
+		deck->data = buf;
+	}
+
+	if ((deck->len < 3) || (deck->data[0] != 'H') || (deck->data[1] != '8')
+	||  ((deck->data[2] != '0') && (deck->data[2] != '2'))) {
+		card_deck_close( deck );
+		return CARD_ENOTCARD;
+	}
+	deck->format = (deck->data[2] == '0') ? 80 : 82;
+	deck->card_bytes = 3 + deck->format * 3 / 2;
+	if ((deck->len - 3) % deck->card_bytes != 0) {
+		card_deck_close( deck );
+		return CARD_ECORRUPT;
+	}
+	deck->ncards = (long)((deck->len - 3) / deck->card_bytes);
+	return CARD_OK;
+}
+
+void card_deck_close( struct card_deck *deck )
+{
+	if (deck->map != NULL) munmap( deck->map, deck->len );
+	else free( (void *)deck->data );
+	memset( deck, 0, sizeof *deck );
+}
+
+const unsigned char *card_deck_card( const struct card_deck *deck, long i,
+				     uint16_t cols[80] )
+{
+	const unsigned char *card = deck->data + 3 + (size_t)i * deck->card_bytes;
+	const unsigned char *p = card + 3;
+	uint16_t all[82];
+	int c;
+
+	if (((card[0] & 0x80) == 0) || ((card[1] & 0x80) == 0)
+	||  ((card[2] & 0x80) == 0)) {
+		return NULL;
+	}
+	for (c = 0; c < deck->format; c += 2, p += 3) {
+		all[c] = (p[0] << 4) | (p[1] >> 4);
+		all[c + 1] = ((p[1] & 0017) << 8) | p[2];
+	}
+	memcpy( cols, all + ((deck->format == 82) ? 1 : 0), 80 * sizeof *cols );
+	return card;
+}
+
+/* draw card i into slot s, unlocked, with the view's scratch and cache
+   or the thread's; a damaged card is drawn blank */
+static void draw( struct card_scroll *scroll, long i, int s, int who )
+{
+	const struct card_atlas *a = scroll->atlas;
+	unsigned char *out = scroll->pixels + (size_t)s * scroll->bitmap;
+	const unsigned char *header;
+	const struct card_codec *print = NULL;
+	uint16_t cols[80];
+
+	header = card_deck_card( scroll->deck, i, cols );
+	if (header == NULL) {
+		memset( cols, 0, sizeof cols );
+	} else if ((scroll->print > 0)
+		|| ((scroll->print < 0) && (header[1] & 0x40))) {
+		print = scroll->codec;
+	}
+	if (scroll->cache[who] != NULL) {
+		memcpy( out, card_cache_draw( scroll->cache[who], cols, header, print ),
+			scroll->bitmap );
+		return;
+	}
+	if (scroll->shrink == 0) {
+		card_render( a, cols, print, out );
+		return;
+	}
+	card_render( a, cols, print, scroll->scratch[who] );
+	card_render_shrink( scroll->scratch[who], a->width, a->height,
+			    scroll->shrink );
+	memcpy( out, scroll->scratch[who], scroll->bitmap );
+}
+
+/* the next ahead card not drawn, nearest the view first, or -1 */
+static long wanted( struct card_scroll *scroll )
+{
+	long card;
+	int k;
+
+	for (k = 0; k < scroll->ahead; k++) {
+		struct slot *s;
+		card = scroll->down ? scroll->top + scroll->rows + k
+				    : scroll->top - 1 - k;
+		if ((card < 0) || (card >= scroll->deck->ncards)) break;
+		s = scroll->slots + card % scroll->nslots;
+		if (s->state == BUSY) continue;
+		if ((s->card == card) && (s->state == READY)) continue;
+		return card;
+	}
+	return -1;
+}
+
+static void *prefetch( void *arg )
+{
+	struct card_scroll *scroll = arg;
+	long card;
+
+	pthread_mutex_lock( &scroll->lock );
+	while (!scroll->stop) {
+		struct slot *s;
+		card = wanted( scroll );
+		if (card < 0) {
+			pthread_cond_wait( &scroll->work, &scroll->lock );
+			continue;
+		}
+		s = scroll->slots + card % scroll->nslots;
+		s->card = card;
+		s->state = BUSY;
+		pthread_mutex_unlock( &scroll->lock );
+		draw( scroll, card, (int)(card % scroll->nslots), 1 );
+		pthread_mutex_lock( &scroll->lock );
+		s->state = READY;
+		scroll->figures.prefetched++;
+		pthread_cond_broadcast( &scroll->done );
+	}
+	pthread_mutex_unlock( &scroll->lock );
+	return NULL;
+}
+
+struct card_scroll *card_scroll_open( const struct card_deck *deck,
+				      const struct card_atlas *atlas,
+				      const struct card_codec *codec,
+				      int print, int shrink, int rows,
+				      int ahead, struct card_cache *view_cache,
+				      struct card_cache *ahead_cache )
+{
+	struct card_scroll *scroll = calloc( 1, sizeof *scroll );
+	int s;
+
+	if (scroll == NULL) return NULL;
+	scroll->deck = deck;
+	scroll->atlas = atlas;
+	scroll->codec = codec;
+	scroll->print = print;
+	scroll->shrink = shrink;
+	scroll->cache[0] = view_cache;
+	scroll->cache[1] = ahead_cache;
+	scroll->rows = (rows < 1) ? 1 : rows;
+	scroll->ahead = (ahead < 0) ? 0 : ahead;
+	scroll->nslots = scroll->rows + scroll->ahead;
+	scroll->width = atlas->width;
+	scroll->height = atlas->height;
+	for (; (shrink > 0) && (scroll->width > 1) && (scroll->height > 1); shrink--) {
+		scroll->width /= 2;
+		scroll->height /= 2;
+	}
+	scroll->bitmap = (size_t)scroll->width * scroll->height * 4;
+	scroll->slots = malloc( scroll->nslots * sizeof *scroll->slots );
+	scroll->pixels = malloc( scroll->nslots * scroll->bitmap );
+	if (scroll->shrink > 0) {
+		scroll->scratch[0] = malloc( (size_t)atlas->width * atlas->height * 4 );
+		scroll->scratch[1] = malloc( (size_t)atlas->width * atlas->height * 4 );
+	}
+	if ((scroll->slots == NULL) || (scroll->pixels == NULL)
+	 || ((scroll->shrink > 0)
+	  && ((scroll->scratch[0] == NULL) || (scroll->scratch[1] == NULL)))) {
+		goto fail;
+	}
+	for (s = 0; s < scroll->nslots; s++) {
+		scroll->slots[s].card = -1;
+		scroll->slots[s].state = EMPTY;
+	}
+	scroll->down = 1;
+	pthread_mutex_init( &scroll->lock, NULL );
+	pthread_cond_init( &scroll->work, NULL );
+	pthread_cond_init( &scroll->done, NULL );
+	if (pthread_create( &scroll->thread, NULL, prefetch, scroll ) != 0) {
+		pthread_mutex_destroy( &scroll->lock );
+		pthread_cond_destroy( &scroll->work );
+		pthread_cond_destroy( &scroll->done );
+		goto fail;
+	}
+	return scroll;
+
+fail:
+	free( scroll->slots );
+	free( scroll->pixels );
+	free( scroll->scratch[0] );
+	free( scroll->scratch[1] );
+	free( scroll );
+	return NULL;
+}
+
+void card_scroll_close( struct card_scroll *scroll )
+{
+	pthread_mutex_lock( &scroll->lock );
+	scroll->stop = 1;
+	pthread_cond_broadcast( &scroll->work );
+	pthread_mutex_unlock( &scroll->lock );
+	pthread_join( scroll->thread, NULL );
+	pthread_mutex_destroy( &scroll->lock );
+	pthread_cond_destroy( &scroll->work );
+	pthread_cond_destroy( &scroll->done );
+	free( scroll->slots );
+	free( scroll->pixels );
+	free( scroll->scratch[0] );
+	free( scroll->scratch[1] );
+	free( scroll );
+}
+
+void card_scroll_to( struct card_scroll *scroll, long top )
+{
+	long last = scroll->deck->ncards - scroll->rows;
+
+	if (top > last) top = last;
+	if (top < 0) top = 0;
+	pthread_mutex_lock( &scroll->lock );
+	if (top != scroll->top) {
+		scroll->down = (top > scroll->top);
+		scroll->top = top;
+		pthread_cond_signal( &scroll->work );
+	}
+	pthread_mutex_unlock( &scroll->lock );
+}
+
+const unsigned char *card_scroll_card( struct card_scroll *scroll, long i )
+{
+	struct slot *s;
+	int n = (int)(i % scroll->nslots), waited = 0;
+
+	if ((i < scroll->top) || (i >= scroll->top + scroll->rows)
+	 || (i >= scroll->deck->ncards)) {
+		return NULL;
+	}
+	s = scroll->slots + n;
+	pthread_mutex_lock( &scroll->lock );
+	while (s->state == BUSY) {
+		if (s->card == i) waited = 1;
+		pthread_cond_wait( &scroll->done, &scroll->lock );
+	}
+	if ((s->card == i) && (s->state == READY)) {
+		if (waited) scroll->figures.waited++;
+		else scroll->figures.found++;
+		pthread_mutex_unlock( &scroll->lock );
+		return scroll->pixels + (size_t)n * scroll->bitmap;
+	}
+	s->card = i;
+	s->state = BUSY;
+	pthread_mutex_unlock( &scroll->lock );
+	draw( scroll, i, n, 0 );
+	pthread_mutex_lock( &scroll->lock );
+	s->state = READY;
+	scroll->figures.drawn++;
+	pthread_cond_broadcast( &scroll->done );
+	pthread_mutex_unlock( &scroll->lock );
+	return scroll->pixels + (size_t)n * scroll->bitmap;
+}
+
+void card_scroll_size( const struct card_scroll *scroll, int *width,
+		       int *height )
+{
+	*width = scroll->width;
+	*height = scroll->height;
+}
+
+void card_scroll_figures( struct card_scroll *scroll,
+			  struct card_scroll_figures *figures )
+{
+	pthread_mutex_lock( &scroll->lock );
+	*figures = scroll->figures;
+	pthread_mutex_unlock( &scroll->lock );
+}
@@ -0,0 +1,87 @@
+/* carddeck.h -- a deck of any length, scrolled through a view of cards.
+ *
+ * A card_deck is a card-image file mapped into memory, not read: a
+ * card is found by its number, its header and columns unpacked when it
+ * is asked for, so a deck of 100,000 cards opens at once and only the
+ * pages of the cards looked at are ever read.  A file that cannot be
+ * mapped, a pipe, is read whole instead.  card_deck_open checks the
+ * H80 or H82 and that the file is whole cards; a card's own header is
+ * checked when it is unpacked, and card_deck_card returns NULL for one
+ * without its 0x80 bits.
+ *
+ * A card_scroll is the model of a view of a deck, rows cards high, at
+ * the deck's card top.  It holds rows + ahead cards drawn, card i in
+ * slot i mod rows + ahead, so whatever the deck's length its memory is
+ * that many drawings.  card_scroll_to moves the view, and which way it
+ * moved says which way it is going: a thread of the scroll's own then
+ * draws the ahead cards past the bottom of the view, going down, or
+ * above its top, going up, while the view shows what it has.  Cards
+ * scrolled past stay until their slots are wanted, so turning back
+ * finds them.  card_scroll_card gives a card in the view drawn, the
+ * prefetched drawing if there is one, or drawn there and then; it is
+ * good until the next card_scroll_to.
+ *
+ * The drawings are card_render's from atlas, shrunk shrink times; print
+ * is 1 to print every card with codec, 0 for none, and -1 for those
+ * with the interpreted bit in their headers.  The figures count the
+ * cards card_scroll_card found drawn, and those it had to draw or to
+ * wait for, and the cards the thread drew.
+ *
+ * view_cache and ahead_cache are card_caches, either or both NULL, that the view's
+ * drawings and the thread's are looked for in first, a card like one
+ * drawn before being copied from there; a cache is not shared between
+ * threads, so they are two, made by the caller from the same atlas and
+ * shrink as the scroll, and the caller's to free after card_scroll_close.
+ *
+ * card_deck_open returns CARD_OK, CARD_EIO, CARD_ENOTCARD, CARD_ECORRUPT
+ * or CARD_ENOMEM; card_scroll_open returns NULL if it is out of memory
+ * or cannot start its thread.  A scroll is used from one thread.
+ *
+ */
+
+#ifndef CARDDECK_H
+#define CARDDECK_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "cardrender.h"
+#include "cardcache.h"
+
+struct card_deck {
+	const unsigned char *data;	/* the file, H80 or H82 first */
+	size_t len;
+	long ncards;
+	int format;			/* 80 or 82 columns stored */
+	size_t card_bytes;		/* header and columns */
+	void *map;			/* as mapped, or NULL if read */
+};
+
+int card_deck_open( struct card_deck *deck, FILE *f );
+void card_deck_close( struct card_deck *deck );
+const unsigned char *card_deck_card( const struct card_deck *deck, long i,
+				     uint16_t cols[80] );
+
+struct card_scroll_figures {
+	long found;		/* drawn ahead, by the time they were wanted */
+	long drawn;		/* drawn when they were wanted */
+	long waited;		/* wanted while the thread was drawing them */
+	long prefetched;	/* drawn by the thread */
+};
+
+struct card_scroll;
+
+struct card_scroll *card_scroll_open( const struct card_deck *deck,
+				      const struct card_atlas *atlas,
+				      const struct card_codec *codec,
+				      int print, int shrink, int rows,
+				      int ahead, struct card_cache *view_cache,
+				      struct card_cache *ahead_cache );
+void card_scroll_close( struct card_scroll *scroll );
+void card_scroll_to( struct card_scroll *scroll, long top );
+const unsigned char *card_scroll_card( struct card_scroll *scroll, long i );
+void card_scroll_size( const struct card_scroll *scroll, int *width,
+		       int *height );
+void card_scroll_figures( struct card_scroll *scroll,
+			  struct card_scroll_figures *figures );
+
+#endif /* CARDDECK_H */
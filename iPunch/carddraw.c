@@ -0,0 +1,332 @@
+/* carddraw.c -- draw each card of a deck as the editor draws it.
+ *
+ * operation:  run carddraw -help for instructions
+ *
+ * build: cc -o carddraw carddraw.c carddeck.c cardcache.c cardrender.c
+ *        cardimage.c cardconv.c cardcodec.c -lz -lpthread
+ *
+ * input  -- a card-image file
+ * output -- a picture of each card, PNG unless -raw
+ *
+ * Each card is drawn by cardrender from the Assets directory, as the
+ * editor shows it: PunchedCard.png with Punch.png at each hole, and a
+ * card with the interpreted bit in its header printed along its top as
+ * the keypunch table reads it; -print prints every card, -noprint none.
+ * The pixels off the card are clear.  -shrink n halves the picture n
+ * times, for thumbnails: -shrink 2 of the plain assets is 127 by 60.
+ *
+ * With one card and no -out, the picture goes to stdout; otherwise
+ * -out gives a printf pattern for the file names, as card%03d.png,
+ * numbered from 1.  -raw writes bare RGBA rows, top first, with no
+ * header, and with no -out the cards go to stdout one after another,
+ * for a program that reads them as a stream; -v gives their size, and
+ * the rate they were drawn and written at, on stderr.
+ *
+ * -bench n draws the deck n times, writing nothing, and reports the
+ * rate cards are drawn at.  With -scroll h it draws instead as a view
+ * h cards high shows the deck scrolled from top to bottom and back a
+ * card at a time, every card in the view at each step, n times.
+ *
+ * -cache m keeps the last m megabytes of drawings, by cardcache, so a
+ * card drawn before, or one just like it, is not drawn again; -v and
+ * -bench then report its hits, misses and evictions.  -ahead a scrolls
+ * instead through the deck's file by the card_scroll of carddeck, as a
+ * viewer would, a cards drawn ahead of the view on a thread of its
+ * own, and reports how many cards were there when wanted; the deck is
+ * not read first, so its length does not matter.  With -cache too the
+ * view and the thread each keep m megabytes, a cache being for one
+ * thread, and both are reported.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "cardconv.h"
+#include "cardimage.h"
+#include "carddeck.h"
+#include "cardcache.h"
+
+static double now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* card i drawn, through the cache if there is one; print is -1 to
+   print only the interpreted cards */
+static const unsigned char *draw( const struct card_atlas *atlas,
+				  struct card_cache *cache,
+				  const struct card_codec *codec, int print,
+				  int shrink, const struct card_deck *deck, long i,
+				  unsigned char *rgba )
+{
+	uint16_t cols[80];
+	const unsigned char *header = card_deck_card( deck, i, cols );
+	const struct card_codec *p;
+
+	if (print < 0) print = header[1] & 0x40;
+	p = print ? codec : NULL;
+	if (cache != NULL) return card_cache_draw( cache, cols, header, p );
+	card_render( atlas, cols, p, rgba );
+	card_render_shrink( rgba, atlas->width, atlas->height, shrink );
+	return rgba;
+}
+
+/* scroll a view through the deck and back, as -bench does, prefetching */
+static long scroll_ahead( const struct card_deck *deck,
+			  const struct card_atlas *atlas,
+			  const struct card_codec *codec, int print, int shrink,
+			  long rows, long ahead, long times,
+			  struct card_cache *view_cache,
+			  struct card_cache *ahead_cache )
+{
+	struct card_scroll *view;
+	struct card_scroll_figures fig;
+	long drawn = 0, last = deck->ncards - rows, step, top, i, n;
+
+	view = card_scroll_open( deck, atlas, codec, print, shrink, (int)rows,
+				 (int)ahead, view_cache, ahead_cache );
+	if (view == NULL) {
+		fprintf( stderr, "carddraw: out of memory\n" );
+		exit(-1);
+	}
+	for (n = 0; n < times; n++) {
+		for (step = 0; step <= 2 * last; step++) {
+			top = (step <= last) ? step : 2 * last - step;
+			card_scroll_to( view, top );
+			for (i = top; i < top + rows; i++)
+				card_scroll_card( view, i );
+			drawn += rows;
+		}
+	}
+	card_scroll_figures( view, &fig );
+	card_scroll_close( view );
+	fprintf( stderr, "view of %ld cards, %ld ahead: %ld found drawn,"
+		 " %ld waited for, %ld drawn when wanted; %ld drawn ahead\n",
+		 rows, ahead, fig.found, fig.waited, fig.drawn, fig.prefetched );
+	return drawn;
+}
+
+static void report( const char *what, const struct card_cache *cache )
+{
+	long looks = cache->hits + cache->misses;
+
+	fprintf( stderr, "%s of %ld cards: %ld hits, %ld misses, %.1f%% hit;"
+		 " %ld evicted, %lld bytes\n", what, cache->capacity, cache->hits,
+		 cache->misses, looks ? 100.0 * cache->hits / looks : 0.0,
+		 cache->evictions, cache->evicted_bytes );
+}
+
+static void usage( const char *progname )
+{
+	fprintf( stderr, "\n%s [options] [deck]\n\n", progname );
+	fprintf( stderr,
+	"Draw each card in a deck as the editor draws it.  If the deck is\n"
+	"missing, read it from stdin.  The options are:\n\n"
+	" -out pattern    file names, as card%%03d.png (stdout for one card)\n"
+	" -raw            write bare RGBA, to stdout one card after another\n"
+	"                 if there is no -out\n"
+	" -assets dir     where PunchedCard.png and Punch.png are (Assets)\n"
+	" -2x             draw from the @2x assets\n"
+	" -shrink n       halve the pictures n times (0)\n"
+	" -print          print every card along its top\n"
+	" -noprint        print none (those interpreted, by default)\n"
+	" -bench n        draw the deck n times and report the rate\n"
+	" -scroll h       with -bench, as a view h cards high scrolled\n"
+	"                 through the deck and back\n"
+	" -cache m        keep m megabytes of drawn cards (none)\n"
+	" -ahead a        with -scroll, page the deck in as a viewer does,\n"
+	"                 a cards drawn ahead on a thread, with a -cache\n"
+	"                 of its own\n"
+	" -v              report the size and rate on stderr\n\n"
+	" -026comm        the keypunch, for printing\n"
+	" -029 -026ftn    (029 default)\n"
+	" -EBCDIC\n\n"
+	);
+	exit(-1);
+}
+
+int main( int argc, char *argv[] )
+{
+	struct card_atlas atlas;
+	struct card_options opt;
+	struct card_codec codec;
+	struct card_image picture;
+	struct card_cache cache, *cached = NULL;
+	struct card_cache ahead_cache, *ahead_cached = NULL;
+	struct card_deck deck;
+	const char *assets = "Assets", *out = NULL;
+	FILE *in = stdin;
+	long ncards, bench = 0, scroll = 0, ahead = 0, megabytes = 0, i, n;
+	double start;
+	int zoom = 1, shrink = 0, print = -1, raw = 0, verbose = 0;
+	int arg = 1, err;
+
+	card_options_init( &opt );
+	while ((arg < argc) && (argv[arg][0] == '-')) { /* command line arg */
+		if (card_list_option( &opt, argv[arg] )) {
+			/* the keypunch */
+		} else if ((strcmp(argv[arg],"-out") == 0) && (arg + 1 < argc)) {
+			out = argv[++arg];
+		} else if (strcmp(argv[arg],"-raw") == 0) {
+			raw = 1;
+		} else if ((strcmp(argv[arg],"-assets") == 0) && (arg + 1 < argc)) {
+			assets = argv[++arg];
+		} else if (strcmp(argv[arg],"-2x") == 0) {
+			zoom = 2;
+		} else if ((strcmp(argv[arg],"-shrink") == 0) && (arg + 1 < argc)) {
+			shrink = atoi( argv[++arg] );
+			if ((shrink < 0) || (shrink > 6)) usage( argv[0] );
+		} else if (strcmp(argv[arg],"-print") == 0) {
+			print = 1;
+		} else if (strcmp(argv[arg],"-noprint") == 0) {
+			print = 0;
+		} else if ((strcmp(argv[arg],"-bench") == 0) && (arg + 1 < argc)) {
+			bench = atol( argv[++arg] );
+		} else if ((strcmp(argv[arg],"-scroll") == 0) && (arg + 1 < argc)) {
+			scroll = atol( argv[++arg] );
+		} else if ((strcmp(argv[arg],"-cache") == 0) && (arg + 1 < argc)) {
+			megabytes = atol( argv[++arg] );
+		} else if ((strcmp(argv[arg],"-ahead") == 0) && (arg + 1 < argc)) {
+			ahead = atol( argv[++arg] );
+		} else if (strcmp(argv[arg],"-v") == 0) {
+			verbose = 1;
+		} else if (strcmp(argv[arg],"-help") == 0) {
+			usage( argv[0] );
+		} else {
+			fprintf( stderr, "%s: unknown option %s;"
+					 " -help available\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+		arg++;
+	}
+	if ( (argc - arg) > 1 ) { /* too many arguments */
+		fprintf( stderr, "%s: too many arguments\n", argv[0] );
+		exit(-1);
+	}
+	if ( (argc - arg) == 1 ) {
+		in = fopen( argv[arg], "rb" );
+		if (in == NULL) {
+			fprintf( stderr, "%s %s: invalid card file\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+	}
+	err = card_deck_open( &deck, in );
+	ncards = deck.ncards;
+	if ((err == CARD_OK) && !((bench > 0) && (scroll > 0) && (ahead > 0)))
+		err = card_validate_buffer( deck.data, deck.len, &ncards );
+	if (err != CARD_OK) {
+		fprintf( stderr, "%s: %s\n", argv[0], card_strerror( err ) );
+		exit(-1);
+	}
+	if ((out == NULL) && !raw && !bench && (ncards != 1)) {
+		fprintf( stderr, "%s: %ld cards need -out; -help available\n",
+			 argv[0], ncards );
+		exit(-1);
+	}
+	card_codec_init( &codec, &opt );
+	err = card_atlas_load( &atlas, assets, zoom );
+	if (err != CARD_OK) {
+		fprintf( stderr, "%s %s: %s\n", argv[0], assets, card_strerror( err ) );
+		exit(-1);
+	}
+	if (card_image_alloc( &picture, atlas.width, atlas.height, 4 ) != CARD_OK) {
+		fprintf( stderr, "%s: out of memory\n", argv[0] );
+		exit(-1);
+	}
+	if (megabytes > 0) {
+		if (card_cache_init( &cache, &atlas, shrink,
+				     (size_t)megabytes << 20 ) != CARD_OK) {
+			fprintf( stderr, "%s: out of memory\n", argv[0] );
+			exit(-1);
+		}
+		cached = &cache;
+	}
+	if ((megabytes > 0) && (bench > 0) && (scroll > 0) && (ahead > 0)) {
+		if (card_cache_init( &ahead_cache, &atlas, shrink,
+				     (size_t)megabytes << 20 ) != CARD_OK) {
+			fprintf( stderr, "%s: out of memory\n", argv[0] );
+			exit(-1);
+		}
+		ahead_cached = &ahead_cache;
+	}
+
+	if (bench > 0) {
+		long drawn = 0, top, step, last;
+		if (scroll > ncards) scroll = ncards;
+		start = now();
+		if ((scroll > 0) && (ahead > 0)) {
+			drawn = scroll_ahead( &deck, &atlas, &codec, print, shrink,
+					      scroll, ahead, bench, cached,
+					      ahead_cached );
+			bench = 0;
+		}
+		for (n = 0; n < bench; n++) {
+			if (scroll <= 0) {
+				for (i = 0; i < ncards; i++)
+					draw( &atlas, cached, &codec, print, shrink,
+					      &deck, i, picture.pixels );
+				drawn += ncards;
+				continue;
+			}
+			/* down a card at a time, then back up */
+			last = ncards - scroll;
+			for (step = 0; step <= 2 * last; step++) {
+				top = (step <= last) ? step : 2 * last - step;
+				for (i = top; i < top + scroll; i++)
+					draw( &atlas, cached, &codec, print, shrink,
+					      &deck, i, picture.pixels );
+				drawn += scroll;
+			}
+		}
+		printf( "%dx%d: %.0f cards a second\n", atlas.width >> shrink,
+			atlas.height >> shrink, drawn / (now() - start) );
+		if (cached != NULL) report( "cache", cached );
+		if (ahead_cached != NULL) report( "ahead cache", ahead_cached );
+		exit(0);
+	}
+
+	picture.width = atlas.width >> shrink;
+	picture.height = atlas.height >> shrink;
+	start = now();
+	for (i = 0; i < ncards; i++) {
+		struct card_image shown = picture;
+		char name[4096];
+		FILE *f = stdout;
+
+		shown.pixels = (unsigned char *)draw( &atlas, cached, &codec, print,
+						      shrink, &deck, i, picture.pixels );
+		if (out != NULL) {
+			snprintf( name, sizeof name, out, (int)(i + 1) );
+			f = fopen( name, "wb" );
+			if (f == NULL) {
+				fprintf( stderr, "%s %s: cannot create\n", argv[0], name );
+				exit(-1);
+			}
+		}
+		n = (long)picture.width * picture.height * 4;
+		err = raw ? ((fwrite( shown.pixels, 1, n, f ) == (size_t)n)
+			     ? CARD_OK : CARD_EIO)
+			  : card_image_write_png( &shown, f );
+		if ((err != CARD_OK) || ((f != stdout) && (fclose( f ) != 0))) {
+			fprintf( stderr, "%s: error writing card %ld\n", argv[0], i + 1 );
+			exit(-1);
+		}
+	}
+	if (fflush( stdout ) != 0) {
+		fprintf( stderr, "%s: error writing the cards\n", argv[0] );
+		exit(-1);
+	}
+	if (verbose) {
+		fprintf( stderr, "%ld cards, %dx%d RGBA, %.0f cards a second\n",
+			 ncards, picture.width, picture.height,
+			 ncards / (now() - start) );
+		if (cached != NULL) report( "cache", cached );
+	}
+	exit(0);
+}
@@ -0,0 +1,536 @@
+/* cardfeed.c -- read punched cards fed one at a time under a camera.
+ *
+ * operation:  run cardfeed -help for instructions
+ *
+ * build: cc -o cardfeed cardfeed.c cardscan.c cardimage.c cardconv.c
+ *        cardcodec.c -lz -lm -lpthread
+ *
+ * input  -- the frames of a video of cards being fed under a camera: a
+ *           stream of binary PNM frames on stdin, as a video tool's
+ *           image pipe gives, or picture files and directories of them
+ * output -- a card-image file with each card fed, once, in order
+ *
+ * This is how volunteers digitize decks: a camera looks down at the
+ * table, and each card is slid under it, left a moment, and slid away.
+ * Most frames show nothing new, so each frame is first reduced to a
+ * perceptual hash, a difference hash of 64 bits: the frame is averaged
+ * down to 9 by 8 blocks, and each bit says whether a block is clearly
+ * lighter than the one to its left.  Frames whose hashes differ in more
+ * than a few bits from the frame before are something moving; once the
+ * hash has held for SETTLE frames the view is still, and it is read,
+ * once, as cardphoto reads a picture.  The rest of the still frames are
+ * skipped for the price of the hash.
+ *
+ * A still view with no card in it is the bare table, and later still
+ * views with the same hash are not read again.  A still view with the same
+ * hash as the last card's may be that card after a hand passed over it,
+ * or the next card landing in the same place, which the hash cannot tell
+ * apart, so it is read, and skipped as a duplicate if its columns are
+ * the last card's too.  Two cards alike, fed one after the other, are
+ * both kept as long as the table shows bare between them.
+ *
+ * Frames are captured on one thread and read on another, through a queue
+ * of -queue frames, each with its own card_image_work, so frames are
+ * decoded straight into the queue and nothing is allocated once every
+ * slot has seen the biggest frame.  A live feed, from stdin or paced at
+ * -fps frames a second as a camera would, never waits for the reader:
+ * a frame finding the queue full is dropped, and counted.  Otherwise
+ * recorded frames are read as fast as the reader takes them, and none
+ * are dropped.  cardshoot -feed makes recorded frames to test with.
+ *
+ * -report gives each card's frame, confidence and doubtful positions on
+ * stderr, and -print and -correct check the printing of interpreted
+ * cards as cardphoto does.  The frames, and those skipped, dropped and
+ * read, go to stderr at the end.
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "cardconv.h"
+#include "cardscan.h"
+
+#define MAX_QUEUE	64
+#define DEAD_BAND	4	/* levels a block must be lighter, for a 1 */
+#define STILL		4	/* bits a frame may differ and be still */
+#define SETTLE		2	/* still frames before the view is read */
+#define SAME		8	/* bits a view may differ and be the same */
+
+/* the last still view read */
+#define SEEN_NOTHING	0
+#define SEEN_BARE	1	/* the table, no card */
+#define SEEN_CARD	2
+
+/* a frame, decoded into its slot's scratch space */
+struct frame {
+	struct card_image_work work;
+	struct card_image gray;
+	long number;		/* from 1, counting those dropped */
+};
+
+static char *progname;
+static const struct card_geometry *geometry = &card_geometry_ibm;
+static struct card_codec codec;
+static int print, correct, do_report;
+
+/* the sources of frames: picture files, or stdin if there are none */
+static char **paths;
+static long npaths, maxpaths;
+
+/* the queue: frames ready, oldest first, and slots free to fill */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t filled = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t emptied = PTHREAD_COND_INITIALIZER;
+static struct frame *slots[MAX_QUEUE + 2];
+static struct frame *ready[MAX_QUEUE], *spare[MAX_QUEUE + 2];
+static int queue = 4, nready, first_ready, nspare, done;
+
+static double fps;		/* pace of a recorded feed, 0 for none */
+static int live;		/* drop frames rather than wait */
+
+/* what happened to the frames */
+static long frames, dropped, moving, skipped, decoded, duplicates, cards;
+
+static double now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* names in order, with runs of digits compared as numbers */
+static int name_order( const char *a, const char *b )
+{
+	while (*a && *b) {
+		if ((*a >= '0') && (*a <= '9') && (*b >= '0') && (*b <= '9')) {
+			const char *da = a, *db = b;
+			size_t la, lb;
+			while (*da == '0') da++;
+			while (*db == '0') db++;
+			for (a = da; (*a >= '0') && (*a <= '9'); a++);
+			for (b = db; (*b >= '0') && (*b <= '9'); b++);
+			la = a - da;
+			lb = b - db;
+			if (la != lb) return (la < lb) ? -1 : 1;
+			if (strncmp( da, db, la ) != 0) return strncmp( da, db, la );
+		} else {
+			if (*a != *b) return (unsigned char)*a - (unsigned char)*b;
+			a++;
+			b++;
+		}
+	}
+	return (unsigned char)*a - (unsigned char)*b;
+}
+
+static int path_order( const void *a, const void *b )
+{
+	return name_order( *(char *const *)a, *(char *const *)b );
+}
+
+static int is_picture( const char *name )
+{
+	static const char *kinds[] = { ".png", ".pnm", ".pgm", ".ppm" };
+	size_t n = strlen( name ), k;
+
+	for (k = 0; k < sizeof kinds / sizeof kinds[0]; k++)
+		if ((n > 4) && (strcasecmp( name + n - 4, kinds[k] ) == 0)) return 1;
+	return 0;
+}
+
+static void add_path( const char *dir, const char *name )
+{
+	if (npaths == maxpaths) {
+		maxpaths = maxpaths ? 2 * maxpaths : 1024;
+		paths = realloc( paths, maxpaths * sizeof *paths );
+		if (paths == NULL) {
+			fprintf( stderr, "%s: out of memory\n", progname );
+			exit(-1);
+		}
+	}
+	paths[npaths] = malloc( strlen( dir ) + strlen( name ) + 2 );
+	if (paths[npaths] == NULL) {
+		fprintf( stderr, "%s: out of memory\n", progname );
+		exit(-1);
+	}
+	if (*dir)
+		sprintf( paths[npaths], "%s/%s", dir, name );
+	else
+		strcpy( paths[npaths], name );
+	npaths++;
+}
+
+/* a picture, or the pictures in a directory in the order of their names */
+static void add_source( const char *path )
+{
+	struct stat st;
+	DIR *d;
+	struct dirent *e;
+	long from = npaths;
+
+	if ((stat( path, &st ) != 0) || !S_ISDIR( st.st_mode )) {
+		add_path( "", path );
+		return;
+	}
+	d = opendir( path );
+	if (d == NULL) {
+		fprintf( stderr, "%s %s: %s\n", progname, path, strerror( errno ) );
+		exit(-1);
+	}
+	while ((e = readdir( d )) != NULL)
+		if ((e->d_name[0] != '.') && is_picture( e->d_name ))
+			add_path( path, e->d_name );
+	closedir( d );
+	qsort( paths + from, npaths - from, sizeof *paths, path_order );
+}
+
+/* the next number in a PNM header, each byte of it kept in buf */
+static long pnm_number( FILE *f, struct card_buf *buf )
+{
+	long n = 0;
+	int ch, digits = 0;
+
+	for (;;) {
+		ch = getc( f );
+		if (ch == '#') {
+			while ((ch != EOF) && (ch != '\n')) {
+				if (card_buf_reserve( buf, buf->len + 1 ) != CARD_OK) return -1;
+				buf->data[buf->len++] = ch;
+				ch = getc( f );
+			}
+		}
+		if (ch == EOF) return -1;
+		if (card_buf_reserve( buf, buf->len + 1 ) != CARD_OK) return -1;
+		buf->data[buf->len++] = ch;
+		if ((ch >= '0') && (ch <= '9')) {
+			if (n > 100000) return -1;
+			n = n * 10 + ch - '0';
+			digits++;
+		} else if (digits) {
+			return n;	/* the whitespace after it is kept */
+		} else if ((ch != ' ') && (ch != '\t') && (ch != '\r') && (ch != '\n')) {
+			return -1;
+		}
+	}
+}
+
+/* the next frame of a PNM stream into buf; returns CARD_OK, 1 at the
+   end of the stream, or an error */
+static int pnm_frame( FILE *f, struct card_buf *buf )
+{
+	long w, h, max;
+	size_t size;
+	int ch = getc( f ), kind;
+
+	buf->len = 0;
+	if (ch == EOF) return 1;
+	kind = getc( f );
+	if ((ch != 'P') || ((kind != '5') && (kind != '6'))) return CARD_EIMAGE;
+	if (card_buf_reserve( buf, 2 ) != CARD_OK) return CARD_ENOMEM;
+	buf->data[buf->len++] = ch;
+	buf->data[buf->len++] = kind;
+	w = pnm_number( f, buf );
+	h = pnm_number( f, buf );
+	max = pnm_number( f, buf );
+	if ((w <= 0) || (h <= 0) || (max <= 0) || (max > 65535)) return CARD_EIMAGE;
+	size = (size_t)w * h * ((kind == '6') ? 3 : 1) * ((max > 255) ? 2 : 1);
+	if (card_buf_reserve( buf, buf->len + size ) != CARD_OK) return CARD_ENOMEM;
+	if (fread( buf->data + buf->len, 1, size, f ) != size) return CARD_EIO;
+	buf->len += size;
+	return CARD_OK;
+}
+
+/* the capture thread: frames in, dropped if the queue is full and the
+   feed is live */
+static void *capture( void *arg )
+{
+	struct frame *f;
+	double start = now();
+	long i;
+	int err;
+
+	(void)arg;
+	pthread_mutex_lock( &lock );
+	f = spare[--nspare];
+	pthread_mutex_unlock( &lock );
+	for (i = 0; (npaths == 0) || (i < npaths); i++) {
+		if (fps > 0) {
+			double wait = start + i / fps - now();
+			if (wait > 0) {
+				struct timespec ts;
+				ts.tv_sec = (time_t)wait;
+				ts.tv_nsec = (long)((wait - ts.tv_sec) * 1e9);
+				nanosleep( &ts, NULL );
+			}
+		}
+		if (npaths == 0) {
+			err = pnm_frame( stdin, &f->work.file );
+			if (err == 1) break;
+			if (err == CARD_OK)
+				err = card_image_decode_work( &f->gray, f->work.file.data,
+							      f->work.file.len, 1, &f->work );
+		} else {
+			err = card_image_load( &f->gray, paths[i], 1, &f->work );
+		}
+		f->number = i + 1;
+		if (err != CARD_OK) {
+			fprintf( stderr, "%s frame %ld: %s\n", progname, i + 1,
+				 card_strerror( err ) );
+			if (npaths == 0) break;	/* the stream is lost */
+			continue;
+		}
+
+		pthread_mutex_lock( &lock );
+		frames++;
+		while (!live && (nready == queue))
+			pthread_cond_wait( &emptied, &lock );
+		if (nready == queue) {
+			dropped++;	/* and f is filled again */
+		} else {
+			ready[(first_ready + nready++) % queue] = f;
+			f = spare[--nspare];
+			pthread_cond_signal( &filled );
+		}
+		pthread_mutex_unlock( &lock );
+	}
+	pthread_mutex_lock( &lock );
+	spare[nspare++] = f;
+	done = 1;
+	pthread_cond_signal( &filled );
+	pthread_mutex_unlock( &lock );
+	return NULL;
+}
+
+/* the difference hash of a frame, from every fourth pixel of every
+   fourth row */
+static uint64_t frame_hash( const struct card_image *gray )
+{
+	long sum[8][9];
+	int count[8][9], x, y, i, j;
+	uint64_t hash = 0;
+
+	memset( sum, 0, sizeof sum );
+	memset( count, 0, sizeof count );
+	for (y = 0; y < gray->height; y += 4) {
+		const unsigned char *row = gray->pixels + (size_t)y * gray->width;
+		i = y * 8 / gray->height;
+		for (x = 0; x < gray->width; x += 4) {
+			j = x * 9 / gray->width;
+			sum[i][j] += row[x];
+			count[i][j]++;
+		}
+	}
+	for (i = 0; i < 8; i++)
+		for (j = 0; j < 8; j++) {
+			long left = sum[i][j] / (count[i][j] ? count[i][j] : 1);
+			long right = sum[i][j + 1] / (count[i][j + 1] ? count[i][j + 1] : 1);
+			hash = (hash << 1) | (right > left + DEAD_BAND);
+		}
+	return hash;
+}
+
+static int bits( uint64_t v )
+{
+	int n;
+	for (n = 0; v != 0; n++) v &= v - 1;
+	return n;
+}
+
+static void report( long number, const struct card_scan *scan )
+{
+	fprintf( stderr, "card %ld: frame %ld, confidence %.2f, %d doubtful%s",
+		 cards, number, scan->confidence, scan->doubtful,
+		 scan->turned ? ", turned" : "" );
+	if (print)
+		fprintf( stderr, ", %s, %d differ, %d corrected",
+			 scan->interpreted ? "printed" : "not printed",
+			 scan->differ, scan->corrected );
+	putc( '\n', stderr );
+}
+
+/* the reader: each frame hashed, and each still view read once */
+static int read_feed( const struct card_options *opt )
+{
+	struct card_scan_work work;
+	struct card_scan scan;
+	uint64_t last = 0, view = 0, table = 0;
+	uint16_t view_cols[80];
+	int have_last = 0, have_table = 0, still = 0, handled = 0, failed = 0;
+	int seen = SEEN_NOTHING;
+
+	memset( &work, 0, sizeof work );
+	for (;;) {
+		struct frame *f;
+		uint64_t hash;
+		unsigned char card[3 + 123];
+		int err;
+
+		pthread_mutex_lock( &lock );
+		while ((nready == 0) && !done) pthread_cond_wait( &filled, &lock );
+		if (nready == 0) {
+			pthread_mutex_unlock( &lock );
+			break;
+		}
+		f = ready[first_ready];
+		first_ready = (first_ready + 1) % queue;
+		nready--;
+		pthread_mutex_unlock( &lock );
+
+		hash = frame_hash( &f->gray );
+		if (!have_last || (bits( hash ^ last ) > STILL)) {
+			moving++;
+			still = handled = 0;
+		} else if (handled || (++still < SETTLE)) {
+			skipped++;
+		} else if (have_table && (bits( hash ^ table ) <= SAME)) {
+			skipped++;	/* the bare table again */
+			seen = SEEN_BARE;
+			handled = 1;
+		} else {
+			handled = 1;
+			decoded++;
+			err = card_scan_image( &f->gray, geometry, &scan, &work );
+			if (err == CARD_ENOCARD) {
+				seen = SEEN_BARE;
+				table = hash;
+				have_table = 1;
+			} else if (err != CARD_OK) {
+				fprintf( stderr, "%s frame %ld: %s\n", progname, f->number,
+					 card_strerror( err ) );
+				failed = 1;
+			} else {
+				if (print)
+					card_scan_print( &f->gray, geometry, &codec, correct,
+							 &scan );
+				if ((seen == SEEN_CARD) && (bits( hash ^ view ) <= SAME)
+				 && (memcmp( scan.cols, view_cols, sizeof view_cols ) == 0)) {
+					duplicates++;
+				} else {
+					if (!cards++)
+						fputs( (opt->format == 80) ? "H80" : "H82", stdout );
+					fwrite( card, 1, card_scan_card( &scan, opt, card ), stdout );
+					if (do_report) report( f->number, &scan );
+				}
+				seen = SEEN_CARD;
+				view = hash;
+				memcpy( view_cols, scan.cols, sizeof view_cols );
+			}
+		}
+		last = hash;
+		have_last = 1;
+
+		pthread_mutex_lock( &lock );
+		spare[nspare++] = f;
+		pthread_cond_signal( &emptied );
+		pthread_mutex_unlock( &lock );
+	}
+	card_scan_work_free( &work );
+	return failed;
+}
+
+static void usage( void )
+{
+	fprintf( stderr, "\n%s [options] [frames ...]\n\n", progname );
+	fprintf( stderr,
+	"Read the cards fed under a camera from the frames of its video\n"
+	"into a card deck on stdout, each card once.  The frames are a\n"
+	"stream of PNM on stdin, or picture files and directories of them,\n"
+	"taken in the order of their names.  The options are:\n\n"
+	" -ipunch         the cards are drawn as the editor draws them\n"
+	" -queue n        frames waiting to be read, at most (4)\n"
+	" -fps r          feed recorded frames at r a second, live (as fast\n"
+	"                 as they are read, none dropped)\n"
+	" -report         report on each card on stderr\n"
+	" -print          check the printing of interpreted cards\n"
+	" -correct        and punch what it says where they differ\n\n"
+	" -H80 -H82       columns per card (H80 default)\n"
+	" -026comm        the keypunch, for -print\n"
+	" -029 -026ftn    (029 default)\n"
+	" -EBCDIC\n\n"
+	"and the card colors and the like of cardmake.\n\n"
+	);
+	exit(-1);
+}
+
+int main( int argc, char *argv[] )
+{
+	struct card_options opt;
+	pthread_t thread;
+	double start, took;
+	int arg = 1, i, failed;
+
+	progname = argv[0];
+	card_options_init( &opt );
+	while ((arg < argc) && (argv[arg][0] == '-') && argv[arg][1]) {
+		if (card_make_option( &opt, argv[arg] )) {
+			/* a card header or keypunch option */
+		} else if (strcmp(argv[arg],"-ipunch") == 0) {
+			geometry = &card_geometry_ipunch;
+		} else if ((strcmp(argv[arg],"-queue") == 0) && (arg + 1 < argc)) {
+			queue = atoi( argv[++arg] );
+		} else if ((strcmp(argv[arg],"-fps") == 0) && (arg + 1 < argc)) {
+			fps = atof( argv[++arg] );
+		} else if (strcmp(argv[arg],"-report") == 0) {
+			do_report = 1;
+		} else if (strcmp(argv[arg],"-print") == 0) {
+			print = 1;
+		} else if (strcmp(argv[arg],"-correct") == 0) {
+			print = correct = 1;
+		} else if (strcmp(argv[arg],"-help") == 0) {
+			usage();
+		} else {
+			fprintf( stderr, "%s: unknown option %s;"
+					 " -help available\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+		arg++;
+	}
+	if (queue < 1) queue = 1;
+	if (queue > MAX_QUEUE) queue = MAX_QUEUE;
+	for (; arg < argc; arg++)
+		if (strcmp( argv[arg], "-" ) != 0) add_source( argv[arg] );
+	live = (npaths == 0) || (fps > 0);
+	card_codec_init( &codec, &opt );
+
+	/* the queue's slots, one more each for the capture and the reader */
+	for (i = 0; i < queue + 2; i++) {
+		slots[i] = calloc( 1, sizeof *slots[i] );
+		if (slots[i] == NULL) {
+			fprintf( stderr, "%s: out of memory\n", argv[0] );
+			exit(-1);
+		}
+		spare[nspare++] = slots[i];
+	}
+
+	start = now();
+	if (pthread_create( &thread, NULL, capture, NULL ) != 0) {
+		fprintf( stderr, "%s: cannot start capture\n", argv[0] );
+		exit(-1);
+	}
+	failed = read_feed( &opt );
+	pthread_join( thread, NULL );
+	took = now() - start;
+	for (i = 0; i < queue + 2; i++) {
+		card_image_work_free( &slots[i]->work );
+		free( slots[i] );
+	}
+	for (i = 0; i < npaths; i++) free( paths[i] );
+	free( paths );
+	if (fflush( stdout ) != 0) {
+		fprintf( stderr, "%s: error writing the deck\n", argv[0] );
+		exit(-1);
+	}
+	fprintf( stderr, "%ld cards from %ld frames in %.3f s, %.1f frames/s:"
+		 " %ld moving, %ld still skipped, %ld read, %ld duplicate,"
+		 " %ld dropped\n", cards, frames, took,
+		 frames / took, moving, skipped, decoded, duplicates, dropped );
+	exit(failed ? 1 : 0);
+}
@@ -0,0 +1,81 @@
+/* cardfont.i
+ *
+ * The 5 by 7 dot letters an interpreting keypunch prints along the top
+ * of a card, for 7-bit ASCII from space to underscore, the characters
+ * that cardcode.i's tables punch.  Each letter is 7 rows, top first, of
+ * 5 dots, the leftmost dot in the 020 bit.  The 029 prints its own
+ * symbols for a few codes, as the cent sign for 12-8-2; these are the
+ * ASCII that DEC's tables put in their place.
+ *
+ * The array is static const uint8_t, so <stdint.h> must be included
+ * first; cardscan.c reads printing with it and cardrender.c prints with
+ * it, and they are the two files that include this.
+ *
+ */
+
+static const uint8_t card_font[64][7] = {
+	{ 000, 000, 000, 000, 000, 000, 000 },	/* space */
+	{ 004, 004, 004, 004, 000, 000, 004 },	/* ! */
+	{ 012, 012, 012, 000, 000, 000, 000 },	/* " */
+	{ 012, 012, 037, 012, 037, 012, 012 },	/* # */
+	{ 004, 017, 024, 016, 005, 036, 004 },	/* $ */
+	{ 030, 031, 002, 004, 010, 023, 003 },	/* % */
+	{ 014, 022, 024, 010, 025, 022, 015 },	/* & */
+	{ 014, 004, 010, 000, 000, 000, 000 },	/* ' */
+	{ 002, 004, 010, 010, 010, 004, 002 },	/* ( */
+	{ 010, 004, 002, 002, 002, 004, 010 },	/* ) */
+	{ 000, 004, 025, 016, 025, 004, 000 },	/* * */
+	{ 000, 004, 004, 037, 004, 004, 000 },	/* + */
+	{ 000, 000, 000, 000, 014, 004, 010 },	/* , */
+	{ 000, 000, 000, 037, 000, 000, 000 },	/* - */
+	{ 000, 000, 000, 000, 000, 014, 014 },	/* . */
+	{ 000, 001, 002, 004, 010, 020, 000 },	/* / */
+	{ 016, 021, 023, 025, 031, 021, 016 },	/* 0 */
+	{ 004, 014, 004, 004, 004, 004, 016 },	/* 1 */
+	{ 016, 021, 001, 002, 004, 010, 037 },	/* 2 */
+	{ 037, 002, 004, 002, 001, 021, 016 },	/* 3 */
+	{ 002, 006, 012, 022, 037, 002, 002 },	/* 4 */
+	{ 037, 020, 036, 001, 001, 021, 016 },	/* 5 */
+	{ 006, 010, 020, 036, 021, 021, 016 },	/* 6 */
+	{ 037, 001, 002, 004, 010, 010, 010 },	/* 7 */
+	{ 016, 021, 021, 016, 021, 021, 016 },	/* 8 */
+	{ 016, 021, 021, 017, 001, 002, 014 },	/* 9 */
+	{ 000, 014, 014, 000, 014, 014, 000 },	/* : */
+	{ 000, 014, 014, 000, 014, 004, 010 },	/* ; */
+	{ 002, 004, 010, 020, 010, 004, 002 },	/* < */
+	{ 000, 000, 037, 000, 037, 000, 000 },	/* = */
+	{ 010, 004, 002, 001, 002, 004, 010 },	/* > */
+	{ 016, 021, 001, 002, 004, 000, 004 },	/* ? */
+	{ 016, 021, 001, 015, 025, 025, 016 },	/* @ */
+	{ 016, 021, 021, 021, 037, 021, 021 },	/* A */
+	{ 036, 021, 021, 036, 021, 021, 036 },	/* B */
+	{ 016, 021, 020, 020, 020, 021, 016 },	/* C */
+	{ 034, 022, 021, 021, 021, 022, 034 },	/* D */
+	{ 037, 020, 020, 036, 020, 020, 037 },	/* E */
+	{ 037, 020, 020, 036, 020, 020, 020 },	/* F */
+	{ 016, 021, 020, 027, 021, 021, 017 },	/* G */
+	{ 021, 021, 021, 037, 021, 021, 021 },	/* H */
+	{ 016, 004, 004, 004, 004, 004, 016 },	/* I */
+	{ 007, 002, 002, 002, 002, 022, 014 },	/* J */
+	{ 021, 022, 024, 030, 024, 022, 021 },	/* K */
+	{ 020, 020, 020, 020, 020, 020, 037 },	/* L */
+	{ 021, 033, 025, 025, 021, 021, 021 },	/* M */
+	{ 021, 021, 031, 025, 023, 021, 021 },	/* N */
+	{ 016, 021, 021, 021, 021, 021, 016 },	/* O */
+	{ 036, 021, 021, 036, 020, 020, 020 },	/* P */
+	{ 016, 021, 021, 021, 025, 022, 015 },	/* Q */
+	{ 036, 021, 021, 036, 024, 022, 021 },	/* R */
+	{ 017, 020, 020, 016, 001, 001, 036 },	/* S */
+	{ 037, 004, 004, 004, 004, 004, 004 },	/* T */
+	{ 021, 021, 021, 021, 021, 021, 016 },	/* U */
+	{ 021, 021, 021, 021, 021, 012, 004 },	/* V */
+	{ 021, 021, 021, 025, 025, 025, 012 },	/* W */
+	{ 021, 021, 012, 004, 012, 021, 021 },	/* X */
+	{ 021, 021, 021, 012, 004, 004, 004 },	/* Y */
+	{ 037, 001, 002, 004, 010, 020, 037 },	/* Z */
+	{ 016, 010, 010, 010, 010, 010, 016 },	/* [ */
+	{ 000, 020, 010, 004, 002, 001, 000 },	/* \ */
+	{ 016, 002, 002, 002, 002, 002, 016 },	/* ] */
+	{ 004, 012, 021, 000, 000, 000, 000 },	/* ^ */
+	{ 000, 000, 000, 000, 000, 000, 037 }	/* _ */
+};
@@ -0,0 +1,467 @@
+/* cardimage.c -- pictures of cards, in memory and in image files.
+ *
+ * see cardimage.h
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include "cardconv.h"
+#include "cardimage.h"
+
+#define MAXSIDE		32768
+#define MAXPIXELS	(1L << 28)
+
+static const unsigned char png_magic[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 032, '\n' };
+
+static int check_size( int width, int height )
+{
+	if ((width < 1) || (height < 1) || (width > MAXSIDE) || (height > MAXSIDE)
+	 || ((long)width * height > MAXPIXELS)) return CARD_EIMAGE;
+	return CARD_OK;
+}
+
+int card_image_alloc( struct card_image *img, int width, int height,
+		      int channels )
+{
+	img->pixels = NULL;
+	if (check_size( width, height ) != CARD_OK) return CARD_EIMAGE;
+	img->pixels = malloc( (size_t)width * height * channels );
+	if (img->pixels == NULL) return CARD_ENOMEM;
+	img->width = width;
+	img->height = height;
+	img->channels = channels;
+	return CARD_OK;
+}
+
+/* an image whose pixels are kept in a work buffer */
+static int work_pixels( struct card_image *img, int width, int height,
+			int channels, struct card_buf *buf )
+{
+	int err;
+
+	img->pixels = NULL;
+	if (check_size( width, height ) != CARD_OK) return CARD_EIMAGE;
+	err = card_buf_reserve( buf, (size_t)width * height * channels );
+	if (err != CARD_OK) return err;
+	img->pixels = buf->data;
+	img->width = width;
+	img->height = height;
+	img->channels = channels;
+	return CARD_OK;
+}
+
+void card_image_free( struct card_image *img )
+{
+	free( img->pixels );
+	img->pixels = NULL;
+	img->width = img->height = 0;
+}
+
+static unsigned long get4( const unsigned char *p )
+{
+	return ((unsigned long)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static int paeth( int a, int b, int c )
+{
+	int p = a + b - c;
+	int pa = abs( p - a ), pb = abs( p - b ), pc = abs( p - c );
+	if ((pa <= pb) && (pa <= pc)) return a;
+	return (pb <= pc) ? b : c;
+}
+
+/* undo the filter on one row, given the row above (zeros for the first) */
+static int unfilter( int type, unsigned char *row, const unsigned char *up,
+		     size_t len, int bpp )
+{
+	size_t i;
+
+	switch (type) {
+	case 0:
+		break;
+	case 1:
+		for (i = bpp; i < len; i++) row[i] += row[i - bpp];
+		break;
+	case 2:
+		for (i = 0; i < len; i++) row[i] += up[i];
+		break;
+	case 3:
+		for (i = 0; i < len; i++)
+			row[i] += ((i >= (size_t)bpp ? row[i - bpp] : 0) + up[i]) >> 1;
+		break;
+	case 4:
+		for (i = 0; i < len; i++)
+			row[i] += paeth( (i >= (size_t)bpp) ? row[i - bpp] : 0, up[i],
+					 (i >= (size_t)bpp) ? up[i - bpp] : 0 );
+		break;
+	default:
+		return CARD_EIMAGE;
+	}
+	return CARD_OK;
+}
+
+/* sample n of a row of samples depth bits wide, scaled to 8 bits
+   unless it is a palette index */
+static int sample( const unsigned char *row, long n, int depth, int index )
+{
+	int v;
+
+	switch (depth) {
+	case 16:
+		return row[2 * n];
+	case 8:
+		return row[n];
+	default:
+		v = (row[n * depth / 8] >> (8 - depth - (n * depth) % 8))
+		    & ((1 << depth) - 1);
+		return index ? v : v * 255 / ((1 << depth) - 1);
+	}
+}
+
+/* luma with the Rec. 601 weights, in fixed point */
+static int luma( int r, int g, int b )
+{
+	return (77 * r + 150 * g + 29 * b + 128) >> 8;
+}
+
+static int decode_png( struct card_image *img, const unsigned char *data,
+		       size_t len, int gray, struct card_image_work *work )
+{
+	static const int samples[7] = { 1, 0, 3, 1, 2, 0, 4 };
+	struct card_buf *idat = &work->idat;
+	unsigned char palette[256 * 3];
+	unsigned char *zero;
+	unsigned long width = 0, height = 0;
+	int depth = 0, type = -1, interlace = 0, npalette = 0;
+	size_t at = 8, rowbytes;
+	z_stream z;
+	int err = CARD_EIMAGE, bpp, in, x, y;
+
+	memset( palette, 0, sizeof palette );
+	idat->len = 0;
+	while (at + 12 <= len) {
+		unsigned long n = get4( data + at );
+		const unsigned char *type_p = data + at + 4, *p = data + at + 8;
+
+		if (n > len - at - 12) return CARD_EIMAGE;
+		if (memcmp( type_p, "IHDR", 4 ) == 0) {
+			if (n < 13) return CARD_EIMAGE;
+			width = get4( p );
+			height = get4( p + 4 );
+			depth = p[8];
+			type = p[9];
+			interlace = p[12];
+		} else if (memcmp( type_p, "PLTE", 4 ) == 0) {
+			npalette = (n / 3 > 256) ? 256 : n / 3;
+			memcpy( palette, p, npalette * 3 );
+		} else if (memcmp( type_p, "IDAT", 4 ) == 0) {
+			if (card_buf_reserve( idat, idat->len + n ) != CARD_OK)
+				return CARD_ENOMEM;
+			memcpy( idat->data + idat->len, p, n );
+			idat->len += n;
+		} else if (memcmp( type_p, "IEND", 4 ) == 0) {
+			break;
+		}
+		at += n + 12;
+	}
+	if ((type < 0) || (type > 6) || (samples[type] == 0) || interlace
+	 || ((depth != 8) && (depth != 16)
+	  && !(((type == 0) || (type == 3)) && ((depth == 1) || (depth == 2)
+						 || (depth == 4))))
+	 || ((type == 3) && (depth == 16)) || (idat->len == 0))
+		return CARD_EIMAGE;
+	err = work_pixels( img, (width > MAXSIDE) ? 0 : (int)width,
+			   (height > MAXSIDE) ? 0 : (int)height,
+			   (gray || (type == 0) || (type == 4)) ? 1 : 3,
+			   &work->pixels );
+	if (err != CARD_OK) return err;
+
+	/* inflated a row at a time, into two rows that take turns */
+	in = samples[type];
+	rowbytes = ((size_t)width * in * depth + 7) / 8;
+	bpp = (in * depth + 7) / 8;
+	if (card_buf_reserve( &work->raw, 3 * (rowbytes + 1) ) != CARD_OK) {
+		img->pixels = NULL;
+		return CARD_ENOMEM;
+	}
+	zero = work->raw.data + 2 * (rowbytes + 1);	/* above the first */
+	memset( zero, 0, rowbytes + 1 );
+	memset( &z, 0, sizeof z );
+	if (inflateInit( &z ) != Z_OK) {
+		img->pixels = NULL;
+		return CARD_ENOMEM;
+	}
+	z.next_in = idat->data;
+	z.avail_in = idat->len;
+
+	for (y = 0; y < (int)height; y++) {
+		unsigned char *row = work->raw.data + (y & 1) * (rowbytes + 1);
+		const unsigned char *up = (y > 0)
+			? work->raw.data + ((y - 1) & 1) * (rowbytes + 1) + 1 : zero;
+		unsigned char *out = img->pixels + (size_t)y * width * img->channels;
+		int zerr;
+
+		z.next_out = row;
+		z.avail_out = rowbytes + 1;
+		do zerr = inflate( &z, Z_SYNC_FLUSH );
+		while ((z.avail_out > 0) && (zerr == Z_OK));
+		if ((z.avail_out > 0)
+		 || (unfilter( row[0], row + 1, up, rowbytes, bpp ) != CARD_OK)) {
+			inflateEnd( &z );
+			img->pixels = NULL;
+			return CARD_EIMAGE;
+		}
+		row++;
+		for (x = 0; x < (int)width; x++) {
+			int v[3];
+			if (type == 3) {
+				const unsigned char *c = palette + 3 * sample( row, x, depth, 1 );
+				v[0] = c[0];
+				v[1] = c[1];
+				v[2] = c[2];
+			} else if ((type == 0) || (type == 4)) {
+				v[0] = v[1] = v[2] = sample( row, (long)x * in, depth, 0 );
+			} else {
+				v[0] = sample( row, (long)x * in, depth, 0 );
+				v[1] = sample( row, (long)x * in + 1, depth, 0 );
+				v[2] = sample( row, (long)x * in + 2, depth, 0 );
+			}
+			if (img->channels == 1) {
+				*out++ = luma( v[0], v[1], v[2] );
+			} else {
+				*out++ = v[0];
+				*out++ = v[1];
+				*out++ = v[2];
+			}
+		}
+	}
+	inflateEnd( &z );
+	return CARD_OK;
+}
+
+/* a number in a PNM header, after white space and comments */
+static long pnm_number( const unsigned char *data, size_t len, size_t *at )
+{
+	long n = 0;
+	int digits = 0;
+
+	for (;;) {
+		while ((*at < len) && ((data[*at] == ' ') || (data[*at] == '\t')
+		    || (data[*at] == '\r') || (data[*at] == '\n'))) (*at)++;
+		if ((*at < len) && (data[*at] == '#')) {
+			while ((*at < len) && (data[*at] != '\n')) (*at)++;
+		} else {
+			break;
+		}
+	}
+	while ((*at < len) && (data[*at] >= '0') && (data[*at] <= '9')
+	    && (n < 1000000)) {
+		n = n * 10 + data[(*at)++] - '0';
+		digits++;
+	}
+	return digits ? n : -1;
+}
+
+static int decode_pnm( struct card_image *img, const unsigned char *data,
+		       size_t len, int gray, struct card_image_work *work )
+{
+	size_t at = 2, n, i;
+	long width, height, maxval;
+	int in = (data[1] == '5') ? 1 : 3, err;
+	unsigned char *out;
+
+	width = pnm_number( data, len, &at );
+	height = pnm_number( data, len, &at );
+	maxval = pnm_number( data, len, &at );
+	if ((width < 1) || (height < 1) || (maxval < 1) || (maxval > 65535)
+	 || (at >= len)) return CARD_EIMAGE;
+	at++;	/* the one white space character after maxval */
+	err = work_pixels( img, (int)width, (int)height, gray ? 1 : in,
+			   &work->pixels );
+	if (err != CARD_OK) return err;
+	n = (size_t)width * height * in;
+	if (len - at < n * ((maxval > 255) ? 2 : 1)) {
+		img->pixels = NULL;
+		return CARD_EIMAGE;
+	}
+	out = img->pixels;
+	for (i = 0; i < n; i += in) {
+		int v[3], k;
+		for (k = 0; k < in; k++) {
+			long s = (maxval > 255)
+				 ? (data[at + 2 * (i + k)] << 8) | data[at + 2 * (i + k) + 1]
+				 : data[at + i + k];
+			v[k] = (maxval == 255) ? s : s * 255 / maxval;
+		}
+		if (in == 1) *out++ = v[0];
+		else if (img->channels == 1) *out++ = luma( v[0], v[1], v[2] );
+		else for (k = 0; k < 3; k++) *out++ = v[k];
+	}
+	return CARD_OK;
+}
+
+int card_image_decode_work( struct card_image *img, const unsigned char *data,
+			    size_t len, int gray, struct card_image_work *work )
+{
+	img->pixels = NULL;
+	if ((len >= 8) && (memcmp( data, png_magic, 8 ) == 0))
+		return decode_png( img, data, len, gray, work );
+	if ((len >= 3) && (data[0] == 'P') && ((data[1] == '5') || (data[1] == '6')))
+		return decode_pnm( img, data, len, gray, work );
+	return CARD_EIMAGE;
+}
+
+int card_image_load( struct card_image *img, const char *path, int gray,
+		     struct card_image_work *work )
+{
+	FILE *f = fopen( path, "rb" );
+	size_t got;
+	int err = CARD_OK;
+
+	img->pixels = NULL;
+	if (f == NULL) return CARD_EIO;
+	work->file.len = 0;
+	do {
+		err = card_buf_reserve( &work->file, work->file.len + 65536 );
+		if (err != CARD_OK) break;
+		got = fread( work->file.data + work->file.len, 1,
+			     work->file.cap - work->file.len, f );
+		work->file.len += got;
+	} while (got > 0);
+	if ((err == CARD_OK) && ferror( f )) err = CARD_EIO;
+	fclose( f );
+	if (err != CARD_OK) return err;
+	return card_image_decode_work( img, work->file.data, work->file.len,
+				       gray, work );
+}
+
+void card_image_work_free( struct card_image_work *work )
+{
+	card_buf_free( &work->file );
+	card_buf_free( &work->idat );
+	card_buf_free( &work->raw );
+	card_buf_free( &work->pixels );
+}
+
+/* decoded in a work of its own, whose pixels it then keeps */
+int card_image_decode( struct card_image *img, const unsigned char *data,
+		       size_t len )
+{
+	struct card_image_work work;
+	int err;
+
+	memset( &work, 0, sizeof work );
+	err = card_image_decode_work( img, data, len, 0, &work );
+	if (err == CARD_OK) work.pixels.data = NULL;
+	card_image_work_free( &work );
+	return err;
+}
+
+int card_image_read( struct card_image *img, FILE *f )
+{
+	struct card_buf buf = { NULL, 0, 0 };
+	size_t got;
+	int err;
+
+	img->pixels = NULL;
+	do {
+		if (card_buf_reserve( &buf, buf.len + 65536 ) != CARD_OK) {
+			card_buf_free( &buf );
+			return CARD_ENOMEM;
+		}
+		got = fread( buf.data + buf.len, 1, buf.cap - buf.len, f );
+		buf.len += got;
+	} while (got > 0);
+	if (ferror( f )) err = CARD_EIO;
+	else err = card_image_decode( img, buf.data, buf.len );
+	card_buf_free( &buf );
+	return err;
+}
+
+static int put_chunk( FILE *f, const char *type, const unsigned char *p,
+		      unsigned long n )
+{
+	unsigned char head[8];
+	unsigned long crc;
+	int i;
+
+	for (i = 0; i < 4; i++) head[i] = (n >> (24 - 8 * i)) & 0377;
+	memcpy( head + 4, type, 4 );
+	crc = crc32( crc32( 0, NULL, 0 ), head + 4, 4 );
+	if (n > 0) crc = crc32( crc, p, n );
+	if ((fwrite( head, 1, 8, f ) != 8)
+	 || ((n > 0) && (fwrite( p, 1, n, f ) != n))) return CARD_EIO;
+	for (i = 0; i < 4; i++) head[i] = (crc >> (24 - 8 * i)) & 0377;
+	return (fwrite( head, 1, 4, f ) == 4) ? CARD_OK : CARD_EIO;
+}
+
+/* every row filtered by its left neighbor, which suits the flat
+   regions of a card picture */
+int card_image_write_png( const struct card_image *img, FILE *f )
+{
+	size_t rowbytes = (size_t)img->width * img->channels;
+	uLong rawlen = img->height * (rowbytes + 1);
+	uLongf zlen = compressBound( rawlen );
+	unsigned char *raw = malloc( rawlen ), *z = malloc( zlen );
+	unsigned char ihdr[13];
+	int err = CARD_ENOMEM, x, y, i;
+
+	if ((raw == NULL) || (z == NULL)) goto done;
+	for (y = 0; y < img->height; y++) {
+		const unsigned char *in = img->pixels + y * rowbytes;
+		unsigned char *out = raw + y * (rowbytes + 1);
+		*out++ = 1;
+		for (x = 0; x < (int)rowbytes; x++)
+			out[x] = in[x] - ((x >= img->channels) ? in[x - img->channels] : 0);
+	}
+	if (compress2( z, &zlen, raw, rawlen, 3 ) != Z_OK) goto done;
+	for (i = 0; i < 4; i++) {
+		ihdr[i] = (img->width >> (24 - 8 * i)) & 0377;
+		ihdr[4 + i] = (img->height >> (24 - 8 * i)) & 0377;
+	}
+	ihdr[8] = 8;
+	ihdr[9] = (img->channels == 1) ? 0 : (img->channels == 3) ? 2 : 6;
+	ihdr[10] = ihdr[11] = ihdr[12] = 0;
+	err = CARD_EIO;
+	if ((fwrite( png_magic, 1, 8, f ) == 8)
+	 && (put_chunk( f, "IHDR", ihdr, 13 ) == CARD_OK)
+	 && (put_chunk( f, "IDAT", z, zlen ) == CARD_OK)
+	 && (put_chunk( f, "IEND", NULL, 0 ) == CARD_OK)) err = CARD_OK;
+done:
+	free( raw );
+	free( z );
+	return err;
+}
+
+int card_image_write_pnm( const struct card_image *img, FILE *f )
+{
+	size_t n = (size_t)img->width * img->height * img->channels;
+
+	if (img->channels == 4)
+		fprintf( f, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 4\nMAXVAL 255\n"
+			 "TUPLTYPE RGB_ALPHA\nENDHDR\n", img->width, img->height );
+	else
+		fprintf( f, "P%c\n%d %d\n255\n", (img->channels == 1) ? '5' : '6',
+			 img->width, img->height );
+	return (fwrite( img->pixels, 1, n, f ) == n) ? CARD_OK : CARD_EIO;
+}
+
+int card_image_gray( struct card_image *gray, const struct card_image *img )
+{
+	long i, n = (long)img->width * img->height;
+	int err = card_image_alloc( gray, img->width, img->height, 1 );
+
+	if (err != CARD_OK) return err;
+	if (img->channels == 1) {
+		memcpy( gray->pixels, img->pixels, n );
+		return CARD_OK;
+	}
+	for (i = 0; i < n; i++) {
+		const unsigned char *p = img->pixels + img->channels * i;
+		gray->pixels[i] = luma( p[0], p[1], p[2] );
+	}
+	return CARD_OK;
+}
@@ -0,0 +1,57 @@
+/* cardimage.h -- pictures of cards, in memory and in image files.
+ *
+ * An image is 8-bit gray, RGB or RGBA, rows top to bottom with no padding
+ * between them.  card_image_read takes a PNG file, as cameras and
+ * scanners and the app's assets give, or a binary PNM (P5 or P6), as
+ * the netpbm tools give; 16-bit samples keep their high byte, palettes
+ * are looked up, and alpha is dropped.  Interlaced PNGs are not read.
+ * PNG needs zlib, so build with -lz.  RGBA images, as cardrender draws,
+ * are written with their alpha, the PNM as a PAM (P7), but not read.
+ *
+ * A thread decoding one picture after another keeps a card_image_work,
+ * as it keeps a card_buf, and card_image_decode_work and card_image_load
+ * then allocate nothing once they have seen the biggest; the pixels
+ * they give are in the work, good until its next use, and are not to
+ * be freed.  With gray set they give gray, converted a pixel at a time
+ * as card_image_gray would, without an RGB copy.
+ *
+ * All routines return CARD_OK or a cardconv.h error.
+ *
+ */
+
+#ifndef CARDIMAGE_H
+#define CARDIMAGE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "cardconv.h"
+
+struct card_image {
+	int width, height;
+	int channels;		/* 1 for gray, 3 for RGB, 4 for RGBA */
+	unsigned char *pixels;
+};
+
+int card_image_alloc( struct card_image *img, int width, int height,
+		      int channels );
+void card_image_free( struct card_image *img );
+
+int card_image_decode( struct card_image *img, const unsigned char *data,
+		       size_t len );
+int card_image_read( struct card_image *img, FILE *f );
+int card_image_write_png( const struct card_image *img, FILE *f );
+int card_image_write_pnm( const struct card_image *img, FILE *f );
+
+int card_image_gray( struct card_image *gray, const struct card_image *img );
+
+struct card_image_work {
+	struct card_buf file, idat, raw, pixels;
+};
+
+int card_image_decode_work( struct card_image *img, const unsigned char *data,
+			    size_t len, int gray, struct card_image_work *work );
+int card_image_load( struct card_image *img, const char *path, int gray,
+		     struct card_image_work *work );
+void card_image_work_free( struct card_image_work *work );
+
+#endif /* CARDIMAGE_H */
@@ -0,0 +1,492 @@
+/* cardio.c -- queued file I/O for the card tools.
+ *
+ * The io_uring backend talks to the kernel directly through the three
+ * io_uring system calls, so it needs no library beyond the kernel
+ * headers.  Each queued request occupies one slot; the slot number is
+ * the user_data of its submission, and holds the caller's tag and the
+ * iovec that a vectored request points at until it completes.
+ *
+ * Define CARDIO_NO_URING to build the pread backend alone.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "cardio.h"
+
+#if defined(__linux__) && !defined(CARDIO_NO_URING)
+#define HAVE_URING 1
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup	425
+#define __NR_io_uring_enter	426
+#define __NR_io_uring_register	427
+#endif
+#endif
+
+struct slot {
+	void *tag;
+	struct iovec iov;
+	int next_free;
+};
+
+struct cardio {
+	int backend;
+	unsigned depth;
+	unsigned queued;	/* requests not yet reaped */
+	struct slot *slots;
+	int free_slot;		/* head of the free slot list */
+	struct iovec *fixed;	/* registered buffers */
+	int nfixed;
+
+	/* pread backend: requests done but not yet reaped */
+	struct cardio_done *ready;
+	unsigned nready;
+
+#ifdef HAVE_URING
+	int ring_fd;
+	unsigned to_submit;
+	void *sq_ptr, *cq_ptr;
+	size_t sq_len, cq_len, sqes_len;
+	unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+#endif
+};
+
+#ifdef HAVE_URING
+
+static int uring_setup( struct cardio *io )
+{
+	struct io_uring_params p;
+	char *sq, *cq;
+	int fd;
+
+	memset( &p, 0, sizeof p );
+	fd = syscall( __NR_io_uring_setup, io->depth, &p );
+	if (fd < 0) return -errno;
+	io->ring_fd = fd;
+
+	io->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	io->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (io->cq_len > io->sq_len) io->sq_len = io->cq_len;
+		io->cq_len = 0;
+	}
+	io->sq_ptr = mmap( NULL, io->sq_len, PROT_READ | PROT_WRITE,
+			   MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING );
+	if (io->sq_ptr == MAP_FAILED) goto fail;
+	if (io->cq_len == 0) {
+		io->cq_ptr = io->sq_ptr;
+	} else {
+		io->cq_ptr = mmap( NULL, io->cq_len, PROT_READ | PROT_WRITE,
+				   MAP_SHARED | MAP_POPULATE, fd,
+				   IORING_OFF_CQ_RING );
+		if (io->cq_ptr == MAP_FAILED) goto fail;
+	}
+	io->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+	io->sqes = mmap( NULL, io->sqes_len, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES );
+	if (io->sqes == MAP_FAILED) goto fail;
+
+	sq = io->sq_ptr;
+	io->sq_head = (unsigned *)(sq + p.sq_off.head);
+	io->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+	io->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+	io->sq_array = (unsigned *)(sq + p.sq_off.array);
+	cq = io->cq_ptr;
+	io->cq_head = (unsigned *)(cq + p.cq_off.head);
+	io->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+	io->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+	io->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+	/* the kernel may round depth up, never down */
+	io->depth = p.sq_entries < io->depth ? p.sq_entries : io->depth;
+	return 0;
+
+fail:
+	{
+		int err = -errno;
+		if ((io->sq_ptr != NULL) && (io->sq_ptr != MAP_FAILED))
+			munmap( io->sq_ptr, io->sq_len );
+		if (io->cq_len && (io->cq_ptr != NULL)
+		&& (io->cq_ptr != MAP_FAILED))
+			munmap( io->cq_ptr, io->cq_len );
+		close( fd );
+		return err;
+	}
+}
+
+static void uring_teardown( struct cardio *io )
+{
+	munmap( io->sqes, io->sqes_len );
+	if (io->cq_len) munmap( io->cq_ptr, io->cq_len );
+	munmap( io->sq_ptr, io->sq_len );
+	close( io->ring_fd );
+}
+
+static void uring_queue( struct cardio *io, int op, int fd, int slot,
+			 off_t offset, int buf_index )
+{
+	unsigned tail = *io->sq_tail;
+	unsigned index = tail & *io->sq_mask;
+	struct io_uring_sqe *sqe = &io->sqes[index];
+	struct iovec *iov = &io->slots[slot].iov;
+
+	memset( sqe, 0, sizeof *sqe );
+	sqe->fd = fd;
+	sqe->off = offset;
+	sqe->user_data = slot;
+	if (buf_index >= 0) { /* fixed ops take the buffer directly */
+		sqe->opcode = (op == IORING_OP_READV)
+			    ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+		sqe->addr = (unsigned long)iov->iov_base;
+		sqe->len = iov->iov_len;
+		sqe->buf_index = buf_index;
+	} else {
+		sqe->opcode = op;
+		sqe->addr = (unsigned long)iov;
+		sqe->len = 1;
+	}
+	io->sq_array[index] = index;
+	__atomic_store_n( io->sq_tail, tail + 1, __ATOMIC_RELEASE );
+	io->to_submit++;
+}
+
+static int uring_enter( struct cardio *io, unsigned min )
+{
+	for (;;) {
+		int ret = syscall( __NR_io_uring_enter, io->ring_fd,
+				   io->to_submit, min,
+				   min ? IORING_ENTER_GETEVENTS : 0, NULL, 0 );
+		if (ret >= 0) {
+			io->to_submit -= ret;
+			return 0;
+		}
+		if (errno != EINTR) return -errno;
+	}
+}
+
+static int uring_reap( struct cardio *io, struct cardio_done *done, int max )
+{
+	unsigned head = *io->cq_head;
+	unsigned tail = __atomic_load_n( io->cq_tail, __ATOMIC_ACQUIRE );
+	int n = 0;
+
+	while ((head != tail) && (n < max)) {
+		struct io_uring_cqe *cqe = &io->cqes[head & *io->cq_mask];
+		int slot = (int)cqe->user_data;
+		done[n].tag = io->slots[slot].tag;
+		done[n].result = cqe->res;
+		io->slots[slot].next_free = io->free_slot;
+		io->free_slot = slot;
+		n++;
+		head++;
+	}
+	__atomic_store_n( io->cq_head, head, __ATOMIC_RELEASE );
+	io->queued -= n;
+	return n;
+}
+
+#endif /* HAVE_URING */
+
+struct cardio *cardio_open( unsigned depth, int backend )
+{
+	struct cardio *io;
+	unsigned i;
+
+	if (depth == 0) depth = 1;
+	io = calloc( 1, sizeof *io );
+	if (io == NULL) return NULL;
+	io->depth = depth;
+	io->backend = CARDIO_PREAD;
+
+#ifdef HAVE_URING
+	if (backend != CARDIO_PREAD) {
+		if (uring_setup( io ) == 0) {
+			io->backend = CARDIO_URING;
+		} else if (backend == CARDIO_URING) {
+			free( io );
+			return NULL;
+		}
+	}
+#else
+	if (backend == CARDIO_URING) {
+		free( io );
+		errno = ENOSYS;
+		return NULL;
+	}
+#endif
+
+	io->slots = calloc( io->depth, sizeof *io->slots );
+	io->ready = calloc( io->depth, sizeof *io->ready );
+	if ((io->slots == NULL) || (io->ready == NULL)) {
+		cardio_close( io );
+		return NULL;
+	}
+	for (i = 0; i < io->depth; i++)
+		io->slots[i].next_free = (i + 1 < io->depth) ? (int)i + 1 : -1;
+	io->free_slot = 0;
+	return io;
+}
+
+void cardio_close( struct cardio *io )
+{
+	if (io == NULL) return;
+#ifdef HAVE_URING
+	if (io->backend == CARDIO_URING) uring_teardown( io );
+#endif
+	free( io->slots );
+	free( io->ready );
+	free( io->fixed );
+	free( io );
+}
+
+int cardio_backend( const struct cardio *io )
+{
+	return io->backend;
+}
+
+const char *cardio_name( const struct cardio *io )
+{
+	return (io->backend == CARDIO_URING) ? "io_uring" : "pread";
+}
+
+unsigned cardio_depth( const struct cardio *io )
+{
+	return io->depth;
+}
+
+/* register buffers for use with buf_index; replaces any earlier set */
+int cardio_register( struct cardio *io, const struct iovec *bufs, int n )
+{
+	struct iovec *copy = malloc( n * sizeof *copy );
+	if (copy == NULL) return -ENOMEM;
+	memcpy( copy, bufs, n * sizeof *copy );
+#ifdef HAVE_URING
+	if (io->backend == CARDIO_URING) {
+		if (io->nfixed > 0)
+			syscall( __NR_io_uring_register, io->ring_fd,
+				 IORING_UNREGISTER_BUFFERS, NULL, 0 );
+		if (syscall( __NR_io_uring_register, io->ring_fd,
+			     IORING_REGISTER_BUFFERS, copy, n ) < 0) {
+			int err = -errno;
+			free( copy );
+			io->nfixed = 0;
+			return err;
+		}
+	}
+#endif
+	free( io->fixed );
+	io->fixed = copy;
+	io->nfixed = n;
+	return 0;
+}
+
+static int queue_request( struct cardio *io, int writing, int fd,
+			  void *buf, size_t len, off_t offset,
+			  int buf_index, void *tag )
+{
+	int slot;
+
+	if (io->queued == io->depth) return -EAGAIN;
+	if (buf_index >= io->nfixed) buf_index = -1;
+	io->queued++;
+
+	if (io->backend == CARDIO_PREAD) {
+		struct cardio_done *d = &io->ready[io->nready++];
+		ssize_t ret;
+		do {
+			ret = writing ? pwrite( fd, buf, len, offset )
+				      : pread( fd, buf, len, offset );
+		} while ((ret < 0) && (errno == EINTR));
+		d->tag = tag;
+		d->result = (ret < 0) ? -errno : ret;
+		return 0;
+	}
+
+	slot = io->free_slot;
+	io->free_slot = io->slots[slot].next_free;
+	io->slots[slot].tag = tag;
+	io->slots[slot].iov.iov_base = buf;
+	io->slots[slot].iov.iov_len = len;
+#ifdef HAVE_URING
+	uring_queue( io, writing ? IORING_OP_WRITEV : IORING_OP_READV,
+		     fd, slot, offset, buf_index );
+#endif
+	return 0;
+}
+
+int cardio_read( struct cardio *io, int fd, void *buf, size_t len,
+		 off_t offset, int buf_index, void *tag )
+{
+	return queue_request( io, 0, fd, buf, len, offset, buf_index, tag );
+}
+
+int cardio_write( struct cardio *io, int fd, const void *buf, size_t len,
+		  off_t offset, int buf_index, void *tag )
+{
+	return queue_request( io, 1, fd, (void *)buf, len, offset,
+			      buf_index, tag );
+}
+
+/* hand queued requests to the kernel without waiting for any */
+int cardio_submit( struct cardio *io )
+{
+#ifdef HAVE_URING
+	if ((io->backend == CARDIO_URING) && (io->to_submit > 0))
+		return uring_enter( io, 0 );
+#endif
+	(void)io;
+	return 0;
+}
+
+/* collect up to max completions, waiting until at least min are in */
+int cardio_wait( struct cardio *io, struct cardio_done *done,
+		 int max, int min )
+{
+	int n = 0;
+
+	if (min > (int)io->queued) min = io->queued;
+	if (io->backend == CARDIO_PREAD) {
+		n = ((unsigned)max < io->nready) ? max : (int)io->nready;
+		memcpy( done, io->ready, n * sizeof *done );
+		memmove( io->ready, io->ready + n,
+			 (io->nready - n) * sizeof *done );
+		io->nready -= n;
+		io->queued -= n;
+		return n;
+	}
+#ifdef HAVE_URING
+	for (;;) {
+		int err;
+		n += uring_reap( io, done + n, max - n );
+		if ((n >= min) || (n == max)) break;
+		err = uring_enter( io, min - n );
+		if (err < 0) return err;
+	}
+	if (io->to_submit > 0) uring_enter( io, 0 );
+#endif
+	return n;
+}
+
+/* one chunk of a whole transfer, tracked so short transfers can resume */
+struct part {
+	char *buf;
+	size_t len;
+	off_t offset;
+};
+
+/* the registered buffer holding all of buf, or -1 */
+static int fixed_index( const struct cardio *io, const char *buf, size_t len )
+{
+	int i;
+
+	for (i = 0; i < io->nfixed; i++) {
+		const char *base = io->fixed[i].iov_base;
+		if ((buf >= base) && (len <= io->fixed[i].iov_len)
+		 && ((size_t)(buf - base) <= io->fixed[i].iov_len - len))
+			return i;
+	}
+	return -1;
+}
+
+static long transfer_all( struct cardio *io, int writing, int fd,
+			  char *buf, size_t len, size_t chunk )
+{
+	struct part *parts;
+	struct cardio_done *done;
+	size_t next = 0;	/* first byte not yet queued */
+	long total = 0;
+	long err = 0;
+	unsigned i, nparts = io->depth;
+	int index = fixed_index( io, buf, len );
+
+	if (chunk == 0) chunk = len ? len : 1;
+	parts = malloc( nparts * sizeof *parts );
+	done = malloc( nparts * sizeof *done );
+	if ((parts == NULL) || (done == NULL)) {
+		free( parts );
+		free( done );
+		return -ENOMEM;
+	}
+	for (i = 0; i < nparts; i++) parts[i].len = 0; /* idle */
+
+	for (;;) {
+		int n, queued = 0;
+
+		/* keep every idle part busy while there is work to do */
+		for (i = 0; (i < nparts) && (next < len) && !err; i++) {
+			if (parts[i].len != 0) continue;
+			parts[i].buf = buf + next;
+			parts[i].offset = next;
+			parts[i].len = (len - next < chunk) ? len - next : chunk;
+			next += parts[i].len;
+			if (writing) {
+				cardio_write( io, fd, parts[i].buf, parts[i].len,
+					      parts[i].offset, index, &parts[i] );
+			} else {
+				cardio_read( io, fd, parts[i].buf, parts[i].len,
+					     parts[i].offset, index, &parts[i] );
+			}
+		}
+		for (i = 0; i < nparts; i++)
+			if (parts[i].len != 0) queued++;
+		if (queued == 0) break;
+
+		n = cardio_wait( io, done, nparts, 1 );
+		if (n < 0) {
+			err = n;
+			break;
+		}
+		while (n-- > 0) {
+			struct part *p = done[n].tag;
+			long got = done[n].result;
+			if (got < 0) {
+				if (!err) err = got;
+				p->len = 0;
+			} else if (got == 0) { /* file shorter than asked */
+				p->len = 0;
+				if (writing && !err) err = -EIO;
+				len = next; /* queue nothing more */
+			} else {
+				total += got;
+				p->buf += got;
+				p->offset += got;
+				p->len -= got;
+				if (p->len == 0) continue;
+				if (writing) { /* resume a short transfer */
+					cardio_write( io, fd, p->buf, p->len,
+						      p->offset, index, p );
+				} else {
+					cardio_read( io, fd, p->buf, p->len,
+						     p->offset, index, p );
+				}
+			}
+		}
+	}
+
+	/* drain anything still in flight after an error */
+	while (cardio_wait( io, done, nparts, 1 ) > 0)
+		;
+	free( parts );
+	free( done );
+	return err ? err : total;
+}
+
+long cardio_read_all( struct cardio *io, int fd, void *buf, size_t len,
+		      size_t chunk )
+{
+	return transfer_all( io, 0, fd, buf, len, chunk );
+}
+
+long cardio_write_all( struct cardio *io, int fd, const void *buf,
+		       size_t len, size_t chunk )
+{
+	return transfer_all( io, 1, fd, (char *)buf, len, chunk );
+}
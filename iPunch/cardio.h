@@ -0,0 +1,66 @@
+/* cardio.h -- queued file I/O for the card tools.
+ *
+ * Reads and writes are queued against a context and their completions
+ * collected later, so that one thread can keep many requests in flight
+ * and keep a fast device busy.  On Linux the context is an io_uring;
+ * anywhere io_uring is missing or refused, the same calls fall back to
+ * pread and pwrite, done at once and reported at the next wait.
+ *
+ * Registered buffers save the kernel mapping a buffer for every request,
+ * but registering pins every page of them.  A whole transfer uses one if
+ * its bytes lie in it; cardbatch registers none, as its buffers are
+ * reserved at the worst case of a conversion and trimmed between files,
+ * and pinning them cost more than the batch itself.  Only cardiobench
+ * -fixed measures them.
+ *
+ * A context belongs to one thread at a time.
+ *
+ */
+
+#ifndef CARDIO_H
+#define CARDIO_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/* backends, for cardio_open */
+#define CARDIO_ANY	0	/* io_uring if available, else pread */
+#define CARDIO_URING	1
+#define CARDIO_PREAD	2
+
+/* one completed request */
+struct cardio_done {
+	void *tag;	/* as given when the request was queued */
+	long result;	/* bytes transferred, or -errno */
+};
+
+struct cardio;
+
+struct cardio *cardio_open( unsigned depth, int backend );
+void cardio_close( struct cardio *io );
+int cardio_backend( const struct cardio *io );
+const char *cardio_name( const struct cardio *io );
+unsigned cardio_depth( const struct cardio *io );
+
+int cardio_register( struct cardio *io, const struct iovec *bufs, int n );
+
+/* queue a request; buf_index names a registered buffer holding buf, or
+   is -1; returns 0, or -EAGAIN when depth requests are already queued */
+int cardio_read( struct cardio *io, int fd, void *buf, size_t len,
+		 off_t offset, int buf_index, void *tag );
+int cardio_write( struct cardio *io, int fd, const void *buf, size_t len,
+		  off_t offset, int buf_index, void *tag );
+
+int cardio_submit( struct cardio *io );
+int cardio_wait( struct cardio *io, struct cardio_done *done,
+		 int max, int min );
+
+/* whole transfers, split into chunk sized requests kept depth deep;
+   a transfer within a registered buffer uses it */
+long cardio_read_all( struct cardio *io, int fd, void *buf, size_t len,
+		      size_t chunk );
+long cardio_write_all( struct cardio *io, int fd, const void *buf,
+		       size_t len, size_t chunk );
+
+#endif /* CARDIO_H */
@@ -0,0 +1,232 @@
+/* cardiobench.c -- compare the cardio backends at several queue depths.
+ *
+ * operation:  run cardiobench -help for instructions
+ *
+ * build: cc -o cardiobench cardiobench.c cardio.c
+ *
+ * Reads a scratch file block by block through each cardio backend,
+ * keeping the given number of requests in flight, and reports the
+ * throughput and request rate of each.  Use -direct to bypass the page
+ * cache, otherwise a second pass mostly measures memory copies.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "cardio.h"
+
+static double now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* xorshift, so random offsets are the same for every run */
+static unsigned long next_random( unsigned long *state )
+{
+	unsigned long x = *state;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	return *state = x;
+}
+
+static int make_scratch( const char *path, size_t size )
+{
+	static char block[1 << 16];
+	size_t done = 0;
+	int fd = open( path, O_WRONLY | O_CREAT | O_TRUNC, 0666 );
+	if (fd < 0) return -1;
+	memset( block, 0x80, sizeof block ); /* looks like card headers */
+	while (done < size) {
+		size_t n = (size - done < sizeof block) ? size - done
+							: sizeof block;
+		if (write( fd, block, n ) != (ssize_t)n) {
+			close( fd );
+			return -1;
+		}
+		done += n;
+	}
+	fsync( fd );
+	return close( fd );
+}
+
+/* read nblocks blocks of bs bytes with depth requests kept in flight */
+static int run( int backend, unsigned depth, int fd, size_t size,
+		size_t bs, int random, int fixed, double *seconds,
+		long *requests )
+{
+	struct cardio *io = cardio_open( depth, backend );
+	struct cardio_done *done;
+	char *bufs;
+	unsigned i;
+	long nblocks = size / bs;
+	long issued = 0, completed = 0;
+	unsigned long seed = 88172645463325252UL;
+	int *idle, nidle;
+	double start;
+
+	if (io == NULL) return -1;
+	depth = cardio_depth( io );
+	done = malloc( depth * sizeof *done );
+	idle = malloc( depth * sizeof *idle );
+	if ((done == NULL) || (idle == NULL)
+	||  (posix_memalign( (void **)&bufs, 4096, depth * bs ) != 0)) {
+		cardio_close( io );
+		return -1;
+	}
+	if (fixed) {
+		struct iovec *iov = malloc( depth * sizeof *iov );
+		if (iov == NULL) {
+			cardio_close( io );
+			return -1;
+		}
+		for (i = 0; i < depth; i++) {
+			iov[i].iov_base = bufs + i * bs;
+			iov[i].iov_len = bs;
+		}
+		if (cardio_register( io, iov, depth ) != 0) fixed = 0;
+		free( iov );
+	}
+	for (i = 0; i < depth; i++) idle[i] = depth - 1 - i;
+	nidle = depth;
+
+	start = now();
+	while (completed < nblocks) {
+		int n;
+		while ((nidle > 0) && (issued < nblocks)) {
+			int b = idle[--nidle];
+			long block = random ? (long)(next_random( &seed ) % nblocks)
+					    : issued;
+			cardio_read( io, fd, bufs + b * bs, bs, block * bs,
+				     fixed ? b : -1, (void *)(long)b );
+			issued++;
+		}
+		n = cardio_wait( io, done, depth, 1 );
+		if (n <= 0) break;
+		while (n-- > 0) {
+			if (done[n].result < 0) {
+				errno = -done[n].result;
+				cardio_close( io );
+				return -1;
+			}
+			idle[nidle++] = (int)(long)done[n].tag;
+			completed++;
+		}
+	}
+	*seconds = now() - start;
+	*requests = completed;
+
+	cardio_close( io );
+	free( bufs );
+	free( done );
+	free( idle );
+	return 0;
+}
+
+int main( int argc, char *argv[] )
+{
+	static unsigned depths[] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+	static int backends[] = { CARDIO_PREAD, CARDIO_URING };
+	const char *path = "cardiobench.tmp";
+	size_t size = 256 << 20;
+	size_t bs = 4096;
+	int direct = 0, random = 0, fixed = 0, keep = 0;
+	int arg = 1;
+	unsigned d;
+	int b, fd;
+
+	while ((arg < argc) && (argv[arg][0] == '-')) { /* command line arg */
+		if ((strcmp(argv[arg],"-file") == 0) && (arg + 1 < argc)) {
+			path = argv[++arg];
+			keep = 1;
+		} else if ((strcmp(argv[arg],"-size") == 0) && (arg + 1 < argc)) {
+			size = (size_t)atol( argv[++arg] ) << 20;
+		} else if ((strcmp(argv[arg],"-bs") == 0) && (arg + 1 < argc)) {
+			bs = (size_t)atol( argv[++arg] );
+		} else if (strcmp(argv[arg],"-direct") == 0) {
+			direct = 1;
+		} else if (strcmp(argv[arg],"-random") == 0) {
+			random = 1;
+		} else if (strcmp(argv[arg],"-fixed") == 0) {
+			fixed = 1;
+		} else if (strcmp(argv[arg],"-help") == 0) {
+			fprintf( stderr, "\n%s [options]\n\n", argv[0] );
+			fprintf( stderr,
+			"Time reads of a scratch file through each cardio\n"
+			"backend at queue depths from 1 to 128.  The options\n"
+			"are:\n\n"
+			" -file path      file to read (default: make a\n"
+			"                 scratch file, deleted afterwards)\n"
+			" -size megabytes size of the scratch file (256)\n"
+			" -bs bytes       bytes per request (4096)\n"
+			" -direct         bypass the page cache (O_DIRECT)\n"
+			" -random         random rather than sequential blocks\n"
+			" -fixed          use registered buffers\n\n"
+			);
+			exit(-1);
+		} else {
+			fprintf( stderr, "%s: unknown option %s;"
+					 " -help available\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+		arg++;
+	}
+
+	if (!keep && (make_scratch( path, size ) != 0)) {
+		fprintf( stderr, "%s %s: cannot make scratch file\n",
+			 argv[0], path );
+		exit(-1);
+	}
+	fd = open( path, O_RDONLY | (direct ? O_DIRECT : 0) );
+	if (fd < 0) {
+		fprintf( stderr, "%s %s: %s\n", argv[0], path,
+			 strerror( errno ) );
+		exit(-1);
+	}
+	if (keep) {
+		struct stat st;
+		fstat( fd, &st );
+		size = st.st_size;
+	}
+	if ((bs == 0) || (size < bs)) {
+		fprintf( stderr, "%s: file smaller than one block\n", argv[0] );
+		exit(-1);
+	}
+
+	printf( "%-9s %5s %10s %10s\n", "backend", "depth", "MB/s", "IOPS" );
+	for (b = 0; b < 2; b++) {
+		for (d = 0; d < sizeof depths / sizeof depths[0]; d++) {
+			double seconds;
+			long requests;
+			if (run( backends[b], depths[d], fd, size, bs,
+				 random, fixed, &seconds, &requests ) != 0) {
+				printf( "%-9s %5u %10s %10s\n",
+					(backends[b] == CARDIO_URING)
+					? "io_uring" : "pread",
+					depths[d], "-", "-" );
+				continue;
+			}
+			printf( "%-9s %5u %10.1f %10.0f\n",
+				(backends[b] == CARDIO_URING) ? "io_uring"
+							      : "pread",
+				depths[d],
+				requests * (double)bs / seconds / 1e6,
+				requests / seconds );
+			fflush( stdout );
+		}
+	}
+
+	close( fd );
+	if (!keep) unlink( path );
+	exit(0);
+}
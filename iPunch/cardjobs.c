@@ -0,0 +1,797 @@
+/* cardjobs.c -- run a stream of card jobs on a pool of emulators.
+ *
+ * operation:  run cardjobs -help for instructions
+ *
+ * build: cc -o cardjobs cardjobs.c sim1401.c sim360.c ftncomp.c ftnvm.c
+ *        simevent.c spool.c ebcdic.c cardconv.c cardcodec.c -lpthread -lm
+ *
+ * input  -- card-image files, each holding one or more jobs
+ * output -- a listing for each job, and its punched cards if it punched
+ *           any, in a directory; a line of figures for each job
+ *
+ * This is the local stand-in for a batch service.  Every deck named is
+ * read and split into jobs at its control cards, punched in the 029
+ * code as cardmake -029 punches them:
+ *
+ *	$JOB name,machine[,CLASS=c][,TIME=s][,LINES=n][,CARDS=n]
+ *	$EOJ
+ *
+ * The machine is FORTRAN, compiled and run as runftn does, 1401, run
+ * as run1401 does, or 360, run as run360 does; the cards after the
+ * $JOB card, up to the next $JOB or $EOJ, are the job's deck.  CLASS
+ * is a letter, A first; jobs go to the workers in class order, and in
+ * the order they were read within a class.  TIME limits the simulated
+ * processor time in seconds, LINES the lines printed and CARDS the
+ * cards punched; on every machine the line or card that goes over is
+ * counted but not printed or punched, and the job is stopped there.
+ * Limits not given on the $JOB card come from the command line.
+ *
+ * Each worker is a thread with its own emulators, so jobs run side by
+ * side, as many at once as there are workers, by default one for each
+ * processor online.  The emulators run a slice of instructions at a
+ * time, short enough that the instruction that goes over a limit is
+ * the last to run.
+ *
+ * For each job, in the order read, a line gives its status, the time
+ * it waited for a worker and ran, in host milliseconds, its simulated
+ * time, instructions, and cards read, lines printed and cards punched.
+ *
+ * -bench makes n FORTRAN jobs and runs them on one worker and then on
+ * all of them, and reports jobs per second for each.
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "cardconv.h"
+#include "ftn.h"
+#include "sim1401.h"
+#include "sim360.h"
+#include "spool.h"
+
+#define MAX_WORKERS	256
+#define SLICE		10000	/* instructions run between looks at the limits */
+#define FTN_INSN_NS	2000LL	/* simulated time of a FORTRAN instruction */
+#define CLASSES		26
+
+#define FORTRAN		0
+#define M1401		1
+#define M360		2
+
+static const char *machine_names[] = { "FORTRAN", "1401", "360" };
+
+/* a job's outcome */
+#define JOB_OK		0
+#define JOB_TIME	1	/* over its TIME */
+#define JOB_LINES	2
+#define JOB_CARDS	3
+#define JOB_FAILED	4	/* the job itself went wrong, see why */
+#define JOB_ERROR	5	/* it could not be run */
+
+static const char *status_names[] = {
+	"ok", "TIME", "LINES", "CARDS", "failed", "error"
+};
+
+struct job {
+	long seq;
+	char name[9];
+	int machine;
+	int class;		/* 0 for A */
+	double time_limit;	/* seconds, 0 for none */
+	long max_lines, max_cards;
+	struct card_buf deck;	/* its cards, as a card-image file */
+	long ncards;
+	struct job *next;	/* in its class queue */
+
+	/* what happened */
+	int status;
+	char why[160];
+	double queued, started, finished;	/* host time */
+	double simulated;	/* processor seconds */
+	long long count;	/* instructions */
+	long read, printed, punched;
+};
+
+struct worker {
+	pthread_t thread;
+	struct sim1401 *m1401;	/* made when first wanted */
+	long jobs;
+};
+
+static char *progname;
+static const char *out_dir = NULL;
+static int write_index = 0;
+static int unthrottled = 0;
+static int form = SPOOL_FORM;
+static struct card_codec control_codec;	/* for control cards, 029 */
+static struct card_codec ftn_codec;	/* for FORTRAN decks */
+
+/* the queues, a FIFO for each class */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static struct job *head[CLASSES], *tail[CLASSES];
+
+static struct job **jobs;
+static long njobs, maxjobs;
+
+static double now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned char *read_all( FILE *f, size_t *len )
+{
+	size_t cap = 1 << 16, got;
+	unsigned char *buf = malloc( cap );
+
+	*len = 0;
+	while ((buf != NULL) && ((got = fread( buf + *len, 1, cap - *len, f )) > 0)) {
+		*len += got;
+		if (*len == cap) {
+			unsigned char *more = realloc( buf, cap *= 2 );
+			if (more == NULL) free( buf );
+			buf = more;
+		}
+	}
+	return buf;
+}
+
+static void enqueue( struct job *job )
+{
+	job->queued = now();
+	job->next = NULL;
+	if (tail[job->class] == NULL) head[job->class] = job;
+	else tail[job->class]->next = job;
+	tail[job->class] = job;
+}
+
+/* the first job of the best class there is */
+static struct job *dequeue( void )
+{
+	struct job *job = NULL;
+	int c;
+
+	pthread_mutex_lock( &lock );
+	for (c = 0; c < CLASSES; c++) {
+		if (head[c] != NULL) {
+			job = head[c];
+			head[c] = job->next;
+			if (head[c] == NULL) tail[c] = NULL;
+			break;
+		}
+	}
+	pthread_mutex_unlock( &lock );
+	return job;
+}
+
+/* a card, decoded for control cards */
+static void card_text( const unsigned char *card, int format, char *text )
+{
+	const unsigned char *p = card + 3;
+	int first = (format == 82) ? 1 : 0;
+	int col;
+
+	for (col = 0; col < 80; col++) {
+		int c = col + first;
+		const unsigned char *q = p + 3 * (c / 2);
+		int code = (c & 1) ? (((q[1] & 017) << 8) | q[2])
+				   : ((q[0] << 4) | (q[1] >> 4));
+		text[col] = card_decode( &control_codec, code );
+	}
+	text[80] = '\0';
+}
+
+/* the fields of a $JOB card; -1 if they do not make sense */
+static int job_card( struct job *job, const char *text )
+{
+	char buf[81], *field, *save;
+	int n = 0;
+
+	strcpy( buf, text + 4 );
+	for (field = strtok_r( buf, ", ", &save ); field != NULL;
+	     field = strtok_r( NULL, ", ", &save ), n++) {
+		char *value = strchr( field, '=' );
+		if (n == 0) {
+			snprintf( job->name, sizeof job->name, "%s", field );
+		} else if (n == 1) {
+			if (strcmp( field, "FORTRAN" ) == 0) job->machine = FORTRAN;
+			else if (strcmp( field, "1401" ) == 0) job->machine = M1401;
+			else if (strcmp( field, "360" ) == 0) job->machine = M360;
+			else return -1;
+		} else if (value == NULL) {
+			return -1;
+		} else {
+			*value++ = '\0';
+			if ((strcmp( field, "CLASS" ) == 0)
+			 && (value[0] >= 'A') && (value[0] <= 'Z') && !value[1])
+				job->class = value[0] - 'A';
+			else if (strcmp( field, "TIME" ) == 0)
+				job->time_limit = atof( value );
+			else if (strcmp( field, "LINES" ) == 0)
+				job->max_lines = atol( value );
+			else if (strcmp( field, "CARDS" ) == 0)
+				job->max_cards = atol( value );
+			else return -1;
+		}
+	}
+	return (n >= 2) ? 0 : -1;
+}
+
+static struct job *new_job( const struct job *defaults )
+{
+	struct job *job = malloc( sizeof *job );
+
+	if ((job == NULL) || ((njobs == maxjobs)
+	 && ((jobs = realloc( jobs, (maxjobs = maxjobs ? maxjobs * 2 : 64)
+				    * sizeof *jobs )) == NULL))) {
+		fprintf( stderr, "%s: out of memory\n", progname );
+		exit(-1);
+	}
+	*job = *defaults;
+	job->seq = njobs + 1;
+	jobs[njobs++] = job;
+	return job;
+}
+
+static void add_card( struct job *job, const unsigned char *card,
+		      size_t card_bytes, int format )
+{
+	if (job->deck.len == 0) {
+		if (card_buf_reserve( &job->deck, 3 + 64 * card_bytes ) != CARD_OK)
+			goto nomem;
+		memcpy( job->deck.data, (format == 80) ? "H80" : "H82", 3 );
+		job->deck.len = 3;
+	}
+	if (card_buf_reserve( &job->deck, job->deck.len + card_bytes ) != CARD_OK)
+		goto nomem;
+	memcpy( job->deck.data + job->deck.len, card, card_bytes );
+	job->deck.len += card_bytes;
+	job->ncards++;
+	return;
+nomem:
+	fprintf( stderr, "%s: out of memory\n", progname );
+	exit(-1);
+}
+
+/* split a deck into jobs at its control cards, and queue them */
+static int split( const char *path, const unsigned char *deck, size_t len,
+		  const struct job *defaults )
+{
+	struct job *job = NULL;
+	size_t card_bytes;
+	long ncards, i, stray = 0;
+	int format, err;
+
+	err = card_validate_buffer( deck, len, &ncards );
+	if (err != CARD_OK) {
+		fprintf( stderr, "%s %s: %s\n", progname, path,
+			 card_strerror( err ) );
+		return -1;
+	}
+	format = (deck[2] == '0') ? 80 : 82;
+	card_bytes = (format == 80) ? 3 + 120 : 3 + 123;
+	for (i = 0; i < ncards; i++) {
+		const unsigned char *card = deck + 3 + i * card_bytes;
+		char text[81];
+
+		card_text( card, format, text );
+		if (strncmp( text, "$JOB", 4 ) == 0) {
+			if (job != NULL) enqueue( job );
+			job = new_job( defaults );
+			if (job_card( job, text ) != 0) {
+				job->status = JOB_ERROR;
+				snprintf( job->why, sizeof job->why,
+					  "bad $JOB card in %s", path );
+			}
+		} else if (strncmp( text, "$EOJ", 4 ) == 0) {
+			if (job != NULL) enqueue( job );
+			job = NULL;
+		} else if (job != NULL) {
+			add_card( job, card, card_bytes, format );
+		} else {
+			stray++;
+		}
+	}
+	if (job != NULL) enqueue( job );
+	if (stray > 0)
+		fprintf( stderr, "%s %s: %ld cards outside any job, ignored\n",
+			 progname, path, stray );
+	return 0;
+}
+
+static FILE *output( const struct job *job, const char *suffix,
+		     const char *mode )
+{
+	char path[4096];
+	FILE *f;
+
+	if (out_dir == NULL) return NULL;
+	snprintf( path, sizeof path, "%s/%04ld-%s.%s", out_dir, job->seq,
+		  job->name, suffix );
+	f = fopen( path, mode );
+	if (f == NULL)
+		fprintf( stderr, "%s %s: %s\n", progname, path, strerror( errno ) );
+	return f;
+}
+
+static void remove_output( const struct job *job, const char *suffix )
+{
+	char path[4096];
+
+	snprintf( path, sizeof path, "%s/%04ld-%s.%s", out_dir, job->seq,
+		  job->name, suffix );
+	remove( path );
+}
+
+static void run_fortran( struct job *job, struct spool *sp )
+{
+	struct ftn_deck deck;
+	struct ftn_program prog;
+	struct ftn_run run;
+	long ncards;
+
+	if (ftn_read_deck( &deck, job->deck.data, job->deck.len,
+			   &ftn_codec ) != CARD_OK) {
+		job->status = JOB_ERROR;
+		strcpy( job->why, "out of memory" );
+		return;
+	}
+	ncards = ftn_program_cards( &deck );
+	if (ftn_compile( &prog, &deck, ncards ) < 0) {
+		job->status = JOB_FAILED;
+		snprintf( job->why, sizeof job->why, "%s", prog.error );
+		ftn_free_deck( &deck );
+		return;
+	}
+	memset( &run, 0, sizeof run );
+	run.spool = sp;
+	run.deck = &deck;
+	run.next_card = ncards;
+	if (job->time_limit > 0) {
+		/* 0 is no limit, so a TIME under an instruction is one */
+		run.limit = (long long)(job->time_limit * 1e9 / FTN_INSN_NS);
+		if (run.limit < 1) run.limit = 1;
+	}
+	run.max_lines = job->max_lines;
+	if (ftn_run( &prog, &run ) < 0) {
+		if (strstr( run.error, "time limit" ) != NULL)
+			job->status = JOB_TIME;
+		else if (strstr( run.error, "line limit" ) != NULL)
+			job->status = JOB_LINES;
+		else
+			job->status = JOB_FAILED;
+		snprintf( job->why, sizeof job->why, "%s", run.error );
+	}
+	job->count = run.count;
+	job->simulated = run.count * FTN_INSN_NS * 1e-9;
+	job->read = run.next_card;
+	job->printed = run.lines;
+	ftn_free( &prog );
+	ftn_free_deck( &deck );
+}
+
+/* the instructions to run before looking again, or 0 if the job is
+   over a limit; no instruction prints more than a line or punches more
+   than a card, so stopping there catches it at the one that goes over */
+static long long slice( struct job *job, long long count, long long insn,
+			long printed, long punched )
+{
+	long long n = SLICE;
+
+	if (job->time_limit > 0) {
+		long long left = (long long)(job->time_limit * 1e9 / insn) - count;
+		if (left <= 0) job->status = JOB_TIME;
+		else if (left < n) n = left;
+	}
+	if (job->max_lines > 0) {
+		if (printed > job->max_lines) job->status = JOB_LINES;
+		else if (job->max_lines - printed + 1 < n)
+			n = job->max_lines - printed + 1;
+	}
+	if (job->max_cards > 0) {
+		if (punched > job->max_cards) job->status = JOB_CARDS;
+		else if (job->max_cards - punched + 1 < n)
+			n = job->max_cards - punched + 1;
+	}
+	return (job->status == JOB_OK) ? n : 0;
+}
+
+/* a job that went over LINES or CARDS in its last slice, and stopped
+   before the next, stopped there */
+static void over( struct job *job, long printed, long punched )
+{
+	if ((job->max_lines > 0) && (printed > job->max_lines))
+		job->status = JOB_LINES;
+	else if ((job->max_cards > 0) && (punched > job->max_cards))
+		job->status = JOB_CARDS;
+}
+
+static void run_1401( struct worker *w, struct job *job, struct spool *sp )
+{
+	struct sim1401 *m;
+	FILE *punch;
+	int stop;
+
+	if (w->m1401 == NULL) w->m1401 = malloc( sizeof *w->m1401 );
+	m = w->m1401;
+	if (m == NULL) {
+		job->status = JOB_ERROR;
+		strcpy( job->why, "out of memory" );
+		return;
+	}
+	sim1401_init( m, SIM1401_MAXMEM );
+	if (unthrottled) m->wheel.mode = SIM_UNTHROTTLED;
+	m->printer = sp;
+	m->max_printed = job->max_lines;
+	m->max_punched = job->max_cards;
+	m->punch = punch = output( job, "pun", "wb" );
+	if (sim1401_attach_deck( m, job->deck.data, job->deck.len ) != CARD_OK) {
+		job->status = JOB_ERROR;
+		strcpy( job->why, "out of memory" );
+		if (punch != NULL) fclose( punch );
+		return;
+	}
+	stop = sim1401_load( m );
+	while ((stop == SIM1401_HALT) || (stop == SIM1401_LIMIT)) {
+		long long n = slice( job, m->count, SIM1401_INSN, m->printed,
+				     m->punched );
+		if (n == 0) break;
+		stop = sim1401_run( m, n );
+		if (stop == SIM1401_HALT) break;
+	}
+	if (stop == SIM1401_HALT) over( job, m->printed, m->punched );
+	if (stop == SIM1401_ERROR) {
+		job->status = JOB_FAILED;
+		snprintf( job->why, sizeof job->why, "%s at %05d", m->error, m->I );
+	} else if (stop == SIM1401_HOPPER) {
+		job->status = JOB_FAILED;
+		snprintf( job->why, sizeof job->why, "reader empty at %05d", m->I );
+	}
+	job->count = m->count;
+	job->simulated = sim1401_time( m ) * 1e-9;
+	job->read = m->next_card;
+	job->printed = m->printed;
+	job->punched = m->punched;
+	sim1401_detach_deck( m );
+	if (punch != NULL) {
+		fclose( punch );
+		if (m->punched == 0) remove_output( job, "pun" );
+	}
+}
+
+static void run_360( struct job *job, struct spool *sp )
+{
+	struct sim360 m;
+	int stop = SIM360_LIMIT;
+
+	if (sim360_init( &m, 256 << 10 ) != CARD_OK) {
+		job->status = JOB_ERROR;
+		strcpy( job->why, "out of memory" );
+		return;
+	}
+	if (unthrottled) m.wheel.mode = SIM_UNTHROTTLED;
+	m.printer = sp;
+	m.max_printed = job->max_lines;
+	if ((sim360_attach_deck( &m, job->deck.data, job->deck.len ) != CARD_OK)
+	 || (sim360_load( &m ) != 0)) {
+		job->status = JOB_FAILED;
+		snprintf( job->why, sizeof job->why, "%s",
+			  m.error ? m.error : "out of memory" );
+		sim360_free( &m );
+		return;
+	}
+	do {
+		long long n = slice( job, m.count, SIM360_INSN, m.print_unit.ops, 0 );
+		if (n == 0) break;
+		stop = sim360_run( &m, n );
+	} while (stop == SIM360_LIMIT);
+	if (stop == SIM360_ABEND) {
+		job->status = JOB_FAILED;
+		snprintf( job->why, sizeof job->why, "abend %06lX",
+			  (unsigned long)m.abend );
+	} else if ((stop == SIM360_ERROR) || (stop == SIM360_WAIT)) {
+		job->status = JOB_FAILED;
+		snprintf( job->why, sizeof job->why, "%s at %06lX",
+			  (stop == SIM360_WAIT) ? "wait state" : m.error,
+			  (unsigned long)m.ia );
+	} else if ((stop == SIM360_EXIT) && (m.r[15] != 0)) {
+		job->status = JOB_FAILED;
+		snprintf( job->why, sizeof job->why, "return code %lu",
+			  (unsigned long)m.r[15] );
+	}
+	if (stop == SIM360_EXIT) over( job, m.print_unit.ops, 0 );
+	job->count = m.count;
+	job->simulated = sim360_time( &m ) * 1e-9;
+	job->read = m.next_card;
+	job->printed = m.print_unit.ops;
+	sim360_free( &m );
+}
+
+static void run_job( struct worker *w, struct job *job )
+{
+	struct spool sp;
+	FILE *listing = NULL, *index = NULL;
+
+	job->started = now();
+	if (job->status == JOB_OK) {
+		listing = output( job, "lst", "w" );
+		if (spool_open( &sp, listing, form ) != 0) {
+			job->status = JOB_ERROR;
+			strcpy( job->why, "out of memory" );
+		} else {
+			switch (job->machine) {
+			case FORTRAN: run_fortran( job, &sp ); break;
+			case M1401: run_1401( w, job, &sp ); break;
+			case M360: run_360( job, &sp ); break;
+			}
+			if (write_index && (listing != NULL))
+				index = output( job, "idx", "wb" );
+			if (spool_close( &sp, index ) != 0)
+				fprintf( stderr, "%s: job %ld: error writing"
+						 " the listing\n", progname, job->seq );
+		}
+		if (index != NULL) fclose( index );
+		if (listing != NULL) fclose( listing );
+	}
+	job->finished = now();
+	w->jobs++;
+}
+
+static void *work( void *arg )
+{
+	struct worker *w = arg;
+	struct job *job;
+
+	while ((job = dequeue()) != NULL) run_job( w, job );
+	return NULL;
+}
+
+/* run everything queued on n workers; returns the jobs each ran */
+static void run_all( int n, FILE *report )
+{
+	static struct worker workers[MAX_WORKERS];
+	int i;
+
+	for (i = 0; i < n; i++) {
+		memset( &workers[i], 0, sizeof workers[i] );
+		if (pthread_create( &workers[i].thread, NULL, work,
+				    &workers[i] ) != 0) {
+			fprintf( stderr, "%s: cannot start worker %d\n",
+				 progname, i + 1 );
+			exit(-1);
+		}
+	}
+	for (i = 0; i < n; i++) {
+		pthread_join( workers[i].thread, NULL );
+		free( workers[i].m1401 );
+		if (report != NULL)
+			fprintf( report, "worker %d: %ld jobs\n", i + 1,
+				 workers[i].jobs );
+	}
+}
+
+static void report_job( FILE *f, const struct job *job )
+{
+	fprintf( f, "%4ld %-8s %-7s %c %-6s %8.1f %8.1f %10.3f %12lld"
+		    " %6ld %7ld %6ld",
+		 job->seq, job->name, machine_names[job->machine],
+		 'A' + job->class, status_names[job->status],
+		 (job->started - job->queued) * 1e3,
+		 (job->finished - job->started) * 1e3,
+		 job->simulated, job->count,
+		 job->read, job->printed, job->punched );
+	if (job->why[0]) fprintf( f, "  %s", job->why );
+	putc( '\n', f );
+}
+
+static void free_jobs( void )
+{
+	long i;
+
+	for (i = 0; i < njobs; i++) {
+		card_buf_free( &jobs[i]->deck );
+		free( jobs[i] );
+	}
+	njobs = 0;
+}
+
+/* a job for the benchmark: primes below 5000, and a sum of roots */
+static const char bench_job[] =
+	"$JOB BENCH%ld,FORTRAN,CLASS=%c\n"
+	"      DIMENSION K(5000)\n"
+	"      N = 0\n"
+	"      DO 10 I = 2, 5000\n"
+	"   10 K(I) = 1\n"
+	"      DO 30 I = 2, 5000\n"
+	"      IF (K(I) .EQ. 0) GO TO 30\n"
+	"      N = N + 1\n"
+	"      DO 20 J = I, 5000, I\n"
+	"   20 K(J) = 0\n"
+	"   30 CONTINUE\n"
+	"      S = 0.0\n"
+	"      DO 40 I = 1, 2000\n"
+	"   40 S = S + SQRT(FLOAT(I))\n"
+	"      PRINT 50, N, S\n"
+	"   50 FORMAT (1H ,I6,F12.2)\n"
+	"      STOP\n"
+	"      END\n"
+	"$EOJ\n";
+
+static void bench( long n, int nworkers, const struct job *defaults )
+{
+	struct card_buf text = { NULL, 0, 0 }, deck = { NULL, 0, 0 };
+	double rate[2];
+	long i;
+	int pass;
+
+	for (i = 0; i < n; i++) {
+		if (card_buf_reserve( &text, text.len + sizeof bench_job + 32 )
+		    != CARD_OK) {
+			fprintf( stderr, "%s: out of memory\n", progname );
+			exit(-1);
+		}
+		text.len += sprintf( (char *)text.data + text.len, bench_job,
+				     i % 10000, 'A' + (int)(i % 3) );
+	}
+	if (card_make_buffer( &control_codec, text.data, text.len, &deck )
+	    != CARD_OK) {
+		fprintf( stderr, "%s: out of memory\n", progname );
+		exit(-1);
+	}
+	for (pass = 0; pass < 2; pass++) {
+		int workers = (pass == 0) ? 1 : nworkers;
+		double start;
+
+		split( "benchmark", deck.data, deck.len, defaults );
+		start = now();
+		run_all( workers, NULL );
+		rate[pass] = n / (now() - start);
+		for (i = 0; i < njobs; i++) {
+			if (jobs[i]->status != JOB_OK) {
+				fprintf( stderr, "%s: benchmark job failed: %s\n",
+					 progname, jobs[i]->why );
+				exit(-1);
+			}
+		}
+		printf( "%3d workers: %8.0f jobs/s\n", workers, rate[pass] );
+		free_jobs();
+	}
+	printf( "%.2f times the throughput of one worker\n", rate[1] / rate[0] );
+	card_buf_free( &text );
+	card_buf_free( &deck );
+}
+
+static void usage( void )
+{
+	fprintf( stderr, "\n%s [options] deck ...\n\n", progname );
+	fprintf( stderr,
+	"Run the jobs in card decks on a pool of emulators.  The jobs are\n"
+	"separated by $JOB and $EOJ cards; the options are:\n\n"
+	" -out dir        put each job's listing and punched cards in dir\n"
+	" -index          write each listing's page index too\n"
+	" -workers n      jobs run at once (one per processor)\n"
+	" -time s         processor seconds a job may take, if its $JOB\n"
+	"                 card does not say (60)\n"
+	" -lines n        lines it may print (10000)\n"
+	" -cards n        cards it may punch (1000)\n"
+	" -class c        its class (A)\n"
+	" -form n         lines on a page (66)\n"
+	" -unthrottled    the emulators' devices take no time\n"
+	" -026comm        how FORTRAN decks are punched (029)\n"
+	" -029 -026ftn\n\n"
+	" -bench [n]      time n FORTRAN jobs instead (200)\n\n"
+	);
+	exit(-1);
+}
+
+int main( int argc, char *argv[] )
+{
+	struct card_options opt, ftn_opt;
+	struct job defaults;
+	long nbench = 0, i;
+	int nworkers = (int)sysconf( _SC_NPROCESSORS_ONLN );
+	int arg = 1, failed = 0;
+	double start;
+
+	progname = argv[0];
+	memset( &defaults, 0, sizeof defaults );
+	defaults.time_limit = 60;
+	defaults.max_lines = 10000;
+	defaults.max_cards = 1000;
+	card_options_init( &ftn_opt );
+	while ((arg < argc) && (argv[arg][0] == '-')) { /* command line arg */
+		if (card_list_option( &ftn_opt, argv[arg] )) {
+			/* translation table for FORTRAN decks */
+		} else if ((strcmp(argv[arg],"-out") == 0) && (arg + 1 < argc)) {
+			out_dir = argv[++arg];
+		} else if (strcmp(argv[arg],"-index") == 0) {
+			write_index = 1;
+		} else if ((strcmp(argv[arg],"-workers") == 0) && (arg + 1 < argc)) {
+			nworkers = atoi( argv[++arg] );
+		} else if ((strcmp(argv[arg],"-time") == 0) && (arg + 1 < argc)) {
+			defaults.time_limit = atof( argv[++arg] );
+		} else if ((strcmp(argv[arg],"-lines") == 0) && (arg + 1 < argc)) {
+			defaults.max_lines = atol( argv[++arg] );
+		} else if ((strcmp(argv[arg],"-cards") == 0) && (arg + 1 < argc)) {
+			defaults.max_cards = atol( argv[++arg] );
+		} else if ((strcmp(argv[arg],"-class") == 0) && (arg + 1 < argc)) {
+			arg++;
+			if ((argv[arg][0] < 'A') || (argv[arg][0] > 'Z')) usage();
+			defaults.class = argv[arg][0] - 'A';
+		} else if ((strcmp(argv[arg],"-form") == 0) && (arg + 1 < argc)) {
+			form = atoi( argv[++arg] );
+		} else if (strcmp(argv[arg],"-unthrottled") == 0) {
+			unthrottled = 1;
+		} else if (strcmp(argv[arg],"-bench") == 0) {
+			nbench = 200;
+			if ((arg + 1 < argc) && (argv[arg + 1][0] != '-'))
+				nbench = atol( argv[++arg] );
+		} else if (strcmp(argv[arg],"-help") == 0) {
+			usage();
+		} else {
+			fprintf( stderr, "%s: unknown option %s;"
+					 " -help available\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+		arg++;
+	}
+	if (nworkers < 1) nworkers = 1;
+	if (nworkers > MAX_WORKERS) nworkers = MAX_WORKERS;
+
+	card_options_init( &opt );
+	opt.table = CARD_029;
+	card_codec_init( &control_codec, &opt );
+	card_codec_init( &ftn_codec, &ftn_opt );
+
+	if (nbench > 0) {
+		bench( nbench, nworkers, &defaults );
+		exit(0);
+	}
+
+	if (arg == argc) {
+		fprintf( stderr, "%s: no decks; -help available\n", argv[0] );
+		exit(-1);
+	}
+	if ((out_dir != NULL) && (mkdir( out_dir, 0777 ) != 0)
+	 && (errno != EEXIST)) {
+		fprintf( stderr, "%s %s: %s\n", argv[0], out_dir,
+			 strerror( errno ) );
+		exit(-1);
+	}
+	for (; arg < argc; arg++) {
+		FILE *f = fopen( argv[arg], "rb" );
+		unsigned char *deck;
+		size_t len;
+
+		if ((f == NULL) || ((deck = read_all( f, &len )) == NULL)) {
+			fprintf( stderr, "%s %s: invalid card file\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+		fclose( f );
+		if (split( argv[arg], deck, len, &defaults ) != 0) failed = 1;
+		free( deck );
+	}
+
+	start = now();
+	run_all( nworkers, NULL );
+	printf( " job name     machine c status  wait ms   run ms"
+		"  simulated  instructions   read printed punched\n" );
+	for (i = 0; i < njobs; i++) {
+		report_job( stdout, jobs[i] );
+		if (jobs[i]->status != JOB_OK) failed = 1;
+	}
+	printf( "%ld jobs on %d workers in %.3f s\n", njobs, nworkers,
+		now() - start );
+	free_jobs();
+	exit(failed ? 1 : 0);
+}
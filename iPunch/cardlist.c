@@ -11,13 +11,12 @@
  * date:    March 5, 1996
  *          Feb  18, 1997  -- added command line options and support.
  *
+ * build:   cc -o cardlist cardlist.c cardcodec.c
+ *
  */
 
 #include <stdio.h>
-#define ERROR 00404
-#include "cardcode.i"
-
-char ascii_code[4096];
+#include "cardcodec.h"
 
 main(argc,argv)
 int argc;
@@ -26,17 +25,19 @@ char *argv[];
 	FILE *ascii_fd, *card_fd;
 	int arg = 1;
 	int format = 80;
-	int table = 3;
+	int table = CARD_029;
 	int dump = 0;
+	struct card_options options;
+	struct card_codec codec;
 	while ((arg < argc) && (argv[arg][0] == '-')) { /* command line arg */
 		if (strcmp(argv[arg],"-026comm") == 0) {
-			table = 1;
+			table = CARD_026COMM;
 		} else if (strcmp(argv[arg],"-026ftn") == 0) {
-			table = 2;
+			table = CARD_026FTN;
 		} else if (strcmp(argv[arg],"-029ftn") == 0) {
-			table = 3;
+			table = CARD_029;
 		} else if (strcmp(argv[arg],"-EBCDIC") == 0) {
-			table = 4;
+			table = CARD_EBCDIC;
 		} else if (strcmp(argv[arg],"-d") == 0) {
 			dump = 1;
 		} else if (strcmp(argv[arg],"-help") == 0) {
@@ -90,30 +91,10 @@ char *argv[];
                 }
         }
 
-	{ /* make appropriate card to ascii translation table */
-		int i;
-		for ( i = 0; i < 4096; i++ ) { /* mark illegal characters */
-			ascii_code[i] = '~';
-		}
-		switch (table) {
-			case 1:
-				for ( i = ' '; i < '`'; i++ )
-					ascii_code[ o26_comm_code[i] ] = i;
-				break;
-			case 2:
-				for ( i = ' '; i < '`'; i++ )
-					ascii_code[ o26_ftn_code[i] ] = i;
-				break;
-			case 3:
-				for ( i = ' '; i < '`'; i++ )
-					ascii_code[ o29_code[i] ] = i;
-				break;
-			case 4:
-				for ( i = 0; i <= 0177; i++ )
-					ascii_code[ EBCDIC_code[i] ] = i;
-				break;
-		}
-	}
+	/* make appropriate card to ascii translation table */
+	card_options_init( &options );
+	options.table = table;
+	card_codec_init( &codec, &options );
 
 	/* check for prefix on input */
 	{
@@ -240,9 +221,9 @@ char *argv[];
 			odd_col = ((second & 0017) << 8) | third;
 
 			/* pack result into line */
-			line[cur_col] = ascii_code[even_col];
+			line[cur_col] = card_decode( &codec, even_col );
 			cur_col++;
-			line[cur_col] = ascii_code[odd_col];
+			line[cur_col] = card_decode( &codec, odd_col );
 			cur_col++;
 		}
 		line[cur_col] = (char)0;
@@ -0,0 +1,206 @@
+/* cardload.c -- load generator for carddaemon.
+ *
+ * operation:  run cardload -help for instructions
+ *
+ * build: cc -o cardload cardload.c cardd.c cardconv.c cardcodec.c -lpthread
+ *
+ * Each of -c threads opens its own connection and sends -n requests
+ * back to back, timing each round trip.  At the end the latencies of
+ * every request are pooled and the median, tail and throughput printed.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "cardd.h"
+
+struct client {
+	pthread_t thread;
+	double *latency;	/* seconds, one per request */
+	long done;
+	int failed;
+};
+
+static const char *sock_path = CARDD_SOCKET;
+static int op = CARDD_ENCODE;
+static long requests = 10000;
+static struct card_buf payload;	/* shared, read only once threads start */
+
+static double now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *run( void *arg )
+{
+	struct client *cl = arg;
+	struct card_buf reply = { NULL, 0, 0 };
+	struct cardd_client *conn = cardd_connect( sock_path );
+	long i;
+
+	if (conn == NULL) {
+		cl->failed = 1;
+		return NULL;
+	}
+	for (i = 0; i < requests; i++) {
+		double start = now();
+		int status = cardd_request( conn, op, NULL, payload.data,
+					    payload.len, &reply );
+		cl->latency[i] = now() - start;
+		if (status != CARD_OK) {
+			fprintf( stderr, "cardload: %s\n",
+				 card_strerror( status ) );
+			cl->failed = 1;
+			break;
+		}
+		cl->done++;
+	}
+	card_buf_free( &reply );
+	cardd_disconnect( conn );
+	return NULL;
+}
+
+static int by_value( const void *a, const void *b )
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+static double percentile( const double *sorted, long n, double p )
+{
+	long i = (long)(p * (n - 1) + 0.5);
+	return sorted[i];
+}
+
+int main( int argc, char *argv[] )
+{
+	struct client *clients;
+	struct card_buf text = { NULL, 0, 0 };
+	struct cardd_client *conn;
+	double *all, start, elapsed;
+	long lines = 40, total = 0;
+	int nclients = 4;
+	int arg = 1, i;
+
+	while ((arg < argc) && (argv[arg][0] == '-')) { /* command line arg */
+		if ((strcmp(argv[arg],"-socket") == 0) && (arg + 1 < argc)) {
+			sock_path = argv[++arg];
+		} else if ((strcmp(argv[arg],"-c") == 0) && (arg + 1 < argc)) {
+			nclients = atoi( argv[++arg] );
+		} else if ((strcmp(argv[arg],"-n") == 0) && (arg + 1 < argc)) {
+			requests = atol( argv[++arg] );
+		} else if ((strcmp(argv[arg],"-lines") == 0) && (arg + 1 < argc)) {
+			lines = atol( argv[++arg] );
+		} else if (strcmp(argv[arg],"-encode") == 0) {
+			op = CARDD_ENCODE;
+		} else if (strcmp(argv[arg],"-decode") == 0) {
+			op = CARDD_DECODE;
+		} else if (strcmp(argv[arg],"-validate") == 0) {
+			op = CARDD_VALIDATE;
+		} else if (strcmp(argv[arg],"-concat") == 0) {
+			op = CARDD_CONCAT;
+		} else if (strcmp(argv[arg],"-help") == 0) {
+			fprintf( stderr, "\n%s [options]\n\n", argv[0] );
+			fprintf( stderr,
+			"Load carddaemon with requests for a deck of -lines\n"
+			"cards and report round trip latency.  The options\n"
+			"are:\n\n"
+			" -socket path    daemon socket (" CARDD_SOCKET ")\n"
+			" -c n            concurrent connections (4)\n"
+			" -n n            requests per connection (10000)\n"
+			" -lines n        cards per request (40)\n"
+			" -encode -decode what to ask for\n"
+			" -validate -concat  (encode default)\n\n"
+			);
+			exit(-1);
+		} else {
+			fprintf( stderr, "%s: unknown option %s;"
+					 " -help available\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+		arg++;
+	}
+	if ((nclients <= 0) || (requests <= 0) || (lines < 0)) {
+		fprintf( stderr, "%s: counts must be positive\n", argv[0] );
+		exit(-1);
+	}
+
+	/* a FORTRAN-looking program, then as cards if the op wants a deck */
+	for (i = 0; i < lines; i++) {
+		char stmt[80], line[96];
+		int n;
+		sprintf( stmt, "%5d FORMAT(12H HELLO WORLD, I5, F10.3)", 100 + i );
+		n = sprintf( line, "%-72s%08d\n", stmt, i % 100000000 );
+		card_buf_reserve( &text, text.len + n );
+		memcpy( text.data + text.len, line, n );
+		text.len += n;
+	}
+	payload = text;
+	if (op != CARDD_ENCODE) {
+		struct card_buf deck = { NULL, 0, 0 };
+		conn = cardd_connect( sock_path );
+		if ((conn == NULL)
+		||  (cardd_request( conn, CARDD_ENCODE, NULL, text.data,
+				    text.len, &deck ) != CARD_OK)) {
+			fprintf( stderr, "%s %s: cannot reach daemon\n",
+				 argv[0], sock_path );
+			exit(-1);
+		}
+		cardd_disconnect( conn );
+		payload.data = NULL;
+		payload.len = payload.cap = 0;
+		if (op == CARDD_CONCAT) { /* the deck, twice */
+			cardd_concat_add( &payload, deck.data, deck.len );
+			cardd_concat_add( &payload, deck.data, deck.len );
+			card_buf_free( &deck );
+		} else {
+			payload = deck;
+		}
+	}
+
+	clients = calloc( nclients, sizeof *clients );
+	for (i = 0; i < nclients; i++) {
+		clients[i].latency = malloc( requests * sizeof(double) );
+		if (clients[i].latency == NULL) {
+			fprintf( stderr, "%s: out of memory\n", argv[0] );
+			exit(-1);
+		}
+	}
+	start = now();
+	for (i = 0; i < nclients; i++)
+		pthread_create( &clients[i].thread, NULL, run, &clients[i] );
+	for (i = 0; i < nclients; i++)
+		pthread_join( clients[i].thread, NULL );
+	elapsed = now() - start;
+
+	all = malloc( nclients * requests * sizeof(double) );
+	for (i = 0; i < nclients; i++) {
+		if (clients[i].failed) {
+			fprintf( stderr, "%s: client %d failed\n", argv[0], i );
+		}
+		memcpy( all + total, clients[i].latency,
+			clients[i].done * sizeof(double) );
+		total += clients[i].done;
+	}
+	if (total == 0) {
+		fprintf( stderr, "%s: no requests completed\n", argv[0] );
+		exit(-1);
+	}
+	qsort( all, total, sizeof(double), by_value );
+
+	printf( "%ld requests, %d connections, %zu bytes each\n",
+		total, nclients, payload.len );
+	printf( "throughput  %10.0f requests/s\n", total / elapsed );
+	printf( "p50         %10.1f us\n", percentile( all, total, 0.50 ) * 1e6 );
+	printf( "p90         %10.1f us\n", percentile( all, total, 0.90 ) * 1e6 );
+	printf( "p99         %10.1f us\n", percentile( all, total, 0.99 ) * 1e6 );
+	printf( "p99.9       %10.1f us\n", percentile( all, total, 0.999 ) * 1e6 );
+	printf( "max         %10.1f us\n", all[total - 1] * 1e6 );
+	exit(0);
+}
@@ -11,11 +11,12 @@
  * date:    March 5, 1996
  *          Feb  18, 1997  -- added command line options and support.
  *
+ * build:   cc -o cardmake cardmake.c cardcodec.c
+ *
  */
 
 #include <stdio.h>
-#define ERROR 00404
-#include "cardcode.i"
+#include "cardcodec.h"
 
 main(argc,argv)
 int argc;
@@ -32,6 +33,8 @@ char *argv[];
 	int table = 4;
 	int form = 1;
 	int logo = 0;
+	struct card_options options;
+	struct card_codec codec;
 
 	while ((arg < argc) && (argv[arg][0] == '-')) { /* command line arg */
 		if (strcmp(argv[arg],"-H80") == 0) {
@@ -159,6 +162,11 @@ char *argv[];
 		}
 	}
 
+	/* translation tables for the chosen keypunch */
+	card_options_init( &options );
+	options.table = table;
+	card_codec_init( &codec, &options );
+
 	/* output file prefix */
 	fputc( 'H', card_fd );
 	fputc( '8', card_fd );
@@ -209,7 +217,7 @@ char *argv[];
 			max_col = 81;
 		}
 		while (src_col <= max_col) {
-			char even_ch, odd_ch; /* source characters */
+			unsigned char even_ch, odd_ch; /* source characters */
 			int even_col, odd_col; /* corresponding 12 bit codes */
 			char first, second, third; /* packed for output */
 
@@ -220,19 +228,8 @@ char *argv[];
 			src_col++;
 			
 			/* convert to card codes */
-			if (table == 1) {
-				even_col = o26_comm_code[ even_ch ];
-				odd_col = o26_comm_code[ odd_ch ];
-			} else if (table == 2) {
-				even_col = o26_ftn_code[ even_ch ];
-				odd_col = o26_ftn_code[ odd_ch ];
-			} else if (table == 4) {
-				even_col = o29_code[ even_ch ];
-				odd_col = o29_code[ odd_ch ];
-			} else { /* table == 8 */
-				even_col = EBCDIC_code[ even_ch ];
-				odd_col = EBCDIC_code[ odd_ch ];
-			}
+			even_col = card_encode( &codec, even_ch );
+			odd_col = card_encode( &codec, odd_ch );
 
 			/* divide 2 columns into 3 bytes */
 			first = even_col >> 4;
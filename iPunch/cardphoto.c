@@ -0,0 +1,214 @@
+/* cardphoto.c -- read punched cards from photographs of them.
+ *
+ * operation:  run cardphoto -help for instructions
+ *
+ * build: cc -o cardphoto cardphoto.c cardscan.c cardimage.c cardconv.c
+ *        cardcodec.c -lz -lm
+ *
+ * input  -- pictures of cards, one card in each, PNG or PNM
+ * output -- a card-image file with a card for each picture, in order
+ *
+ * This is the app's take-a-photo-and-run-it, for the command line.  A
+ * card should fill much of its picture, on something darker than the
+ * card so that the holes show dark, at any angle and in any light, and
+ * turned over if it is upside down; see cardscan.h.  The cards are laid
+ * out as real cards are, unless -ipunch says they are drawn as the
+ * editor draws them, as cardshoot makes them.
+ *
+ * -report gives each picture's confidence, doubtful positions, corners
+ * and whether the card was turned, on stderr; -list adds the text of
+ * the card as the keypunch table reads it.  A picture with no card to
+ * be found is reported and left out of the deck, and the exit status
+ * is then 1.
+ *
+ * -print reads the printing along the top of interpreted cards too and
+ * checks it against the holes, as the keypunch table prints them, and
+ * -correct punches what the printing says where they differ; see
+ * cardscan.h.  -report then counts the columns that differ or were
+ * corrected, and -list shows the printing read under the holes' text,
+ * with a ^ under each column that differs, a * under each corrected and
+ * a ? under each with ink over it that could not be read, which counts
+ * as doubtful.
+ *
+ * -bench n reads the first picture n times and reports the time to
+ * read one, which is the latency of reading a frame.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "cardconv.h"
+#include "cardscan.h"
+
+static double now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report( const char *path, const struct card_scan *scan,
+		    const struct card_codec *codec, int list, int print )
+{
+	int c;
+
+	static const char *cuts[] = { "no cut", "right cut", "left cut", "both cut" };
+
+	fprintf( stderr, "%s: confidence %.2f, %d doubtful, %s%s, corners", path,
+		 scan->confidence, scan->doubtful, cuts[scan->cut],
+		 scan->turned ? ", turned" : "" );
+	for (c = 0; c < 4; c++)
+		fprintf( stderr, " (%.1f,%.1f)", scan->corner[c][0], scan->corner[c][1] );
+	putc( '\n', stderr );
+	if (print)
+		fprintf( stderr, "  %s, %d differ, %d corrected\n",
+			 scan->interpreted ? "printed" : "not printed",
+			 scan->differ, scan->corrected );
+	if (list) {
+		char text[81];
+		int n = 80;
+		for (c = 0; c < 80; c++) text[c] = card_decode( codec, scan->cols[c] );
+		while ((n > 0) && (text[n - 1] == ' ')) n--;
+		text[n] = '\0';
+		fprintf( stderr, "  %s\n", text );
+		if (print && scan->interpreted) {
+			static const char marks[] = " ^*?";
+			for (c = 0, n = 80; c < 80; c++) text[c] = scan->printed[c];
+			while ((n > 0) && (text[n - 1] == ' ')) n--;
+			text[n] = '\0';
+			fprintf( stderr, "  %s\n", text );
+			for (c = 0, n = 0; c < 80; c++) {
+				int k = scan->check[c] - CARD_PRINT_UNREAD;
+				text[c] = (k > 0) ? marks[k] : ' ';
+				if (k > 0) n = c + 1;
+			}
+			text[n] = '\0';
+			if (n > 0) fprintf( stderr, "  %s\n", text );
+		}
+	}
+}
+
+static void usage( const char *progname )
+{
+	fprintf( stderr, "\n%s [options] picture ...\n\n", progname );
+	fprintf( stderr,
+	"Read a punched card from each picture into a card deck on stdout.\n"
+	"The options are:\n\n"
+	" -ipunch         the cards are drawn as the editor draws them\n"
+	" -report         report on each picture on stderr\n"
+	" -list           and what is punched in it\n"
+	" -print          check the printing of interpreted cards\n"
+	" -correct        and punch what it says where they differ\n"
+	" -bench n        time n readings of the first picture instead\n\n"
+	" -H80 -H82       columns per card (H80 default)\n"
+	" -026comm        the keypunch, for -list\n"
+	" -029 -026ftn    (029 default)\n"
+	" -EBCDIC\n\n"
+	"and the card colors and the like of cardmake.\n\n"
+	);
+	exit(-1);
+}
+
+int main( int argc, char *argv[] )
+{
+	const struct card_geometry *geometry = &card_geometry_ibm;
+	struct card_options opt;
+	struct card_codec codec;
+	struct card_image_work image_work;
+	struct card_scan_work work;
+	struct card_scan scan;
+	long bench = 0, i;
+	int do_report = 0, list = 0, print = 0, correct = 0;
+	int failed = 0, wrote = 0;
+	int arg = 1, err;
+
+	card_options_init( &opt );
+	while ((arg < argc) && (argv[arg][0] == '-')) { /* command line arg */
+		if (card_make_option( &opt, argv[arg] )) {
+			/* a card header or keypunch option */
+		} else if (strcmp(argv[arg],"-ipunch") == 0) {
+			geometry = &card_geometry_ipunch;
+		} else if (strcmp(argv[arg],"-report") == 0) {
+			do_report = 1;
+		} else if (strcmp(argv[arg],"-list") == 0) {
+			do_report = list = 1;
+		} else if (strcmp(argv[arg],"-print") == 0) {
+			print = 1;
+		} else if (strcmp(argv[arg],"-correct") == 0) {
+			print = correct = 1;
+		} else if ((strcmp(argv[arg],"-bench") == 0) && (arg + 1 < argc)) {
+			bench = atol( argv[++arg] );
+		} else if (strcmp(argv[arg],"-help") == 0) {
+			usage( argv[0] );
+		} else {
+			fprintf( stderr, "%s: unknown option %s;"
+					 " -help available\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+		arg++;
+	}
+	if (arg == argc) {
+		fprintf( stderr, "%s: no pictures; -help available\n", argv[0] );
+		exit(-1);
+	}
+	card_codec_init( &codec, &opt );
+	memset( &image_work, 0, sizeof image_work );
+	memset( &work, 0, sizeof work );
+
+	if (bench > 0) {
+		struct card_image gray;
+		double start;
+
+		err = card_image_load( &gray, argv[arg], 1, &image_work );
+		if (err != CARD_OK) {
+			fprintf( stderr, "%s %s: %s\n", argv[0], argv[arg],
+				 card_strerror( err ) );
+			exit(-1);
+		}
+		start = now();
+		for (i = 0; i < bench; i++) {
+			err = card_scan_image( &gray, geometry, &scan, &work );
+			if (err != CARD_OK) {
+				fprintf( stderr, "%s %s: %s\n", argv[0], argv[arg],
+					 card_strerror( err ) );
+				exit(-1);
+			}
+			if (print)
+				card_scan_print( &gray, geometry, &codec, correct, &scan );
+		}
+		printf( "%dx%d: %.2f ms a picture\n", gray.width, gray.height,
+			(now() - start) * 1e3 / bench );
+		exit(0);
+	}
+
+	for (; arg < argc; arg++) {
+		struct card_image gray;
+		unsigned char card[3 + 123];
+		size_t n;
+
+		err = card_image_load( &gray, argv[arg], 1, &image_work );
+		if (err == CARD_OK)
+			err = card_scan_image( &gray, geometry, &scan, &work );
+		if (err != CARD_OK) {
+			fprintf( stderr, "%s %s: %s\n", argv[0], argv[arg],
+				 card_strerror( err ) );
+			failed = 1;
+			continue;
+		}
+		if (print) card_scan_print( &gray, geometry, &codec, correct, &scan );
+		if (do_report) report( argv[arg], &scan, &codec, list, print );
+		if (!wrote++) fputs( (opt.format == 80) ? "H80" : "H82", stdout );
+		n = card_scan_card( &scan, &opt, card );
+		fwrite( card, 1, n, stdout );
+	}
+	card_image_work_free( &image_work );
+	card_scan_work_free( &work );
+	if (fflush( stdout ) != 0) {
+		fprintf( stderr, "%s: error writing the deck\n", argv[0] );
+		exit(-1);
+	}
+	exit(failed ? 1 : 0);
+}
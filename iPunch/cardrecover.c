@@ -0,0 +1,291 @@
+/* cardrecover.c -- recover the sound cards from a damaged card-image file.
+ *
+ * operation:  run cardrecover -help for instructions
+ *
+ * build: cc -o cardrecover cardrecover.c cardcodec.c
+ *
+ * input  -- a card-image file, possibly with bytes lost or inserted
+ * output -- a card-image file holding every card that looks sound,
+ *           and a damage report on stderr (or the -report file)
+ *
+ * cardlist keeps decoding misaligned bytes after damage, and cardcat
+ * gives up on the rest of the file.  This instead copies cards while
+ * they look right, all three header bytes carrying the 0x80 bit and
+ * nearly every column a code the keypunch can make, and when one does
+ * not, scans forward for the next offset where a card plausibly
+ * starts: one that looks right, and that the card after starts with a
+ * header too, or that ends the file.
+ *
+ * The scan for header bytes looks at 16 or 32 offsets at once with
+ * SSE2, AVX2 or NEON, so a long damaged stretch costs little more than
+ * reading it.
+ *
+ * see the README file for details of the card image file format!
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cardcodec.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+static struct card_codec codec;
+static int format = 0;		/* 80 or 82, 0 to take it from the prefix */
+static int binary = 0;		/* accept any column values */
+static int min_legal = 76;	/* legal columns needed, of 80 */
+
+/* the first offset at or after from where three bytes in a row have
+   the 0x80 bit set, or len if there is none */
+static size_t next_header( const unsigned char *buf, size_t from, size_t len )
+{
+#if defined(__AVX2__)
+	while (from + 34 <= len) {
+		__m256i a = _mm256_loadu_si256( (const __m256i *)(buf + from) );
+		__m256i b = _mm256_loadu_si256( (const __m256i *)(buf + from + 1) );
+		__m256i c = _mm256_loadu_si256( (const __m256i *)(buf + from + 2) );
+		unsigned m = _mm256_movemask_epi8(
+			_mm256_and_si256( _mm256_and_si256( a, b ), c ) );
+		if (m != 0) return from + __builtin_ctz( m );
+		from += 32;
+	}
+#elif defined(__SSE2__)
+	while (from + 18 <= len) {
+		__m128i a = _mm_loadu_si128( (const __m128i *)(buf + from) );
+		__m128i b = _mm_loadu_si128( (const __m128i *)(buf + from + 1) );
+		__m128i c = _mm_loadu_si128( (const __m128i *)(buf + from + 2) );
+		unsigned m = _mm_movemask_epi8(
+			_mm_and_si128( _mm_and_si128( a, b ), c ) );
+		if (m != 0) return from + __builtin_ctz( m );
+		from += 16;
+	}
+#elif defined(__ARM_NEON)
+	while (from + 18 <= len) {
+		uint8x16_t a = vld1q_u8( buf + from );
+		uint8x16_t b = vld1q_u8( buf + from + 1 );
+		uint8x16_t c = vld1q_u8( buf + from + 2 );
+		uint8x16_t all = vandq_u8( vandq_u8( a, b ), c );
+		uint64x2_t high = vreinterpretq_u64_u8(
+			vandq_u8( all, vdupq_n_u8( 0x80 ) ) );
+		if ((vgetq_lane_u64( high, 0 ) | vgetq_lane_u64( high, 1 )) != 0)
+			break; /* the scalar loop finds which offset */
+		from += 16;
+	}
+#endif
+	while (from + 3 <= len) {
+		if (buf[from] & buf[from + 1] & buf[from + 2] & 0x80)
+			return from;
+		from++;
+	}
+	return len;
+}
+
+/* does a card plausibly start at p?  card_bytes are known to remain */
+static int plausible( const unsigned char *p, size_t card_bytes )
+{
+	const unsigned char *col = p + 3;
+	int legal = 0;
+	int i;
+
+	if ((p[0] & p[1] & p[2] & 0x80) == 0) return 0;
+	if (binary) return 1;
+
+	for (i = 0; i < (int)(card_bytes - 3) / 3; i++, col += 3) {
+		int even_col = (col[0] << 4) | (col[1] >> 4);
+		int odd_col = ((col[1] & 0017) << 8) | col[2];
+		legal += (card_decode( &codec, even_col ) != '~');
+		legal += (card_decode( &codec, odd_col ) != '~');
+	}
+	if (card_bytes != 3 + 120) legal = legal * 80 / 82; /* H82 */
+	return legal >= min_legal;
+}
+
+/* after damage, is p a place to start again?  a plausible card whose
+   successor starts with a header too, or that ends the file */
+static int resync( const unsigned char *p, const unsigned char *end,
+		   size_t card_bytes )
+{
+	const unsigned char *next = p + card_bytes;
+
+	if (((size_t)(end - p) < card_bytes) || !plausible( p, card_bytes ))
+		return 0;
+	return (end - next < 3) || (next[0] & next[1] & next[2] & 0x80);
+}
+
+static void usage( const char *progname )
+{
+	fprintf( stderr, "\n%s [options] [input [output]]\n\n", progname );
+	fprintf( stderr,
+	"Copy the sound cards of a damaged card file, skipping damage.\n"
+	"If output is missing, output to stdout; if input is also\n"
+	"missing, input from stdin.  The options are:\n\n"
+	" -H80 -H82       format, if the prefix is damaged too\n\n"
+	" -026comm        the keypunch the cards were made on, used\n"
+	" -029 -026ftn    to judge columns (029 default)\n"
+	" -EBCDIC\n\n"
+	" -binary         any column value is plausible; rely on card\n"
+	"                 headers alone\n\n"
+	" -legal n        legal columns a card needs, of 80 (76)\n\n"
+	" -report file    write the damage report there, not stderr\n\n"
+	);
+	exit(-1);
+}
+
+int main( int argc, char *argv[] )
+{
+	struct card_options opt;
+	FILE *card_fd, *report_fd = stderr;
+	const unsigned char *buf, *p, *end;
+	unsigned char *owned = NULL;
+	size_t len, card_bytes;
+	long cards = 0, regions = 0, skipped = 0;
+	int arg = 1;
+	int in_fd = 0;
+
+	card_options_init( &opt );
+	while ((arg < argc) && (argv[arg][0] == '-')) { /* command line arg */
+		if (strcmp(argv[arg],"-H80") == 0) {
+			format = 80;
+		} else if (strcmp(argv[arg],"-H82") == 0) {
+			format = 82;
+		} else if (strcmp(argv[arg],"-binary") == 0) {
+			binary = 1;
+		} else if ((strcmp(argv[arg],"-legal") == 0) && (arg + 1 < argc)) {
+			min_legal = atoi( argv[++arg] );
+		} else if ((strcmp(argv[arg],"-report") == 0) && (arg + 1 < argc)) {
+			report_fd = fopen( argv[++arg], "w" );
+			if (report_fd == NULL) {
+				fprintf( stderr, "%s %s: invalid report file\n",
+					 argv[0], argv[arg] );
+				exit(-1);
+			}
+		} else if (strcmp(argv[arg],"-help") == 0) {
+			usage( argv[0] );
+		} else if (!card_list_option( &opt, argv[arg] )) {
+			fprintf( stderr, "%s: unknown option %s;"
+					 " -help available\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+		arg++;
+	}
+	if ( (argc - arg) > 2 ) { /* too many arguments */
+		fprintf( stderr, "%s: too many arguments\n", argv[0] );
+		exit(-1);
+	}
+	card_codec_init( &codec, &opt );
+
+	/* map the input where we can; a pipe has to be read into memory */
+	if ( (argc - arg) >= 1 ) {
+		in_fd = open( argv[arg], O_RDONLY );
+		if (in_fd < 0) {
+			fprintf( stderr, "%s %s: invalid card file\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+	}
+	{
+		struct stat st;
+		void *map = MAP_FAILED;
+		if ((fstat( in_fd, &st ) == 0) && S_ISREG( st.st_mode )
+		&&  (st.st_size > 0)) {
+			map = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+				    in_fd, 0 );
+		}
+		if (map != MAP_FAILED) {
+			madvise( map, st.st_size, MADV_SEQUENTIAL );
+			buf = map;
+			len = st.st_size;
+		} else {
+			size_t cap = 1 << 20;
+			ssize_t got;
+			len = 0;
+			owned = malloc( cap );
+			while ((owned != NULL)
+			&& ((got = read( in_fd, owned + len, cap - len )) > 0)) {
+				len += got;
+				if (len == cap) owned = realloc( owned, cap *= 2 );
+			}
+			if (owned == NULL) {
+				fprintf( stderr, "%s: out of memory\n", argv[0] );
+				exit(-1);
+			}
+			buf = owned;
+		}
+	}
+	if ( (argc - arg) < 2 ) {
+		card_fd = stdout;
+	} else {
+		card_fd = fopen( argv[arg+1], "w" );
+		if ( card_fd == NULL ) {
+			fprintf( stderr, "%s %s: invalid card file\n",
+				 argv[0], argv[arg+1] );
+			exit(-1);
+		}
+	}
+
+	/* the prefix decides the format, unless it was given */
+	p = buf;
+	end = buf + len;
+	if ((len >= 3) && (p[0] == 'H') && (p[1] == '8')
+	&&  ((p[2] == '0') || (p[2] == '2'))) {
+		if (format == 0) format = (p[2] == '0') ? 80 : 82;
+		p += 3;
+	} else {
+		if (format == 0) format = 80;
+		fprintf( report_fd, "prefix damaged, assuming H%d\n", format );
+	}
+	card_bytes = (format == 80) ? 3 + 120 : 3 + 123;
+
+	fputc( 'H', card_fd );
+	fputc( '8', card_fd );
+	fputc( (format == 80) ? '0' : '2', card_fd );
+
+	while (p < end) {
+		const unsigned char *bad = p;
+
+		if (((size_t)(end - p) >= card_bytes)
+		&&  plausible( p, card_bytes )) {
+			fwrite( p, 1, card_bytes, card_fd );
+			p += card_bytes;
+			cards++;
+			continue;
+		}
+
+		/* damage: find the next offset where a card plausibly starts */
+		do {
+			p = buf + next_header( buf, (p - buf) + 1, len );
+		} while ((p < end) && !resync( p, end, card_bytes ));
+		regions++;
+		skipped += p - bad;
+		if (p < end) {
+			fprintf( report_fd,
+				 "bytes %ld-%ld: damaged, %ld bytes skipped;"
+				 " resynchronized before card %ld\n",
+				 (long)(bad - buf), (long)(p - buf) - 1,
+				 (long)(p - bad), cards + 1 );
+		} else {
+			fprintf( report_fd,
+				 "bytes %ld-%ld: damaged to end of file,"
+				 " %ld bytes skipped\n",
+				 (long)(bad - buf), (long)len - 1,
+				 (long)(p - bad) );
+		}
+	}
+
+	fprintf( report_fd, "%ld cards recovered, %ld damaged regions,"
+			    " %ld bytes skipped\n", cards, regions, skipped );
+	fclose( card_fd );
+	if (report_fd != stderr) fclose( report_fd );
+	free( owned );
+	exit( (regions == 0) ? 0 : 1 );
+}
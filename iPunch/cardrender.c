@@ -0,0 +1,367 @@
+/* cardrender.c -- draw punched cards as the editor draws them, anywhere.
+ *
+ * see cardrender.h
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cardconv.h"
+#include "cardimage.h"
+#include "cardrender.h"
+#include "cardfont.i"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/* where column c, row r is, at zoom 1 */
+#define HOLE_X( c )	(17 + 6 * (c))
+#define HOLE_Y( r )	(20 + 17 * (r))
+#define LETTER_X( c )	(18 + 6 * (c))
+#define LETTER_Y	8
+#define STRIP		6	/* wide, that a column is drawn in */
+
+static int load( struct card_image *img, const char *dir, const char *name )
+{
+	char path[4096];
+	FILE *f;
+	int err;
+
+	snprintf( path, sizeof path, "%s/%s", dir, name );
+	f = fopen( path, "rb" );
+	if (f == NULL) return CARD_EIO;
+	err = card_image_read( img, f );
+	fclose( f );
+	if ((err == CARD_OK) && (img->channels != 3)) {
+		card_image_free( img );
+		err = CARD_EIMAGE;
+	}
+	return err;
+}
+
+/* the sample card in the assets is punched already; paper over its
+   holes, the places all dark where Punch.png is dark, which reach a
+   row lower than that */
+static void paper_holes( struct card_atlas *atlas, const struct card_image *blank,
+			 const struct card_image *punch )
+{
+	int z = atlas->zoom, w = atlas->width, c, r, x, y;
+
+	for (c = 0; c < 80; c++) {
+		for (r = 0; r < 12; r++) {
+			int light = 0;
+			for (y = 0; y < punch->height; y++) {
+				int py = HOLE_Y( r ) * z + y;
+				for (x = 0; x < punch->width; x++) {
+					int px = HOLE_X( c ) * z + x;
+					if ((punch->pixels[3 * (y * punch->width + x)] < 128)
+					 && (blank->pixels[3 * ((size_t)py * w + px)] >= 128))
+						light++;
+				}
+			}
+			if (light) continue;
+			for (y = 0; y < punch->height; y++) {
+				int py = HOLE_Y( r ) * z + y;
+				for (x = 0; x < punch->width; x++) {
+					int px = HOLE_X( c ) * z + x;
+					const unsigned char *dot = punch->pixels
+						+ 3 * (y * punch->width + x);
+					if ((dot[0] < 128) || ((y >= z)
+					 && (dot[-3 * z * punch->width] < 128)))
+						memset( atlas->card + 4 * ((size_t)py * w + px),
+							255, 3 );
+				}
+			}
+		}
+	}
+}
+
+int card_atlas_load( struct card_atlas *atlas, const char *assets, int zoom )
+{
+	struct card_image blank, punch;
+	size_t hole_size, letter_size;
+	int w, h, z = zoom, x, y, l, err;
+
+	memset( atlas, 0, sizeof *atlas );
+	err = load( &blank, assets, (z == 2) ? "PunchedCard@2x.png" : "PunchedCard.png" );
+	if (err != CARD_OK) return err;
+	err = load( &punch, assets, (z == 2) ? "Punch@2x.png" : "Punch.png" );
+	if (err != CARD_OK) {
+		card_image_free( &blank );
+		return err;
+	}
+	w = blank.width;
+	h = blank.height;
+	err = CARD_EIMAGE;
+	if ((HOLE_X( 79 ) * z + punch.width > w) || (HOLE_Y( 11 ) * z + punch.height > h)
+	 || ((LETTER_X( 79 ) + 5) * z > w) || ((LETTER_Y + 7) * z > h)
+	 || (punch.width > STRIP * z)) goto done;
+
+	atlas->width = w;
+	atlas->height = h;
+	atlas->zoom = z;
+	atlas->hole_width = punch.width;
+	atlas->hole_height = punch.height;
+	atlas->letter_width = 5 * z;
+	atlas->letter_height = 7 * z;
+	hole_size = (size_t)punch.width * punch.height * 4;
+	letter_size = (size_t)atlas->letter_width * atlas->letter_height * 4;
+	atlas->card = malloc( (size_t)w * h * 4 );
+	atlas->hole = malloc( hole_size );
+	atlas->hole_mask = malloc( hole_size );
+	atlas->letters = malloc( 64 * letter_size );
+	atlas->letter_masks = malloc( 64 * letter_size );
+	err = CARD_ENOMEM;
+	if ((atlas->card == NULL) || (atlas->hole == NULL) || (atlas->hole_mask == NULL)
+	 || (atlas->letters == NULL) || (atlas->letter_masks == NULL)) goto done;
+
+	/* the blank card, without the sample's holes and printing, clear
+	   outside its outline, which is convex, on each row */
+	for (y = 0; y < h; y++) {
+		const unsigned char *in = blank.pixels + (size_t)y * w * 3;
+		unsigned char *out = atlas->card + (size_t)y * w * 4;
+		int left = 0, right = w - 1;
+		while ((left < w) && (in[3 * left] >= 128)) left++;
+		while ((right >= 0) && (in[3 * right] >= 128)) right--;
+		for (x = 0; x < w; x++, in += 3, out += 4) {
+			memcpy( out, in, 3 );
+			out[3] = ((x < left) || (x > right)) ? 0 : 255;
+		}
+	}
+	paper_holes( atlas, &blank, &punch );
+	for (y = LETTER_Y * z; y < (LETTER_Y + 7) * z; y++) {
+		unsigned char *out = atlas->card + ((size_t)y * w + HOLE_X( 0 ) * z) * 4;
+		for (x = 0; x < 470 * z; x++, out += 4) memset( out, 255, 3 );
+	}
+
+	for (x = 0; x < punch.width * punch.height; x++) {
+		memcpy( atlas->hole + 4 * x, punch.pixels + 3 * x, 3 );
+		atlas->hole[4 * x + 3] = 255;
+	}
+	memset( atlas->hole_mask, 0377, hole_size );
+
+	/* ink where the letter has a dot, the card elsewhere */
+	for (l = 0; l < 64; l++) {
+		unsigned char *p = atlas->letters + l * letter_size;
+		unsigned char *m = atlas->letter_masks + l * letter_size;
+		for (y = 0; y < atlas->letter_height; y++) {
+			for (x = 0; x < atlas->letter_width; x++, p += 4, m += 4) {
+				int dot = card_font[l][y / z] & (020 >> (x / z));
+				p[0] = p[1] = p[2] = 0;
+				p[3] = dot ? 255 : 0;
+				memset( m, dot ? 0377 : 0, 4 );
+			}
+		}
+	}
+	err = CARD_OK;
+done:
+	card_image_free( &blank );
+	card_image_free( &punch );
+	if (err != CARD_OK) card_atlas_free( atlas );
+	return err;
+}
+
+void card_atlas_free( struct card_atlas *atlas )
+{
+	free( atlas->card );
+	free( atlas->hole );
+	free( atlas->hole_mask );
+	free( atlas->letters );
+	free( atlas->letter_masks );
+	memset( atlas, 0, sizeof *atlas );
+}
+
+/* a sprite, width bytes by height rows, onto the card where the mask
+   is set */
+static void blit( unsigned char *to, size_t stride, const unsigned char *sprite,
+		  const unsigned char *mask, int width, int height )
+{
+	for (; height > 0; height--, to += stride, sprite += width, mask += width) {
+		int i = 0;
+#if defined(__SSE2__)
+		for (; i + 16 <= width; i += 16) {
+			__m128i s = _mm_loadu_si128( (const __m128i *)(sprite + i) );
+			__m128i m = _mm_loadu_si128( (const __m128i *)(mask + i) );
+			__m128i d = _mm_loadu_si128( (const __m128i *)(to + i) );
+			_mm_storeu_si128( (__m128i *)(to + i),
+				_mm_or_si128( _mm_and_si128( s, m ), _mm_andnot_si128( m, d ) ) );
+		}
+#elif defined(__ARM_NEON)
+		for (; i + 16 <= width; i += 16)
+			vst1q_u8( to + i, vbslq_u8( vld1q_u8( mask + i ),
+				vld1q_u8( sprite + i ), vld1q_u8( to + i ) ) );
+#endif
+		for (; i < width; i++)
+			to[i] = (sprite[i] & mask[i]) | (to[i] & ~mask[i]);
+	}
+}
+
+/* column c's holes and letter, over what is there */
+static void draw_column( const struct card_atlas *atlas, int c, uint16_t col,
+			 const struct card_codec *print, unsigned char *rgba )
+{
+	size_t stride = (size_t)atlas->width * 4;
+	size_t letter_size = (size_t)atlas->letter_width * atlas->letter_height * 4;
+	int z = atlas->zoom, r, ch;
+
+	for (r = 0; col && (r < 12); r++)
+		if (col & (1 << (11 - r)))
+			blit( rgba + HOLE_Y( r ) * z * stride + HOLE_X( c ) * z * 4,
+			      stride, atlas->hole, atlas->hole_mask,
+			      atlas->hole_width * 4, atlas->hole_height );
+	if (print == NULL) return;
+	ch = card_decode( print, col );
+	if ((ch <= ' ') || (ch > '_')) return;
+	blit( rgba + LETTER_Y * z * stride + LETTER_X( c ) * z * 4, stride,
+	      atlas->letters + (ch - ' ') * letter_size,
+	      atlas->letter_masks + (ch - ' ') * letter_size,
+	      atlas->letter_width * 4, atlas->letter_height );
+}
+
+void card_render( const struct card_atlas *atlas, const uint16_t *cols,
+		  const struct card_codec *print, unsigned char *rgba )
+{
+	int c;
+
+	memcpy( rgba, atlas->card, (size_t)atlas->width * 4 * atlas->height );
+	for (c = 0; c < 80; c++) draw_column( atlas, c, cols[c], print, rgba );
+}
+
+/* the rows a column is drawn in, from its letter to its last hole */
+static int strip_top( const struct card_atlas *atlas )
+{
+	return LETTER_Y * atlas->zoom;
+}
+
+static int strip_bottom( const struct card_atlas *atlas )
+{
+	return HOLE_Y( 11 ) * atlas->zoom + atlas->hole_height;
+}
+
+void card_render_column( const struct card_atlas *atlas, int c, uint16_t col,
+			 const struct card_codec *print, unsigned char *rgba )
+{
+	size_t stride = (size_t)atlas->width * 4;
+	size_t at = (size_t)strip_top( atlas ) * stride + HOLE_X( c ) * atlas->zoom * 4;
+	int y;
+
+	for (y = strip_top( atlas ); y < strip_bottom( atlas ); y++, at += stride)
+		memcpy( rgba + at, atlas->card + at, STRIP * atlas->zoom * 4 );
+	draw_column( atlas, c, col, print, rgba );
+}
+
+/* all of the card is to be shown again */
+static void redraw( struct card_view *view )
+{
+	card_render( view->atlas, view->cols, view->print, view->rgba );
+	memset( view->changed, 1, sizeof view->changed );
+	view->x = view->y = 0;
+	view->width = view->atlas->width;
+	view->height = view->atlas->height;
+}
+
+int card_view_init( struct card_view *view, const struct card_atlas *atlas,
+		    const struct card_codec *print )
+{
+	memset( view, 0, sizeof *view );
+	view->rgba = malloc( (size_t)atlas->width * atlas->height * 4 );
+	if (view->rgba == NULL) return CARD_ENOMEM;
+	view->atlas = atlas;
+	view->print = print;
+	redraw( view );
+	return CARD_OK;
+}
+
+void card_view_free( struct card_view *view )
+{
+	free( view->rgba );
+	memset( view, 0, sizeof *view );
+}
+
+int card_view_update( struct card_view *view, const uint16_t *cols )
+{
+	int z = view->atlas->zoom, first = -1, last = -1, n = 0, c;
+
+	for (c = 0; c < 80; c++) {
+		view->changed[c] = (cols[c] != view->cols[c]);
+		if (!view->changed[c]) continue;
+		card_render_column( view->atlas, c, cols[c], view->print, view->rgba );
+		view->cols[c] = cols[c];
+		if (first < 0) first = c;
+		last = c;
+		n++;
+	}
+	view->x = view->y = view->width = view->height = 0;
+	if (n > 0) {
+		view->x = HOLE_X( first ) * z;
+		view->width = (last - first + 1) * STRIP * z;
+		view->y = strip_top( view->atlas );
+		view->height = strip_bottom( view->atlas ) - view->y;
+	}
+	return n;
+}
+
+void card_view_set_print( struct card_view *view,
+			  const struct card_codec *print )
+{
+	view->print = print;
+	redraw( view );
+}
+
+/* each pixel of the top half of in the average of a 2 by 2 block; the
+   averages go two rows down, then two pixels across, rounding up */
+static void halve( unsigned char *rgba, int width, int height )
+{
+	int w = width / 2, h = height / 2, x, y;
+
+	for (y = 0; y < h; y++) {
+		const unsigned char *r0 = rgba + (size_t)2 * y * width * 4;
+		const unsigned char *r1 = r0 + (size_t)width * 4;
+		unsigned char *out = rgba + (size_t)y * w * 4;
+		x = 0;
+#if defined(__SSE2__)
+		for (; x + 4 <= w; x += 4) {
+			__m128i a = _mm_avg_epu8( _mm_loadu_si128( (const __m128i *)(r0 + 8 * x) ),
+						  _mm_loadu_si128( (const __m128i *)(r1 + 8 * x) ) );
+			__m128i b = _mm_avg_epu8( _mm_loadu_si128( (const __m128i *)(r0 + 8 * x + 16) ),
+						  _mm_loadu_si128( (const __m128i *)(r1 + 8 * x + 16) ) );
+			__m128 fa = _mm_castsi128_ps( a ), fb = _mm_castsi128_ps( b );
+			__m128i even = _mm_castps_si128( _mm_shuffle_ps( fa, fb, _MM_SHUFFLE( 2, 0, 2, 0 ) ) );
+			__m128i odd = _mm_castps_si128( _mm_shuffle_ps( fa, fb, _MM_SHUFFLE( 3, 1, 3, 1 ) ) );
+			_mm_storeu_si128( (__m128i *)(out + 4 * x), _mm_avg_epu8( even, odd ) );
+		}
+#elif defined(__ARM_NEON)
+		for (; x + 4 <= w; x += 4) {
+			uint32x4x2_t a = vld2q_u32( (const uint32_t *)(r0 + 8 * x) );
+			uint32x4x2_t b = vld2q_u32( (const uint32_t *)(r1 + 8 * x) );
+			uint8x16_t even = vrhaddq_u8( vreinterpretq_u8_u32( a.val[0] ),
+						      vreinterpretq_u8_u32( b.val[0] ) );
+			uint8x16_t odd = vrhaddq_u8( vreinterpretq_u8_u32( a.val[1] ),
+						     vreinterpretq_u8_u32( b.val[1] ) );
+			vst1q_u8( out + 4 * x, vrhaddq_u8( even, odd ) );
+		}
+#endif
+		for (; x < w; x++) {
+			int i;
+			for (i = 0; i < 4; i++) {
+				int left = (r0[8 * x + i] + r1[8 * x + i] + 1) >> 1;
+				int right = (r0[8 * x + 4 + i] + r1[8 * x + 4 + i] + 1) >> 1;
+				out[4 * x + i] = (left + right + 1) >> 1;
+			}
+		}
+	}
+}
+
+void card_render_shrink( unsigned char *rgba, int width, int height,
+			 int times )
+{
+	for (; (times > 0) && (width > 1) && (height > 1); times--) {
+		halve( rgba, width, height );
+		width /= 2;
+		height /= 2;
+	}
+}
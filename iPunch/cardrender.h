@@ -0,0 +1,89 @@
+/* cardrender.h -- draw punched cards as the editor draws them, anywhere.
+ *
+ * A card is Punch.png at each hole over PunchedCard.png; this draws it
+ * into RGBA memory, with no view system, so the editor draws the card
+ * under the cursor with it, and a deck can be drawn to files on any
+ * machine and at any rate.
+ *
+ * A card_atlas is everything a card is drawn from, made once from the
+ * app's assets at zoom 1 or 2, for the plain or @2x files: the blank
+ * card, which is PunchedCard.png with the holes of the sample card it
+ * is papered over, its printing cleared, and the pixels outside its
+ * outline, on each row, made clear; the hole, which is Punch.png; and
+ * the 64 letters of cardfont.i, a zoom by zoom square a dot.  Each hole
+ * and letter has a mask beside its pixels, all ones where it covers the
+ * card, so drawing one is (sprite & mask) | (card & ~mask), 16 bytes at
+ * a time with SSE2 or NEON.
+ *
+ * card_render copies the blank card whole into rgba, width by height
+ * pixels, and draws a hole at each punch; given a codec, it prints the
+ * card along its top as that keypunch would, as for an interpreted
+ * card.  Column c's holes are at (17 + 6c, 20 + 17r) times the zoom,
+ * rows r from 12 at the top, and its letter at (18 + 6c, 8).  Once made,
+ * an atlas is only read, so any number of threads may draw from one.
+ *
+ * A card_view is a card being edited, drawn into one bitmap it keeps:
+ * card_view_update takes the card's columns as they are now, compares
+ * them with those it last drew, and redraws just the columns that
+ * differ, the blank card's strip under each copied back and its holes
+ * and letter drawn again; changed says which they were, and x, y,
+ * width and height the rectangle of the bitmap they span, for a view
+ * to refresh.  A keystroke changes a column or two, so costs the same
+ * at column 1 as at column 80, and on a card of any length.
+ * card_view_set_print changes the printing, or with NULL stops it, and
+ * redraws the card.  card_render_column draws one column into a
+ * drawing that has the rest of the card.
+ *
+ * card_render_shrink halves a drawing times times, each pixel of the
+ * result the average of a 2 by 2 block, in place, for thumbnails; odd
+ * last rows and columns are dropped.
+ *
+ * card_atlas_load returns CARD_OK, CARD_EIO if an asset cannot be
+ * opened, CARD_EIMAGE if one is not RGB or the card does not hold all
+ * 80 columns, or CARD_ENOMEM; card_view_init returns CARD_OK or
+ * CARD_ENOMEM, and card_view_update the number of columns it redrew.
+ *
+ */
+
+#ifndef CARDRENDER_H
+#define CARDRENDER_H
+
+#include <stdint.h>
+#include "cardcodec.h"
+
+struct card_atlas {
+	int width, height, zoom;
+	unsigned char *card;		/* the blank card, RGBA */
+	int hole_width, hole_height;
+	unsigned char *hole, *hole_mask;
+	int letter_width, letter_height;
+	unsigned char *letters, *letter_masks;	/* 64, ' ' to '_' */
+};
+
+int card_atlas_load( struct card_atlas *atlas, const char *assets, int zoom );
+void card_atlas_free( struct card_atlas *atlas );
+
+void card_render( const struct card_atlas *atlas, const uint16_t *cols,
+		  const struct card_codec *print, unsigned char *rgba );
+void card_render_column( const struct card_atlas *atlas, int c, uint16_t col,
+			 const struct card_codec *print, unsigned char *rgba );
+void card_render_shrink( unsigned char *rgba, int width, int height,
+			 int times );
+
+struct card_view {
+	const struct card_atlas *atlas;
+	const struct card_codec *print;	/* NULL for no printing */
+	unsigned char *rgba;		/* the atlas's width by height */
+	uint16_t cols[80];		/* as drawn in rgba */
+	uint8_t changed[80];		/* by the last update */
+	int x, y, width, height;	/* and where, in pixels */
+};
+
+int card_view_init( struct card_view *view, const struct card_atlas *atlas,
+		    const struct card_codec *print );
+void card_view_free( struct card_view *view );
+int card_view_update( struct card_view *view, const uint16_t *cols );
+void card_view_set_print( struct card_view *view,
+			  const struct card_codec *print );
+
+#endif /* CARDRENDER_H */
@@ -0,0 +1,770 @@
+/* cardscan.c -- read the holes of a punched card from a picture of it.
+ *
+ * see cardscan.h
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "cardconv.h"
+#include "cardscan.h"
+#include "cardfont.i"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/* a real card, in inches */
+const struct card_geometry card_geometry_ibm = {
+	7.375, 3.25, 0.251, 0.087, 0.25, 0.25, 0.055, 0.125, 0.25, 0.1,
+	0, 0.1, 0.012, 0.014
+};
+
+/* PunchedCard.png, in its pixels inside the outline; the editor puts
+   Punch.png for row r of column c at 17 + 6c, 20 + 17r, and cardshoot
+   prints column c's letter from 18 + 6c, 8 */
+const struct card_geometry card_geometry_ipunch = {
+	498, 226, 12, 6, 19, 17, 4, 8, 8, 13,
+	0.5, 4.5, 1, 1
+};
+
+#define COARSE		512	/* samples across the image, finding it */
+#define EDGE_POINTS	32	/* along each side */
+#define TILES_X		16	/* threshold tiles across the card */
+#define TILES_Y		4
+#define INNER		0.6	/* of a hole's size, read */
+#define HOLE		0.875	/* dark part of the lightest column of a hole */
+#define INK		0.25	/* of a column's white, the least ink seen */
+#define MISSES		5	/* dots a letter read may miss, at most */
+#define MARGIN		2	/* fewer than the next best letter, at least */
+#define MIN_DOT		1.25	/* pixels between dots, to read printing */
+
+struct point {
+	double x, y;
+};
+
+/* x = (a u + b v + c) / (g u + h v + 1), and y likewise with d e f,
+   for u and v from 0 to 1 across the card */
+struct map {
+	double a, b, c, d, e, f, g, h;
+};
+
+static void map_quad( struct map *m, const double q[4][2] )
+{
+	double sx = q[0][0] - q[1][0] + q[2][0] - q[3][0];
+	double sy = q[0][1] - q[1][1] + q[2][1] - q[3][1];
+	double dx1 = q[1][0] - q[2][0], dx2 = q[3][0] - q[2][0];
+	double dy1 = q[1][1] - q[2][1], dy2 = q[3][1] - q[2][1];
+	double den = dx1 * dy2 - dx2 * dy1;
+
+	if ((fabs( sx ) < 1e-9 && fabs( sy ) < 1e-9) || (fabs( den ) < 1e-12)) {
+		m->g = m->h = 0;
+	} else {
+		m->g = (sx * dy2 - dx2 * sy) / den;
+		m->h = (dx1 * sy - sx * dy1) / den;
+	}
+	m->a = q[1][0] - q[0][0] + m->g * q[1][0];
+	m->b = q[3][0] - q[0][0] + m->h * q[3][0];
+	m->c = q[0][0];
+	m->d = q[1][1] - q[0][1] + m->g * q[1][1];
+	m->e = q[3][1] - q[0][1] + m->h * q[3][1];
+	m->f = q[0][1];
+}
+
+static struct point map_point( const struct map *m, double u, double v )
+{
+	struct point p;
+	double w = m->g * u + m->h * v + 1;
+
+	p.x = (m->a * u + m->b * v + m->c) / w;
+	p.y = (m->d * u + m->e * v + m->f) / w;
+	return p;
+}
+
+/* the image at a point, interpolated, in 1/256ths */
+static int pixel( const struct card_image *img, double x, double y )
+{
+	int ix, iy, fx, fy;
+	const unsigned char *p;
+
+	if (x < 0) x = 0;
+	if (y < 0) y = 0;
+	if (x > img->width - 1.001) x = img->width - 1.001;
+	if (y > img->height - 1.001) y = img->height - 1.001;
+	ix = (int)x;
+	iy = (int)y;
+	fx = (int)((x - ix) * 256);
+	fy = (int)((y - iy) * 256);
+	p = img->pixels + (size_t)iy * img->width + ix;
+	return ((p[0] * (256 - fx) + p[1] * fx) * (256 - fy)
+		+ (p[img->width] * (256 - fx) + p[img->width + 1] * fx) * fy) >> 8;
+}
+
+/* Otsu's threshold, and the mean of the dark side */
+static int otsu( const long hist[256], int *dark )
+{
+	double total = 0, sum = 0, sum_b = 0, w_b = 0, best = -1;
+	int t, best_t = 128;
+
+	for (t = 0; t < 256; t++) {
+		total += hist[t];
+		sum += (double)t * hist[t];
+	}
+	for (t = 0; t < 256; t++) {
+		double w_f, between;
+		w_b += hist[t];
+		if (w_b == 0) continue;
+		w_f = total - w_b;
+		if (w_f == 0) break;
+		sum_b += (double)t * hist[t];
+		between = w_b * w_f * (sum_b / w_b - (sum - sum_b) / w_f)
+			  * (sum_b / w_b - (sum - sum_b) / w_f);
+		if (between > best) {
+			best = between;
+			best_t = t;
+		}
+	}
+	for (t = 0, w_b = sum_b = 0; t <= best_t; t++) {
+		w_b += hist[t];
+		sum_b += (double)t * hist[t];
+	}
+	*dark = (w_b > 0) ? (int)(sum_b / w_b) : 0;
+	return best_t + 1;	/* light is at least this */
+}
+
+/* rough corners, from the light pixels that have light neighbors */
+static int rough_corners( const struct card_image *img, int t, int step,
+			  double q[4][2] )
+{
+	const unsigned char *p = img->pixels;
+	int w = img->width, x, y, k;
+	double n = 0, mx = 0, my = 0, sxx = 0, syy = 0, sxy = 0;
+	double theta, c, s, best[4];
+
+#define LIGHT( x, y ) (p[(size_t)(y) * w + (x)] >= t)
+	for (y = step; y < img->height - step; y += step) {
+		for (x = step; x < w - step; x += step) {
+			if (LIGHT( x, y ) && LIGHT( x - step, y ) && LIGHT( x + step, y )
+			 && LIGHT( x, y - step ) && LIGHT( x, y + step )) {
+				n++;
+				mx += x;
+				my += y;
+				sxx += (double)x * x;
+				syy += (double)y * y;
+				sxy += (double)x * y;
+			}
+		}
+	}
+	if (n < 64) return CARD_ENOCARD;
+	mx /= n;
+	my /= n;
+	sxx = sxx / n - mx * mx;
+	syy = syy / n - my * my;
+	sxy = sxy / n - mx * my;
+	theta = 0.5 * atan2( 2 * sxy, sxx - syy );	/* the long axis */
+	c = cos( theta );
+	s = sin( theta );
+
+	/* along the axis, the corners are the extremes of u+v and u-v */
+	for (k = 0; k < 4; k++) best[k] = -1e30;
+	for (y = step; y < img->height - step; y += step) {
+		for (x = step; x < w - step; x += step) {
+			double u, v, score[4];
+			if (!(LIGHT( x, y ) && LIGHT( x - step, y ) && LIGHT( x + step, y )
+			 && LIGHT( x, y - step ) && LIGHT( x, y + step ))) continue;
+			u = (x - mx) * c + (y - my) * s;
+			v = -(x - mx) * s + (y - my) * c;
+			score[0] = -u - v;
+			score[1] = u - v;
+			score[2] = u + v;
+			score[3] = -u + v;
+			for (k = 0; k < 4; k++) {
+				if (score[k] > best[k]) {
+					best[k] = score[k];
+					q[k][0] = x;
+					q[k][1] = y;
+				}
+			}
+		}
+	}
+#undef LIGHT
+	return CARD_OK;
+}
+
+/* fit a line to points, dropping those far from it and fitting again;
+   the line is a point on it and a unit direction */
+static int fit_line( struct point *pts, int n, struct point *at,
+		     struct point *dir )
+{
+	int pass, i, kept;
+
+	for (pass = 0; pass < 2; pass++) {
+		double mx = 0, my = 0, sxx = 0, syy = 0, sxy = 0, theta, worst;
+		if (n < 6) return -1;
+		for (i = 0; i < n; i++) {
+			mx += pts[i].x;
+			my += pts[i].y;
+		}
+		mx /= n;
+		my /= n;
+		for (i = 0; i < n; i++) {
+			double dx = pts[i].x - mx, dy = pts[i].y - my;
+			sxx += dx * dx;
+			syy += dy * dy;
+			sxy += dx * dy;
+		}
+		theta = 0.5 * atan2( 2 * sxy, sxx - syy );
+		at->x = mx;
+		at->y = my;
+		dir->x = cos( theta );
+		dir->y = sin( theta );
+		if (pass == 1) break;
+
+		/* a point off by more than twice the typical is not on the edge */
+		for (i = 0, worst = 0; i < n; i++)
+			worst += fabs( (pts[i].x - mx) * dir->y - (pts[i].y - my) * dir->x );
+		worst = 2 * worst / n + 0.5;
+		for (i = kept = 0; i < n; i++)
+			if (fabs( (pts[i].x - mx) * dir->y - (pts[i].y - my) * dir->x ) <= worst)
+				pts[kept++] = pts[i];
+		n = kept;
+	}
+	return 0;
+}
+
+/* the crossings from the ground onto the card along the middle of the
+   side from a to b, found looking in from reach pixels outside */
+static int edge_points( const struct card_image *img, int t,
+			const double a[2], const double b[2], struct point center,
+			double reach, struct point *pts )
+{
+	double dx = b[0] - a[0], dy = b[1] - a[1];
+	double len = sqrt( dx * dx + dy * dy ), nx, ny;
+	int i, n = 0;
+
+	if (len < 1) return 0;
+	nx = -dy / len;
+	ny = dx / len;
+	if (nx * ((a[0] + b[0]) / 2 - center.x) + ny * ((a[1] + b[1]) / 2 - center.y) < 0) {
+		nx = -nx;
+		ny = -ny;
+	}
+	for (i = 0; i < EDGE_POINTS; i++) {
+		double f = 0.15 + 0.7 * i / (EDGE_POINTS - 1);
+		double px = a[0] + f * dx, py = a[1] + f * dy, d;
+		int last = pixel( img, px + reach * nx, py + reach * ny );
+
+		if (last >= t * 256) continue;	/* not outside the card */
+		for (d = reach - 0.5; d > -reach; d -= 0.5) {
+			int here = pixel( img, px + d * nx, py + d * ny );
+			if (here >= t * 256) {
+				double frac = (double)(t * 256 - last) / (here - last);
+				d += 0.5 * (1 - frac);
+				pts[n].x = px + d * nx;
+				pts[n].y = py + d * ny;
+				n++;
+				break;
+			}
+			last = here;
+		}
+	}
+	return n;
+}
+
+static int intersect( struct point a, struct point da, struct point b,
+		      struct point db, double out[2] )
+{
+	double den = da.x * db.y - da.y * db.x, s;
+
+	if (fabs( den ) < 1e-9) return -1;
+	s = ((b.x - a.x) * db.y - (b.y - a.y) * db.x) / den;
+	out[0] = a.x + s * da.x;
+	out[1] = a.y + s * da.y;
+	return 0;
+}
+
+/* how far from corner a, along the side to b, the side comes back to
+   within depth of the line a b, past a cut or a rounding, in pixels */
+static double departure( const struct card_image *img, int t,
+			 const double a[2], const double b[2],
+			 struct point center, double depth, double reach )
+{
+	double dx = b[0] - a[0], dy = b[1] - a[1];
+	double len = sqrt( dx * dx + dy * dy ), nx, ny, s;
+
+	if (len < 1) return 0;
+	dx /= len;
+	dy /= len;
+	nx = -dy;
+	ny = dx;
+	if (nx * (center.x - a[0]) + ny * (center.y - a[1]) < 0) {
+		nx = -nx;
+		ny = -ny;
+	}
+	for (s = 0; s < reach; s += 0.5) {
+		double px = a[0] + s * dx, py = a[1] + s * dy;
+		if (pixel( img, px + depth * nx, py + depth * ny ) >= t * 256) return s;
+	}
+	return reach;
+}
+
+/* which corners are cut: those that leave the top or bottom as far
+   from the corner as a cut does, rather than a rounding; the scale at
+   each corner comes from the map, for the near end of a card seen at
+   a slant is bigger than the far */
+static int cut_corners( const struct card_image *img, int t,
+			const double q[4][2], const struct map *m,
+			const struct card_geometry *g )
+{
+	static const int along[4] = { 1, 0, 3, 2 };
+	double far = 2 * ((g->cut > g->round) ? g->cut : g->round);
+	struct point center;
+	int k, cut = 0;
+
+	center.x = (q[0][0] + q[1][0] + q[2][0] + q[3][0]) / 4;
+	center.y = (q[0][1] + q[1][1] + q[2][1] + q[3][1]) / 4;
+	for (k = 0; k < 4; k++) {
+		double u = (k == 0 || k == 3) ? far / g->width : 1 - far / g->width;
+		struct point p = map_point( m, u, (k < 2) ? 0 : 1 );
+		double unit = hypot( p.x - q[k][0], p.y - q[k][1] ) / far;
+		double depth = (g->round / 8 * unit > 1.5) ? g->round / 8 * unit : 1.5;
+		double d = departure( img, t, q[k], q[along[k]], center, depth,
+				      far * unit ) / unit;
+		if (fabs( d - g->cut ) < fabs( d - g->round )) cut |= 1 << k;
+	}
+	return cut;
+}
+
+/* map the card upright, CARD_SCAN_SCALE pixels a column */
+static void upright( const struct card_image *img, const struct map *m,
+		     unsigned char *out, int w, int h )
+{
+	int x, y;
+
+	for (y = 0; y < h; y++) {
+		double v = (y + 0.5) / h;
+		for (x = 0; x < w; x++) {
+			struct point p = map_point( m, (x + 0.5) / w, v );
+			*out++ = pixel( img, p.x, p.y ) >> 8;
+		}
+	}
+}
+
+/* mask[i] = 1 where in[i] < t */
+static void threshold( const unsigned char *in, unsigned char *mask, int n,
+		       int t )
+{
+	int i = 0;
+#if defined(__AVX2__)
+	__m256i below = _mm256_set1_epi8( (char)(t - 1) );
+	__m256i one = _mm256_set1_epi8( 1 );
+	for (; i + 32 <= n; i += 32) {
+		__m256i p = _mm256_loadu_si256( (const __m256i *)(in + i) );
+		__m256i dark = _mm256_cmpeq_epi8( _mm256_min_epu8( p, below ), p );
+		_mm256_storeu_si256( (__m256i *)(mask + i), _mm256_and_si256( dark, one ) );
+	}
+#elif defined(__SSE2__)
+	__m128i below = _mm_set1_epi8( (char)(t - 1) );
+	__m128i one = _mm_set1_epi8( 1 );
+	for (; i + 16 <= n; i += 16) {
+		__m128i p = _mm_loadu_si128( (const __m128i *)(in + i) );
+		__m128i dark = _mm_cmpeq_epi8( _mm_min_epu8( p, below ), p );
+		_mm_storeu_si128( (__m128i *)(mask + i), _mm_and_si128( dark, one ) );
+	}
+#elif defined(__ARM_NEON)
+	uint8x16_t limit = vdupq_n_u8( (uint8_t)t );
+	uint8x16_t one = vdupq_n_u8( 1 );
+	for (; i + 16 <= n; i += 16)
+		vst1q_u8( mask + i, vandq_u8( vcltq_u8( vld1q_u8( in + i ), limit ), one ) );
+#endif
+	if (t <= 0) {
+		memset( mask + i, 0, n - i );
+		return;
+	}
+	for (; i < n; i++) mask[i] = in[i] < t;
+}
+
+/* sums[x] += row[x]; sums stay under 256 for bands under 256 rows */
+static void add_row( uint8_t *sums, const unsigned char *row, int n )
+{
+	int i = 0;
+#if defined(__AVX2__)
+	for (; i + 32 <= n; i += 32)
+		_mm256_storeu_si256( (__m256i *)(sums + i), _mm256_add_epi8(
+			_mm256_loadu_si256( (const __m256i *)(sums + i) ),
+			_mm256_loadu_si256( (const __m256i *)(row + i) ) ) );
+#elif defined(__SSE2__)
+	for (; i + 16 <= n; i += 16)
+		_mm_storeu_si128( (__m128i *)(sums + i), _mm_add_epi8(
+			_mm_loadu_si128( (const __m128i *)(sums + i) ),
+			_mm_loadu_si128( (const __m128i *)(row + i) ) ) );
+#elif defined(__ARM_NEON)
+	for (; i + 16 <= n; i += 16)
+		vst1q_u8( sums + i, vaddq_u8( vld1q_u8( sums + i ), vld1q_u8( row + i ) ) );
+#endif
+	for (; i < n; i++) sums[i] += row[i];
+}
+
+/* threshold each tile halfway between its white and the ground */
+static void threshold_tiles( const unsigned char *img, unsigned char *mask,
+			     int w, int h, int dark )
+{
+	int tx, ty, x, y;
+
+	for (ty = 0; ty < TILES_Y; ty++) {
+		int y0 = h * ty / TILES_Y, y1 = h * (ty + 1) / TILES_Y;
+		for (tx = 0; tx < TILES_X; tx++) {
+			int x0 = w * tx / TILES_X, x1 = w * (tx + 1) / TILES_X;
+			long hist[256], count = 0, want;
+			int white = 255;
+
+			memset( hist, 0, sizeof hist );
+			for (y = y0; y < y1; y++)
+				for (x = x0; x < x1; x++) hist[img[y * w + x]]++;
+			want = (long)(x1 - x0) * (y1 - y0) / 10;
+			while ((white > 0) && ((count += hist[white]) < want)) white--;
+			for (y = y0; y < y1; y++)
+				threshold( img + y * w + x0, mask + y * w + x0, x1 - x0,
+					   (white + dark + 1) / 2 );
+		}
+	}
+}
+
+static int reserve( struct card_scan_work *work, size_t size, size_t sums )
+{
+	if (size > work->size) {
+		free( work->upright );
+		free( work->mask );
+		work->upright = malloc( size );
+		work->mask = malloc( size );
+		work->size = size;
+		if ((work->upright == NULL) || (work->mask == NULL)) {
+			card_scan_work_free( work );
+			return CARD_ENOMEM;
+		}
+	}
+	if (sums > work->sums_size) {
+		free( work->sums );
+		work->sums = malloc( sums );
+		work->sums_size = sums;
+		if (work->sums == NULL) {
+			card_scan_work_free( work );
+			return CARD_ENOMEM;
+		}
+	}
+	return CARD_OK;
+}
+
+void card_scan_work_free( struct card_scan_work *work )
+{
+	free( work->upright );
+	free( work->mask );
+	free( work->sums );
+	memset( work, 0, sizeof *work );
+}
+
+int card_scan_image( const struct card_image *gray,
+		     const struct card_geometry *g, struct card_scan *scan,
+		     struct card_scan_work *work )
+{
+	long hist[256];
+	struct point pts[EDGE_POINTS], at[4], dir[4], center;
+	struct map m;
+	double q[4][2], reach, scale, worst = 1;
+	int t, dark, step, k, w, h, r, c, err, cut;
+	size_t i, n;
+
+	memset( scan, 0, sizeof *scan );
+	if ((gray->channels != 1) || (gray->width < 16) || (gray->height < 16))
+		return CARD_EIMAGE;
+
+	/* light and dark, from a sample of the image */
+	memset( hist, 0, sizeof hist );
+	n = (size_t)gray->width * gray->height;
+	step = (int)(n / 262144) + 1;
+	for (i = 0; i < n; i += step) hist[gray->pixels[i]]++;
+	t = otsu( hist, &dark );
+
+	/* the corners, roughly and then exactly */
+	step = ((gray->width > gray->height) ? gray->width : gray->height) / COARSE + 1;
+	err = rough_corners( gray, t, step, q );
+	if (err != CARD_OK) return err;
+	center.x = (q[0][0] + q[1][0] + q[2][0] + q[3][0]) / 4;
+	center.y = (q[0][1] + q[1][1] + q[2][1] + q[3][1]) / 4;
+	reach = 0.04 * hypot( q[1][0] - q[0][0], q[1][1] - q[0][1] ) + 2 * step + 3;
+	for (k = 0; k < 4; k++) {
+		int got = edge_points( gray, t, q[k], q[(k + 1) % 4], center, reach, pts );
+		if (fit_line( pts, got, &at[k], &dir[k] ) != 0) return CARD_ENOCARD;
+	}
+	for (k = 0; k < 4; k++) {
+		if (intersect( at[(k + 3) % 4], dir[(k + 3) % 4], at[k], dir[k], q[k] ) != 0)
+			return CARD_ENOCARD;
+		if ((q[k][0] < -1) || (q[k][0] > gray->width)
+		 || (q[k][1] < -1) || (q[k][1] > gray->height))
+			return CARD_ENOCARD;	/* not all in the picture */
+	}
+
+	/* the cut goes at the top; turn the card over if it is not there */
+	map_quad( &m, q );
+	cut = cut_corners( gray, t, q, &m, g );
+	if ((cut & 014) && !(cut & 03)) {
+		double turn[4][2];
+		memcpy( turn, q, sizeof turn );
+		for (k = 0; k < 4; k++) {
+			q[k][0] = turn[(k + 2) % 4][0];
+			q[k][1] = turn[(k + 2) % 4][1];
+		}
+		map_quad( &m, q );
+		scan->turned = 1;
+		cut >>= 2;
+	}
+	scan->cut = ((cut & 1) ? 2 : 0) | ((cut & 2) ? 1 : 0);
+	memcpy( scan->corner, q, sizeof scan->corner );
+
+	/* upright, thresholded */
+	scale = CARD_SCAN_SCALE / g->col_pitch;
+	w = (int)(g->width * scale + 0.5);
+	h = (int)(g->height * scale + 0.5);
+	err = reserve( work, (size_t)w * h, w );
+	if (err != CARD_OK) return err;
+	upright( gray, &m, work->upright, w, h );
+	threshold_tiles( work->upright, work->mask, w, h, dark );
+
+	/* the middle of each hole position, dark or light */
+	scan->confidence = 1;
+	for (r = 0; r < 12; r++) {
+		double cy = (g->row12 + r * g->row_pitch) * scale;
+		int y0 = (int)(cy - INNER / 2 * g->hole_height * scale + 0.5);
+		int y1 = (int)(cy + INNER / 2 * g->hole_height * scale + 0.5);
+		if (y0 < 0) y0 = 0;
+		if (y1 > h) y1 = h;
+		if (y1 <= y0) y1 = y0 + 1;
+		memset( work->sums, 0, w );
+		for (k = y0; k < y1; k++) add_row( work->sums, work->mask + k * w, w );
+
+		for (c = 0; c < 80; c++) {
+			double cx = (g->col1 + c * g->col_pitch) * scale, dark_part, sure;
+			int x0 = (int)(cx - INNER / 2 * g->hole_width * scale + 0.5);
+			int x1 = (int)(cx + INNER / 2 * g->hole_width * scale + 0.5);
+			int least = 255, x;
+			if (x0 < 0) x0 = 0;
+			if (x1 > w) x1 = w;
+			if (x1 <= x0) x1 = x0 + 1;
+			for (x = x0; x < x1; x++)
+				if (work->sums[x] < least) least = work->sums[x];
+			dark_part = (double)least / (y1 - y0);
+			if (dark_part >= HOLE) scan->cols[c] |= 1 << (11 - r);
+			sure = fabs( dark_part - HOLE ) / (1 - HOLE);
+			if (sure < worst) worst = sure;
+			if (sure < 0.5) scan->doubtful++;
+		}
+	}
+	scan->confidence = worst;
+	return CARD_OK;
+}
+
+static int popcount( uint64_t v )
+{
+#if defined(__GNUC__)
+	return __builtin_popcountll( v );
+#else
+	int n;
+	for (n = 0; v != 0; n++) v &= v - 1;
+	return n;
+#endif
+}
+
+/* the letter printed over column c, ' ' for none or ~ if not sure,
+   from samples of the picture half a dot apart, 13 across and 17 down
+   around where the letter would be; holes are what is punched there,
+   and cut the card's cut corners, as in card_scan */
+static int read_letter( const struct card_image *gray,
+			const struct card_geometry *g, const struct map *m,
+			const struct card_codec *codec, const uint64_t *letters,
+			int c, uint16_t holes, int cut )
+{
+	double left = (cut & 2) ? g->cut : g->round;
+	double right = (cut & 1) ? g->cut : g->round;
+	int sample[17][13], count[256], misses[64], x, y, k;
+	int least = 1 << 16, white, want, t, i, j, l;
+	int best = 64, found = 1, own, fits, fit = 0, near = 0;
+	double cx = g->col1 + c * g->col_pitch + g->print_x;
+
+	memset( count, 0, sizeof count );
+	for (y = 0; y < 17; y++) {
+		double py = g->print_y + (y - 8) * g->dot_y / 2;
+		for (x = 0; x < 13; x++) {
+			double px = cx + (x - 6) * g->dot_x / 2;
+			struct point p = map_point( m, px / g->width, py / g->height );
+			int level = pixel( gray, p.x, p.y );
+			/* past the cut or the rounding of a top corner, or
+			   within the dots its edge blurs over, is the
+			   ground, not ink; it is taken as paper */
+			if ((px + py < left + 3 * g->dot_x)
+			 || (g->width - px + py < right + 3 * g->dot_x)) {
+				sample[y][x] = -1;
+				continue;
+			}
+			sample[y][x] = level;
+			count[level >> 8]++;
+			if ((y > 0) && (y < 16) && (x > 0) && (x < 12)
+			 && (level < least))
+				least = level;	/* not the edge of the card */
+		}
+	}
+
+	/* the white is what a quarter of the samples are at least */
+	for (white = 255, want = 17 * 13 / 4, k = 0; white > 0; white--)
+		if ((k += count[white]) >= want) break;
+	white <<= 8;
+	if (white - least < INK * white) return ' ';	/* no ink */
+	t = (white + least) / 2;
+	for (y = 0; y < 17; y++)
+		for (x = 0; x < 13; x++)
+			if (sample[y][x] < 0) sample[y][x] = white;
+
+	/* a letter has paper either side; ink there is the edge of the card
+	   or something else that is not a letter */
+	for (y = 2, k = 0; y < 15; y++)
+		k += (sample[y][0] < t) + (sample[y][12] < t);
+	if (k > 1) return '~';
+
+	/* the dots at each offset, against each letter but the space, for
+	   there is ink; the letters it might be are those of the best
+	   offset, for half a dot off can turn an L to an _ */
+	for (k = 0; k < 9; k++) {
+		int sy = (k + 4) % 9 / 3 - 1, sx = (k + 4) % 9 % 3 - 1;
+		int here[64], least_here = 64;
+		uint64_t dots = 0;
+		for (i = 0; i < 7; i++)
+			for (j = 0; j < 5; j++)
+				dots = (dots << 1)
+				     | (sample[2 * i + 2 + sy][2 * j + 2 + sx] < t);
+		for (l = 1; l < 64; l++) {
+			here[l] = popcount( dots ^ letters[l] );
+			if (here[l] < least_here) least_here = here[l];
+		}
+		if (least_here < best) {
+			best = least_here;
+			memcpy( misses, here, sizeof here );
+		}
+	}
+	if (best > MISSES) return '~';
+
+	/* the letter punched, if it is near enough; else one letter
+	   clearly best, or among letters nearly as good, the one whose
+	   holes include all those sensed, for a hanging chad hides a hole
+	   but makes none */
+	own = card_decode( codec, holes ) - ' ';
+	for (l = 1, fits = 0; l < 64; l++) {
+		uint16_t code;
+		if ((misses[l] > MISSES) || (misses[l] >= best + MARGIN)) continue;
+		near++;
+		found = l;
+		code = card_encode( codec, ' ' + l );
+		if ((code != CARD_ILLEGAL) && ((code & holes) == holes)) {
+			fits++;
+			fit = l;
+		}
+	}
+	if ((own > 0) && (own < 64) && (misses[own] <= MISSES))
+		return ' ' + own;
+	if (near == 1) return ' ' + found;
+	if (fits == 1) return ' ' + fit;
+	return '~';
+}
+
+/* read the printing along the top of a scanned card and check it
+   against the holes, correcting them if asked; returns the columns
+   that differ */
+int card_scan_print( const struct card_image *gray,
+		     const struct card_geometry *g,
+		     const struct card_codec *codec, int correct,
+		     struct card_scan *scan )
+{
+	uint64_t letters[64];
+	struct map m;
+	int c, i;
+
+	for (c = 0; c < 64; c++)
+		for (i = 0, letters[c] = 0; i < 7; i++)
+			letters[c] = (letters[c] << 5) | card_font[c][i];
+	map_quad( &m, (const double (*)[2])scan->corner );
+	scan->interpreted = scan->differ = scan->corrected = 0;
+	memset( scan->printed, ' ', sizeof scan->printed );
+	memset( scan->check, CARD_PRINT_UNREAD, sizeof scan->check );
+
+	/* dots closer than a pixel or so blur together past reading */
+	for (c = 0; c < 80; c += 79) {
+		double x = (g->col1 + c * g->col_pitch) / g->width;
+		struct point p = map_point( &m, x, g->print_y / g->height );
+		struct point px = map_point( &m, x + g->dot_x / g->width,
+					     g->print_y / g->height );
+		struct point py = map_point( &m, x, (g->print_y + g->dot_y) / g->height );
+		if ((hypot( px.x - p.x, px.y - p.y ) < MIN_DOT)
+		 || (hypot( py.x - p.x, py.y - p.y ) < MIN_DOT))
+			return 0;
+	}
+
+	for (c = 0; c < 80; c++) {
+		scan->printed[c] = read_letter( gray, g, &m, codec, letters, c,
+						scan->cols[c], scan->cut );
+		if ((scan->printed[c] != ' ') && (scan->printed[c] != '~'))
+			scan->interpreted = 1;
+	}
+
+	for (c = 0; c < 80; c++) {
+		int read = scan->printed[c];
+		int punched = card_decode( codec, scan->cols[c] );
+		uint16_t code;
+
+		if (!scan->interpreted) continue;
+		if (read == '~') {
+			scan->check[c] = CARD_PRINT_DOUBT;
+			scan->doubtful++;
+			continue;
+		}
+		if ((punched < ' ') || (punched > '_')) continue;
+		if (read == punched) {
+			scan->check[c] = CARD_PRINT_AGREE;
+			continue;
+		}
+		scan->check[c] = CARD_PRINT_DIFFER;
+		code = card_encode( codec, read );
+		if (correct && (read != ' ') && (code != CARD_ILLEGAL)) {
+			scan->cols[c] = code;
+			scan->check[c] = CARD_PRINT_FIXED;
+			scan->corrected++;
+		} else {
+			scan->differ++;
+		}
+	}
+	return scan->differ;
+}
+
+/* the card image of a scan, header and all, with the cut that was seen
+   and the rest of the header from opt; returns its length */
+size_t card_scan_card( const struct card_scan *scan,
+		       const struct card_options *opt, unsigned char *card )
+{
+	uint16_t cols[82];
+	int n = (opt->format == 80) ? 80 : 82;
+	int first = (n == 82) ? 1 : 0;
+	int i;
+
+	memset( cols, 0, sizeof cols );
+	memcpy( cols + first, scan->cols, sizeof scan->cols );
+	*card++ = 0x80 | (opt->color << 3) | (opt->corner << 2) | scan->cut;
+	*card++ = 0x80 | ((opt->interp | scan->interpreted) << 6)
+		       | (opt->punch << 3) | opt->form;
+	*card++ = 0x80 | opt->logo;
+	for (i = 0; i < n; i += 2) {
+		*card++ = cols[i] >> 4;
+		*card++ = ((cols[i] & 017) << 4) | (cols[i + 1] >> 8);
+		*card++ = cols[i + 1] & 0377;
+	}
+	return 3 + 3 * n / 2;
+}
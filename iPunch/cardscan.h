@@ -0,0 +1,130 @@
+/* cardscan.h -- read the holes of a punched card from a picture of it.
+ *
+ * The card is found in a gray image as the big light shape on a darker
+ * ground: the light pixels' principal axis gives its long side, their
+ * extreme points along it give rough corners, and lines fitted to the
+ * dark-to-light crossings along the middle of each side give the four
+ * edges and so the corners exactly, whatever the cut and rounding of
+ * the corners.  The card is then mapped from its corners, perspective
+ * and all, onto an upright picture CARD_SCAN_SCALE pixels a column
+ * wide; that is thresholded tile by tile against the card's own white,
+ * so uneven light does not matter, and each hole position is read as
+ * the fraction of dark pixels in the middle of where the hole would
+ * be.  A hole is dark all across, so it is the lightest column of that
+ * middle that counts, and seven eighths dark is a hole; the digits
+ * printed in the hole positions are strokes that leave some column of
+ * it mostly light.  Holes show the ground through them, so it must be
+ * darker than the card.
+ *
+ * A card the right way up has its corner cut at the top; one with the
+ * cut at the bottom was upside down and is turned over.  Cards with no
+ * cut, or two, are taken as they come.  A corner is cut if the top or
+ * bottom edge comes back to its line as far from the corner as the
+ * geometry's cut does, rather than its rounding.
+ *
+ * The layout of the card comes from a card_geometry, in any unit:
+ * card_geometry_ibm is a real card in inches, and card_geometry_ipunch
+ * is the app's PunchedCard.png with Punch.png holes, in its pixels.
+ *
+ * The confidence of a reading is how far its least certain position
+ * was from the threshold, in eighths and at most 1: 1 if no position
+ * was within an eighth of it, 0 if one was right at it.  doubtful
+ * counts the positions within a sixteenth.
+ *
+ * An interpreted card has what is punched in it printed along its top
+ * edge as well, 5 by 7 dot letters from cardfont.i over each column.
+ * card_scan_print reads them from the picture, each column's dots
+ * sampled at half a dot's spacing against that column's own white and
+ * ink, and matched against every letter at nine offsets of half a dot.
+ * Some letters, 0 and O, or R and P, differ by a few dots only, so the
+ * holes are taken as a guide: the letter punched is read if it misses
+ * few dots, and otherwise a letter is read if the next best misses
+ * clearly more, or among letters nearly as good, if it is the one
+ * whose holes include all of those sensed, since a chad left hanging
+ * in a hole reads as no hole at all but never as a hole.  Each column
+ * is then checked against its holes as the codec's keypunch prints
+ * them, and where a letter was read and the holes say otherwise, the
+ * column is flagged, or with correct, the holes are taken to be what
+ * the letter says.  A column with ink over it and no letter read is
+ * doubtful, and counted in doubtful with the positions.  A card with
+ * no printing anywhere was not interpreted, and every column is left
+ * unchecked.
+ *
+ * Thresholding and summing the hole positions go 16 or 32 pixels at a
+ * time with SSE2, AVX2 or NEON.  Scratch space is kept in a struct
+ * card_scan_work, one per thread, so a thread reading one picture after
+ * another allocates nothing once it has seen the biggest.
+ *
+ */
+
+#ifndef CARDSCAN_H
+#define CARDSCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cardcodec.h"
+#include "cardimage.h"
+
+#define CARD_SCAN_SCALE	8	/* pixels a column, upright */
+
+struct card_geometry {
+	double width, height;		/* the card */
+	double col1, col_pitch;		/* column 1's center from the left */
+	double row12, row_pitch;	/* row 12's center from the top */
+	double hole_width, hole_height;
+	double cut, round;		/* how far along the top or bottom a
+					   cut corner or a rounded one goes */
+	double print_x, print_y;	/* a column's printing, its center
+					   from the column's and the top */
+	double dot_x, dot_y;		/* between the dots of a letter */
+};
+
+extern const struct card_geometry card_geometry_ibm;
+extern const struct card_geometry card_geometry_ipunch;
+
+struct card_scan {
+	uint16_t cols[80];		/* 12-bit column codes */
+	double corner[4][2];		/* in the image: top left, top
+					   right, bottom right, bottom left */
+	int cut;			/* as card_options: 0 none, 1 right,
+					   2 left, 3 both */
+	int turned;			/* it was upside down */
+	double confidence;		/* 0 to 1 */
+	int doubtful;			/* positions near the threshold,
+					   and printing not read */
+
+	/* from card_scan_print */
+	char printed[80];		/* the letters read, ' ' for none
+					   and ~ for one not sure of */
+	uint8_t check[80];		/* CARD_PRINT_AGREE and so on */
+	int interpreted;		/* any printing was seen */
+	int differ, corrected;		/* columns, as in check */
+};
+
+/* what card_scan_print found of each column */
+#define CARD_PRINT_AGREE	0	/* the printing is what is punched */
+#define CARD_PRINT_UNREAD	1	/* no letter read, or none expected */
+#define CARD_PRINT_DIFFER	2	/* the printing and the holes differ */
+#define CARD_PRINT_FIXED	3	/* and the holes were made to agree */
+#define CARD_PRINT_DOUBT	4	/* ink, but no letter read */
+
+struct card_scan_work {
+	unsigned char *upright, *mask;	/* the card, mapped upright */
+	size_t size;
+	uint8_t *sums;			/* dark pixels by column in a row band */
+	size_t sums_size;
+};
+
+int card_scan_image( const struct card_image *gray,
+		     const struct card_geometry *g, struct card_scan *scan,
+		     struct card_scan_work *work );
+void card_scan_work_free( struct card_scan_work *work );
+int card_scan_print( const struct card_image *gray,
+		     const struct card_geometry *g,
+		     const struct card_codec *codec, int correct,
+		     struct card_scan *scan );
+
+size_t card_scan_card( const struct card_scan *scan,
+		       const struct card_options *opt, unsigned char *card );
+
+#endif /* CARDSCAN_H */
@@ -0,0 +1,519 @@
+/* cardshoot.c -- make pictures of punched cards, as a camera would.
+ *
+ * operation:  run cardshoot -help for instructions
+ *
+ * build: cc -o cardshoot cardshoot.c cardrender.c cardimage.c cardconv.c
+ *        cardcodec.c -lz -lm
+ *
+ * input  -- a card-image file
+ * output -- a picture of each card, PNG unless -ppm
+ *
+ * Each card is drawn as the editor draws it, by cardrender from the
+ * Assets directory, and then set down on a dark, mottled table at an
+ * angle, seen in perspective, lit from one side and with sensor noise:
+ * the synthetic photos that cardphoto is tested with.  A card with the
+ * interpreted bit in its header has what is punched in it printed
+ * along its top, as the keypunch table reads it.  -chad n leaves the
+ * chad of n of the holes on the card hanging half over its hole, for
+ * cardphoto to find from the printing.  Everything random comes from
+ * -seed, so a run can be repeated exactly.  The corners of each card
+ * in its picture go to stderr with -v.
+ *
+ * With one card and no -out, the picture goes to stdout; otherwise
+ * -out gives a printf pattern for the file names, as card%03d.png,
+ * numbered from 1.
+ *
+ * -feed n makes the frames a camera would record of the cards fed one
+ * at a time under it, for cardfeed: the bare table for a few frames,
+ * then each card sliding in from the right, lying still for n frames
+ * and sliding out to the left, the table bare for four frames between
+ * cards.  The table, the light and the camera stay put; each card lands
+ * within a percent of where the first did, as in a jig, and every frame
+ * has its own sensor noise.  With -ppm and no -out the frames go to
+ * stdout one after another, as a video tool's image pipe gives them.
+ * -v reports the still frames of each card.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "cardconv.h"
+#include "cardimage.h"
+#include "cardrender.h"
+
+#define PI	3.14159265358979
+
+static unsigned long long seed = 1;
+
+/* a number from 0 to 1 */
+static double uniform( void )
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+	return (seed >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double between( double lo, double hi )
+{
+	return lo + (hi - lo) * uniform();
+}
+
+static double gaussian( void )
+{
+	double u = uniform() + 1e-12, v = uniform();
+	return sqrt( -2 * log( u ) ) * cos( 2 * PI * v );
+}
+
+static unsigned char *read_all( FILE *f, size_t *len )
+{
+	size_t cap = 1 << 16, got;
+	unsigned char *buf = malloc( cap );
+
+	*len = 0;
+	while ((buf != NULL) && ((got = fread( buf + *len, 1, cap - *len, f )) > 0)) {
+		*len += got;
+		if (*len == cap) buf = realloc( buf, cap *= 2 );
+	}
+	return buf;
+}
+
+/* paper over width by height pixels at x, y, or ink them */
+static void fill( struct card_image *face, int x, int y, int width, int height,
+		  int level )
+{
+	int i;
+
+	for (; height > 0; height--, y++)
+		if ((y >= 0) && (y < face->height))
+			for (i = x; (i < x + width) && (i < face->width); i++)
+				memset( face->pixels + 4 * ((size_t)y * face->width + i),
+					level, 3 );
+}
+
+/* the card face, printed if it was interpreted, with chads left hanging
+   in some holes; the pixels off the card are clear */
+static void draw_card( struct card_image *face, const struct card_atlas *atlas,
+		       const uint16_t *cols, const struct card_codec *codec,
+		       int interp, int chads )
+{
+	int c, r;
+
+	card_render( atlas, cols, interp ? codec : NULL, face->pixels );
+
+	/* a chad hangs over the left or right of its hole, half or more */
+	for (; chads > 0; chads--) {
+		int tries = 0, cover, from;
+		do {
+			c = (int)(uniform() * 80);
+			r = (int)(uniform() * 12);
+		} while (!(cols[c] & (1 << (11 - r))) && (++tries < 10000));
+		if (tries == 10000) break;
+		cover = (uniform() < 0.5) ? 2 : 3;
+		from = (uniform() < 0.5) ? 18 : 22 - cover;
+		fill( face, (from + 6 * c) * atlas->zoom, (20 + 17 * r) * atlas->zoom,
+		      cover * atlas->zoom, atlas->hole_height, 255 );
+	}
+}
+
+/* the projective map taking the unit square to a quad, as a matrix
+   with [2][2] = 1, and its inverse */
+static void square_to_quad( double m[3][3], const double q[4][2] )
+{
+	double sx = q[0][0] - q[1][0] + q[2][0] - q[3][0];
+	double sy = q[0][1] - q[1][1] + q[2][1] - q[3][1];
+	double dx1 = q[1][0] - q[2][0], dx2 = q[3][0] - q[2][0];
+	double dy1 = q[1][1] - q[2][1], dy2 = q[3][1] - q[2][1];
+	double den = dx1 * dy2 - dx2 * dy1;
+	double g = (sx * dy2 - dx2 * sy) / den, h = (dx1 * sy - sx * dy1) / den;
+
+	m[0][0] = q[1][0] - q[0][0] + g * q[1][0];
+	m[0][1] = q[3][0] - q[0][0] + h * q[3][0];
+	m[0][2] = q[0][0];
+	m[1][0] = q[1][1] - q[0][1] + g * q[1][1];
+	m[1][1] = q[3][1] - q[0][1] + h * q[3][1];
+	m[1][2] = q[0][1];
+	m[2][0] = g;
+	m[2][1] = h;
+	m[2][2] = 1;
+}
+
+static void invert( double inv[3][3], double m[3][3] )
+{
+	double det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+		   - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+		   + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+	int i, j;
+
+	for (i = 0; i < 3; i++) {
+		for (j = 0; j < 3; j++) {
+			int a = (j + 1) % 3, b = (j + 2) % 3;
+			int c = (i + 1) % 3, d = (i + 2) % 3;
+			inv[i][j] = (m[a][c] * m[b][d] - m[a][d] * m[b][c]) / det;
+		}
+	}
+}
+
+/* a smooth random field, for the grain of the table */
+static double mottle( const double *grid, int n, double x, double y )
+{
+	int ix = (int)x, iy = (int)y;
+	double fx = x - ix, fy = y - iy;
+	const double *p = grid + iy * (n + 1) + ix;
+
+	return (p[0] * (1 - fx) + p[1] * fx) * (1 - fy)
+	     + (p[n + 1] * (1 - fx) + p[n + 2] * fx) * fy;
+}
+
+struct shot {
+	int width, height;
+	double angle;		/* degrees, or random within it */
+	double tilt;		/* perspective, a fraction of the card */
+	double fill;		/* of the picture's width the card spans */
+	double light;		/* fall-off across the picture */
+	double noise;		/* sigma, in levels */
+	int turn;		/* upside down */
+};
+
+/* the table the cards are set on, and the light on it */
+struct table {
+	double base;		/* its level */
+	double lx, ly;		/* the way the light falls off */
+	double grid[17 * 17];	/* its grain */
+};
+
+static void set_table( struct table *t )
+{
+	int k;
+
+	t->base = between( 25, 60 );
+	t->lx = between( -1, 1 );
+	t->ly = between( -1, 1 );
+	for (k = 0; k < 17 * 17; k++) t->grid[k] = between( -12, 12 );
+}
+
+/* where a card goes in the picture: its corners */
+static void place( const struct card_image *face, const struct shot *s,
+		   double corners[4][2] )
+{
+	double angle = between( -s->angle, s->angle ) * PI / 180 + (s->turn ? PI : 0);
+	double cw = s->fill * s->width * between( 0.85, 1.0 );
+	double ch = cw * face->height / face->width;
+	double cx = s->width / 2.0 + between( -0.1, 0.1 ) * s->width;
+	double cy = s->height / 2.0 + between( -0.1, 0.1 ) * s->height;
+	double shrink;
+	int k;
+
+	for (k = 0; k < 4; k++) {
+		double u = ((k == 1) || (k == 2)) ? 0.5 : -0.5;
+		double v = (k >= 2) ? 0.5 : -0.5;
+		double px = u * cw + between( -s->tilt, s->tilt ) * cw;
+		double py = v * ch + between( -s->tilt, s->tilt ) * cw;
+		corners[k][0] = cx + px * cos( angle ) - py * sin( angle );
+		corners[k][1] = cy + px * sin( angle ) + py * cos( angle );
+	}
+
+	/* the card is all in the picture, if smaller than asked for */
+	for (k = 0, shrink = 1; k < 4; k++) {
+		double room[2], at[2] = { cx, cy }, size[2];
+		int i;
+		size[0] = s->width;
+		size[1] = s->height;
+		for (i = 0; i < 2; i++) {
+			double d = corners[k][i] - at[i];
+			room[i] = (d < 0) ? (at[i] - 0.02 * size[i]) / -d
+					  : (0.98 * size[i] - at[i]) / (d + 1e-9);
+			if (room[i] < shrink) shrink = room[i];
+		}
+	}
+	for (k = 0; k < 4; k++) {
+		corners[k][0] = cx + (corners[k][0] - cx) * shrink;
+		corners[k][1] = cy + (corners[k][1] - cy) * shrink;
+	}
+}
+
+/* the picture of a card at its corners on the table, or of the table
+   alone if face is NULL */
+static void shoot( struct card_image *photo, const struct card_image *face,
+		   const struct shot *s,
+		   const struct table *t, double corners[4][2] )
+{
+	double m[3][3], inv[3][3];
+	int x, y;
+
+	if (face != NULL) {
+		square_to_quad( m, corners );
+		invert( inv, m );
+	}
+	for (y = 0; y < s->height; y++) {
+		for (x = 0; x < s->width; x++) {
+			double lit = 1 - s->light * (0.5 + 0.25 * (t->lx * (2.0 * x / s->width - 1)
+							 + t->ly * (2.0 * y / s->height - 1)));
+			unsigned char *out = photo->pixels + 3 * ((size_t)y * s->width + x);
+			double rgb[3], fx = -1, fy = -1;
+			int i;
+
+			if (face != NULL) {
+				double w = inv[2][0] * x + inv[2][1] * y + inv[2][2];
+				double u = (inv[0][0] * x + inv[0][1] * y + inv[0][2]) / w;
+				double v = (inv[1][0] * x + inv[1][1] * y + inv[1][2]) / w;
+				fx = u * face->width - 0.5;
+				fy = v * face->height - 0.5;
+			}
+			if ((fx >= 0) && (fy >= 0) && (fx < face->width - 1)
+			 && (fy < face->height - 1)
+			 && face->pixels[4 * ((size_t)(int)(fy + 0.5) * face->width
+					     + (int)(fx + 0.5)) + 3]) {
+				int ix = (int)fx, iy = (int)fy;
+				double ax = fx - ix, ay = fy - iy;
+				const unsigned char *p = face->pixels
+					+ 4 * ((size_t)iy * face->width + ix);
+				for (i = 0; i < 3; i++) {
+					rgb[i] = (p[i] * (1 - ax) + p[4 + i] * ax) * (1 - ay)
+					       + (p[4 * face->width + i] * (1 - ax)
+						  + p[4 * face->width + 4 + i] * ax) * ay;
+				}
+				/* card stock is not paper white */
+				rgb[0] *= 0.97;
+				rgb[1] *= 0.94;
+				rgb[2] *= 0.84;
+			} else {
+				double level = t->base + mottle( t->grid, 16, 16.0 * x / s->width,
+								 16.0 * y / s->height );
+				rgb[0] = level * 1.1;
+				rgb[1] = level;
+				rgb[2] = level * 0.9;
+			}
+			for (i = 0; i < 3; i++) {
+				double level = rgb[i] * lit + s->noise * gaussian();
+				out[i] = (level < 0) ? 0 : (level > 255) ? 255 : (int)level;
+			}
+		}
+	}
+}
+
+/* a picture to its file, numbered n, or to stdout */
+static void write_picture( const struct card_image *photo, const char *out,
+			   long n, int ppm, const char *progname )
+{
+	char name[4096];
+	FILE *f = stdout;
+	int err;
+
+	if (out != NULL) {
+		snprintf( name, sizeof name, out, (int)n );
+		f = fopen( name, "wb" );
+		if (f == NULL) {
+			fprintf( stderr, "%s %s: cannot create\n", progname, name );
+			exit(-1);
+		}
+	}
+	err = ppm ? card_image_write_pnm( photo, f )
+		  : card_image_write_png( photo, f );
+	if ((err != CARD_OK) || (fflush( f ) != 0)) {
+		fprintf( stderr, "%s: error writing picture %ld\n", progname, n );
+		exit(-1);
+	}
+	if (f != stdout) fclose( f );
+}
+
+static void usage( const char *progname )
+{
+	fprintf( stderr, "\n%s [options] [deck]\n\n", progname );
+	fprintf( stderr,
+	"Make a photograph of each card in a deck, drawn as the editor\n"
+	"draws it.  If the deck is missing, read it from stdin.  The\n"
+	"options are:\n\n"
+	" -out pattern    file names, as card%%03d.png (stdout for one card)\n"
+	" -assets dir     where PunchedCard.png and Punch.png are (Assets)\n"
+	" -2x             draw from the @2x assets\n"
+	" -size WxH       pixels in the picture (1280x720)\n"
+	" -fill f         of its width the card spans (0.7)\n"
+	" -angle a        turned by up to a degrees either way (10)\n"
+	" -tilt t         corners out of square by up to t of the width (0.03)\n"
+	" -light l        light falling off across the picture (0.3)\n"
+	" -noise n        sensor noise, in levels (4)\n"
+	" -turn           upside down\n"
+	" -chad n         leave n chads hanging in holes (0)\n"
+	" -feed n         frames of cards fed under a camera, n still each\n"
+	" -seed n         for everything random (1)\n"
+	" -ppm            write PPM, not PNG\n"
+	" -v              report each card's corners on stderr\n\n"
+	" -026comm        the keypunch, for printing interpreted cards\n"
+	" -029 -026ftn    (029 default)\n"
+	" -EBCDIC\n\n"
+	);
+	exit(-1);
+}
+
+int main( int argc, char *argv[] )
+{
+	struct shot s = { 1280, 720, 10, 0.03, 0.7, 0.3, 4, 0 };
+	struct card_atlas atlas;
+	struct card_image face, photo;
+	struct card_options opt;
+	struct card_codec codec;
+	struct table table;
+	const char *assets = "Assets", *out = NULL;
+	unsigned char *deck;
+	FILE *in = stdin;
+	size_t len, card_bytes;
+	long ncards, i, frame = 0;
+	double home[4][2], dx, dy;
+	int zoom = 1, ppm = 0, verbose = 0, chads = 0, feed = 0;
+	int arg = 1, err, format;
+
+	card_options_init( &opt );
+	while ((arg < argc) && (argv[arg][0] == '-')) { /* command line arg */
+		if (card_list_option( &opt, argv[arg] )) {
+			/* the keypunch */
+		} else if ((strcmp(argv[arg],"-out") == 0) && (arg + 1 < argc)) {
+			out = argv[++arg];
+		} else if ((strcmp(argv[arg],"-assets") == 0) && (arg + 1 < argc)) {
+			assets = argv[++arg];
+		} else if (strcmp(argv[arg],"-2x") == 0) {
+			zoom = 2;
+		} else if ((strcmp(argv[arg],"-size") == 0) && (arg + 1 < argc)) {
+			if ((sscanf( argv[++arg], "%dx%d", &s.width, &s.height ) != 2)
+			 || (s.width < 64) || (s.height < 64)) usage( argv[0] );
+		} else if ((strcmp(argv[arg],"-fill") == 0) && (arg + 1 < argc)) {
+			s.fill = atof( argv[++arg] );
+		} else if ((strcmp(argv[arg],"-angle") == 0) && (arg + 1 < argc)) {
+			s.angle = atof( argv[++arg] );
+		} else if ((strcmp(argv[arg],"-tilt") == 0) && (arg + 1 < argc)) {
+			s.tilt = atof( argv[++arg] );
+		} else if ((strcmp(argv[arg],"-light") == 0) && (arg + 1 < argc)) {
+			s.light = atof( argv[++arg] );
+		} else if ((strcmp(argv[arg],"-noise") == 0) && (arg + 1 < argc)) {
+			s.noise = atof( argv[++arg] );
+		} else if (strcmp(argv[arg],"-turn") == 0) {
+			s.turn = 1;
+		} else if ((strcmp(argv[arg],"-feed") == 0) && (arg + 1 < argc)) {
+			feed = atoi( argv[++arg] );
+			if (feed < 1) usage( argv[0] );
+		} else if ((strcmp(argv[arg],"-chad") == 0) && (arg + 1 < argc)) {
+			chads = atoi( argv[++arg] );
+		} else if ((strcmp(argv[arg],"-seed") == 0) && (arg + 1 < argc)) {
+			seed = strtoull( argv[++arg], NULL, 10 ) * 2654435761ULL + 1;
+		} else if (strcmp(argv[arg],"-ppm") == 0) {
+			ppm = 1;
+		} else if (strcmp(argv[arg],"-v") == 0) {
+			verbose = 1;
+		} else if (strcmp(argv[arg],"-help") == 0) {
+			usage( argv[0] );
+		} else {
+			fprintf( stderr, "%s: unknown option %s;"
+					 " -help available\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+		arg++;
+	}
+	if ( (argc - arg) > 1 ) { /* too many arguments */
+		fprintf( stderr, "%s: too many arguments\n", argv[0] );
+		exit(-1);
+	}
+	if ( (argc - arg) == 1 ) {
+		in = fopen( argv[arg], "rb" );
+		if (in == NULL) {
+			fprintf( stderr, "%s %s: invalid card file\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+	}
+	deck = read_all( in, &len );
+	if (deck == NULL) {
+		fprintf( stderr, "%s: out of memory\n", argv[0] );
+		exit(-1);
+	}
+	err = card_validate_buffer( deck, len, &ncards );
+	if (err != CARD_OK) {
+		fprintf( stderr, "%s: %s\n", argv[0], card_strerror( err ) );
+		exit(-1);
+	}
+	if ((out == NULL) && feed && !ppm) {
+		fprintf( stderr, "%s: PNG frames need -out; -help available\n",
+			 argv[0] );
+		exit(-1);
+	}
+	if ((out == NULL) && !feed && (ncards != 1)) {
+		fprintf( stderr, "%s: %ld cards need -out; -help available\n",
+			 argv[0], ncards );
+		exit(-1);
+	}
+	format = (deck[2] == '0') ? 80 : 82;
+	card_codec_init( &codec, &opt );
+	card_bytes = (format == 80) ? 3 + 120 : 3 + 123;
+
+	err = card_atlas_load( &atlas, assets, zoom );
+	if (err != CARD_OK) {
+		fprintf( stderr, "%s %s: %s\n", argv[0], assets, card_strerror( err ) );
+		exit(-1);
+	}
+	if ((card_image_alloc( &face, atlas.width, atlas.height, 4 ) != CARD_OK)
+	 || (card_image_alloc( &photo, s.width, s.height, 3 ) != CARD_OK)) {
+		fprintf( stderr, "%s: out of memory\n", argv[0] );
+		exit(-1);
+	}
+
+	for (i = 0; i < ncards; i++) {
+		const unsigned char *p = deck + 3 + i * card_bytes + 3;
+		uint16_t cols[82];
+		double corners[4][2];
+		int c, k;
+
+		for (c = 0; c < ((format == 80) ? 80 : 82); c += 2, p += 3) {
+			cols[c] = (p[0] << 4) | (p[1] >> 4);
+			cols[c + 1] = ((p[1] & 0017) << 8) | p[2];
+		}
+		draw_card( &face, &atlas, cols + ((format == 82) ? 1 : 0), &codec,
+			   deck[3 + i * card_bytes + 1] & 0x40, chads );
+		if (feed == 0) {
+			place( &face, &s, corners );
+			set_table( &table );
+			shoot( &photo, &face, &s, &table, corners );
+			write_picture( &photo, out, ++frame, ppm, argv[0] );
+			if (verbose) {
+				fprintf( stderr, "card %ld:", i + 1 );
+				for (c = 0; c < 4; c++)
+					fprintf( stderr, " (%.1f,%.1f)",
+						 corners[c][0], corners[c][1] );
+				putc( '\n', stderr );
+			}
+			continue;
+		}
+
+		/* fed: each card lands near where the first did, slides in,
+		   lies still, slides out, and leaves the table bare a moment */
+		if (i == 0) {
+			set_table( &table );
+			place( &face, &s, home );
+			for (k = 0; k < 3; k++) {
+				shoot( &photo, NULL, &s, &table, NULL );
+				write_picture( &photo, out, ++frame, ppm, argv[0] );
+			}
+		}
+		dx = between( -0.01, 0.01 ) * s.width;
+		dy = between( -0.01, 0.01 ) * s.height;
+		for (k = -3; k < feed + 3; k++) {
+			double slide = (k < 0) ? -k * s.width / 3.0
+				     : (k >= feed) ? -(k - feed + 1) * s.width / 3.0 : 0;
+			for (c = 0; c < 4; c++) {
+				corners[c][0] = home[c][0] + dx + slide;
+				corners[c][1] = home[c][1] + dy;
+			}
+			shoot( &photo, &face, &s, &table, corners );
+			write_picture( &photo, out, ++frame, ppm, argv[0] );
+			if (verbose && (k == 0))
+				fprintf( stderr, "card %ld: frames %ld to %ld\n", i + 1,
+					 frame, frame + feed - 1 );
+		}
+		for (k = 0; k < 4; k++) {
+			shoot( &photo, NULL, &s, &table, NULL );
+			write_picture( &photo, out, ++frame, ppm, argv[0] );
+		}
+	}
+	exit(0);
+}
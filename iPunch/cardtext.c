@@ -0,0 +1,407 @@
+/* cardtext.c -- the text of a deck being edited, kept a card line at a time.
+ *
+ * see cardtext.h
+ *
+ * A line is punched by handing it, with its newline unless it is the
+ * last line, to card_make_buffer, and keeping the cards without the
+ * file's H80 or H82; cardmake starts each card afresh after a newline,
+ * so the cards of the lines one after another are the cards of the
+ * whole text.  Only the last line is punched without a newline; a line
+ * stops being the last only by a newline typed in it, and another
+ * becomes the last only by being added or joined to, and each of these
+ * marks it changed anyway.
+ *
+ * The changed lines are a list, each line knowing its place in it, so
+ * a line is marked, unmarked or freed in constant time and a flush
+ * costs the lines changed, not the lines there are.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "cardtext.h"
+
+struct card_line {
+	unsigned char *text;	/* without its newline */
+	int len, cap;
+	struct card_buf cards;	/* as punched */
+	int ncards;
+	long changed;		/* its place in the changed list + 1, or 0 */
+};
+
+static struct card_line *line( const struct card_text *text, long i )
+{
+	return text->lines[(i < text->gap) ? i : i + text->cap - text->nlines];
+}
+
+static size_t card_bytes( const struct card_text *text )
+{
+	return (text->codec->opt.format == 80) ? 3 + 120 : 3 + 123;
+}
+
+static void move_gap( struct card_text *text, long to )
+{
+	long gap_len = text->cap - text->nlines;
+
+	if (to < text->gap) {
+		memmove( text->lines + to + gap_len, text->lines + to,
+			 (text->gap - to) * sizeof *text->lines );
+	} else if (to > text->gap) {
+		memmove( text->lines + text->gap, text->lines + text->gap + gap_len,
+			 (to - text->gap) * sizeof *text->lines );
+	}
+	text->gap = to;
+}
+
+static int insert_line( struct card_text *text, long i, struct card_line *ln )
+{
+	if (text->nlines == text->cap) {
+		long cap = text->cap ? 2 * text->cap : 64;
+		struct card_line **lines = realloc( text->lines, cap * sizeof *lines );
+		if (lines == NULL) return CARD_ENOMEM;
+		memmove( lines + text->gap + cap - text->nlines, lines + text->gap,
+			 (text->nlines - text->gap) * sizeof *lines );
+		text->lines = lines;
+		text->cap = cap;
+	}
+	move_gap( text, i );
+	text->lines[text->gap++] = ln;
+	text->nlines++;
+	return CARD_OK;
+}
+
+static struct card_line *remove_line( struct card_text *text, long i )
+{
+	move_gap( text, i + 1 );
+	text->nlines--;
+	return text->lines[--text->gap];
+}
+
+static int mark( struct card_text *text, struct card_line *ln )
+{
+	if (ln->changed) return CARD_OK;
+	if (text->nchanged == text->changed_cap) {
+		long cap = text->changed_cap ? 2 * text->changed_cap : 64;
+		struct card_line **changed = realloc( text->changed,
+						      cap * sizeof *changed );
+		if (changed == NULL) return CARD_ENOMEM;
+		text->changed = changed;
+		text->changed_cap = cap;
+	}
+	text->changed[text->nchanged++] = ln;
+	ln->changed = text->nchanged;
+	return CARD_OK;
+}
+
+static void unmark( struct card_text *text, struct card_line *ln )
+{
+	struct card_line *moved;
+
+	if (!ln->changed) return;
+	moved = text->changed[--text->nchanged];
+	text->changed[ln->changed - 1] = moved;
+	moved->changed = ln->changed;
+	ln->changed = 0;
+}
+
+static void free_line( struct card_text *text, struct card_line *ln )
+{
+	unmark( text, ln );
+	text->cards -= ln->ncards;
+	free( ln->text );
+	card_buf_free( &ln->cards );
+	free( ln );
+}
+
+/* room for len bytes of text in a line */
+static int room( struct card_line *ln, size_t len )
+{
+	unsigned char *t;
+	int cap;
+
+	if (len <= (size_t)ln->cap) return CARD_OK;
+	if (len > 0x3fffffff) return CARD_ENOMEM;
+	cap = ln->cap ? ln->cap : 96;
+	while ((size_t)cap < len) cap *= 2;
+	t = realloc( ln->text, cap );
+	if (t == NULL) return CARD_ENOMEM;
+	ln->text = t;
+	ln->cap = cap;
+	return CARD_OK;
+}
+
+static struct card_line *new_line( const unsigned char *s, size_t n,
+				   const unsigned char *tail, size_t tail_len )
+{
+	struct card_line *ln = calloc( 1, sizeof *ln );
+
+	if (ln == NULL) return NULL;
+	if (room( ln, n + tail_len ) != CARD_OK) {
+		free( ln );
+		return NULL;
+	}
+	if (n > 0) memcpy( ln->text, s, n );
+	if (tail_len > 0) memcpy( ln->text + n, tail, tail_len );
+	ln->len = (int)(n + tail_len);
+	return ln;
+}
+
+/* punch a line's cards again */
+static int punch( struct card_text *text, struct card_line *ln )
+{
+	size_t n = ln->len, size = card_bytes( text );
+	int err, ncards;
+
+	err = card_buf_reserve( &text->scratch, n + 1 );
+	if (err != CARD_OK) return err;
+	if (n > 0) memcpy( text->scratch.data, ln->text, n );
+	if (ln != line( text, text->nlines - 1 )) text->scratch.data[n++] = '\n';
+	err = card_make_buffer( text->codec, text->scratch.data, n, &text->made );
+	if (err != CARD_OK) return err;
+	ncards = (int)((text->made.len - 3) / size);
+	err = card_buf_reserve( &ln->cards, (ncards > 0) ? ncards * size : 1 );
+	if (err != CARD_OK) return err;
+	if (ncards > 0) memcpy( ln->cards.data, text->made.data + 3, ncards * size );
+	ln->cards.len = ncards * size;
+	text->cards += ncards - ln->ncards;
+	ln->ncards = ncards;
+	unmark( text, ln );
+	text->punched++;
+	return CARD_OK;
+}
+
+int card_text_init( struct card_text *text, const struct card_codec *codec )
+{
+	struct card_line *ln;
+
+	memset( text, 0, sizeof *text );
+	text->codec = codec;
+	ln = new_line( NULL, 0, NULL, 0 );
+	if ((ln == NULL) || (insert_line( text, 0, ln ) != CARD_OK)
+	 || (mark( text, ln ) != CARD_OK)) {
+		free( ln );
+		card_text_free( text );
+		return CARD_ENOMEM;
+	}
+	return CARD_OK;
+}
+
+void card_text_free( struct card_text *text )
+{
+	long i;
+
+	for (i = 0; i < text->nlines; i++) {
+		struct card_line *ln = line( text, i );
+		free( ln->text );
+		card_buf_free( &ln->cards );
+		free( ln );
+	}
+	free( text->lines );
+	free( text->changed );
+	card_buf_free( &text->scratch );
+	card_buf_free( &text->made );
+	memset( text, 0, sizeof *text );
+}
+
+long card_text_line_at( struct card_text *text, size_t at, int *col )
+{
+	long l = text->hint_line;
+	size_t start = text->hint_start;
+
+	if (l >= text->nlines) {
+		l = 0;
+		start = 0;
+	}
+	while (at < start) {
+		l--;
+		start -= line( text, l )->len + 1;
+	}
+	while ((l < text->nlines - 1) && (at > start + line( text, l )->len)) {
+		start += line( text, l )->len + 1;
+		l++;
+	}
+	text->hint_line = l;
+	text->hint_start = start;
+	*col = (at - start < (size_t)line( text, l )->len)
+	       ? (int)(at - start) : line( text, l )->len;
+	return l;
+}
+
+int card_text_replace( struct card_text *text, size_t at, size_t remove,
+		       const unsigned char *s, size_t n )
+{
+	const unsigned char *end = s + n, *nl;
+	struct card_line *ln;
+	size_t start;
+	long l, k;
+	int c, err;
+
+	l = card_text_line_at( text, at, &c );
+	start = text->hint_start;
+	ln = line( text, l );
+	if ((remove > 0) || (n > 0)) {
+		err = mark( text, ln );
+		if (err != CARD_OK) return err;
+	}
+
+	/* the bytes removed, joining lines across newlines */
+	while (remove > 0) {
+		size_t avail = ln->len - c;
+		struct card_line *next;
+		if (remove <= avail) {
+			memmove( ln->text + c, ln->text + c + remove, avail - remove );
+			ln->len -= (int)remove;
+			break;
+		}
+		remove -= avail + 1;
+		ln->len = c;
+		if (l == text->nlines - 1) break;
+		next = line( text, l + 1 );
+		err = room( ln, (size_t)c + next->len );
+		if (err != CARD_OK) return err;
+		if (next->len > 0) memcpy( ln->text + c, next->text, next->len );
+		ln->len += next->len;
+		free_line( text, remove_line( text, l + 1 ) );
+	}
+
+	/* and those inserted, splitting lines at newlines */
+	nl = (n > 0) ? memchr( s, '\n', n ) : NULL;
+	if ((nl == NULL) && (n > 0)) {
+		err = room( ln, (size_t)ln->len + n );
+		if (err != CARD_OK) return err;
+		memmove( ln->text + c + n, ln->text + c, ln->len - c );
+		memcpy( ln->text + c, s, n );
+		ln->len += (int)n;
+	} else if (nl != NULL) {
+		const unsigned char *p = nl + 1;
+		for (k = l + 1; ; k++) {
+			const unsigned char *q = memchr( p, '\n', end - p );
+			struct card_line *added;
+			added = (q != NULL) ? new_line( p, q - p, NULL, 0 )
+					    : new_line( p, end - p, ln->text + c,
+							ln->len - c );
+			if (added == NULL) return CARD_ENOMEM;
+			err = insert_line( text, k, added );
+			if (err == CARD_OK) {
+				err = mark( text, added );
+				if (err != CARD_OK) remove_line( text, k );
+			}
+			if (err != CARD_OK) {
+				free( added->text );
+				free( added );
+				return err;
+			}
+			if (q == NULL) break;
+			p = q + 1;
+		}
+		ln->len = c;
+		err = room( ln, (size_t)c + (nl - s) );
+		if (err != CARD_OK) return err;
+		memcpy( ln->text + c, s, nl - s );
+		ln->len += (int)(nl - s);
+	}
+
+	text->hint_line = l;
+	text->hint_start = start;
+	return CARD_OK;
+}
+
+const unsigned char *card_text_line( const struct card_text *text, long i,
+				     int *len )
+{
+	struct card_line *ln = line( text, i );
+
+	*len = ln->len;
+	return ln->text;
+}
+
+const unsigned char *card_text_card( struct card_text *text, long i,
+				     int *ncards )
+{
+	struct card_line *ln = line( text, i );
+
+	if (ln->changed && (punch( text, ln ) != CARD_OK)) return NULL;
+	*ncards = ln->ncards;
+	return ln->cards.data;
+}
+
+const unsigned char *card_text_columns( struct card_text *text, long i,
+				       int card, uint16_t cols[80] )
+{
+	int format = text->codec->opt.format, ncards, c;
+	const unsigned char *cards = card_text_card( text, i, &ncards );
+	const unsigned char *p;
+	uint16_t all[82];
+
+	if ((cards == NULL) || (card < 0) || (card >= ncards)) return NULL;
+	cards += card * card_bytes( text );
+	p = cards + 3;
+	for (c = 0; c < format; c += 2, p += 3) {
+		all[c] = (p[0] << 4) | (p[1] >> 4);
+		all[c + 1] = ((p[1] & 0017) << 8) | p[2];
+	}
+	memcpy( cols, all + ((format == 82) ? 1 : 0), 80 * sizeof *cols );
+	return cards;
+}
+
+int card_text_card_at( const struct card_text *text, long i, int col,
+		       int *column )
+{
+	struct card_line *ln = line( text, i );
+	int card = 0, c = 1, k;
+
+	/* as card_make_buffer fills columns 1 to 80, c the next to fill */
+	if (col > ln->len) col = ln->len;
+	for (k = 0; k < col; k++) {
+		if (c > 80) {
+			card++;
+			c = 1;
+		}
+		if (ln->text[k] == '\t') {
+			do c++; while (((c & 07) != 1) && (c < 81));
+		} else {
+			c++;
+		}
+	}
+	if ((c > 80) && (col < ln->len)) {
+		card++;
+		c = 1;
+	}
+	*column = (c > 80) ? 79 : c - 1;
+	return card;
+}
+
+int card_text_flush( struct card_text *text )
+{
+	int err;
+
+	while (text->nchanged > 0) {
+		err = punch( text, text->changed[text->nchanged - 1] );
+		if (err != CARD_OK) return err;
+	}
+	return CARD_OK;
+}
+
+int card_text_deck( struct card_text *text, struct card_buf *out )
+{
+	size_t size = card_bytes( text );
+	unsigned char *dst;
+	long i;
+	int err;
+
+	err = card_text_flush( text );
+	if (err != CARD_OK) return err;
+	err = card_buf_reserve( out, 3 + text->cards * size );
+	if (err != CARD_OK) return err;
+	dst = out->data;
+	*dst++ = 'H';
+	*dst++ = '8';
+	*dst++ = (text->codec->opt.format == 80) ? '0' : '2';
+	for (i = 0; i < text->nlines; i++) {
+		struct card_line *ln = line( text, i );
+		memcpy( dst, ln->cards.data, ln->ncards * size );
+		dst += ln->ncards * size;
+	}
+	out->len = dst - out->data;
+	return CARD_OK;
+}
@@ -0,0 +1,83 @@
+/* cardtext.h -- the text of a deck being edited, kept a card line at a time.
+ *
+ * The editor's text is a program, a line to a card.  A card_text holds
+ * it as its lines, each with the cards cardmake punches for it: one for
+ * a line of up to 80 columns, more for a longer one, tabs set every 8
+ * columns, and for the last line none if it is empty.  An edit marks
+ * the lines it touches, and only those are punched again, so a
+ * keystroke costs the same in a program of 5000 lines as in one of 5.
+ *
+ * card_text_replace is the one edit, as a text view makes them: the
+ * bytes from at, remove long, give way to the n of s, newlines
+ * splitting lines and a removed newline joining two.  Offsets count
+ * bytes and each newline as one; the line at an offset is found by
+ * walking from the last one found, so edits near each other, as typing
+ * is, find their line at once.  The lines are kept in a gap buffer,
+ * the gap where lines were last added or taken away.
+ *
+ * card_text_card gives line i's cards, packed three bytes to two
+ * columns after each card's header as in a card-image file, punching
+ * them first if the line has changed, and card_text_columns the 80
+ * 12-bit columns of one of them, returning its header, or NULL if the
+ * line has no such card.  card_text_card_at says which of line i's
+ * cards the character at col, counting from 0, is punched on, and in
+ * which of its columns, from 0, with tabs set as cardmake sets them; a
+ * col at the end of the line is on the card of the character before
+ * it.  card_text_flush punches every changed line, and card_text_deck
+ * gives the whole deck, H80 or H82 as the codec says, byte for byte
+ * what card_make_buffer makes of the whole text.  punched counts the
+ * lines punched, and cards the deck's length as of the last flush.
+ *
+ * card_text_init, card_text_replace, card_text_deck and card_text_flush
+ * return CARD_OK or CARD_ENOMEM, and card_text_card NULL when out of
+ * memory; an edit that runs out of memory may be left half made.
+ *
+ */
+
+#ifndef CARDTEXT_H
+#define CARDTEXT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cardconv.h"
+
+struct card_line;
+
+struct card_text {
+	const struct card_codec *codec;
+	long nlines;		/* never fewer than 1 */
+	long punched;		/* lines punched, ever */
+	long cards;		/* in the deck, as of the last flush */
+
+	/* the lines, with a gap of cap - nlines at gap */
+	struct card_line **lines;
+	long cap, gap;
+
+	/* the lines changed since they were punched */
+	struct card_line **changed;
+	long nchanged, changed_cap;
+
+	/* where the last offset was found */
+	long hint_line;
+	size_t hint_start;
+
+	struct card_buf scratch, made;	/* for punching a line */
+};
+
+int card_text_init( struct card_text *text, const struct card_codec *codec );
+void card_text_free( struct card_text *text );
+int card_text_replace( struct card_text *text, size_t at, size_t remove,
+		       const unsigned char *s, size_t n );
+long card_text_line_at( struct card_text *text, size_t at, int *col );
+const unsigned char *card_text_line( const struct card_text *text, long i,
+				     int *len );
+const unsigned char *card_text_card( struct card_text *text, long i,
+				     int *ncards );
+const unsigned char *card_text_columns( struct card_text *text, long i,
+					int card, uint16_t cols[80] );
+int card_text_card_at( const struct card_text *text, long i, int col,
+		       int *column );
+int card_text_flush( struct card_text *text );
+int card_text_deck( struct card_text *text, struct card_buf *out );
+
+#endif /* CARDTEXT_H */
@@ -0,0 +1,781 @@
+/* cardvector.c -- draw a deck as real cards, in SVG or PDF, for printing.
+ *
+ * operation:  run cardvector -help for instructions
+ *
+ * build: cc -o cardvector cardvector.c cardscan.c cardimage.c cardconv.c
+ *        cardcodec.c -lz -lm
+ *
+ * input  -- a card-image file
+ * output -- an SVG drawing of the deck, or a PDF with a page a card
+ *
+ * Each card is drawn at its real size, 7 3/8 by 3 1/4 inches, laid out
+ * as card_geometry_ibm says, with the card's header deciding how: its
+ * color, or a cream card with a stripe of the color; its corners round
+ * or square; which top corners are cut; and the preprinted form, one of
+ * the cardmake forms:
+ *
+ *	blank	nothing
+ *	5081	the digits 0 to 9 in each column, numbered under the 0s
+ *		and along the bottom: the general purpose card
+ *	507536	as 5081, with a rule every ten columns
+ *	5280	digits, numbered along the bottom only
+ *	327	digits alone
+ *	733727	the assembler card: name, operation, operand and
+ *		identification-sequence fields
+ *	888157	the FORTRAN card: statement number, continuation,
+ *		statement and identification fields
+ *
+ * These are the common layouts of such cards, not copies of IBM's
+ * artwork.  The holes are black, and a card with the interpreted bit in
+ * its header has its columns printed along its top in the 5 by 7 dots
+ * of cardfont.i, as the keypunch table reads them; -print prints every
+ * card, -noprint none.
+ *
+ * What cards share is drawn once in a document and used by each card:
+ * each form, outline and letter the deck needs is an SVG def or a PDF
+ * form XObject, so a card itself is its color, its holes and where its
+ * letters go.  PDF page contents are compressed.  SVG lays the cards out
+ * one under another; PDF puts each on a page of its own size, as card
+ * stock is fed to a printer.  The output is SVG unless -pdf, or -out
+ * names a file ending .pdf.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <zlib.h>
+#include "cardconv.h"
+#include "cardscan.h"
+#include "cardfont.i"
+
+#define MIL( inches )	((int)((inches) * 1000 + 0.5))
+#define GAP		250	/* mils between cards, in SVG */
+#define KAPPA		0.5523	/* a quarter circle as a Bezier curve */
+#define DIGIT_SIZE	90	/* mils, the form's digits */
+#define NUMBER_SIZE	45	/* its column numbers */
+#define LABEL_SIZE	40	/* its field labels and legend */
+#define DOT		10	/* mils across a printed dot */
+
+static double now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned char *read_all( FILE *f, size_t *len )
+{
+	size_t cap = 1 << 16, got;
+	unsigned char *buf = malloc( cap );
+
+	*len = 0;
+	while ((buf != NULL) && ((got = fread( buf + *len, 1, cap - *len, f )) > 0)) {
+		*len += got;
+		if (*len == cap) buf = realloc( buf, cap *= 2 );
+	}
+	return buf;
+}
+
+/* the preprinted forms, numbered as cardmake numbers them */
+#define DIGITS		1	/* 0 to 9 in each column */
+#define NUMBERS		2	/* column numbers under the 0s */
+#define BOTTOM		4	/* and along the bottom */
+#define TENS		8	/* a rule every ten columns */
+
+struct field {
+	int first, last;		/* columns, from 1 */
+	const char *label[2];		/* lines of it */
+};
+
+struct form {
+	const char *name;
+	int print;
+	const char *legend;
+	struct field fields[5];
+};
+
+static const struct form forms[8] = {
+	{ "blank", 0, NULL, { { 0 } } },
+	{ "5081", DIGITS | NUMBERS | BOTTOM, "IBM 5081", { { 0 } } },
+	{ "507536", DIGITS | NUMBERS | BOTTOM | TENS, "IBM 507536", { { 0 } } },
+	{ "5280", DIGITS | BOTTOM, "IBM 5280", { { 0 } } },
+	{ "327", DIGITS, "IBM 327", { { 0 } } },
+	{ "733727", DIGITS | NUMBERS | BOTTOM, "IBM 733727", {
+		{ 1, 8, { "NAME" } },
+		{ 10, 14, { "OPERATION" } },
+		{ 16, 71, { "OPERAND" } },
+		{ 73, 80, { "IDENTIFICATION-", "SEQUENCE" } } } },
+	{ "888157", DIGITS | NUMBERS | BOTTOM, "IBM 888157", {
+		{ 1, 5, { "STATEMENT", "NUMBER" } },
+		{ 6, 6, { "" } },
+		{ 7, 72, { "FORTRAN STATEMENT" } },
+		{ 73, 80, { "IDENTIFICATION" } } } },
+	{ "blank", 0, NULL, { { 0 } } }	/* 7 is not a form */
+};
+
+/* the card colors, and the stripes on cream cards */
+static const char *colors[8] = {
+	"f2e8c9", "fbfbf8", "f6ec8a", "f3c6cf",
+	"bcd3ee", "c4e3bf", "f5c48e", "c9a27a"
+};
+static const char *stripes[8] = {
+	"b89b52", "888888", "d8c020", "d0607a",
+	"3f6fb5", "4c9a4a", "e07b22", "7a4e2a"
+};
+
+/* Helvetica's widths, in thousandths of its size, from space to _ */
+static const short helvetica[64] = {
+	278, 278, 355, 556, 556, 889, 667, 191, 333, 333, 389, 584, 278, 333, 278, 278,
+	556, 556, 556, 556, 556, 556, 556, 556, 556, 556, 278, 278, 584, 584, 584, 556,
+	1015, 667, 667, 722, 722, 667, 611, 778, 722, 278, 500, 667, 556, 833, 722, 778,
+	667, 778, 722, 667, 611, 722, 667, 944, 667, 667, 611, 278, 278, 278, 469, 556
+};
+
+/* a document being written; drawing goes to buf, and SVG goes out a
+   card at a time, PDF a stream at a time, counting the bytes */
+struct doc {
+	FILE *f;
+	int pdf;
+	struct card_buf buf;
+	long pos;			/* bytes written */
+	long *xref;			/* each PDF object's offset */
+	int objects;
+	int err;
+};
+
+static void put( struct doc *d, const char *fmt, ... )
+{
+	va_list ap;
+	int n;
+
+	for (;;) {
+		va_start( ap, fmt );
+		n = vsnprintf( (char *)d->buf.data + d->buf.len, d->buf.cap - d->buf.len,
+			       fmt, ap );
+		va_end( ap );
+		if ((n >= 0) && (d->buf.len + n < d->buf.cap)) break;
+		if (card_buf_reserve( &d->buf, d->buf.len + ((n > 0) ? n : 0) + 4096 )
+		    != CARD_OK) {
+			d->err = CARD_ENOMEM;
+			return;
+		}
+	}
+	d->buf.len += n;
+}
+
+static void flush( struct doc *d, const void *data, size_t n )
+{
+	if (fwrite( data, 1, n, d->f ) != n) d->err = CARD_EIO;
+	d->pos += n;
+}
+
+/* what has been put, out */
+static void drain( struct doc *d )
+{
+	flush( d, d->buf.data, d->buf.len );
+	d->buf.len = 0;
+}
+
+/* a PDF object begins here, after what has been put so far */
+static void object( struct doc *d, int n )
+{
+	char head[32];
+
+	drain( d );
+	d->xref[n] = d->pos;
+	flush( d, head, sprintf( head, "%d 0 obj\n", n ) );
+}
+
+/* what has been drawn, as a PDF stream object with dict before /Length */
+static void stream( struct doc *d, int n, const char *dict )
+{
+	uLongf zlen = compressBound( d->buf.len );
+	unsigned char *z = malloc( zlen );
+	char head[512];
+
+	if ((z == NULL) || (compress2( z, &zlen, d->buf.data, d->buf.len, 6 ) != Z_OK)) {
+		d->err = CARD_ENOMEM;
+		free( z );
+		return;
+	}
+	d->buf.len = 0;
+	object( d, n );
+	flush( d, head, sprintf( head, "<< %s/Length %lu /Filter /FlateDecode >>\nstream\n",
+				 dict, (unsigned long)zlen ) );
+	flush( d, z, zlen );
+	flush( d, "\nendstream\nendobj\n", 18 );
+	free( z );
+}
+
+/* a path, in the document's syntax */
+static void move( struct doc *d, double x, double y )
+{
+	put( d, d->pdf ? "%.0f %.0f m " : "M%.0f %.0f", x, y );
+}
+
+static void line( struct doc *d, double x, double y )
+{
+	put( d, d->pdf ? "%.0f %.0f l " : "L%.0f %.0f", x, y );
+}
+
+/* from the current point a, around the corner c, to b */
+static void corner( struct doc *d, double ax, double ay, double cx, double cy,
+		    double bx, double by )
+{
+	put( d, d->pdf ? "%.0f %.0f %.0f %.0f %.0f %.0f c " : "C%.0f %.0f %.0f %.0f %.0f %.0f",
+	     ax + KAPPA * (cx - ax), ay + KAPPA * (cy - ay),
+	     bx + KAPPA * (cx - bx), by + KAPPA * (cy - by), bx, by );
+}
+
+/* a card's outline, clockwise from the top left, in mils with y down;
+   a cut goes g->cut along the top and down at 60 degrees, and round
+   corners have a radius of g->round */
+static void outline( struct doc *d, const struct card_geometry *g, int round,
+		     int cut )
+{
+	double w = MIL( g->width ), h = MIL( g->height );
+	double r = round ? MIL( g->round ) : 0, cx = MIL( g->cut ), cy = cx * 1.732;
+
+	if (cut & 2) {
+		move( d, 0, cy );
+		line( d, cx, 0 );
+	} else if (r > 0) {
+		move( d, 0, r );
+		corner( d, 0, r, 0, 0, r, 0 );
+	} else {
+		move( d, 0, 0 );
+	}
+	if (cut & 1) {
+		line( d, w - cx, 0 );
+		line( d, w, cy );
+	} else if (r > 0) {
+		line( d, w - r, 0 );
+		corner( d, w - r, 0, w, 0, w, r );
+	} else {
+		line( d, w, 0 );
+	}
+	if (r > 0) {
+		line( d, w, h - r );
+		corner( d, w, h - r, w, h, w - r, h );
+		line( d, r, h );
+		corner( d, r, h, 0, h, 0, h - r );
+	} else {
+		line( d, w, h );
+		line( d, 0, h );
+	}
+	put( d, d->pdf ? "h" : "Z" );
+}
+
+/* text with its baseline at y, starting, centered or ending at x as
+   anchor is -1, 0 or 1 */
+static void text( struct doc *d, double x, double y, int size, int anchor,
+		  const char *s )
+{
+	static const char *anchors[] = { "", " text-anchor=\"middle\"", " text-anchor=\"end\"" };
+	const char *p;
+	long width = 0;
+
+	if (!d->pdf) {
+		put( d, "<text x=\"%.0f\" y=\"%.0f\" font-size=\"%d\"%s>%s</text>\n",
+		     x, y, size, anchors[anchor + 1], s );
+		return;
+	}
+	for (p = s; *p; p++)
+		width += ((*p >= ' ') && (*p <= '_')) ? helvetica[*p - ' '] : 556;
+	x -= (anchor + 1) * width * size / 2000.0;
+	put( d, "BT /Hv %d Tf 1 0 0 -1 %.0f %.0f Tm (%s) Tj ET\n", size, x, y, s );
+}
+
+/* where a column's center and a row's are, in mils; rows are 12, 11,
+   0 to 9 from the top */
+static double col_x( const struct card_geometry *g, int c )
+{
+	return 1000 * (g->col1 + c * g->col_pitch);
+}
+
+static double row_y( const struct card_geometry *g, int r )
+{
+	return 1000 * (g->row12 + r * g->row_pitch);
+}
+
+/* a rule down the card */
+static void rule( struct doc *d, double x, double top, double bottom )
+{
+	if (d->pdf)
+		put( d, "%.0f %.0f m %.0f %.0f l S\n", x, top, x, bottom );
+	else
+		put( d, "<path d=\"M%.0f %.0fV%.0f\" stroke=\"#3a3430\""
+		     " stroke-width=\"6\"/>\n", x, top, bottom );
+}
+
+/* a preprinted form's artwork */
+static void draw_form( struct doc *d, const struct card_geometry *g,
+		       const struct form *form )
+{
+	double top = row_y( g, 0 ) + 1000 * g->hole_height / 2;
+	double bottom = MIL( g->height ) - 60;
+	char number[8];
+	int c, r, k, i;
+
+	if ((form->print & DIGITS) && d->pdf) {
+		/* a row of one digit, spaced out to the columns */
+		double spacing = 1000 * g->col_pitch - DIGIT_SIZE * 0.556;
+		for (r = 2; r < 12; r++) {
+			put( d, "BT /Hv %d Tf %.1f Tc 1 0 0 -1 %.0f %.0f Tm (", DIGIT_SIZE,
+			     spacing, col_x( g, 0 ) - DIGIT_SIZE * 0.278,
+			     row_y( g, r ) + DIGIT_SIZE * 0.36 );
+			for (c = 0; c < 80; c++) put( d, "%d", r - 2 );
+			put( d, ") Tj 0 Tc ET\n" );
+		}
+	} else if (form->print & DIGITS) {
+		/* a column of the digits, from digits_def */
+		for (c = 0; c < 80; c++)
+			put( d, "<use xlink:href=\"#d\" x=\"%.0f\"/>\n", col_x( g, c ) );
+	}
+	for (c = 0; c < 80; c++) {
+		sprintf( number, "%d", c + 1 );
+		if (form->print & NUMBERS)
+			text( d, col_x( g, c ), (row_y( g, 2 ) + row_y( g, 3 )) / 2
+			      + NUMBER_SIZE * 0.36, NUMBER_SIZE, 0, number );
+		if (form->print & BOTTOM)
+			text( d, col_x( g, c ), row_y( g, 11 ) + 1000 * g->hole_height / 2
+			      + NUMBER_SIZE * 0.9, NUMBER_SIZE, 0, number );
+	}
+	if (form->legend != NULL)
+		text( d, MIL( g->width ) - 60, MIL( g->height ) - 25, LABEL_SIZE, 1,
+		      form->legend );
+
+	/* the fields: a rule between them, and their labels between the
+	   12s and the 11s */
+	for (k = 0; form->fields[k].first; k++) {
+		const struct field *f = &form->fields[k];
+		double mid = (col_x( g, f->first - 1 ) + col_x( g, f->last - 1 )) / 2;
+		double y = (row_y( g, 0 ) + row_y( g, 1 )) / 2 + LABEL_SIZE * 0.36;
+		int lines = (f->label[1] != NULL) ? 2 : 1;
+		for (i = 0; i < lines; i++)
+			if (f->label[i][0] != '\0')
+				text( d, mid, y + (i - (lines - 1) / 2.0) * LABEL_SIZE,
+				      LABEL_SIZE, 0, f->label[i] );
+		for (i = 0; i < 2; i++) {
+			int edge = i ? f->last : f->first - 1;
+			if ((edge > 0) && (edge < 80))
+				rule( d, col_x( g, edge ) - 1000 * g->col_pitch / 2,
+				      top, bottom );
+		}
+	}
+	for (c = 10; (form->print & TENS) && (c < 80); c += 10)
+		rule( d, col_x( g, c ) - 1000 * g->col_pitch / 2, top, bottom );
+}
+
+/* the digits 0 to 9 down a column centered at 0, once in an SVG */
+static void digits_def( struct doc *d, const struct card_geometry *g )
+{
+	int r;
+
+	put( d, "<g id=\"d\" font-family=\"Helvetica,Arial,sans-serif\""
+	     " fill=\"#3a3430\" font-size=\"%d\" text-anchor=\"middle\">\n",
+	     DIGIT_SIZE );
+	for (r = 2; r < 12; r++)
+		put( d, "<text y=\"%.0f\">%d</text>\n",
+		     row_y( g, r ) + DIGIT_SIZE * 0.36, r - 2 );
+	put( d, "</g>\n" );
+}
+
+/* a letter's dots, around its center */
+static void draw_letter( struct doc *d, const struct card_geometry *g, int ch )
+{
+	int x, y;
+
+	for (y = 0; y < 7; y++)
+		for (x = 0; x < 5; x++)
+			if (card_font[ch - ' '][y] & (020 >> x)) {
+				double px = (x - 2) * 1000 * g->dot_x - DOT / 2.0;
+				double py = (y - 3) * 1000 * g->dot_y - DOT / 2.0;
+				put( d, d->pdf ? "%.0f %.0f %d %d re " : "M%.0f %.0fh%dv%dh-%dz",
+				     px, py, DOT, DOT, DOT );
+			}
+	if (d->pdf) put( d, "f" );
+}
+
+/* what the deck uses, so it is drawn once */
+struct uses {
+	int forms[8];			/* PDF objects, or 1 for SVG */
+	int outlines[8];		/* by corner and cut */
+	int letters[64];
+};
+
+struct card {
+	uint16_t cols[80];
+	int color, round, cut, form, print;
+};
+
+static void card( const unsigned char *deck, long i, int print,
+		  struct card *k )
+{
+	int format = (deck[2] == '0') ? 80 : 82;
+	size_t card_bytes = (format == 80) ? 3 + 120 : 3 + 123;
+	const unsigned char *h = deck + 3 + i * card_bytes;
+	const unsigned char *p = h + 3;
+	uint16_t all[82];
+	int c;
+
+	for (c = 0; c < format; c += 2, p += 3) {
+		all[c] = (p[0] << 4) | (p[1] >> 4);
+		all[c + 1] = ((p[1] & 0017) << 8) | p[2];
+	}
+	memcpy( k->cols, all + ((format == 82) ? 1 : 0), sizeof k->cols );
+	k->color = (h[0] >> 3) & 017;
+	k->round = !((h[0] >> 2) & 1);
+	k->cut = h[0] & 3;
+	k->form = h[1] & 7;
+	k->print = (print < 0) ? ((h[1] >> 6) & 1) : print;
+}
+
+/* a card's own drawing; its top left is at 0, 0 */
+static void draw_card( struct doc *d, const struct card_geometry *g,
+		       const struct card *k, const struct card_codec *codec )
+{
+	const char *fill = colors[(k->color & 8) ? 0 : (k->color & 7)];
+	int shape = 2 * k->cut + k->round, c, r, ch, lastx = 0, lasty = 0, holes = 0, at;
+	int hw = MIL( g->hole_width ), hh = MIL( g->hole_height );
+	unsigned long rgb = strtoul( fill, NULL, 16 );
+
+	/* the card and its stripe */
+	if (d->pdf) {
+		put( d, "0.541 0.518 0.471 RG 5 w %.3f %.3f %.3f rg ", (rgb >> 16) / 255.0,
+		     ((rgb >> 8) & 0377) / 255.0, (rgb & 0377) / 255.0 );
+		outline( d, g, k->round, k->cut );
+		put( d, " B\n" );
+		if (k->color & 8) {
+			rgb = strtoul( stripes[k->color & 7], NULL, 16 );
+			put( d, "q " );
+			outline( d, g, k->round, k->cut );
+			put( d, " W n %.3f %.3f %.3f rg 0 0 %d 50 re f Q\n", (rgb >> 16) / 255.0,
+			     ((rgb >> 8) & 0377) / 255.0, (rgb & 0377) / 255.0,
+			     MIL( g->width ) );
+		}
+		if (forms[k->form].print || forms[k->form].fields[0].first)
+			put( d, "/Fm%d Do\n", k->form );
+		put( d, "0 g\n" );
+	} else {
+		put( d, "<use xlink:href=\"#o%d\" fill=\"#%s\"/>\n", shape, fill );
+		if (k->color & 8)
+			put( d, "<rect width=\"%d\" height=\"50\" fill=\"#%s\""
+			     " clip-path=\"url(#c%d)\"/>\n", MIL( g->width ),
+			     stripes[k->color & 7], shape );
+		if (forms[k->form].print || forms[k->form].fields[0].first)
+			put( d, "<use xlink:href=\"#f%d\"/>\n", k->form );
+	}
+
+	/* the holes, black; in PDF a column at a time, moved along from
+	   the last, so that the same few operators repeat and compress */
+	for (c = 0, at = 0; c < 80; c++) {
+		int x = (int)(col_x( g, c ) + 0.5), left = (hw + 1) / 2;
+		if (k->cols[c] == 0) continue;
+		if (d->pdf) put( d, "%s1 0 0 1 %d 0 cm", at ? "" : "q ", x - at );
+		for (r = 0; r < 12; r++) {
+			int y = (int)(row_y( g, r ) - hh / 2.0 + 0.5);
+			if (!(k->cols[c] & (1 << (11 - r)))) continue;
+			if (d->pdf)
+				put( d, " %d %d %d %d re", -left, y, hw, hh );
+			else if (holes == 0)
+				put( d, "<path d=\"M%d %dh%dv%dh-%dz", x - left, y, hw, hh, hw );
+			else
+				put( d, "m%d %dh%dv%dh-%dz", x - left - lastx, y - lasty,
+				     hw, hh, hw );
+			lastx = x - left;
+			lasty = y;
+			holes++;
+		}
+		if (d->pdf) put( d, " f\n" );
+		at = x;
+	}
+	if (holes > 0) put( d, d->pdf ? "Q\n" : "\"/>\n" );
+
+	/* its printing */
+	for (c = 0, at = 0; k->print && (c < 80); c++) {
+		int x = (int)(col_x( g, c ) + 1000 * g->print_x + 0.5);
+		int y = (int)(1000 * g->print_y + 0.5);
+		ch = card_decode( codec, k->cols[c] );
+		if ((ch <= ' ') || (ch > '_')) continue;
+		if (!d->pdf)
+			put( d, "<use xlink:href=\"#l%02X\" x=\"%d\" y=\"%d\"/>\n", ch, x, y );
+		else if (at == 0)
+			put( d, "q 1 0 0 1 %d %d cm /L%02X Do\n", x, y, ch );
+		else
+			put( d, "1 0 0 1 %d 0 cm /L%02X Do\n", x - at, ch );
+		at = x;
+	}
+	if (d->pdf && at) put( d, "Q\n" );
+}
+
+/* forms, outlines and letters the deck uses, numbered as PDF objects
+   from next, and how many objects that is */
+static int find_uses( const unsigned char *deck, long ncards, int print,
+		      const struct card_codec *codec, struct uses *u, int next )
+{
+	struct card k;
+	long i;
+	int c, n = 0;
+
+	memset( u, 0, sizeof *u );
+	for (i = 0; i < ncards; i++) {
+		card( deck, i, print, &k );
+		if ((forms[k.form].print || forms[k.form].fields[0].first)
+		 && !u->forms[k.form]) u->forms[k.form] = next + n++;
+		u->outlines[2 * k.cut + k.round] = 1;
+		for (c = 0; k.print && (c < 80); c++) {
+			int ch = card_decode( codec, k.cols[c] );
+			if ((ch > ' ') && (ch <= '_') && !u->letters[ch - ' '])
+				u->letters[ch - ' '] = next + n++;
+		}
+	}
+	return n;
+}
+
+static void write_svg( struct doc *d, const struct card_geometry *g,
+		       const unsigned char *deck, long ncards, int print,
+		       const struct card_codec *codec )
+{
+	struct uses u;
+	struct card k;
+	long i, height = ncards * (MIL( g->height ) + GAP) - GAP;
+	int s;
+
+	if (height < 0) height = 0;
+	find_uses( deck, ncards, print, codec, &u, 1 );
+	put( d, "<?xml version=\"1.0\" encoding=\"US-ASCII\"?>\n"
+	     "<svg xmlns=\"http://www.w3.org/2000/svg\""
+	     " xmlns:xlink=\"http://www.w3.org/1999/xlink\"\n"
+	     " width=\"%.3fin\" height=\"%.3fin\" viewBox=\"0 0 %d %ld\">\n<defs>\n",
+	     g->width, height / 1000.0, MIL( g->width ), height );
+	for (s = 0; s < 8; s++) {
+		if (!u.outlines[s]) continue;
+		put( d, "<path id=\"o%d\" stroke=\"#8a8478\" stroke-width=\"5\" d=\"", s );
+		outline( d, g, s & 1, s >> 1 );
+		put( d, "\"/>\n<clipPath id=\"c%d\"><use xlink:href=\"#o%d\"/></clipPath>\n",
+		     s, s );
+	}
+	for (s = 0; s < 8; s++)
+		if (u.forms[s] && (forms[s].print & DIGITS)) break;
+	if (s < 8) digits_def( d, g );
+	for (s = 0; s < 8; s++) {
+		if (!u.forms[s]) continue;
+		put( d, "<g id=\"f%d\" font-family=\"Helvetica,Arial,sans-serif\""
+		     " fill=\"#3a3430\">\n", s );
+		draw_form( d, g, &forms[s] );
+		put( d, "</g>\n" );
+	}
+	for (s = 1; s < 64; s++) {
+		if (!u.letters[s]) continue;
+		put( d, "<path id=\"l%02X\" d=\"", ' ' + s );
+		draw_letter( d, g, ' ' + s );
+		put( d, "\"/>\n" );
+	}
+	put( d, "</defs>\n" );
+	for (i = 0; (i < ncards) && (d->err == CARD_OK); i++) {
+		card( deck, i, print, &k );
+		put( d, "<g transform=\"translate(0 %ld)\">\n", i * (MIL( g->height ) + GAP) );
+		draw_card( d, g, &k, codec );
+		put( d, "</g>\n" );
+		drain( d );
+	}
+	put( d, "</svg>\n" );
+	drain( d );
+}
+
+/* objects: 1 the catalog, 2 the pages, 3 the font, 4 the resources
+   every page shares, then the forms and letters, then a content stream
+   and a page for each card */
+static void write_pdf( struct doc *d, const struct card_geometry *g,
+		       const unsigned char *deck, long ncards, int print,
+		       const struct card_codec *codec )
+{
+	static const char magic[] = "%PDF-1.4\n%\342\343\317\323\n";
+	struct uses u;
+	struct card k;
+	char dict[256];
+	long i, start;
+	int shared, first_page, s;
+
+	shared = find_uses( deck, ncards, print, codec, &u, 5 );
+	first_page = 5 + shared;
+	d->objects = first_page + 2 * ncards;
+	d->xref = calloc( d->objects, sizeof *d->xref );
+	if (d->xref == NULL) {
+		d->err = CARD_ENOMEM;
+		return;
+	}
+	flush( d, magic, sizeof magic - 1 );
+	object( d, 1 );
+	put( d, "<< /Type /Catalog /Pages 2 0 R >>\nendobj\n" );
+	object( d, 3 );
+	put( d, "<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica"
+	     " /Encoding /WinAnsiEncoding >>\nendobj\n" );
+	drain( d );
+
+	sprintf( dict, "/Type /XObject /Subtype /Form /BBox [0 0 %d %d]"
+		 " /Resources << /Font << /Hv 3 0 R >> >> ",
+		 MIL( g->width ), MIL( g->height ) );
+	for (s = 0; s < 8; s++) {
+		if (!u.forms[s]) continue;
+		put( d, "0.227 0.204 0.188 rg 0.227 0.204 0.188 RG 6 w\n" );
+		draw_form( d, g, &forms[s] );
+		stream( d, u.forms[s], dict );
+	}
+	sprintf( dict, "/Type /XObject /Subtype /Form /BBox [-50 -60 50 60] " );
+	for (s = 1; s < 64; s++) {
+		if (!u.letters[s]) continue;
+		draw_letter( d, g, ' ' + s );
+		stream( d, u.letters[s], dict );
+	}
+	object( d, 4 );
+	put( d, "<< /Font << /Hv 3 0 R >> /XObject <<" );
+	for (s = 0; s < 8; s++)
+		if (u.forms[s]) put( d, " /Fm%d %d 0 R", s, u.forms[s] );
+	for (s = 1; s < 64; s++)
+		if (u.letters[s]) put( d, " /L%02X %d 0 R", ' ' + s, u.letters[s] );
+	put( d, " >> >>\nendobj\n" );
+	drain( d );
+
+	for (i = 0; (i < ncards) && (d->err == CARD_OK); i++) {
+		int content = first_page + 2 * i;
+		card( deck, i, print, &k );
+		put( d, "0.072 0 0 -0.072 0 %.3f cm\n", 72 * g->height );
+		draw_card( d, g, &k, codec );
+		stream( d, content, "" );
+		object( d, content + 1 );
+		put( d, "<< /Type /Page /Parent 2 0 R /MediaBox [0 0 %.3f %.3f]"
+		     " /Resources 4 0 R /Contents %d 0 R >>\nendobj\n",
+		     72 * g->width, 72 * g->height, content );
+		drain( d );
+	}
+
+	object( d, 2 );
+	put( d, "<< /Type /Pages /Count %ld /Kids [", ncards );
+	for (i = 0; i < ncards; i++) put( d, " %ld 0 R", first_page + 2 * i + 1 );
+	put( d, " ] >>\nendobj\n" );
+	drain( d );
+
+	start = d->pos;
+	put( d, "xref\n0 %d\n0000000000 65535 f \n", d->objects );
+	for (s = 1; s < d->objects; s++) put( d, "%010ld 00000 n \n", d->xref[s] );
+	put( d, "trailer\n<< /Size %d /Root 1 0 R >>\nstartxref\n%ld\n%%%%EOF\n",
+	     d->objects, start );
+	drain( d );
+}
+
+static void usage( const char *progname )
+{
+	fprintf( stderr, "\n%s [options] [deck]\n\n", progname );
+	fprintf( stderr,
+	"Draw a deck as real cards, with their preprinted forms, in SVG or\n"
+	"PDF for printing.  If the deck is missing, read it from stdin.\n"
+	"The options are:\n\n"
+	" -out file       where to write it (stdout)\n"
+	" -pdf            write PDF, a page a card (SVG default; a -out\n"
+	"                 file ending .pdf is PDF)\n"
+	" -print          print every card along its top\n"
+	" -noprint        print none (those interpreted, by default)\n"
+	" -v              report the time and size on stderr\n\n"
+	" -026comm        the keypunch, for printing\n"
+	" -029 -026ftn    (029 default)\n"
+	" -EBCDIC\n\n"
+	);
+	exit(-1);
+}
+
+int main( int argc, char *argv[] )
+{
+	const struct card_geometry *g = &card_geometry_ibm;
+	struct card_options opt;
+	struct card_codec codec;
+	struct doc d;
+	const char *out = NULL;
+	unsigned char *deck;
+	FILE *in = stdin;
+	size_t len;
+	long ncards;
+	double start;
+	int pdf = 0, print = -1, verbose = 0;
+	int arg = 1, err;
+
+	card_options_init( &opt );
+	while ((arg < argc) && (argv[arg][0] == '-')) { /* command line arg */
+		if (card_list_option( &opt, argv[arg] )) {
+			/* the keypunch */
+		} else if ((strcmp(argv[arg],"-out") == 0) && (arg + 1 < argc)) {
+			out = argv[++arg];
+			len = strlen( out );
+			if ((len > 4) && (strcmp( out + len - 4, ".pdf" ) == 0)) pdf = 1;
+		} else if (strcmp(argv[arg],"-pdf") == 0) {
+			pdf = 1;
+		} else if (strcmp(argv[arg],"-print") == 0) {
+			print = 1;
+		} else if (strcmp(argv[arg],"-noprint") == 0) {
+			print = 0;
+		} else if (strcmp(argv[arg],"-v") == 0) {
+			verbose = 1;
+		} else if (strcmp(argv[arg],"-help") == 0) {
+			usage( argv[0] );
+		} else {
+			fprintf( stderr, "%s: unknown option %s;"
+					 " -help available\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+		arg++;
+	}
+	if ( (argc - arg) > 1 ) { /* too many arguments */
+		fprintf( stderr, "%s: too many arguments\n", argv[0] );
+		exit(-1);
+	}
+	if ( (argc - arg) == 1 ) {
+		in = fopen( argv[arg], "rb" );
+		if (in == NULL) {
+			fprintf( stderr, "%s %s: invalid card file\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+	}
+	deck = read_all( in, &len );
+	if (deck == NULL) {
+		fprintf( stderr, "%s: out of memory\n", argv[0] );
+		exit(-1);
+	}
+	err = card_validate_buffer( deck, len, &ncards );
+	if (err != CARD_OK) {
+		fprintf( stderr, "%s: %s\n", argv[0], card_strerror( err ) );
+		exit(-1);
+	}
+	card_codec_init( &codec, &opt );
+
+	memset( &d, 0, sizeof d );
+	d.pdf = pdf;
+	d.f = stdout;
+	if (out != NULL) {
+		d.f = fopen( out, "wb" );
+		if (d.f == NULL) {
+			fprintf( stderr, "%s %s: cannot create\n", argv[0], out );
+			exit(-1);
+		}
+	}
+	start = now();
+	if (pdf)
+		write_pdf( &d, g, deck, ncards, print, &codec );
+	else
+		write_svg( &d, g, deck, ncards, print, &codec );
+	if ((d.err == CARD_OK) && (fflush( d.f ) != 0)) d.err = CARD_EIO;
+	if (d.err != CARD_OK) {
+		fprintf( stderr, "%s: %s\n", argv[0], card_strerror( d.err ) );
+		exit(-1);
+	}
+	if (d.f != stdout) fclose( d.f );
+	if (verbose)
+		fprintf( stderr, "%ld cards, %ld bytes of %s, in %.3f s\n", ncards,
+			 d.pos, pdf ? "PDF" : "SVG", now() - start );
+	exit(0);
+}
@@ -0,0 +1,126 @@
+/* ebcdic.c -- EBCDIC bytes, card punches and ASCII.
+ *
+ * The punches follow the System/360 card code.  It is nearly regular:
+ * the low four bits of the byte give the digit punches, the next two
+ * pick zone punches, and the top two say whether a 9 punch, an 8 punch
+ * or a double zone goes with them.  The exceptions, where the regular
+ * code would collide or where a common character was given a simpler
+ * code, are listed as such below.
+ *
+ * The reverse tables are built on first use, once, from the forward
+ * code and from the cardmake EBCDIC table.
+ *
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include "ebcdic.h"
+#include "cardcodec.h"
+
+#define R8	00002
+#define R9	00001
+#define PUNCH( digit )	(01000 >> (digit))	/* rows 1-9 */
+
+/* zone punches for bits 2-3 of the byte, single and double */
+static const int zone1[4] = { 04000, 02000, 01000, 00000 };
+static const int zone2[4] = { 05000, 06000, 03000, 07000 };
+
+int ebcdic_to_hollerith( int byte )
+{
+	int z = (byte >> 4) & 3, low = byte & 15;
+
+	switch ((byte >> 6) & 3) {
+	case 0: /* 00-3F, controls: a 9 punch */
+		if (low == 0) return zone2[z] | R9 | R8 | PUNCH(1);
+		if (low <= 7) return zone1[z] | R9 | PUNCH(low);
+		if (low == 8) return zone1[z] | R9 | R8;
+		if (low == 9) return zone1[z] | R9 | R8 | PUNCH(1);
+		return zone1[z] | R9 | R8 | PUNCH(low - 8);
+
+	case 1: /* 40-7F, specials */
+		if (low == 0) {
+			static const int first[4] = { 00000, 04000, 02000, 07000 };
+			return first[z];		/* blank & - */
+		}
+		if (byte == 0x61) return 01000 | PUNCH(1);	/* / */
+		if (byte == 0x6A) return 06000;			/* 12-11 */
+		if (low <= 7) return zone2[z] | R9 | PUNCH(low);
+		if (low == 8) return zone2[z] | R9 | R8;
+		if (low == 9) return zone1[z] | R8 | PUNCH(1);
+		return zone1[z] | R8 | PUNCH(low - 8);
+
+	case 2: /* 80-BF, lower case: a double zone */
+		if (low == 0) return zone2[z] | R8 | PUNCH(1);
+		if (low <= 9) return zone2[z] | PUNCH(low);
+		return zone2[z] | R8 | PUNCH(low - 8);
+
+	default: /* C0-FF, upper case and digits */
+		if (low == 0) {
+			static const int first[4] = {
+				05000, 03000, 01000 | R8 | PUNCH(2), 01000
+			};
+			return first[z];		/* { } \ 0 */
+		}
+		if (byte == 0xE1) return 03000 | R9 | PUNCH(1); /* 11-0-9-1 */
+		if (low <= 9) return zone1[z] | PUNCH(low);
+		return zone2[z] | R9 | R8 | PUNCH(low - 8);
+	}
+}
+
+static int16_t from_hollerith[4096];
+static uint8_t to_ascii[256];
+static uint8_t from_ascii[128];
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+static void build( void )
+{
+	struct card_options opt;
+	struct card_codec codec;
+	int i;
+
+	for (i = 0; i < 4096; i++) from_hollerith[i] = -1;
+	for (i = 0; i < 256; i++) {
+		from_hollerith[ebcdic_to_hollerith( i )] = i;
+		to_ascii[i] = ' ';
+	}
+
+	/* whatever cardmake -EBCDIC punches for a character */
+	card_options_init( &opt );
+	opt.table = CARD_EBCDIC;
+	card_codec_init( &codec, &opt );
+	for (i = 0; i < 128; i++) {
+		int col = card_encode( &codec, i );
+		from_ascii[i] = 0x40;
+		if ((col == CARD_ILLEGAL) || (from_hollerith[col] < 0)) continue;
+		from_ascii[i] = from_hollerith[col];
+		to_ascii[from_hollerith[col]] = i;
+	}
+
+	/* the table has no punches for these; use their code page 037
+	   bytes, but the broken bar for |, since the table gives 4F to ^ */
+	for (i = 0; i < 5; i++) {
+		static const char ascii[] = "{}`~|";
+		static const uint8_t byte[] = { 0xC0, 0xD0, 0x79, 0xA1, 0x6A };
+		from_ascii[(int)ascii[i]] = byte[i];
+		to_ascii[byte[i]] = ascii[i];
+	}
+	to_ascii[0x40] = ' ';
+}
+
+int ebcdic_from_hollerith( int col )
+{
+	pthread_once( &once, build );
+	return from_hollerith[col & 07777];
+}
+
+int ebcdic_to_ascii( int byte )
+{
+	pthread_once( &once, build );
+	return to_ascii[byte & 0xFF];
+}
+
+int ebcdic_from_ascii( int ch )
+{
+	pthread_once( &once, build );
+	return (ch & ~0177) ? 0x40 : from_ascii[ch];
+}
@@ -0,0 +1,21 @@
+/* ebcdic.h -- EBCDIC bytes, card punches and ASCII.
+ *
+ * Every one of the 256 EBCDIC bytes has its own combination of punches,
+ * so binary data, such as the text of an object deck, can be punched
+ * and read back.  The ASCII side agrees with cardmake -EBCDIC: a
+ * character cardmake punches reads back as the byte with those punches.
+ *
+ * Columns are 12-bit card codes as in cardcode.i, row 12 in 04000 down
+ * to row 9 in 00001.
+ *
+ */
+
+#ifndef EBCDIC_H
+#define EBCDIC_H
+
+int ebcdic_to_hollerith( int byte );
+int ebcdic_from_hollerith( int col );	/* -1 if no byte has these punches */
+int ebcdic_to_ascii( int byte );	/* blank if there is no character */
+int ebcdic_from_ascii( int ch );	/* 0x40, blank, if there is no byte */
+
+#endif /* EBCDIC_H */
@@ -0,0 +1,190 @@
+/* ftn.h -- FORTRAN deck compiler and bytecode machine.
+ *
+ * A deck is a FORTRAN program, in fixed form, followed by its data
+ * cards.  Columns 1-5 of a program card hold the statement label,
+ * column 6 marks a continuation, 7-72 hold the statement and 73-80 are
+ * ignored; a C or * in column 1 makes a comment.  The program ends at
+ * its END card, and the cards after it are read by READ statements.
+ *
+ * The language is a FORTRAN II/IV subset: INTEGER and REAL scalars and
+ * arrays of one or two dimensions, implicit typing, DIMENSION, INTEGER,
+ * REAL, assignment, GO TO, computed GO TO, arithmetic and logical IF,
+ * DO, CONTINUE, STOP, PAUSE, END, READ, WRITE and PRINT with FORMAT or
+ * list directed, implied DO in I/O lists, and the common intrinsic
+ * functions.  There are no subprograms, COMMON or EQUIVALENCE.
+ *
+ * The compiler turns a program into code for a register machine: every
+ * variable, constant and temporary has its own register, and most
+ * instructions take two registers and put the result in a third.
+ * Constant subexpressions are folded as they are parsed, and in each
+ * DO loop, subexpressions whose operands the loop never changes are
+ * computed once, ahead of it.
+ *
+ * A compiled program is position independent: a few flat arrays that
+ * can be written out and read back as they are.
+ *
+ */
+
+#ifndef FTN_H
+#define FTN_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "cardcodec.h"
+#include "spool.h"
+
+#define FTN_COLUMNS	80	/* characters in a card */
+#define FTN_RECORD	136	/* characters in a printed line */
+
+/* a deck, one blank padded, NUL terminated string per card */
+struct ftn_deck {
+	char (*card)[FTN_COLUMNS + 1];
+	long ncards;
+};
+
+union ftn_value {
+	int32_t i;
+	double f;
+};
+
+/* operations; a, b and c are registers unless it says otherwise */
+#define FTN_MOV		0	/* a = b */
+#define FTN_IADD	1	/* a = b + c, and so on, in integer */
+#define FTN_ISUB	2
+#define FTN_IMUL	3
+#define FTN_IDIV	4
+#define FTN_IMOD	5
+#define FTN_IPOW	6
+#define FTN_INEG	7	/* a = -b */
+#define FTN_FADD	8	/* a = b + c, and so on, in real */
+#define FTN_FSUB	9
+#define FTN_FMUL	10
+#define FTN_FDIV	11
+#define FTN_FMOD	12
+#define FTN_FPOW	13
+#define FTN_FPOWI	14	/* real b to the integer c */
+#define FTN_FNEG	15
+#define FTN_ITOF	16	/* a = FLOAT(b) */
+#define FTN_FTOI	17	/* a = IFIX(b) */
+#define FTN_IEQ		18	/* a = 1 if b .EQ. c, else 0, and so on */
+#define FTN_INE		19
+#define FTN_ILT		20
+#define FTN_ILE		21
+#define FTN_IGT		22
+#define FTN_IGE		23
+#define FTN_FEQ		24
+#define FTN_FNE		25
+#define FTN_FLT		26
+#define FTN_FLE		27
+#define FTN_FGT		28
+#define FTN_FGE		29
+#define FTN_AND		30
+#define FTN_OR		31
+#define FTN_NOT		32
+#define FTN_IABS	33
+#define FTN_FABS	34
+#define FTN_IMAX	35
+#define FTN_IMIN	36
+#define FTN_FMAX	37
+#define FTN_FMIN	38
+#define FTN_ISIGN	39
+#define FTN_FSIGN	40
+#define FTN_SQRT	41
+#define FTN_SIN		42
+#define FTN_COS		43
+#define FTN_TAN		44
+#define FTN_ATAN	45
+#define FTN_EXP		46
+#define FTN_LOG		47
+#define FTN_LOG10	48
+#define FTN_ALOAD	49	/* a = array b (c) */
+#define FTN_ASTORE	50	/* array b (c) = a */
+#define FTN_JMP		51	/* go to a */
+#define FTN_JZ		52	/* go to c if a is zero */
+#define FTN_IIF		53	/* go to b if a < 0, c if a = 0 */
+#define FTN_FIF		54
+#define FTN_CGOTO	55	/* take jump a of the b jumps that follow */
+#define FTN_LOOP	56	/* a += b+1, go to c if not past b */
+#define FTN_WBEGIN	57	/* start a record, format a or -1 for * */
+#define FTN_WINT	58	/* put a */
+#define FTN_WREAL	59
+#define FTN_WEND	60
+#define FTN_RBEGIN	61	/* read a card, format a or -1 for * */
+#define FTN_RINT	62	/* get a */
+#define FTN_RREAL	63
+#define FTN_REND	64
+#define FTN_WTEXT	65	/* put text a, b characters, list directed */
+#define FTN_PAUSE	66
+#define FTN_STOP	67
+#define FTN_NOPS	68
+
+struct ftn_insn {
+	int32_t op;
+	int32_t a, b, c;	/* registers, or code addresses */
+};
+
+struct ftn_array {
+	int32_t base;		/* first element in array storage */
+	int32_t size;		/* elements */
+};
+
+/* one FORMAT edit descriptor */
+struct ftn_item {
+	int32_t kind;		/* I F E X H or / */
+	int32_t repeat;
+	int32_t w, d;		/* width and decimals; H: text and length */
+};
+
+struct ftn_format {
+	int32_t first, count;	/* range of items */
+	int32_t revert;		/* where reuse starts: the last outer group */
+};
+
+struct ftn_program {
+	struct ftn_insn *code;
+	int32_t *card;		/* the card each instruction came from */
+	int32_t ncode;
+	union ftn_value *init;	/* registers, with constants filled in */
+	int32_t nregs;
+	struct ftn_array *arrays;
+	int32_t narrays;
+	int32_t memsize;	/* array storage, in elements */
+	struct ftn_item *items;
+	int32_t nitems;
+	struct ftn_format *formats;
+	int32_t nformats;
+	char *text;		/* of H and '' in FORMATs, and quoted output */
+	int32_t ntext;
+
+	/* what the optimizer did */
+	int32_t folded;		/* operations done at compile time */
+	int32_t hoisted;	/* expressions moved out of loops */
+
+	char error[160];	/* why compiling failed */
+};
+
+/* the state of one run */
+struct ftn_run {
+	FILE *out;			/* WRITE and PRINT */
+	struct spool *spool;		/* or, if not NULL, print on it,
+					   column 1 carriage control */
+	const struct ftn_deck *deck;	/* READ takes data cards from it */
+	long next_card;			/* starting after the END card */
+	long long limit;		/* instructions, or 0 for no limit */
+	long max_lines;			/* lines written, or 0 for no limit */
+	long long count;		/* instructions executed */
+	long lines;			/* lines written */
+	char error[160];		/* why running failed */
+};
+
+int ftn_read_deck( struct ftn_deck *deck, const unsigned char *buf,
+		   size_t len, const struct card_codec *codec );
+void ftn_free_deck( struct ftn_deck *deck );
+long ftn_program_cards( const struct ftn_deck *deck );
+
+int ftn_compile( struct ftn_program *prog, const struct ftn_deck *deck,
+		 long ncards );
+void ftn_free( struct ftn_program *prog );
+int ftn_run( const struct ftn_program *prog, struct ftn_run *run );
+
+#endif /* FTN_H */
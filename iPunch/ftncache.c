@@ -0,0 +1,349 @@
+/* ftncache.c -- compiled FORTRAN programs, kept on disk by content.
+ *
+ * see ftncache.h
+ *
+ * The key is two 64-bit FNV-1a hashes of the program cards, started
+ * from different offsets and each finished with a mixing step.  It is
+ * not meant to stand up to someone making collisions on purpose, only
+ * to tell decks apart; the key is checked again in the file's header,
+ * and the payload has a hash of its own so a damaged file is a miss.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "ftncache.h"
+
+#define FNV_PRIME	0x100000001b3ULL
+#define FNV_OFFSET	0xcbf29ce484222325ULL
+#define MAXCOUNT	(1 << 26)	/* sanity limit on a loaded array */
+
+#ifdef __APPLE__
+#define MTIME( st )	((st).st_mtimespec.tv_sec * 1000000000LL \
+			 + (st).st_mtimespec.tv_nsec)
+#else
+#define MTIME( st )	((st).st_mtim.tv_sec * 1000000000LL \
+			 + (st).st_mtim.tv_nsec)
+#endif
+
+struct header {
+	char magic[4];		/* FTNC */
+	int32_t version;
+	unsigned char key[FTN_KEY];
+	int32_t ncode, nregs, narrays, memsize;
+	int32_t nitems, nformats, ntext;
+	int32_t folded, hoisted;
+	uint64_t check;		/* FNV-1a of the payload */
+};
+
+static uint64_t fnv( uint64_t h, const void *data, size_t len )
+{
+	const unsigned char *p = data;
+
+	while (len-- > 0) {
+		h ^= *p++;
+		h *= FNV_PRIME;
+	}
+	return h;
+}
+
+/* the finishing step of splitmix64 */
+static uint64_t mix( uint64_t h )
+{
+	h ^= h >> 30;
+	h *= 0xbf58476d1ce4e5b9ULL;
+	h ^= h >> 27;
+	h *= 0x94d049bb133111ebULL;
+	return h ^ (h >> 31);
+}
+
+void ftn_key( const struct ftn_deck *deck, long ncards,
+	      unsigned char key[FTN_KEY] )
+{
+	uint64_t h[2] = { FNV_OFFSET, FNV_OFFSET ^ 0x9e3779b97f4a7c15ULL };
+	int32_t head[2] = { FTN_CACHE_VERSION, (int32_t)ncards };
+	long i;
+	int lane, b;
+
+	for (lane = 0; lane < 2; lane++) {
+		h[lane] = fnv( h[lane], head, sizeof head );
+		for (i = 0; i < ncards; i++)
+			h[lane] = fnv( h[lane], deck->card[i], 72 );
+		h[lane] = mix( h[lane] + lane );
+		for (b = 0; b < 8; b++)
+			key[lane * 8 + b] = (unsigned char)(h[lane] >> (56 - 8 * b));
+	}
+}
+
+/* the program's arrays, in the order they are written */
+#define SECTIONS( prog ) { \
+	{ (prog)->code, sizeof *(prog)->code, (prog)->ncode }, \
+	{ (prog)->card, sizeof *(prog)->card, (prog)->ncode }, \
+	{ (prog)->init, sizeof *(prog)->init, (prog)->nregs }, \
+	{ (prog)->arrays, sizeof *(prog)->arrays, (prog)->narrays }, \
+	{ (prog)->items, sizeof *(prog)->items, (prog)->nitems }, \
+	{ (prog)->formats, sizeof *(prog)->formats, (prog)->nformats }, \
+	{ (prog)->text, 1, (prog)->ntext } }
+
+struct section {
+	void *data;
+	size_t size;
+	size_t count;
+};
+
+#define NSECTIONS	7
+
+int ftn_save( const struct ftn_program *prog, const unsigned char *key,
+	      FILE *f )
+{
+	struct section sec[NSECTIONS] = SECTIONS( prog );
+	struct header h;
+	int i;
+
+	memset( &h, 0, sizeof h );
+	memcpy( h.magic, "FTNC", 4 );
+	h.version = FTN_CACHE_VERSION;
+	memcpy( h.key, key, FTN_KEY );
+	h.ncode = prog->ncode;
+	h.nregs = prog->nregs;
+	h.narrays = prog->narrays;
+	h.memsize = prog->memsize;
+	h.nitems = prog->nitems;
+	h.nformats = prog->nformats;
+	h.ntext = prog->ntext;
+	h.folded = prog->folded;
+	h.hoisted = prog->hoisted;
+	h.check = FNV_OFFSET;
+	for (i = 0; i < NSECTIONS; i++)
+		h.check = fnv( h.check, sec[i].data, sec[i].size * sec[i].count );
+
+	if (fwrite( &h, sizeof h, 1, f ) != 1) return -1;
+	for (i = 0; i < NSECTIONS; i++) {
+		if (sec[i].count == 0) continue;
+		if (fwrite( sec[i].data, sec[i].size, sec[i].count, f )
+		    != sec[i].count) return -1;
+	}
+	return (fflush( f ) == 0) ? 0 : -1;
+}
+
+int ftn_load( struct ftn_program *prog, const unsigned char *key,
+	      FILE *f )
+{
+	struct header h;
+	uint64_t check = FNV_OFFSET;
+	int i;
+
+	memset( prog, 0, sizeof *prog );
+	if ((fread( &h, sizeof h, 1, f ) != 1)
+	 || (memcmp( h.magic, "FTNC", 4 ) != 0)
+	 || (h.version != FTN_CACHE_VERSION)
+	 || (memcmp( h.key, key, FTN_KEY ) != 0)) return -1;
+	if ((h.ncode < 1) || (h.ncode > MAXCOUNT)
+	 || (h.nregs < 0) || (h.nregs > MAXCOUNT)
+	 || (h.narrays < 0) || (h.narrays > MAXCOUNT)
+	 || (h.memsize < 0) || (h.memsize > MAXCOUNT)
+	 || (h.nitems < 0) || (h.nitems > MAXCOUNT)
+	 || (h.nformats < 0) || (h.nformats > MAXCOUNT)
+	 || (h.ntext < 0) || (h.ntext > MAXCOUNT)) return -1;
+
+	prog->ncode = h.ncode;
+	prog->nregs = h.nregs;
+	prog->narrays = h.narrays;
+	prog->memsize = h.memsize;
+	prog->nitems = h.nitems;
+	prog->nformats = h.nformats;
+	prog->ntext = h.ntext;
+	prog->folded = h.folded;
+	prog->hoisted = h.hoisted;
+	prog->code = malloc( h.ncode * sizeof *prog->code );
+	prog->card = malloc( h.ncode * sizeof *prog->card );
+	prog->init = malloc( (h.nregs + 1) * sizeof *prog->init );
+	prog->arrays = malloc( (h.narrays + 1) * sizeof *prog->arrays );
+	prog->items = malloc( (h.nitems + 1) * sizeof *prog->items );
+	prog->formats = malloc( (h.nformats + 1) * sizeof *prog->formats );
+	prog->text = malloc( h.ntext + 1 );
+	{
+		struct section sec[NSECTIONS] = SECTIONS( prog );
+		for (i = 0; i < NSECTIONS; i++) {
+			if ((sec[i].data == NULL)
+			 || (fread( sec[i].data, sec[i].size, sec[i].count, f )
+			     != sec[i].count)) {
+				ftn_free( prog );
+				return -1;
+			}
+			check = fnv( check, sec[i].data,
+				     sec[i].size * sec[i].count );
+		}
+	}
+	if ((check != h.check) || (fgetc( f ) != EOF)) {
+		ftn_free( prog );
+		return -1;
+	}
+	return 0;
+}
+
+int ftn_cache_open( struct ftn_cache *cache, const char *dir,
+		    long long budget )
+{
+	memset( cache, 0, sizeof *cache );
+	if (strlen( dir ) + 2 * FTN_KEY + 32 > sizeof cache->dir) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	strcpy( cache->dir, dir );
+	cache->budget = budget;
+	if ((mkdir( dir, 0777 ) != 0) && (errno != EEXIST)) return -1;
+	return 0;
+}
+
+struct entry {
+	char name[2 * FTN_KEY + 8];
+	long long size;
+	long long mtime;
+};
+
+static int is_entry( const char *name )
+{
+	size_t len = strlen( name );
+
+	return (len == 2 * FTN_KEY + 4) && (strcmp( name + 2 * FTN_KEY, ".ftn" ) == 0);
+}
+
+/* the files in the cache; *n of them, in a new array */
+static struct entry *scan( const struct ftn_cache *cache, long *n )
+{
+	struct entry *list = NULL;
+	long max = 0;
+	struct dirent *d;
+	DIR *dir = opendir( cache->dir );
+
+	*n = 0;
+	if (dir == NULL) return NULL;
+	while ((d = readdir( dir )) != NULL) {
+		char path[sizeof cache->dir + 64];
+		struct stat st;
+
+		if (!is_entry( d->d_name )) continue;
+		snprintf( path, sizeof path, "%s/%s", cache->dir, d->d_name );
+		if (stat( path, &st ) != 0) continue;
+		if (*n == max) {
+			struct entry *more;
+			max = max ? max * 2 : 64;
+			more = realloc( list, max * sizeof *list );
+			if (more == NULL) break;
+			list = more;
+		}
+		strcpy( list[*n].name, d->d_name );
+		list[*n].size = st.st_size;
+		list[*n].mtime = MTIME( st );
+		(*n)++;
+	}
+	closedir( dir );
+	return list;
+}
+
+static int by_age( const void *a, const void *b )
+{
+	const struct entry *x = a, *y = b;
+
+	return (x->mtime > y->mtime) - (x->mtime < y->mtime);
+}
+
+/* remove the least recently used files, sparing keep, until under budget */
+static void evict( struct ftn_cache *cache, const char *keep )
+{
+	struct entry *list;
+	long long total = 0;
+	long n, i;
+
+	if (cache->budget <= 0) return;
+	list = scan( cache, &n );
+	for (i = 0; i < n; i++) total += list[i].size;
+	if (total > cache->budget) {
+		qsort( list, n, sizeof *list, by_age );
+		for (i = 0; (i < n) && (total > cache->budget); i++) {
+			char path[sizeof cache->dir + 64];
+
+			if (strcmp( list[i].name, keep ) == 0) continue;
+			snprintf( path, sizeof path, "%s/%s", cache->dir,
+				  list[i].name );
+			if (unlink( path ) != 0) continue;
+			total -= list[i].size;
+			cache->evictions++;
+			cache->evicted_bytes += list[i].size;
+		}
+	}
+	free( list );
+}
+
+static void store( struct ftn_cache *cache, const struct ftn_program *prog,
+		   const unsigned char *key, const char *name )
+{
+	char path[sizeof cache->dir + 64], tmp[sizeof cache->dir + 96];
+	FILE *f;
+	int err;
+
+	snprintf( path, sizeof path, "%s/%s", cache->dir, name );
+	snprintf( tmp, sizeof tmp, "%s/%s.%ld.tmp", cache->dir, name,
+		  (long)getpid() );
+	f = fopen( tmp, "wb" );
+	if (f == NULL) return;
+	err = ftn_save( prog, key, f );
+	if (fclose( f ) != 0) err = -1;
+	if ((err != 0) || (rename( tmp, path ) != 0)) {
+		unlink( tmp );
+		return;
+	}
+	cache->stores++;
+	evict( cache, name );
+}
+
+/* like ftn_compile, but from the cache when the program is there */
+int ftn_cache_compile( struct ftn_cache *cache, struct ftn_program *prog,
+		       const struct ftn_deck *deck, long ncards )
+{
+	unsigned char key[FTN_KEY];
+	char name[2 * FTN_KEY + 8], path[sizeof cache->dir + 64];
+	FILE *f;
+	int i;
+
+	ftn_key( deck, ncards, key );
+	for (i = 0; i < FTN_KEY; i++)
+		sprintf( cache->last_key + 2 * i, "%02x", key[i] );
+	snprintf( name, sizeof name, "%s.ftn", cache->last_key );
+	snprintf( path, sizeof path, "%s/%s", cache->dir, name );
+
+	f = fopen( path, "rb" );
+	if (f != NULL) {
+		int loaded = ftn_load( prog, key, f );
+		fclose( f );
+		if (loaded == 0) {
+			utimensat( AT_FDCWD, path, NULL, 0 );
+			cache->hits++;
+			cache->last_hit = 1;
+			return 0;
+		}
+	}
+	cache->misses++;
+	cache->last_hit = 0;
+	if (ftn_compile( prog, deck, ncards ) < 0) return -1;
+	store( cache, prog, key, name );
+	return 0;
+}
+
+void ftn_cache_usage( const struct ftn_cache *cache, long *files,
+		      long long *bytes )
+{
+	struct entry *list = scan( cache, files );
+	long i;
+
+	*bytes = 0;
+	for (i = 0; i < *files; i++) *bytes += list[i].size;
+	free( list );
+}
@@ -0,0 +1,59 @@
+/* ftncache.h -- compiled FORTRAN programs, kept on disk by content.
+ *
+ * Decks are often run again with only their data cards changed.  The
+ * cache keys a compiled program by a hash of its program cards,
+ * columns 1-72 of every card through END, so a new data section or new
+ * sequence numbers in 73-80 find the program already compiled and the
+ * compiler is skipped.  Comment cards are part of the key, since they
+ * shift the card numbers that runtime errors report.
+ *
+ * Each program is a file named by its key in the cache directory,
+ * written to a temporary name and renamed, so that runs sharing the
+ * directory never see half a file.  A hit sets the file's time, and
+ * when a store takes the directory over its byte budget the files used
+ * least recently are removed until it fits.
+ *
+ * The file holds the program's arrays as they are in memory, in host
+ * byte order, after a header with the key and FTN_CACHE_VERSION; a
+ * file from another version, or one that does not check, is a miss.
+ *
+ */
+
+#ifndef FTNCACHE_H
+#define FTNCACHE_H
+
+#include <stdio.h>
+#include "ftn.h"
+
+#define FTN_CACHE_VERSION	1	/* change with the instruction set */
+#define FTN_KEY			16	/* bytes in a key */
+
+struct ftn_cache {
+	char dir[1024];
+	long long budget;	/* bytes on disk, or 0 for no limit */
+
+	/* what this cache has seen */
+	long hits, misses;
+	long stores;		/* programs written */
+	long evictions;		/* files removed to keep to the budget */
+	long long evicted_bytes;
+	int last_hit;		/* the last ftn_cache_compile was a hit */
+	char last_key[2 * FTN_KEY + 1];	/* and its key, in hex */
+};
+
+void ftn_key( const struct ftn_deck *deck, long ncards,
+	      unsigned char key[FTN_KEY] );
+
+int ftn_save( const struct ftn_program *prog, const unsigned char *key,
+	      FILE *f );
+int ftn_load( struct ftn_program *prog, const unsigned char *key,
+	      FILE *f );
+
+int ftn_cache_open( struct ftn_cache *cache, const char *dir,
+		    long long budget );
+int ftn_cache_compile( struct ftn_cache *cache, struct ftn_program *prog,
+		       const struct ftn_deck *deck, long ncards );
+void ftn_cache_usage( const struct ftn_cache *cache, long *files,
+		      long long *bytes );
+
+#endif /* FTNCACHE_H */
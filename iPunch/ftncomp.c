@@ -0,0 +1,1934 @@
+/* ftncomp.c -- FORTRAN deck compiler.
+ *
+ * see ftn.h
+ *
+ * Each statement is gathered from its cards, squeezed free of blanks,
+ * as the old compilers did, and parsed into a tree.  Constants are
+ * folded as the trees are built.  Code is generated once the whole
+ * program has been parsed, so that at each DO the statements of its
+ * range can be searched for the variables the loop changes; any
+ * subtree that uses none of them is computed ahead of the loop and
+ * left in a register of its own, unless it could stop the run: it may
+ * be one the loop never reaches, or reaches only when an IF is true.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include "ftn.h"
+#include "cardconv.h"
+
+#define MAXSTMT		(66 * 20)	/* 19 continuation cards */
+#define MAXNAME		6
+#define MAXMEM		(16 << 20)	/* elements of array storage */
+#define ARENA		65536
+
+/* expression trees */
+#define N_CONST		0
+#define N_VAR		1
+#define N_ELEM		2	/* array element, kid[0] the linear subscript */
+#define N_OP		3	/* op on kid[0], and kid[1] if binary */
+
+#define T_INT		0
+#define T_REAL		1
+
+struct node {
+	int kind, type;
+	int op;
+	union ftn_value value;	/* of a constant */
+	int sym;		/* of a variable or element */
+	struct node *kid[2];
+	int reg;		/* where a hoisted value is, or -1 */
+};
+
+struct symbol {
+	char name[MAXNAME + 1];
+	int type;
+	int typed;		/* given in INTEGER or REAL */
+	int dims, dim[2];	/* dims is 0 for a scalar */
+	int used;		/* too late to type or dimension it */
+	int reg;		/* register of a scalar, number of an array */
+};
+
+/* an I/O list item: a value, an element or array, text, or implied DO */
+struct ioitem {
+	struct node *expr;
+	int array;		/* a whole array, or -1 */
+	int text, len;		/* quoted text, in the program's text */
+	struct ioitem *list;	/* implied DO, over list */
+	int var;
+	struct node *from, *to, *step;
+	struct ioitem *next;
+};
+
+#define S_NONE		0	/* declarations and FORMAT */
+#define S_ASSIGN	1
+#define S_GOTO		2
+#define S_CGOTO		3
+#define S_AIF		4
+#define S_LIF		5
+#define S_DO		6
+#define S_CONTINUE	7
+#define S_STOP		8
+#define S_PAUSE		9
+#define S_END		10
+#define S_READ		11
+#define S_WRITE		12
+
+struct stmt {
+	int kind;
+	int label;
+	int card;		/* first card, counting from 1 */
+	struct node *lhs, *expr;
+	int var;		/* DO */
+	struct node *from, *to, *step;
+	int *target, ntarget;	/* labels jumped to, or ending a DO */
+	struct stmt *then;	/* logical IF */
+	int fmt;		/* FORMAT label, or 0 for * */
+	struct ioitem *io;
+};
+
+struct label {
+	int number;
+	int addr;		/* in the code, or -1 */
+	int format;		/* format number, or -1 */
+	int card;
+};
+
+/* a reference to a label, to be filled in at the end */
+struct fixup {
+	int insn;
+	int field;		/* 0 for a, 1 for b, 2 for c */
+	int label;
+	int format;		/* wants a FORMAT rather than a statement */
+	int card;
+};
+
+struct konst {
+	int type;
+	union ftn_value value;
+	int reg;
+};
+
+struct loop {
+	int label;
+	int var, limit;
+	int top;
+};
+
+struct comp {
+	struct ftn_program *prog;
+	jmp_buf fail;
+	int card;		/* for error messages */
+	const char *p;		/* parse position */
+
+	struct symbol *syms;
+	int nsyms, maxsyms;
+	struct stmt *stmts;
+	int nstmts, maxstmts;
+	struct label *labels;
+	int nlabels, maxlabels;
+	struct fixup *fixups;
+	int nfixups, maxfixups;
+	struct konst *konsts;
+	int nkonsts, maxkonsts;
+	struct loop *loops;
+	int nloops, maxloops;
+	int maxcode, maxcards, maxregs, maxitems, maxformats, maxtext, maxarrays;
+
+	char *arena;		/* chunks, each linked from its first bytes */
+	size_t arena_used;
+};
+
+/*
+ * storage
+ */
+
+static void fail( struct comp *c, const char *fmt, ... )
+{
+	char msg[120];
+	va_list ap;
+
+	va_start( ap, fmt );
+	vsnprintf( msg, sizeof msg, fmt, ap );
+	va_end( ap );
+	snprintf( c->prog->error, sizeof c->prog->error, "card %d: %s",
+		  c->card, msg );
+	longjmp( c->fail, 1 );
+}
+
+/* make room for element n of an array of size-byte elements */
+static void *grow( struct comp *c, void *array, int *max, int n, size_t size )
+{
+	int cap = *max;
+
+	if (n < cap) return array;
+	cap = cap ? cap : 64;
+	while (cap <= n) cap *= 2;
+	array = realloc( array, cap * size );
+	if (array == NULL) fail( c, "out of memory" );
+	memset( (char *)array + *max * size, 0, (cap - *max) * size );
+	*max = cap;
+	return array;
+}
+
+/* zeroed storage that lives until the compile ends */
+static void *alloc( struct comp *c, size_t size )
+{
+	void *p;
+
+	size = (size + 15) & ~(size_t)15;
+	if ((c->arena == NULL) || (c->arena_used + size > ARENA)) {
+		char *chunk = malloc( ARENA );
+		if ((chunk == NULL) || (size > ARENA - 16))
+			fail( c, "out of memory" );
+		*(char **)chunk = c->arena;
+		c->arena = chunk;
+		c->arena_used = 16;
+	}
+	p = c->arena + c->arena_used;
+	c->arena_used += size;
+	memset( p, 0, size );
+	return p;
+}
+
+static void free_arena( struct comp *c )
+{
+	while (c->arena != NULL) {
+		char *next = *(char **)c->arena;
+		free( c->arena );
+		c->arena = next;
+	}
+}
+
+/*
+ * reading decks
+ */
+
+int ftn_read_deck( struct ftn_deck *deck, const unsigned char *buf,
+		   size_t len, const struct card_codec *codec )
+{
+	struct card_buf text = { NULL, 0, 0 };
+	const unsigned char *p, *end;
+	long max = 0;
+	int err;
+
+	deck->card = NULL;
+	deck->ncards = 0;
+	if ((len >= 3) && (buf[0] == 'H') && (buf[1] == '8')) {
+		err = card_list_buffer( codec, buf, len, &text );
+		if (err != CARD_OK) {
+			card_buf_free( &text );
+			return err;
+		}
+		buf = text.data;
+		len = text.len;
+	}
+
+	/* one card per line, tabs set every 8 columns as in cardmake */
+	for (p = buf, end = buf + len; p < end; ) {
+		char *card;
+		int col = 0;
+
+		if (deck->ncards == max) {
+			void *more;
+			max = max ? max * 2 : 256;
+			more = realloc( deck->card, max * sizeof *deck->card );
+			if (more == NULL) {
+				card_buf_free( &text );
+				ftn_free_deck( deck );
+				return CARD_ENOMEM;
+			}
+			deck->card = more;
+		}
+		card = deck->card[deck->ncards++];
+		while ((p < end) && (*p != '\n')) {
+			if (*p == '\t') {
+				do card[col++] = ' ';
+				while ((col & 07) && (col < FTN_COLUMNS));
+			} else if ((*p != '\r') && (col < FTN_COLUMNS)) {
+				card[col++] = *p;
+			}
+			p++;
+		}
+		p++;
+		while (col < FTN_COLUMNS) card[col++] = ' ';
+		card[FTN_COLUMNS] = '\0';
+	}
+	card_buf_free( &text );
+	return CARD_OK;
+}
+
+void ftn_free_deck( struct ftn_deck *deck )
+{
+	free( deck->card );
+	deck->card = NULL;
+	deck->ncards = 0;
+}
+
+static int is_comment( const char *card )
+{
+	const char *p;
+
+	if ((card[0] == 'C') || (card[0] == 'c') || (card[0] == '*'))
+		return 1;
+	for (p = card; *p == ' '; p++)
+		continue;
+	return *p == '\0';
+}
+
+static int is_continuation( const char *card )
+{
+	return (card[5] != ' ') && (card[5] != '0');
+}
+
+/* the number of program cards, up to and including END */
+long ftn_program_cards( const struct ftn_deck *deck )
+{
+	long i;
+
+	for (i = 0; i < deck->ncards; i++) {
+		const char *card = deck->card[i];
+		char word[4];
+		int col, n = 0;
+
+		if (is_comment( card ) || is_continuation( card )) continue;
+		for (col = 6; (col < 72) && (n < 4); col++) {
+			if (card[col] != ' ') word[n++] = toupper( card[col] );
+		}
+		if ((n == 3) && (memcmp( word, "END", 3 ) == 0)) {
+			/* and no continuation, which would make it ENDX=... */
+			if ((i + 1 < deck->ncards)
+			 && !is_comment( deck->card[i + 1] )
+			 && is_continuation( deck->card[i + 1] )) continue;
+			return i + 1;
+		}
+	}
+	return deck->ncards;
+}
+
+/*
+ * Remove the blanks from a statement, upper casing it, except within
+ * quotes and, in a FORMAT, Hollerith fields.
+ */
+static void squeeze( struct comp *c, const char *raw, char *out, int format )
+{
+	char *o = out;
+	char last = '(';
+
+	while (*raw != '\0') {
+		if (*raw == ' ') {
+			raw++;
+		} else if (*raw == '\'') {
+			*o++ = *raw++;
+			for (;;) {
+				if (*raw == '\0') fail( c, "unbalanced quote" );
+				if ((raw[0] == '\'') && (raw[1] == '\'')) {
+					*o++ = *raw++;
+					*o++ = *raw++;
+				} else if (*raw == '\'') {
+					break;
+				} else {
+					*o++ = *raw++;
+				}
+			}
+			last = *o++ = *raw++;
+		} else if (format && isdigit( (unsigned char)*raw )
+			   && ((last == '(') || (last == ',') || (last == '/'))) {
+			const char *q = raw;
+			int n = 0;
+			while (isdigit( (unsigned char)*q ) || (*q == ' ')) {
+				if (*q != ' ') n = n * 10 + (*q - '0');
+				q++;
+			}
+			while (raw < q) {
+				if (*raw != ' ') *o++ = *raw;
+				raw++;
+			}
+			last = '0';
+			if ((*q == 'H') || (*q == 'h')) {
+				*o++ = 'H';
+				raw++;
+				while (n-- > 0) {
+					if (*raw == '\0') fail( c, "short Hollerith field" );
+					*o++ = *raw++;
+				}
+				last = 'H';
+			}
+		} else {
+			last = *o++ = toupper( (unsigned char)*raw++ );
+		}
+	}
+	*o = '\0';
+}
+
+/*
+ * registers and code
+ */
+
+static int newreg( struct comp *c )
+{
+	struct ftn_program *prog = c->prog;
+
+	prog->init = grow( c, prog->init, &c->maxregs, prog->nregs,
+			   sizeof *prog->init );
+	return prog->nregs++;
+}
+
+static int emit( struct comp *c, int op, int a, int b, int cc )
+{
+	struct ftn_program *prog = c->prog;
+
+	prog->code = grow( c, prog->code, &c->maxcode, prog->ncode,
+			   sizeof *prog->code );
+	prog->card = grow( c, prog->card, &c->maxcards, prog->ncode,
+			   sizeof *prog->card );
+	prog->code[prog->ncode].op = op;
+	prog->code[prog->ncode].a = a;
+	prog->code[prog->ncode].b = b;
+	prog->code[prog->ncode].c = cc;
+	prog->card[prog->ncode] = c->card;
+	return prog->ncode++;
+}
+
+static struct label *find_label( struct comp *c, int number )
+{
+	int i;
+
+	for (i = 0; i < c->nlabels; i++) {
+		if (c->labels[i].number == number) return &c->labels[i];
+	}
+	c->labels = grow( c, c->labels, &c->maxlabels, c->nlabels,
+			  sizeof *c->labels );
+	c->labels[c->nlabels].number = number;
+	c->labels[c->nlabels].addr = -1;
+	c->labels[c->nlabels].format = -1;
+	c->labels[c->nlabels].card = 0;
+	return &c->labels[c->nlabels++];
+}
+
+static void fixup( struct comp *c, int insn, int field, int label, int format )
+{
+	struct fixup *f;
+
+	c->fixups = grow( c, c->fixups, &c->maxfixups, c->nfixups,
+			  sizeof *c->fixups );
+	f = &c->fixups[c->nfixups++];
+	f->insn = insn;
+	f->field = field;
+	f->label = label;
+	f->format = format;
+	f->card = c->card;
+}
+
+static int constant( struct comp *c, int type, union ftn_value value )
+{
+	struct konst *k;
+	int i;
+
+	for (i = 0; i < c->nkonsts; i++) {
+		k = &c->konsts[i];
+		if ((k->type == type) && ((type == T_INT)
+		  ? (k->value.i == value.i)
+		  : (memcmp( &k->value.f, &value.f, sizeof value.f ) == 0)))
+			return k->reg;
+	}
+	c->konsts = grow( c, c->konsts, &c->maxkonsts, c->nkonsts,
+			  sizeof *c->konsts );
+	k = &c->konsts[c->nkonsts++];
+	k->type = type;
+	k->value = value;
+	k->reg = newreg( c );
+	c->prog->init[k->reg] = value;
+	return k->reg;
+}
+
+/*
+ * symbols
+ */
+
+static int symbol( struct comp *c, const char *name )
+{
+	struct symbol *s;
+	int i;
+
+	for (i = 0; i < c->nsyms; i++) {
+		if (strcmp( c->syms[i].name, name ) == 0) return i;
+	}
+	c->syms = grow( c, c->syms, &c->maxsyms, c->nsyms, sizeof *c->syms );
+	s = &c->syms[c->nsyms];
+	strcpy( s->name, name );
+	s->type = ((name[0] >= 'I') && (name[0] <= 'N')) ? T_INT : T_REAL;
+	s->reg = -1;
+	return c->nsyms++;
+}
+
+static int scalar_reg( struct comp *c, int sym )
+{
+	struct symbol *s = &c->syms[sym];
+
+	if (s->reg < 0) {
+		int reg = newreg( c );
+		s = &c->syms[sym];
+		s->reg = reg;
+	}
+	return s->reg;
+}
+
+/*
+ * trees, folded as they are built
+ */
+
+static struct node *leaf( struct comp *c, int kind, int type )
+{
+	struct node *n = alloc( c, sizeof *n );
+
+	n->kind = kind;
+	n->type = type;
+	n->reg = -1;
+	return n;
+}
+
+static struct node *int_const( struct comp *c, int32_t i )
+{
+	struct node *n = leaf( c, N_CONST, T_INT );
+
+	n->value.i = i;
+	return n;
+}
+
+static struct node *real_const( struct comp *c, double f )
+{
+	struct node *n = leaf( c, N_CONST, T_REAL );
+
+	n->value.f = f;
+	return n;
+}
+
+static int32_t ipow( int32_t x, int32_t n )
+{
+	uint32_t r = 1, b = x;
+
+	while (n > 0) {
+		if (n & 1) r *= b;
+		b *= b;
+		n >>= 1;
+	}
+	return (int32_t)r;
+}
+
+static double fpowi( double x, int32_t n )
+{
+	double r = 1.0;
+	long e = (n < 0) ? -(long)n : n;
+
+	while (e > 0) {
+		if (e & 1) r *= x;
+		x *= x;
+		e >>= 1;
+	}
+	return (n < 0) ? 1.0 / r : r;
+}
+
+/* the value of op on constants, or 0 if it cannot be done now */
+static int fold( int op, const struct node *a, const struct node *b,
+		 union ftn_value *r )
+{
+	int32_t x = a->value.i, y = b ? b->value.i : 0;
+	double f = a->value.f, g = b ? b->value.f : 0.0;
+
+	switch (op) {
+	case FTN_IADD: r->i = (int32_t)((uint32_t)x + (uint32_t)y); break;
+	case FTN_ISUB: r->i = (int32_t)((uint32_t)x - (uint32_t)y); break;
+	case FTN_IMUL: r->i = (int32_t)((uint32_t)x * (uint32_t)y); break;
+	case FTN_IDIV:
+	case FTN_IMOD:
+		if ((y == 0) || ((x == INT32_MIN) && (y == -1))) return 0;
+		r->i = (op == FTN_IDIV) ? x / y : x % y;
+		break;
+	case FTN_IPOW:
+		if (y < 0) return 0;
+		r->i = ipow( x, y );
+		break;
+	case FTN_INEG: r->i = (int32_t)(0 - (uint32_t)x); break;
+	case FTN_FADD: r->f = f + g; break;
+	case FTN_FSUB: r->f = f - g; break;
+	case FTN_FMUL: r->f = f * g; break;
+	case FTN_FDIV: r->f = f / g; break;
+	case FTN_FMOD: r->f = fmod( f, g ); break;
+	case FTN_FPOW: r->f = pow( f, g ); break;
+	case FTN_FPOWI: r->f = fpowi( f, y ); break;
+	case FTN_FNEG: r->f = -f; break;
+	case FTN_ITOF: r->f = x; break;
+	case FTN_FTOI:
+		if (!(fabs( f ) < 2147483648.0)) return 0;
+		r->i = (int32_t)f;
+		break;
+	case FTN_IEQ: r->i = x == y; break;
+	case FTN_INE: r->i = x != y; break;
+	case FTN_ILT: r->i = x < y; break;
+	case FTN_ILE: r->i = x <= y; break;
+	case FTN_IGT: r->i = x > y; break;
+	case FTN_IGE: r->i = x >= y; break;
+	case FTN_FEQ: r->i = f == g; break;
+	case FTN_FNE: r->i = f != g; break;
+	case FTN_FLT: r->i = f < g; break;
+	case FTN_FLE: r->i = f <= g; break;
+	case FTN_FGT: r->i = f > g; break;
+	case FTN_FGE: r->i = f >= g; break;
+	case FTN_AND: r->i = x && y; break;
+	case FTN_OR: r->i = x || y; break;
+	case FTN_NOT: r->i = !x; break;
+	case FTN_IABS: r->i = (x < 0) ? (int32_t)(0 - (uint32_t)x) : x; break;
+	case FTN_FABS: r->f = fabs( f ); break;
+	case FTN_IMAX: r->i = (x > y) ? x : y; break;
+	case FTN_IMIN: r->i = (x < y) ? x : y; break;
+	case FTN_FMAX: r->f = (f > g) ? f : g; break;
+	case FTN_FMIN: r->f = (f < g) ? f : g; break;
+	case FTN_ISIGN:
+		x = (x < 0) ? (int32_t)(0 - (uint32_t)x) : x;
+		r->i = (y < 0) ? (int32_t)(0 - (uint32_t)x) : x;
+		break;
+	case FTN_FSIGN: r->f = (g < 0) ? -fabs( f ) : fabs( f ); break;
+	case FTN_SQRT: r->f = sqrt( f ); break;
+	case FTN_SIN: r->f = sin( f ); break;
+	case FTN_COS: r->f = cos( f ); break;
+	case FTN_TAN: r->f = tan( f ); break;
+	case FTN_ATAN: r->f = atan( f ); break;
+	case FTN_EXP: r->f = exp( f ); break;
+	case FTN_LOG: r->f = log( f ); break;
+	case FTN_LOG10: r->f = log10( f ); break;
+	default: return 0;
+	}
+	return 1;
+}
+
+static struct node *op_node( struct comp *c, int op, int type,
+			     struct node *a, struct node *b )
+{
+	struct node *n;
+	union ftn_value value;
+
+	if ((a->kind == N_CONST) && ((b == NULL) || (b->kind == N_CONST))
+	 && fold( op, a, b, &value )) {
+		n = leaf( c, N_CONST, type );
+		n->value = value;
+		c->prog->folded++;
+		return n;
+	}
+	n = leaf( c, N_OP, type );
+	n->op = op;
+	n->kid[0] = a;
+	n->kid[1] = b;
+	return n;
+}
+
+static struct node *convert( struct comp *c, struct node *n, int type )
+{
+	if (n->type == type) return n;
+	return op_node( c, (type == T_REAL) ? FTN_ITOF : FTN_FTOI, type,
+			n, NULL );
+}
+
+/* an arithmetic operation, in real if either side is real */
+static struct node *arith( struct comp *c, int iop, int fop,
+			   struct node *a, struct node *b )
+{
+	int type = ((a->type == T_REAL) || (b->type == T_REAL)) ? T_REAL
+								: T_INT;
+
+	a = convert( c, a, type );
+	b = convert( c, b, type );
+	return op_node( c, (type == T_INT) ? iop : fop, type, a, b );
+}
+
+static struct node *power( struct comp *c, struct node *a, struct node *b )
+{
+	if (b->type == T_INT) {
+		return op_node( c, (a->type == T_INT) ? FTN_IPOW : FTN_FPOWI,
+				a->type, a, b );
+	}
+	return op_node( c, FTN_FPOW, T_REAL, convert( c, a, T_REAL ), b );
+}
+
+/*
+ * expressions
+ */
+
+static int accept( struct comp *c, const char *token )
+{
+	size_t len = strlen( token );
+
+	if (strncmp( c->p, token, len ) != 0) return 0;
+	c->p += len;
+	return 1;
+}
+
+static void expect( struct comp *c, const char *token )
+{
+	if (!accept( c, token )) fail( c, "%s expected at %.12s", token, c->p );
+}
+
+static int name( struct comp *c, char *buf )
+{
+	int n = 0;
+
+	if (!isupper( (unsigned char)*c->p )) return 0;
+	while (isupper( (unsigned char)*c->p ) || isdigit( (unsigned char)*c->p )) {
+		if (n == MAXNAME) fail( c, "name longer than %d letters", MAXNAME );
+		buf[n++] = *c->p++;
+	}
+	buf[n] = '\0';
+	return 1;
+}
+
+static int number( struct comp *c )
+{
+	long n = 0;
+
+	if (!isdigit( (unsigned char)*c->p )) fail( c, "number expected at %.12s", c->p );
+	while (isdigit( (unsigned char)*c->p )) {
+		n = n * 10 + (*c->p++ - '0');
+		if (n > 2147483647L) fail( c, "number too big" );
+	}
+	return (int)n;
+}
+
+/* true if a period here starts an operator such as .EQ., not a fraction */
+static int dot_operator( const char *p )
+{
+	static const char *ops[] = { ".EQ.", ".NE.", ".LT.", ".LE.", ".GT.",
+		".GE.", ".AND.", ".OR.", ".NOT.", ".TRUE.", ".FALSE.", NULL };
+	int i;
+
+	for (i = 0; ops[i] != NULL; i++) {
+		if (strncmp( p, ops[i], strlen( ops[i] ) ) == 0) return 1;
+	}
+	return 0;
+}
+
+static struct node *constant_node( struct comp *c )
+{
+	const char *start = c->p, *p = c->p;
+	char buf[64];
+	int real = 0;
+
+	while (isdigit( (unsigned char)*p )) p++;
+	if ((*p == '.') && !dot_operator( p )) {
+		real = 1;
+		p++;
+		while (isdigit( (unsigned char)*p )) p++;
+	}
+	if (((*p == 'E') || (*p == 'D')) && (p > start)
+	 && (isdigit( (unsigned char)p[1] )
+	  || (((p[1] == '+') || (p[1] == '-')) && isdigit( (unsigned char)p[2] )))) {
+		real = 1;
+		p += 2;
+		while (isdigit( (unsigned char)*p )) p++;
+	}
+	if ((p == start) || (p - start >= (long)sizeof buf))
+		fail( c, "bad constant at %.12s", start );
+	memcpy( buf, start, p - start );
+	buf[p - start] = '\0';
+	c->p = p;
+	if (real) {
+		char *e = strchr( buf, 'D' );
+		if (e != NULL) *e = 'E';
+		return real_const( c, strtod( buf, NULL ) );
+	} else {
+		long v = strtol( buf, NULL, 10 );
+		if ((v > 2147483647L) || (strlen( buf ) > 10)) fail( c, "number too big" );
+		return int_const( c, (int32_t)v );
+	}
+}
+
+static struct node *expression( struct comp *c );
+
+/* the intrinsic functions */
+static const struct intrinsic {
+	const char *name;
+	int nargs;		/* -1 for two or more */
+	int arg;		/* argument type, or -1 for either */
+	int iop, fop;		/* for integer and real arguments */
+	int result;		/* or -1 for that of the arguments */
+} intrinsics[] = {
+	{ "ABS",	1, -1,		FTN_IABS, FTN_FABS, -1 },
+	{ "IABS",	1, T_INT,	FTN_IABS, 0, T_INT },
+	{ "SQRT",	1, T_REAL,	0, FTN_SQRT, T_REAL },
+	{ "SIN",	1, T_REAL,	0, FTN_SIN, T_REAL },
+	{ "COS",	1, T_REAL,	0, FTN_COS, T_REAL },
+	{ "TAN",	1, T_REAL,	0, FTN_TAN, T_REAL },
+	{ "ATAN",	1, T_REAL,	0, FTN_ATAN, T_REAL },
+	{ "EXP",	1, T_REAL,	0, FTN_EXP, T_REAL },
+	{ "ALOG",	1, T_REAL,	0, FTN_LOG, T_REAL },
+	{ "ALOG10",	1, T_REAL,	0, FTN_LOG10, T_REAL },
+	{ "LOG",	1, T_REAL,	0, FTN_LOG, T_REAL },
+	{ "LOG10",	1, T_REAL,	0, FTN_LOG10, T_REAL },
+	{ "FLOAT",	1, T_INT,	FTN_ITOF, 0, T_REAL },
+	{ "REAL",	1, -1,		FTN_ITOF, FTN_MOV, T_REAL },
+	{ "IFIX",	1, T_REAL,	0, FTN_FTOI, T_INT },
+	{ "INT",	1, -1,		FTN_MOV, FTN_FTOI, T_INT },
+	{ "MOD",	2, T_INT,	FTN_IMOD, 0, T_INT },
+	{ "AMOD",	2, T_REAL,	0, FTN_FMOD, T_REAL },
+	{ "MAX0",	-1, T_INT,	FTN_IMAX, 0, T_INT },
+	{ "MIN0",	-1, T_INT,	FTN_IMIN, 0, T_INT },
+	{ "AMAX1",	-1, T_REAL,	0, FTN_FMAX, T_REAL },
+	{ "AMIN1",	-1, T_REAL,	0, FTN_FMIN, T_REAL },
+	{ "MAX",	-1, -1,		FTN_IMAX, FTN_FMAX, -1 },
+	{ "MIN",	-1, -1,		FTN_IMIN, FTN_FMIN, -1 },
+	{ "SIGN",	2, T_REAL,	0, FTN_FSIGN, T_REAL },
+	{ "ISIGN",	2, T_INT,	FTN_ISIGN, 0, T_INT },
+	{ NULL,		0, 0,		0, 0, 0 }
+};
+
+static struct node *intrinsic( struct comp *c, const struct intrinsic *f )
+{
+	struct node *args[16], *n;
+	int nargs = 0, type, op, i;
+
+	do {
+		if (nargs == 16) fail( c, "too many arguments to %s", f->name );
+		args[nargs++] = expression( c );
+	} while (accept( c, "," ));
+	expect( c, ")" );
+	if ((f->nargs > 0) ? (nargs != f->nargs) : (nargs < 2))
+		fail( c, "wrong number of arguments to %s", f->name );
+
+	type = f->arg;
+	if (type < 0) {
+		type = T_INT;
+		for (i = 0; i < nargs; i++) {
+			if (args[i]->type == T_REAL) type = T_REAL;
+		}
+	}
+	for (i = 0; i < nargs; i++) args[i] = convert( c, args[i], type );
+	op = (type == T_INT) ? f->iop : f->fop;
+
+	if (op == FTN_MOV) return args[0];
+	if ((op == FTN_ITOF) || (op == FTN_FTOI))
+		return convert( c, args[0], f->result );
+	n = op_node( c, op, (f->result < 0) ? type : f->result, args[0],
+		     (nargs > 1) ? args[1] : NULL );
+	for (i = 2; i < nargs; i++)
+		n = op_node( c, op, n->type, n, args[i] );
+	return n;
+}
+
+/* an array element; the name has been read, and the ( */
+static struct node *element( struct comp *c, int sym )
+{
+	struct symbol *s = &c->syms[sym];
+	struct node *sub[2], *n;
+	int nsubs = 0;
+
+	do {
+		if (nsubs == 2) fail( c, "too many subscripts for %s", s->name );
+		sub[nsubs++] = convert( c, expression( c ), T_INT );
+	} while (accept( c, "," ));
+	expect( c, ")" );
+	s = &c->syms[sym];
+	if (nsubs != s->dims) fail( c, "%s has %d subscripts", s->name, s->dims );
+
+	/* column major: I + (J - 1) * the first dimension */
+	n = leaf( c, N_ELEM, s->type );
+	n->sym = sym;
+	n->kid[0] = sub[0];
+	if (nsubs == 2) {
+		struct node *col = arith( c, FTN_ISUB, FTN_FSUB, sub[1],
+					  int_const( c, 1 ) );
+		col = arith( c, FTN_IMUL, FTN_FMUL, col,
+			     int_const( c, s->dim[0] ) );
+		n->kid[0] = arith( c, FTN_IADD, FTN_FADD, col, sub[0] );
+	}
+	return n;
+}
+
+static struct node *variable( struct comp *c, int sym )
+{
+	struct node *n = leaf( c, N_VAR, c->syms[sym].type );
+
+	n->sym = sym;
+	scalar_reg( c, sym );
+	return n;
+}
+
+static struct node *primary( struct comp *c )
+{
+	char buf[MAXNAME + 1];
+	struct node *n;
+	int sym, i;
+
+	if (accept( c, "(" )) {
+		n = expression( c );
+		expect( c, ")" );
+		return n;
+	}
+	if (accept( c, ".TRUE." )) return int_const( c, 1 );
+	if (accept( c, ".FALSE." )) return int_const( c, 0 );
+	if (isdigit( (unsigned char)*c->p ) || (*c->p == '.'))
+		return constant_node( c );
+	if (!name( c, buf )) fail( c, "syntax error at %.12s", c->p );
+
+	if (accept( c, "(" )) {
+		for (i = 0; i < c->nsyms; i++) {
+			if ((strcmp( c->syms[i].name, buf ) == 0)
+			 && (c->syms[i].dims > 0))
+				return element( c, i );
+		}
+		for (i = 0; intrinsics[i].name != NULL; i++) {
+			if (strcmp( intrinsics[i].name, buf ) == 0)
+				return intrinsic( c, &intrinsics[i] );
+		}
+		fail( c, "%s is not an array or a known function", buf );
+	}
+	sym = symbol( c, buf );
+	c->syms[sym].used = 1;
+	if (c->syms[sym].dims > 0) fail( c, "%s needs a subscript", buf );
+	return variable( c, sym );
+}
+
+static struct node *factor( struct comp *c )
+{
+	struct node *n = primary( c );
+
+	if (accept( c, "**" )) n = power( c, n, factor( c ) );
+	return n;
+}
+
+static struct node *term( struct comp *c )
+{
+	struct node *n = factor( c );
+
+	for (;;) {
+		if ((c->p[0] == '*') && (c->p[1] != '*')) {
+			c->p++;
+			n = arith( c, FTN_IMUL, FTN_FMUL, n, factor( c ) );
+		} else if (accept( c, "/" )) {
+			n = arith( c, FTN_IDIV, FTN_FDIV, n, factor( c ) );
+		} else {
+			return n;
+		}
+	}
+}
+
+static struct node *sum( struct comp *c )
+{
+	struct node *n;
+
+	if (accept( c, "-" )) {
+		n = term( c );
+		n = op_node( c, (n->type == T_INT) ? FTN_INEG : FTN_FNEG,
+			     n->type, n, NULL );
+	} else {
+		accept( c, "+" );
+		n = term( c );
+	}
+	for (;;) {
+		if (accept( c, "+" )) {
+			n = arith( c, FTN_IADD, FTN_FADD, n, term( c ) );
+		} else if (accept( c, "-" )) {
+			n = arith( c, FTN_ISUB, FTN_FSUB, n, term( c ) );
+		} else {
+			return n;
+		}
+	}
+}
+
+static struct node *relation( struct comp *c )
+{
+	static const struct { const char *token; int op; } rel[] = {
+		{ ".EQ.", FTN_IEQ }, { ".NE.", FTN_INE }, { ".LT.", FTN_ILT },
+		{ ".LE.", FTN_ILE }, { ".GT.", FTN_IGT }, { ".GE.", FTN_IGE },
+		{ NULL, 0 }
+	};
+	struct node *n = sum( c ), *m;
+	int i;
+
+	for (i = 0; rel[i].token != NULL; i++) {
+		if (accept( c, rel[i].token )) {
+			m = sum( c );
+			n = arith( c, rel[i].op, rel[i].op + FTN_FEQ - FTN_IEQ,
+				   n, m );
+			n->type = T_INT;
+			return n;
+		}
+	}
+	return n;
+}
+
+static struct node *negation( struct comp *c )
+{
+	if (accept( c, ".NOT." ))
+		return op_node( c, FTN_NOT, T_INT, negation( c ), NULL );
+	return relation( c );
+}
+
+static struct node *conjunction( struct comp *c )
+{
+	struct node *n = negation( c );
+
+	while (accept( c, ".AND." ))
+		n = op_node( c, FTN_AND, T_INT, n, negation( c ) );
+	return n;
+}
+
+static struct node *expression( struct comp *c )
+{
+	struct node *n = conjunction( c );
+
+	while (accept( c, ".OR." ))
+		n = op_node( c, FTN_OR, T_INT, n, conjunction( c ) );
+	return n;
+}
+
+/* a variable or array element to be assigned */
+static struct node *target( struct comp *c )
+{
+	char buf[MAXNAME + 1];
+	int sym;
+
+	if (!name( c, buf )) fail( c, "variable expected at %.12s", c->p );
+	sym = symbol( c, buf );
+	c->syms[sym].used = 1;
+	if (c->syms[sym].dims > 0) {
+		expect( c, "(" );
+		return element( c, sym );
+	}
+	return variable( c, sym );
+}
+
+/*
+ * statements
+ */
+
+/* skip a parenthesized group, at its (, returning what follows it */
+static const char *skip_parens( const char *p )
+{
+	int depth = 0;
+
+	do {
+		if (*p == '\0') return p;
+		if (*p == '(') depth++;
+		if (*p == ')') depth--;
+		if (*p == '\'') {
+			do p++;
+			while ((*p != '\0') && (*p != '\''));
+			if (*p == '\0') return p;
+		}
+		p++;
+	} while (depth > 0);
+	return p;
+}
+
+static int is_assignment( const char *p )
+{
+	if (!isupper( (unsigned char)*p )) return 0;
+	while (isupper( (unsigned char)*p ) || isdigit( (unsigned char)*p )) p++;
+	if (*p == '(') p = skip_parens( p );
+	return *p == '=';
+}
+
+/* DO label, var = from, to: a comma after the = at the outer level */
+static int is_do( const char *p )
+{
+	if ((strncmp( p, "DO", 2 ) != 0) || !isdigit( (unsigned char)p[2] ))
+		return 0;
+	p = strchr( p, '=' );
+	if (p == NULL) return 0;
+	while (*p != '\0') {
+		if (*p == '(') p = skip_parens( p );
+		else if (*p++ == ',') return 1;
+	}
+	return 0;
+}
+
+static int label_ref( struct comp *c )
+{
+	int n = number( c );
+
+	if ((n == 0) || (n > 99999)) fail( c, "bad statement label %d", n );
+	return n;
+}
+
+/* DIMENSION, INTEGER and REAL lists */
+static void declare( struct comp *c, int type )
+{
+	do {
+		char buf[MAXNAME + 1];
+		struct symbol *s;
+		int sym;
+
+		if (!name( c, buf )) fail( c, "name expected at %.12s", c->p );
+		sym = symbol( c, buf );
+		s = &c->syms[sym];
+		if (s->used) fail( c, "%s declared after it is used", buf );
+		if (type >= 0) {
+			s->type = type;
+			s->typed = 1;
+		}
+		if (accept( c, "(" )) {
+			struct ftn_program *prog = c->prog;
+			long size = 1;
+			int reg;
+
+			if (s->dims > 0) fail( c, "%s dimensioned twice", buf );
+			do {
+				if (s->dims == 2) fail( c, "%s has over two dimensions", buf );
+				s->dim[s->dims] = number( c );
+				if (s->dim[s->dims] == 0) fail( c, "%s has a zero dimension", buf );
+				size *= s->dim[s->dims++];
+				if (size > MAXMEM) fail( c, "%s is too big", buf );
+			} while (accept( c, "," ));
+			expect( c, ")" );
+			if (prog->memsize + size > MAXMEM) fail( c, "arrays too big" );
+
+			reg = prog->narrays;
+			prog->arrays = grow( c, prog->arrays, &c->maxarrays,
+					     reg, sizeof *prog->arrays );
+			prog->arrays[reg].base = prog->memsize;
+			prog->arrays[reg].size = size;
+			prog->narrays++;
+			prog->memsize += size;
+			c->syms[sym].reg = reg;
+		} else if (type < 0) {
+			fail( c, "dimensions expected for %s", buf );
+		}
+	} while (accept( c, "," ));
+}
+
+static void add_item( struct comp *c, int kind, int repeat, int w, int d )
+{
+	struct ftn_program *prog = c->prog;
+	struct ftn_item *item;
+
+	prog->items = grow( c, prog->items, &c->maxitems, prog->nitems,
+			    sizeof *prog->items );
+	item = &prog->items[prog->nitems++];
+	item->kind = kind;
+	item->repeat = repeat;
+	item->w = w;
+	item->d = d;
+}
+
+static void add_text( struct comp *c, int ch )
+{
+	struct ftn_program *prog = c->prog;
+
+	prog->text = grow( c, prog->text, &c->maxtext, prog->ntext, 1 );
+	prog->text[prog->ntext++] = ch;
+}
+
+/* the items of a FORMAT, after the (; groups are written out in full */
+static void format_list( struct comp *c, int depth )
+{
+	struct ftn_program *prog = c->prog;
+
+	for (;;) {
+		int repeat = 1, has_repeat = 0, w = 0, d = 0;
+		int kind;
+
+		if (accept( c, ")" )) return;
+		if (accept( c, "," )) continue;
+		if (accept( c, "/" )) {
+			add_item( c, '/', 1, 0, 0 );
+			continue;
+		}
+		if (isdigit( (unsigned char)*c->p )) {
+			repeat = number( c );
+			has_repeat = 1;
+		}
+		kind = *c->p++;
+		switch (kind) {
+		case '(': {
+			int first = prog->nitems, count, i;
+			if (depth > 3) fail( c, "FORMAT groups nested too deep" );
+			if (depth == 0) {
+				struct ftn_format *f = &prog->formats[prog->nformats];
+				f->revert = first - f->first;
+			}
+			format_list( c, depth + 1 );
+			count = prog->nitems - first;
+			while (--repeat > 0) {
+				for (i = 0; i < count; i++) {
+					struct ftn_item item = prog->items[first + i];
+					add_item( c, item.kind, item.repeat,
+						  item.w, item.d );
+				}
+			}
+			break;
+		}
+		case 'I':
+			w = number( c );
+			add_item( c, 'I', repeat, w, 0 );
+			break;
+		case 'F':
+		case 'E':
+		case 'D':
+		case 'G':
+			w = number( c );
+			expect( c, "." );
+			d = number( c );
+			add_item( c, (kind == 'F') ? 'F' : 'E', repeat, w, d );
+			break;
+		case 'X':
+			add_item( c, 'X', 1, repeat, 0 );
+			break;
+		case 'H':
+			if (!has_repeat) fail( c, "H without a count" );
+			add_item( c, 'H', 1, prog->ntext, repeat );
+			while (repeat-- > 0) {
+				if (*c->p == '\0') fail( c, "short Hollerith field" );
+				add_text( c, *c->p++ );
+			}
+			break;
+		case '\'':
+			add_item( c, 'H', 1, prog->ntext, 0 );
+			for (;;) {
+				if (*c->p == '\0') fail( c, "unbalanced quote" );
+				if ((c->p[0] == '\'') && (c->p[1] == '\'')) c->p++;
+				else if (*c->p == '\'') break;
+				add_text( c, *c->p++ );
+				prog->items[prog->nitems - 1].d++;
+			}
+			c->p++;
+			break;
+		default:
+			fail( c, "FORMAT code %c not supported", kind );
+		}
+	}
+}
+
+/* NAME= next, the variable of an implied DO */
+static int at_index( struct comp *c )
+{
+	const char *p = c->p;
+
+	if (!isupper( (unsigned char)*p )) return 0;
+	while (isupper( (unsigned char)*p ) || isdigit( (unsigned char)*p )) p++;
+	return *p == '=';
+}
+
+/* an implied DO; there is a = at the top level of the parentheses */
+static int implied_do( const char *p )
+{
+	int depth = 0;
+
+	for (; *p != '\0'; p++) {
+		if (*p == '(') depth++;
+		else if ((*p == ')') && (--depth == 0)) return 0;
+		else if ((*p == '=') && (depth == 1)) return 1;
+	}
+	return 0;
+}
+
+static void do_bounds( struct comp *c, int *var, struct node **from,
+		       struct node **to, struct node **step )
+{
+	char buf[MAXNAME + 1];
+	int sym;
+
+	if (!name( c, buf )) fail( c, "DO variable expected" );
+	sym = symbol( c, buf );
+	c->syms[sym].used = 1;
+	if (c->syms[sym].dims > 0) fail( c, "DO variable %s is an array", buf );
+	if (c->syms[sym].type != T_INT) fail( c, "DO variable %s is not integer", buf );
+	scalar_reg( c, sym );
+	*var = sym;
+	expect( c, "=" );
+	*from = convert( c, expression( c ), T_INT );
+	expect( c, "," );
+	*to = convert( c, expression( c ), T_INT );
+	*step = accept( c, "," ) ? convert( c, expression( c ), T_INT )
+				 : int_const( c, 1 );
+	if (((*step)->kind == N_CONST) && ((*step)->value.i == 0))
+		fail( c, "DO step is zero" );
+}
+
+static struct ioitem *io_list( struct comp *c, int reading, int nested )
+{
+	struct ioitem *head = NULL, **tail = &head;
+
+	for (;;) {
+		struct ioitem *item;
+		int i;
+
+		if (nested && at_index( c )) return head;
+		item = alloc( c, sizeof *item );
+		item->array = -1;
+		if ((*c->p == '(') && implied_do( c->p )) {
+			c->p++;
+			item->list = io_list( c, reading, 1 );
+			if (item->list == NULL) fail( c, "empty implied DO" );
+			do_bounds( c, &item->var, &item->from, &item->to,
+				   &item->step );
+			expect( c, ")" );
+		} else if (!reading && (*c->p == '\'')) {
+			c->p++;
+			item->text = c->prog->ntext;
+			for (;;) {
+				if (*c->p == '\0') fail( c, "unbalanced quote" );
+				if ((c->p[0] == '\'') && (c->p[1] == '\'')) c->p++;
+				else if (*c->p == '\'') break;
+				add_text( c, *c->p++ );
+				item->len++;
+			}
+			c->p++;
+		} else {
+			/* a whole array is an array name standing alone */
+			const char *p = c->p;
+			char buf[MAXNAME + 1];
+			item->array = -1;
+			if (name( c, buf ) && (*c->p != '(')) {
+				for (i = 0; i < c->nsyms; i++) {
+					if ((strcmp( c->syms[i].name, buf ) == 0)
+					 && (c->syms[i].dims > 0))
+						item->array = i;
+				}
+			}
+			if (item->array < 0) {
+				c->p = p;
+				item->expr = reading ? target( c ) : expression( c );
+			}
+		}
+		*tail = item;
+		tail = &item->next;
+		if (!accept( c, "," )) {
+			if (nested) fail( c, "implied DO variable expected" );
+			return head;
+		}
+	}
+}
+
+/* the format and unit of READ, WRITE and PRINT, and then the list */
+static void io_statement( struct comp *c, struct stmt *st, int reading,
+			  int has_unit )
+{
+	if (has_unit) {
+		if (!accept( c, "*" )) number( c );
+		expect( c, "," );
+	}
+	st->fmt = accept( c, "*" ) ? 0 : label_ref( c );
+	if (has_unit) {
+		expect( c, ")" );
+	} else if (*c->p != '\0') {
+		expect( c, "," );
+	}
+	if (*c->p != '\0') st->io = io_list( c, reading, 0 );
+}
+
+static int *labels_list( struct comp *c, int *n )
+{
+	int buf[256], *list, i;
+
+	*n = 0;
+	do {
+		if (*n == 256) fail( c, "too many labels" );
+		buf[(*n)++] = label_ref( c );
+	} while (accept( c, "," ));
+	list = alloc( c, *n * sizeof *list );
+	for (i = 0; i < *n; i++) list[i] = buf[i];
+	return list;
+}
+
+static void parse_stmt( struct comp *c, struct stmt *st, int nested )
+{
+	static const char *unsupported[] = { "SUBROUTINE", "FUNCTION",
+		"CALL", "RETURN", "COMMON", "EQUIVALENCE", "DATA", "LOGICAL",
+		"DOUBLEPRECISION", "COMPLEX", "EXTERNAL", "ASSIGN", NULL };
+	int i;
+
+	if (is_do( c->p )) {
+		if (nested) fail( c, "DO cannot follow a logical IF" );
+		c->p += 2;
+		st->kind = S_DO;
+		st->target = alloc( c, sizeof *st->target );
+		st->target[0] = label_ref( c );
+		st->ntarget = 1;
+		accept( c, "," );
+		do_bounds( c, &st->var, &st->from, &st->to, &st->step );
+	} else if (is_assignment( c->p )) {
+		st->kind = S_ASSIGN;
+		st->lhs = target( c );
+		expect( c, "=" );
+		st->expr = convert( c, expression( c ), st->lhs->type );
+	} else if (accept( c, "GOTO" )) {
+		if (accept( c, "(" )) {
+			st->kind = S_CGOTO;
+			st->target = labels_list( c, &st->ntarget );
+			expect( c, ")" );
+			accept( c, "," );
+			st->expr = convert( c, expression( c ), T_INT );
+		} else {
+			st->kind = S_GOTO;
+			st->target = alloc( c, sizeof *st->target );
+			st->target[0] = label_ref( c );
+			st->ntarget = 1;
+		}
+	} else if (accept( c, "IF(" )) {
+		st->expr = expression( c );
+		expect( c, ")" );
+		if (isdigit( (unsigned char)*c->p )) {
+			st->kind = S_AIF;
+			st->target = labels_list( c, &st->ntarget );
+			if (st->ntarget != 3) fail( c, "IF needs three labels" );
+		} else {
+			if (nested) fail( c, "IF cannot follow a logical IF" );
+			st->kind = S_LIF;
+			if (st->expr->type != T_INT)
+				fail( c, "IF condition is not logical" );
+			st->then = alloc( c, sizeof *st->then );
+			st->then->card = st->card;
+			parse_stmt( c, st->then, 1 );
+			if (st->then->kind == S_NONE)
+				fail( c, "IF of a declaration" );
+		}
+	} else if (strcmp( c->p, "CONTINUE" ) == 0) {
+		c->p += 8;
+		st->kind = S_CONTINUE;
+	} else if (accept( c, "STOP" )) {
+		if (*c->p != '\0') number( c );
+		st->kind = S_STOP;
+	} else if (accept( c, "PAUSE" )) {
+		if (*c->p != '\0') number( c );
+		st->kind = S_PAUSE;
+	} else if (strcmp( c->p, "END" ) == 0) {
+		if (nested) fail( c, "END cannot follow a logical IF" );
+		c->p += 3;
+		st->kind = S_END;
+	} else if (accept( c, "DIMENSION" )) {
+		declare( c, -1 );
+	} else if (accept( c, "INTEGER" )) {
+		declare( c, T_INT );
+	} else if (accept( c, "REAL" )) {
+		declare( c, T_REAL );
+	} else if (accept( c, "FORMAT(" )) {
+		struct ftn_program *prog = c->prog;
+		struct label *l;
+		if (st->label == 0) fail( c, "FORMAT without a label" );
+		prog->formats = grow( c, prog->formats, &c->maxformats,
+				      prog->nformats, sizeof *prog->formats );
+		prog->formats[prog->nformats].first = prog->nitems;
+		prog->formats[prog->nformats].revert = 0;
+		format_list( c, 0 );
+		prog->formats[prog->nformats].count =
+			prog->nitems - prog->formats[prog->nformats].first;
+		l = find_label( c, st->label );
+		l->format = prog->nformats++;
+	} else if (accept( c, "READ(" )) {
+		st->kind = S_READ;
+		io_statement( c, st, 1, 1 );
+	} else if (accept( c, "READ" )) {
+		st->kind = S_READ;
+		io_statement( c, st, 1, 0 );
+	} else if (accept( c, "WRITE(" )) {
+		st->kind = S_WRITE;
+		io_statement( c, st, 0, 1 );
+	} else if (accept( c, "PRINT" )) {
+		st->kind = S_WRITE;
+		io_statement( c, st, 0, 0 );
+	} else {
+		for (i = 0; unsupported[i] != NULL; i++) {
+			if (strncmp( c->p, unsupported[i], strlen( unsupported[i] ) ) == 0)
+				fail( c, "%s is not supported", unsupported[i] );
+		}
+		fail( c, "unknown statement %.12s", c->p );
+	}
+	if (*c->p != '\0') fail( c, "extra text %.12s", c->p );
+}
+
+/* squeeze and parse one statement gathered from its cards */
+static void statement( struct comp *c, int label, const char *raw )
+{
+	char text[MAXSTMT + 1];
+	struct stmt *st;
+
+	squeeze( c, raw, text, 0 );
+	if ((label != 0) && (strncmp( text, "FORMAT(", 7 ) == 0))
+		squeeze( c, raw, text, 1 );
+
+	c->stmts = grow( c, c->stmts, &c->maxstmts, c->nstmts,
+			 sizeof *c->stmts );
+	st = &c->stmts[c->nstmts];
+	st->label = label;
+	st->card = c->card;
+	if (label != 0) {
+		struct label *l = find_label( c, label );
+		if (l->card != 0) fail( c, "label %d used twice", label );
+		l->card = c->card;
+	}
+	c->p = text;
+	parse_stmt( c, st, 0 );
+	c->nstmts++;
+}
+
+/*
+ * code generation
+ */
+
+static int gen( struct comp *c, struct node *n, int dest );
+
+static int gen_op( struct comp *c, struct node *n, int dest )
+{
+	int a, b = 0, r;
+
+	if (n->kind == N_ELEM) {
+		a = gen( c, n->kid[0], -1 );
+		r = (dest >= 0) ? dest : newreg( c );
+		emit( c, FTN_ALOAD, r, c->syms[n->sym].reg, a );
+		return r;
+	}
+	a = gen( c, n->kid[0], -1 );
+	if (n->kid[1] != NULL) b = gen( c, n->kid[1], -1 );
+	r = (dest >= 0) ? dest : newreg( c );
+	emit( c, n->op, r, a, b );
+	return r;
+}
+
+/* the register holding n, put in dest if that is not negative */
+static int gen( struct comp *c, struct node *n, int dest )
+{
+	int r;
+
+	if (n->reg >= 0) {
+		r = n->reg;
+	} else if (n->kind == N_CONST) {
+		r = constant( c, n->type, n->value );
+	} else if (n->kind == N_VAR) {
+		r = c->syms[n->sym].reg;
+	} else {
+		return gen_op( c, n, dest );
+	}
+	if ((dest >= 0) && (dest != r)) {
+		emit( c, FTN_MOV, dest, r, 0 );
+		r = dest;
+	}
+	return r;
+}
+
+static int invariant( struct comp *c, const struct node *n, const char *changed )
+{
+	const struct node *div;
+
+	if (n->reg >= 0) return 1;
+	switch (n->kind) {
+	case N_CONST:
+		return 1;
+	case N_VAR:
+		return !changed[n->sym];
+	case N_ELEM:
+		return 0;
+	}
+	/* moved ahead, these could stop a run that would never reach them,
+	   as from inside a logical IF that is false */
+	div = n->kid[1];
+	if ((n->op == FTN_IDIV) || (n->op == FTN_IMOD)) {
+		if ((div->kind != N_CONST) || (div->value.i == 0)) return 0;
+	} else if (n->op == FTN_IPOW) {
+		if ((div->kind != N_CONST) || (div->value.i < 0)) return 0;
+	} else if (n->op == FTN_FTOI) {
+		return 0;
+	}
+	return invariant( c, n->kid[0], changed )
+	    && ((n->kid[1] == NULL) || invariant( c, n->kid[1], changed ));
+}
+
+/* compute the largest invariant subtrees of n now, ahead of the loop */
+static void hoist( struct comp *c, struct node *n, const char *changed )
+{
+	if ((n == NULL) || (n->reg >= 0)
+	 || (n->kind == N_CONST) || (n->kind == N_VAR)) return;
+	if ((n->kind == N_OP) && invariant( c, n, changed )) {
+		int r = newreg( c );
+		gen_op( c, n, r );
+		n->reg = r;
+		c->prog->hoisted++;
+		return;
+	}
+	hoist( c, n->kid[0], changed );
+	hoist( c, n->kid[1], changed );
+}
+
+static void io_changes( struct comp *c, const struct ioitem *item,
+			int reading, char *changed )
+{
+	for (; item != NULL; item = item->next) {
+		if (item->list != NULL) {
+			changed[item->var] = 1;
+			io_changes( c, item->list, reading, changed );
+		} else if (reading && (item->array >= 0)) {
+			changed[item->array] = 1;
+		} else if (reading) {
+			changed[item->expr->sym] = 1;
+		}
+	}
+}
+
+static void changes( struct comp *c, const struct stmt *st, char *changed )
+{
+	switch (st->kind) {
+	case S_ASSIGN:
+		changed[st->lhs->sym] = 1;
+		break;
+	case S_DO:
+		changed[st->var] = 1;
+		break;
+	case S_LIF:
+		changes( c, st->then, changed );
+		break;
+	case S_READ:
+	case S_WRITE:
+		io_changes( c, st->io, st->kind == S_READ, changed );
+		break;
+	}
+}
+
+static void io_hoist( struct comp *c, struct ioitem *item, const char *changed )
+{
+	for (; item != NULL; item = item->next) {
+		if (item->list != NULL) {
+			hoist( c, item->from, changed );
+			hoist( c, item->to, changed );
+			hoist( c, item->step, changed );
+			io_hoist( c, item->list, changed );
+		} else if (item->expr != NULL) {
+			if (item->expr->kind == N_ELEM)
+				hoist( c, item->expr->kid[0], changed );
+			else
+				hoist( c, item->expr, changed );
+		}
+	}
+}
+
+static void stmt_hoist( struct comp *c, struct stmt *st, const char *changed )
+{
+	if ((st->lhs != NULL) && (st->lhs->kind == N_ELEM))
+		hoist( c, st->lhs->kid[0], changed );
+	hoist( c, st->expr, changed );
+	hoist( c, st->from, changed );
+	hoist( c, st->to, changed );
+	hoist( c, st->step, changed );
+	if (st->then != NULL) stmt_hoist( c, st->then, changed );
+	io_hoist( c, st->io, changed );
+}
+
+/* the loop starting at statement first ends at last */
+static void loop_hoist( struct comp *c, int first, int last )
+{
+	char *changed = alloc( c, c->nsyms + 1 );
+	int i;
+
+	for (i = first; i <= last; i++) changes( c, &c->stmts[i], changed );
+	for (i = first + 1; i <= last; i++)
+		stmt_hoist( c, &c->stmts[i], changed );
+}
+
+/* start a loop: the limit and step go in a pair of registers */
+static int loop_start( struct comp *c, int var, struct node *from,
+		       struct node *to, struct node *step )
+{
+	int limit = newreg( c );
+
+	newreg( c );
+	gen( c, to, limit );
+	gen( c, step, limit + 1 );
+	gen( c, from, c->syms[var].reg );
+	return limit;
+}
+
+static void gen_io( struct comp *c, struct ioitem *item, int reading )
+{
+	struct ftn_program *prog = c->prog;
+
+	for (; item != NULL; item = item->next) {
+		if (item->list != NULL) {
+			int limit, top;
+			limit = loop_start( c, item->var, item->from, item->to,
+					    item->step );
+			top = prog->ncode;
+			gen_io( c, item->list, reading );
+			emit( c, FTN_LOOP, c->syms[item->var].reg, limit, top );
+		} else if (item->array >= 0) {
+			const struct symbol *s = &c->syms[item->array];
+			int index = newreg( c ), limit = newreg( c ), t, top;
+			union ftn_value one;
+			newreg( c );
+			t = newreg( c );
+			prog->init[limit].i = prog->arrays[s->reg].size;
+			prog->init[limit + 1].i = 1;
+			one.i = 1;
+			emit( c, FTN_MOV, index, constant( c, T_INT, one ), 0 );
+			top = prog->ncode;
+			if (reading) {
+				emit( c, (s->type == T_INT) ? FTN_RINT : FTN_RREAL,
+				      t, 0, 0 );
+				emit( c, FTN_ASTORE, t, s->reg, index );
+			} else {
+				emit( c, FTN_ALOAD, t, s->reg, index );
+				emit( c, (s->type == T_INT) ? FTN_WINT : FTN_WREAL,
+				      t, 0, 0 );
+			}
+			emit( c, FTN_LOOP, index, limit, top );
+		} else if (reading) {
+			struct node *n = item->expr;
+			int op = (n->type == T_INT) ? FTN_RINT : FTN_RREAL;
+			if (n->kind == N_VAR) {
+				emit( c, op, c->syms[n->sym].reg, 0, 0 );
+			} else {
+				int index = gen( c, n->kid[0], -1 );
+				int t = newreg( c );
+				emit( c, op, t, 0, 0 );
+				emit( c, FTN_ASTORE, t, c->syms[n->sym].reg, index );
+			}
+		} else if (item->expr == NULL) {
+			emit( c, FTN_WTEXT, item->text, item->len, 0 );
+		} else {
+			int r = gen( c, item->expr, -1 );
+			emit( c, (item->expr->type == T_INT) ? FTN_WINT : FTN_WREAL,
+			      r, 0, 0 );
+		}
+	}
+}
+
+static void gen_stmt( struct comp *c, struct stmt *st, int index )
+{
+	struct ftn_program *prog = c->prog;
+	int r, i, at;
+
+	switch (st->kind) {
+	case S_NONE:
+	case S_CONTINUE:
+		break;
+	case S_ASSIGN:
+		if (st->lhs->kind == N_VAR) {
+			gen( c, st->expr, c->syms[st->lhs->sym].reg );
+		} else {
+			int sub = gen( c, st->lhs->kid[0], -1 );
+			r = gen( c, st->expr, -1 );
+			emit( c, FTN_ASTORE, r, c->syms[st->lhs->sym].reg, sub );
+		}
+		break;
+	case S_GOTO:
+		fixup( c, emit( c, FTN_JMP, 0, 0, 0 ), 0, st->target[0], 0 );
+		break;
+	case S_CGOTO:
+		r = gen( c, st->expr, -1 );
+		emit( c, FTN_CGOTO, r, st->ntarget, 0 );
+		for (i = 0; i < st->ntarget; i++)
+			fixup( c, emit( c, FTN_JMP, 0, 0, 0 ), 0, st->target[i], 0 );
+		break;
+	case S_AIF:
+		r = gen( c, st->expr, -1 );
+		at = emit( c, (st->expr->type == T_INT) ? FTN_IIF : FTN_FIF,
+			   r, 0, 0 );
+		fixup( c, at, 1, st->target[0], 0 );
+		fixup( c, at, 2, st->target[1], 0 );
+		fixup( c, emit( c, FTN_JMP, 0, 0, 0 ), 0, st->target[2], 0 );
+		break;
+	case S_LIF:
+		r = gen( c, st->expr, -1 );
+		at = emit( c, FTN_JZ, r, 0, 0 );
+		gen_stmt( c, st->then, -1 );
+		prog->code[at].c = prog->ncode;
+		break;
+	case S_DO: {
+		struct loop *l;
+		int last;
+		for (last = index + 1; last < c->nstmts; last++) {
+			if (c->stmts[last].label == st->target[0]) break;
+		}
+		if (last == c->nstmts)
+			fail( c, "DO ends at label %d, which does not follow",
+			      st->target[0] );
+		r = loop_start( c, st->var, st->from, st->to, st->step );
+		loop_hoist( c, index, last );
+		c->loops = grow( c, c->loops, &c->maxloops, c->nloops,
+				 sizeof *c->loops );
+		l = &c->loops[c->nloops++];
+		l->label = st->target[0];
+		l->var = c->syms[st->var].reg;
+		l->limit = r;
+		l->top = prog->ncode;
+		break;
+	}
+	case S_STOP:
+	case S_END:
+		emit( c, FTN_STOP, 0, 0, 0 );
+		break;
+	case S_PAUSE:
+		emit( c, FTN_PAUSE, 0, 0, 0 );
+		break;
+	case S_READ:
+	case S_WRITE:
+		at = emit( c, (st->kind == S_READ) ? FTN_RBEGIN : FTN_WBEGIN,
+			   -1, 0, 0 );
+		if (st->fmt != 0) fixup( c, at, 0, st->fmt, 1 );
+		gen_io( c, st->io, st->kind == S_READ );
+		emit( c, (st->kind == S_READ) ? FTN_REND : FTN_WEND, 0, 0, 0 );
+		break;
+	}
+}
+
+static void resolve( struct comp *c )
+{
+	struct ftn_program *prog = c->prog;
+	int i;
+
+	for (i = 0; i < c->nfixups; i++) {
+		const struct fixup *f = &c->fixups[i];
+		struct label *l = find_label( c, f->label );
+		int32_t *field;
+		int value;
+
+		c->card = f->card;
+		if (l->card == 0) fail( c, "no statement %d", f->label );
+		value = f->format ? l->format : l->addr;
+		if (value < 0) {
+			fail( c, f->format ? "statement %d is not a FORMAT"
+					   : "statement %d is a FORMAT",
+			      f->label );
+		}
+		field = (f->field == 0) ? &prog->code[f->insn].a
+		      : (f->field == 1) ? &prog->code[f->insn].b
+		      : &prog->code[f->insn].c;
+		*field = value;
+	}
+}
+
+static void generate( struct comp *c )
+{
+	struct ftn_program *prog = c->prog;
+	int i;
+
+	for (i = 0; i < c->nstmts; i++) {
+		struct stmt *st = &c->stmts[i];
+
+		c->card = st->card;
+		if ((st->label != 0) && (find_label( c, st->label )->format < 0))
+			find_label( c, st->label )->addr = prog->ncode;
+		gen_stmt( c, st, i );
+
+		/* close the loops ending here, innermost first */
+		while ((st->label != 0) && (c->nloops > 0)
+		    && (c->loops[c->nloops - 1].label == st->label)) {
+			struct loop *l = &c->loops[--c->nloops];
+			switch (st->kind) {
+			case S_GOTO:
+			case S_CGOTO:
+			case S_AIF:
+			case S_DO:
+			case S_STOP:
+			case S_PAUSE:
+				fail( c, "DO cannot end on this statement" );
+			}
+			emit( c, FTN_LOOP, l->var, l->limit, l->top );
+		}
+	}
+	if (c->nloops > 0) fail( c, "DO loops overlap" );
+	resolve( c );
+}
+
+/* gather the statements from their cards and parse them */
+static void parse_cards( struct comp *c, const struct ftn_deck *deck,
+			 long ncards )
+{
+	char raw[MAXSTMT + 1];
+	int label = 0, len = -1;
+	long i;
+
+	for (i = 0; i < ncards; i++) {
+		const char *card = deck->card[i];
+		int col;
+
+		if (is_comment( card )) continue;
+		if (is_continuation( card )) {
+			if (len < 0) {
+				c->card = i + 1;
+				fail( c, "continuation of nothing" );
+			}
+			if (len + 66 > MAXSTMT) fail( c, "too many continuations" );
+		} else {
+			if (len >= 0) {
+				raw[len] = '\0';
+				statement( c, label, raw );
+			}
+			c->card = i + 1;
+			label = 0;
+			for (col = 0; col < 5; col++) {
+				if (isdigit( (unsigned char)card[col] ))
+					label = label * 10 + (card[col] - '0');
+				else if (card[col] != ' ')
+					fail( c, "bad label field" );
+			}
+			len = 0;
+		}
+		memcpy( raw + len, card + 6, 66 );
+		len += 66;
+	}
+	if (len >= 0) {
+		raw[len] = '\0';
+		statement( c, label, raw );
+	}
+	if ((c->nstmts == 0) || (c->stmts[c->nstmts - 1].kind != S_END)) {
+		c->card = ncards;
+		fail( c, "no END statement" );
+	}
+	for (i = 0; i < c->nstmts - 1; i++) {
+		if (c->stmts[i].kind == S_END) {
+			c->card = c->stmts[i].card;
+			fail( c, "statements after END" );
+		}
+	}
+}
+
+static void free_comp( struct comp *c )
+{
+	free( c->syms );
+	free( c->stmts );
+	free( c->labels );
+	free( c->fixups );
+	free( c->konsts );
+	free( c->loops );
+	free_arena( c );
+}
+
+int ftn_compile( struct ftn_program *prog, const struct ftn_deck *deck,
+		 long ncards )
+{
+	struct comp comp, *c = &comp;
+
+	memset( prog, 0, sizeof *prog );
+	memset( c, 0, sizeof *c );
+	c->prog = prog;
+	if (setjmp( c->fail )) {
+		free_comp( c );
+		ftn_free( prog );
+		return -1;
+	}
+	parse_cards( c, deck, ncards );
+	generate( c );
+	free_comp( c );
+	return 0;
+}
+
+void ftn_free( struct ftn_program *prog )
+{
+	free( prog->code );
+	free( prog->card );
+	free( prog->init );
+	free( prog->arrays );
+	free( prog->items );
+	free( prog->formats );
+	free( prog->text );
+	prog->code = NULL;
+	prog->card = NULL;
+	prog->init = NULL;
+	prog->arrays = NULL;
+	prog->items = NULL;
+	prog->formats = NULL;
+	prog->text = NULL;
+}
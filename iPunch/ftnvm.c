@@ -0,0 +1,680 @@
+/* ftnvm.c -- FORTRAN bytecode machine.
+ *
+ * see ftn.h
+ *
+ * The registers are an array of unions, filled from the program's
+ * initial values, and each instruction is one case of a switch.  Array
+ * subscripts are checked against the array's size.
+ *
+ * Formatted I/O walks the FORMAT items as the list is transferred:
+ * literals, spacing and slashes are done as they are reached, and each
+ * list item takes the next I, F or E.  When the items run out with list
+ * left, a new record starts and the format is used again from its last
+ * outer group, or from the top if it has none.
+ * Blanks in numeric input fields are ignored.  List directed output puts
+ * a blank before each value; list directed input takes values separated
+ * by blanks or commas, going on to the next card as needed.  A number
+ * that does not fit its field, or is infinite or not a number, fills
+ * the field with stars, and Fw.0 still ends in a decimal point.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include "ftn.h"
+
+/* the state of one READ or WRITE */
+struct io {
+	const struct ftn_program *prog;
+	struct ftn_run *run;
+	const struct ftn_format *fmt;	/* or NULL for list directed */
+	int pos, used;		/* the item, and how many of its repeats */
+	int reading;
+	char rec[FTN_RECORD + 1];	/* the line being written */
+	int len;
+	const char *card;	/* the card being read */
+	int col;
+	char why[120];		/* what went wrong */
+};
+
+static int io_error( struct io *io, const char *fmt, ... )
+{
+	va_list ap;
+
+	va_start( ap, fmt );
+	vsnprintf( io->why, sizeof io->why, fmt, ap );
+	va_end( ap );
+	return -1;
+}
+
+/* a line over the limit is counted, not written; the run stops at the
+   end of the statement */
+static void write_record( struct io *io )
+{
+	struct ftn_run *run = io->run;
+
+	if ((run->max_lines <= 0) || (run->lines < run->max_lines)) {
+		if (run->spool != NULL) {
+			spool_asa( run->spool, io->rec, io->len );
+		} else {
+			fwrite( io->rec, 1, io->len, run->out );
+			putc( '\n', run->out );
+		}
+	}
+	run->lines++;
+	io->len = 0;
+}
+
+static void put( struct io *io, const char *s, int n )
+{
+	while (n-- > 0) {
+		if (io->len == FTN_RECORD) write_record( io );
+		io->rec[io->len++] = *s++;
+	}
+}
+
+/* a field of width w all stars, for a value that cannot be shown */
+static void stars( struct io *io, int w )
+{
+	while (w-- > 0) put( io, "*", 1 );
+}
+
+/* a field of width w, or w stars if s does not fit */
+static void put_field( struct io *io, const char *s, int w )
+{
+	int n = strlen( s );
+
+	if (n > w) {
+		stars( io, w );
+		return;
+	}
+	while (n < w--) put( io, " ", 1 );
+	put( io, s, n );
+}
+
+static int next_card( struct io *io )
+{
+	struct ftn_run *run = io->run;
+
+	if ((run->deck == NULL) || (run->next_card >= run->deck->ncards))
+		return io_error( io, "READ past the last data card" );
+	io->card = run->deck->card[run->next_card++];
+	io->col = 0;
+	return 0;
+}
+
+/* end the record, going on to the next line or card */
+static int new_record( struct io *io )
+{
+	if (io->reading) return next_card( io );
+	write_record( io );
+	return 0;
+}
+
+static int data_item( const struct ftn_item *item )
+{
+	return (item->kind == 'I') || (item->kind == 'F') || (item->kind == 'E');
+}
+
+/* X, literals and / */
+static int control_item( struct io *io, const struct ftn_item *item )
+{
+	int n;
+
+	switch (item->kind) {
+	case 'X':
+		if (io->reading) io->col += item->w;
+		else for (n = 0; n < item->w; n++) put( io, " ", 1 );
+		return 0;
+	case 'H':
+		if (io->reading) io->col += item->d;
+		else put( io, io->prog->text + item->w, item->d );
+		return 0;
+	case '/':
+		return new_record( io );
+	}
+	return 0;
+}
+
+/* the next I, F or E item, doing the others on the way */
+static const struct ftn_item *next_item( struct io *io )
+{
+	const struct ftn_format *fmt = io->fmt;
+	int reverted = 0;
+
+	for (;;) {
+		const struct ftn_item *item;
+
+		if (io->pos == fmt->count) {
+			if (reverted) {
+				io_error( io, "FORMAT has no I, F or E for the list" );
+				return NULL;
+			}
+			reverted = 1;
+			io->pos = fmt->revert;
+			if (new_record( io ) < 0) return NULL;
+		}
+		item = &io->prog->items[fmt->first + io->pos];
+		if (data_item( item )) {
+			if (io->used < item->repeat) {
+				io->used++;
+				return item;
+			}
+			io->pos++;
+			io->used = 0;
+		} else {
+			io->pos++;
+			if (control_item( io, item ) < 0) return NULL;
+		}
+	}
+}
+
+/* at the end of the list, do the items up to the next I, F or E */
+static int finish( struct io *io )
+{
+	const struct ftn_format *fmt = io->fmt;
+
+	while ((fmt != NULL) && (io->pos < fmt->count)) {
+		const struct ftn_item *item = &io->prog->items[fmt->first + io->pos];
+
+		if (data_item( item )) {
+			if (io->used < item->repeat) break;
+			io->pos++;
+			io->used = 0;
+			continue;
+		}
+		io->pos++;
+		if (control_item( io, item ) < 0) return -1;
+	}
+	if (!io->reading) return new_record( io );
+	return 0;
+}
+
+static int begin( struct io *io, int fmt, int reading )
+{
+	io->fmt = (fmt >= 0) ? &io->prog->formats[fmt] : NULL;
+	io->pos = io->used = 0;
+	io->reading = reading;
+	io->len = 0;
+	return reading ? next_card( io ) : 0;
+}
+
+/* FORTRAN E style: 0.ddddE+ee */
+static void e_format( char *buf, double v, int d )
+{
+	char digits[64], *e;
+	int exp = 0;
+
+	if (d < 1) d = 1;
+	if (d > 30) d = 30;
+	if (v == 0.0) {
+		memset( digits, '0', d );
+		digits[d] = '\0';
+	} else {
+		sprintf( digits, "%.*e", d - 1, fabs( v ) );
+		e = strchr( digits, 'e' );
+		exp = atoi( e + 1 ) + 1;
+		*e = '\0';
+		if (digits[1] == '.') memmove( digits + 1, digits + 2, strlen( digits + 2 ) + 1 );
+	}
+	sprintf( buf, "%s0.%sE%c%02d", (v < 0.0) ? "-" : "", digits,
+		 (exp < 0) ? '-' : '+', abs( exp ) );
+}
+
+static int write_int( struct io *io, int32_t v )
+{
+	const struct ftn_item *item;
+	char buf[64];
+
+	if (io->fmt == NULL) {
+		sprintf( buf, " %d", v );
+		put( io, buf, strlen( buf ) );
+		return 0;
+	}
+	item = next_item( io );
+	if (item == NULL) return -1;
+	if (item->kind != 'I')
+		return io_error( io, "integer written with %c format", item->kind );
+	sprintf( buf, "%d", v );
+	put_field( io, buf, item->w );
+	return 0;
+}
+
+static int write_real( struct io *io, double v )
+{
+	const struct ftn_item *item;
+	char buf[400];
+
+	if (io->fmt == NULL) {
+		double a = fabs( v );
+		if ((a == 0.0) || ((a >= 0.1) && (a < 1e7))) {
+			int before = (a < 1.0) ? 1 : (int)floor( log10( a ) ) + 1;
+			sprintf( buf, " %.*f", 7 - before, v );
+		} else {
+			sprintf( buf, " %.6E", v );
+		}
+		put( io, buf, strlen( buf ) );
+		return 0;
+	}
+	item = next_item( io );
+	if (item == NULL) return -1;
+	if ((item->kind == 'F') || (item->kind == 'E')) {
+		/* too big for buf, infinite or not a number */
+		if (!(fabs( v ) < 1e300)) {
+			stars( io, item->w );
+			return 0;
+		}
+	}
+	if (item->kind == 'F') {
+		/* the decimal point even with no digits after it */
+		sprintf( buf, "%#.*f", item->d, v );
+		/* leave off the leading zero if that makes it fit */
+		if ((int)strlen( buf ) == item->w + 1) {
+			char *z = strstr( buf, "0." );
+			if ((z == buf) || ((z == buf + 1) && (buf[0] == '-')))
+				memmove( z, z + 1, strlen( z ) );
+		}
+	} else if (item->kind == 'E') {
+		e_format( buf, v, item->d );
+	} else {
+		return io_error( io, "real written with %c format", item->kind );
+	}
+	put_field( io, buf, item->w );
+	return 0;
+}
+
+/* the next w columns, blanks removed */
+static void field( struct io *io, char *buf, int w )
+{
+	int n = 0;
+
+	while (w-- > 0) {
+		if ((io->col < FTN_COLUMNS) && (io->card[io->col] != ' '))
+			buf[n++] = io->card[io->col];
+		io->col++;
+	}
+	buf[n] = '\0';
+}
+
+/* the next value of a list directed READ */
+static int token( struct io *io, char *buf )
+{
+	int n = 0;
+
+	for (;;) {
+		while ((io->col < FTN_COLUMNS) && (io->card[io->col] == ' '))
+			io->col++;
+		if (io->col < FTN_COLUMNS) break;
+		if (next_card( io ) < 0) return -1;
+	}
+	while ((io->col < FTN_COLUMNS) && (io->card[io->col] != ' ')
+	    && (io->card[io->col] != ',')) {
+		buf[n++] = io->card[io->col++];
+	}
+	if ((io->col < FTN_COLUMNS) && (io->card[io->col] == ',')) io->col++;
+	buf[n] = '\0';
+	return 0;
+}
+
+static int bad_data( struct io *io, const char *text )
+{
+	return io_error( io, "bad data '%s' on data card %ld", text,
+			 io->run->next_card );
+}
+
+static int read_int( struct io *io, int32_t *v )
+{
+	char buf[FTN_COLUMNS + 1], *end;
+	long n;
+
+	if (io->fmt == NULL) {
+		if (token( io, buf ) < 0) return -1;
+	} else {
+		const struct ftn_item *item = next_item( io );
+		if (item == NULL) return -1;
+		if (item->kind != 'I')
+			return io_error( io, "integer read with %c format", item->kind );
+		field( io, buf, item->w );
+		if (buf[0] == '\0') {
+			*v = 0;
+			return 0;
+		}
+	}
+	n = strtol( buf, &end, 10 );
+	if ((*end != '\0') || (end == buf) || (n > INT32_MAX) || (n < INT32_MIN))
+		return bad_data( io, buf );
+	*v = (int32_t)n;
+	return 0;
+}
+
+static int read_real( struct io *io, double *v )
+{
+	char buf[2 * FTN_COLUMNS + 2], *end, *e;
+	int d = 0;
+
+	if (io->fmt == NULL) {
+		if (token( io, buf ) < 0) return -1;
+	} else {
+		const struct ftn_item *item = next_item( io );
+		if (item == NULL) return -1;
+		if ((item->kind != 'F') && (item->kind != 'E'))
+			return io_error( io, "real read with %c format", item->kind );
+		field( io, buf, item->w );
+		d = item->d;
+		if (buf[0] == '\0') {
+			*v = 0.0;
+			return 0;
+		}
+	}
+
+	/* the exponent may be D, or just a sign after the digits */
+	for (e = buf + 1; *e != '\0'; e++) {
+		if (*e == 'D') *e = 'E';
+		if (((*e == '+') || (*e == '-')) && (e[-1] != 'E')) {
+			memmove( e + 1, e, strlen( e ) + 1 );
+			*e++ = 'E';
+		}
+	}
+	*v = strtod( buf, &end );
+	if ((*end != '\0') || (end == buf)) return bad_data( io, buf );
+
+	/* with no decimal point, the last d digits are the fraction */
+	if ((strchr( buf, '.' ) == NULL) && (d > 0)) {
+		e = strchr( buf, 'E' );
+		if (e != NULL) *e = '\0';
+		*v = strtod( buf, NULL ) / pow( 10.0, d );
+		if (e != NULL) *v *= pow( 10.0, atoi( e + 1 ) );
+	}
+	return 0;
+}
+
+static int trap( const struct ftn_program *prog, struct ftn_run *run,
+		 const struct ftn_insn *at, const char *fmt, ... )
+{
+	char msg[120];
+	va_list ap;
+
+	va_start( ap, fmt );
+	vsnprintf( msg, sizeof msg, fmt, ap );
+	va_end( ap );
+	snprintf( run->error, sizeof run->error, "card %d: %s",
+		  prog->card[at - prog->code], msg );
+	return -1;
+}
+
+int ftn_run( const struct ftn_program *prog, struct ftn_run *run )
+{
+	const struct ftn_insn *code = prog->code, *ip = code, *i;
+	union ftn_value *r, *mem;
+	struct io io;
+	long long count = 0;
+	long long end = (run->limit > 0) ? run->limit + 1 : -1;
+	int status = 0;
+
+	r = malloc( (prog->nregs + 1) * sizeof *r );
+	mem = calloc( prog->memsize + 1, sizeof *mem );
+	if ((r == NULL) || (mem == NULL)) {
+		free( r );
+		free( mem );
+		snprintf( run->error, sizeof run->error, "out of memory" );
+		return -1;
+	}
+	memcpy( r, prog->init, prog->nregs * sizeof *r );
+	memset( &io, 0, sizeof io );
+	io.prog = prog;
+	io.run = run;
+
+	for (;;) {
+		i = ip++;
+		if (++count == end) {
+			status = trap( prog, run, i, "time limit" );
+			goto done;
+		}
+		switch (i->op) {
+		case FTN_MOV:
+			r[i->a] = r[i->b];
+			break;
+		case FTN_IADD:
+			r[i->a].i = (int32_t)((uint32_t)r[i->b].i + (uint32_t)r[i->c].i);
+			break;
+		case FTN_ISUB:
+			r[i->a].i = (int32_t)((uint32_t)r[i->b].i - (uint32_t)r[i->c].i);
+			break;
+		case FTN_IMUL:
+			r[i->a].i = (int32_t)((uint32_t)r[i->b].i * (uint32_t)r[i->c].i);
+			break;
+		case FTN_IDIV:
+		case FTN_IMOD: {
+			int32_t x = r[i->b].i, y = r[i->c].i;
+			if (y == 0) {
+				status = trap( prog, run, i, "integer division by zero" );
+				goto done;
+			}
+			if (y == -1) r[i->a].i = (i->op == FTN_IDIV)
+					? (int32_t)(0 - (uint32_t)x) : 0;
+			else r[i->a].i = (i->op == FTN_IDIV) ? x / y : x % y;
+			break;
+		}
+		case FTN_IPOW: {
+			int32_t x = r[i->b].i, n = r[i->c].i;
+			if (n >= 0) {
+				uint32_t p = 1, b = x;
+				while (n > 0) {
+					if (n & 1) p *= b;
+					b *= b;
+					n >>= 1;
+				}
+				r[i->a].i = (int32_t)p;
+			} else if (x == 0) {
+				status = trap( prog, run, i, "zero to a negative power" );
+				goto done;
+			} else {
+				r[i->a].i = (x == 1) ? 1 : (x == -1) ? ((n & 1) ? -1 : 1) : 0;
+			}
+			break;
+		}
+		case FTN_INEG:
+			r[i->a].i = (int32_t)(0 - (uint32_t)r[i->b].i);
+			break;
+		case FTN_FADD:
+			r[i->a].f = r[i->b].f + r[i->c].f;
+			break;
+		case FTN_FSUB:
+			r[i->a].f = r[i->b].f - r[i->c].f;
+			break;
+		case FTN_FMUL:
+			r[i->a].f = r[i->b].f * r[i->c].f;
+			break;
+		case FTN_FDIV:
+			r[i->a].f = r[i->b].f / r[i->c].f;
+			break;
+		case FTN_FMOD:
+			r[i->a].f = fmod( r[i->b].f, r[i->c].f );
+			break;
+		case FTN_FPOW:
+			r[i->a].f = pow( r[i->b].f, r[i->c].f );
+			break;
+		case FTN_FPOWI: {
+			double x = r[i->b].f, p = 1.0;
+			long n = r[i->c].i, e = (n < 0) ? -n : n;
+			while (e > 0) {
+				if (e & 1) p *= x;
+				x *= x;
+				e >>= 1;
+			}
+			r[i->a].f = (n < 0) ? 1.0 / p : p;
+			break;
+		}
+		case FTN_FNEG:
+			r[i->a].f = -r[i->b].f;
+			break;
+		case FTN_ITOF:
+			r[i->a].f = r[i->b].i;
+			break;
+		case FTN_FTOI:
+			if (!(fabs( r[i->b].f ) < 2147483648.0)) {
+				status = trap( prog, run, i, "%g is too big for an integer",
+					       r[i->b].f );
+				goto done;
+			}
+			r[i->a].i = (int32_t)r[i->b].f;
+			break;
+		case FTN_IEQ: r[i->a].i = r[i->b].i == r[i->c].i; break;
+		case FTN_INE: r[i->a].i = r[i->b].i != r[i->c].i; break;
+		case FTN_ILT: r[i->a].i = r[i->b].i < r[i->c].i; break;
+		case FTN_ILE: r[i->a].i = r[i->b].i <= r[i->c].i; break;
+		case FTN_IGT: r[i->a].i = r[i->b].i > r[i->c].i; break;
+		case FTN_IGE: r[i->a].i = r[i->b].i >= r[i->c].i; break;
+		case FTN_FEQ: r[i->a].i = r[i->b].f == r[i->c].f; break;
+		case FTN_FNE: r[i->a].i = r[i->b].f != r[i->c].f; break;
+		case FTN_FLT: r[i->a].i = r[i->b].f < r[i->c].f; break;
+		case FTN_FLE: r[i->a].i = r[i->b].f <= r[i->c].f; break;
+		case FTN_FGT: r[i->a].i = r[i->b].f > r[i->c].f; break;
+		case FTN_FGE: r[i->a].i = r[i->b].f >= r[i->c].f; break;
+		case FTN_AND: r[i->a].i = r[i->b].i && r[i->c].i; break;
+		case FTN_OR: r[i->a].i = r[i->b].i || r[i->c].i; break;
+		case FTN_NOT: r[i->a].i = !r[i->b].i; break;
+		case FTN_IABS: {
+			int32_t x = r[i->b].i;
+			r[i->a].i = (x < 0) ? (int32_t)(0 - (uint32_t)x) : x;
+			break;
+		}
+		case FTN_FABS:
+			r[i->a].f = fabs( r[i->b].f );
+			break;
+		case FTN_IMAX: {
+			int32_t x = r[i->b].i, y = r[i->c].i;
+			r[i->a].i = (x > y) ? x : y;
+			break;
+		}
+		case FTN_IMIN: {
+			int32_t x = r[i->b].i, y = r[i->c].i;
+			r[i->a].i = (x < y) ? x : y;
+			break;
+		}
+		case FTN_FMAX: {
+			double x = r[i->b].f, y = r[i->c].f;
+			r[i->a].f = (x > y) ? x : y;
+			break;
+		}
+		case FTN_FMIN: {
+			double x = r[i->b].f, y = r[i->c].f;
+			r[i->a].f = (x < y) ? x : y;
+			break;
+		}
+		case FTN_ISIGN: {
+			int32_t x = r[i->b].i;
+			x = (x < 0) ? (int32_t)(0 - (uint32_t)x) : x;
+			r[i->a].i = (r[i->c].i < 0) ? (int32_t)(0 - (uint32_t)x) : x;
+			break;
+		}
+		case FTN_FSIGN:
+			r[i->a].f = (r[i->c].f < 0) ? -fabs( r[i->b].f )
+						    : fabs( r[i->b].f );
+			break;
+		case FTN_SQRT: r[i->a].f = sqrt( r[i->b].f ); break;
+		case FTN_SIN: r[i->a].f = sin( r[i->b].f ); break;
+		case FTN_COS: r[i->a].f = cos( r[i->b].f ); break;
+		case FTN_TAN: r[i->a].f = tan( r[i->b].f ); break;
+		case FTN_ATAN: r[i->a].f = atan( r[i->b].f ); break;
+		case FTN_EXP: r[i->a].f = exp( r[i->b].f ); break;
+		case FTN_LOG: r[i->a].f = log( r[i->b].f ); break;
+		case FTN_LOG10: r[i->a].f = log10( r[i->b].f ); break;
+		case FTN_ALOAD:
+		case FTN_ASTORE: {
+			const struct ftn_array *a = &prog->arrays[i->b];
+			int32_t k = r[i->c].i;
+			if ((k < 1) || (k > a->size)) {
+				status = trap( prog, run, i, "subscript %d out of"
+					       " range 1 to %d", k, a->size );
+				goto done;
+			}
+			if (i->op == FTN_ALOAD) r[i->a] = mem[a->base + k - 1];
+			else mem[a->base + k - 1] = r[i->a];
+			break;
+		}
+		case FTN_JMP:
+			ip = code + i->a;
+			break;
+		case FTN_JZ:
+			if (r[i->a].i == 0) ip = code + i->c;
+			break;
+		case FTN_IIF:
+			if (r[i->a].i < 0) ip = code + i->b;
+			else if (r[i->a].i == 0) ip = code + i->c;
+			break;
+		case FTN_FIF:
+			if (r[i->a].f < 0) ip = code + i->b;
+			else if (r[i->a].f == 0) ip = code + i->c;
+			break;
+		case FTN_CGOTO: {
+			int32_t k = r[i->a].i;
+			ip = ((k >= 1) && (k <= i->b)) ? i + k : i + i->b + 1;
+			break;
+		}
+		case FTN_LOOP: {
+			int64_t v = (int64_t)r[i->a].i + r[i->b + 1].i;
+			r[i->a].i = (int32_t)v;
+			if ((r[i->b + 1].i > 0) ? (v <= r[i->b].i) : (v >= r[i->b].i))
+				ip = code + i->c;
+			break;
+		}
+		case FTN_WBEGIN:
+		case FTN_RBEGIN:
+			if (begin( &io, i->a, i->op == FTN_RBEGIN ) < 0) goto io_trap;
+			break;
+		case FTN_WINT:
+			if (write_int( &io, r[i->a].i ) < 0) goto io_trap;
+			break;
+		case FTN_WREAL:
+			if (write_real( &io, r[i->a].f ) < 0) goto io_trap;
+			break;
+		case FTN_RINT:
+			if (read_int( &io, &r[i->a].i ) < 0) goto io_trap;
+			break;
+		case FTN_RREAL:
+			if (read_real( &io, &r[i->a].f ) < 0) goto io_trap;
+			break;
+		case FTN_WTEXT:
+			if (io.fmt != NULL) {
+				io_error( &io, "quoted text needs list directed output" );
+				goto io_trap;
+			}
+			put( &io, " ", 1 );
+			put( &io, prog->text + i->a, i->b );
+			break;
+		case FTN_WEND:
+		case FTN_REND:
+			if (finish( &io ) < 0) goto io_trap;
+			if ((run->max_lines > 0) && (run->lines > run->max_lines)) {
+				status = trap( prog, run, i, "line limit" );
+				goto done;
+			}
+			break;
+		case FTN_PAUSE:
+			if (run->spool != NULL) spool_flush( run->spool );
+			else fflush( run->out );
+			fprintf( stderr, "PAUSE\n" );
+			break;
+		case FTN_STOP:
+			goto done;
+		default:
+			status = trap( prog, run, i, "bad operation %d", i->op );
+			goto done;
+		}
+	}
+
+io_trap:
+	status = trap( prog, run, i, "%s", io.why );
+done:
+	if (run->spool != NULL) spool_flush( run->spool );
+	else fflush( run->out );
+	run->count += count;
+	free( r );
+	free( mem );
+	return status;
+}
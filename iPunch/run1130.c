@@ -0,0 +1,203 @@
+/* run1130.c -- run a card deck on an emulated IBM 1130.
+ *
+ * operation:  run run1130 -help for instructions
+ *
+ * build: cc -o run1130 run1130.c sim1130.c ebcdic.c cardconv.c cardcodec.c
+ *
+ * input  -- a card-image file: a program load card, then whatever the
+ *           program it loads reads from the 1442
+ * output -- the console printer, as text
+ *
+ * The deck goes into the 1442 hopper and PROGRAM LOAD is pressed: the
+ * first card is read into words 0-79 and the machine starts at 0.  It
+ * runs until it waits with nothing left to interrupt it, or does
+ * something invalid.
+ *
+ * -bench ignores any deck and times a nested counting loop.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sim1130.h"
+#include "cardconv.h"
+
+#define SHORT( op, tag, disp ) (((op) << 11) | ((tag) << 8) | ((disp) & 0xFF))
+#define LONG( op, tag )	(((op) << 11) | 0x0400 | ((tag) << 8))
+
+static double now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* sum a constant inner * outer times, five instructions a pass */
+static double bench( struct sim1130 *m, long passes )
+{
+	static const uint16_t loop[] = {
+		LONG( 014, 2 ), 0,	/* 100 LDX L2 -outer */
+		LONG( 014, 1 ), 0,	/* 102 LDX L1 -inner */
+		SHORT( 030, 0, 0x0B ),	/* 104 LD one */
+		SHORT( 020, 0, 0x0B ),	/* 105 A sum */
+		SHORT( 032, 0, 0x0A ),	/* 106 STO sum */
+		SHORT( 016, 1, 1 ),	/* 107 MDX 1 +1, skip at zero */
+		SHORT( 016, 0, -5 ),	/* 108 MDX back to 104 */
+		SHORT( 016, 2, 1 ),	/* 109 MDX 2 +1, skip at zero */
+		SHORT( 016, 0, -9 ),	/* 10A MDX back to 102 */
+		SHORT( 006, 0, 0 ),	/* 10B WAIT */
+	};
+	long outer = (passes + 999) / 1000;
+	double start;
+
+	sim1130_init( m, 4096 );
+	memcpy( m->mem + 0x100, loop, sizeof loop );
+	m->mem[0x101] = -outer;
+	m->mem[0x103] = -1000;
+	m->mem[0x110] = 1;
+	m->iar = 0x100;
+
+	start = now();
+	if (sim1130_run( m, -1 ) != SIM1130_WAIT) {
+		fprintf( stderr, "run1130: benchmark failed, %s\n", m->error );
+		exit(-1);
+	}
+	return m->count / (now() - start);
+}
+
+static unsigned char *read_all( FILE *f, size_t *len )
+{
+	size_t cap = 1 << 16, got;
+	unsigned char *buf = malloc( cap );
+
+	*len = 0;
+	while ((buf != NULL) && ((got = fread( buf + *len, 1, cap - *len, f )) > 0)) {
+		*len += got;
+		if (*len == cap) buf = realloc( buf, cap *= 2 );
+	}
+	return buf;
+}
+
+static void usage( const char *progname )
+{
+	fprintf( stderr, "\n%s [options] [deck]\n\n", progname );
+	fprintf( stderr,
+	"Program load and run a card deck on an emulated IBM 1130.\n"
+	"If the deck is missing, read it from stdin.  The options are:\n\n"
+	" -mem n          storage words, a power of 2 to 32768 (32768)\n"
+	" -print file     console printer output (stdout)\n"
+	" -switches n     console entry switches, in hex (0)\n"
+	" -limit n        stop after n instructions\n"
+	" -stats          report instructions and time on stderr\n\n"
+	" -bench [n]      time n passes of a loop instead (10000000)\n\n"
+	);
+	exit(-1);
+}
+
+int main( int argc, char *argv[] )
+{
+	static struct sim1130 machine;
+	struct sim1130 *m = &machine;
+	FILE *deck_fd = stdin, *print_fd = stdout;
+	unsigned char *deck;
+	size_t len;
+	long long limit = -1;
+	long passes = 0, switches = 0;
+	int memsize = SIM1130_MAXMEM, stats = 0;
+	int arg = 1, err, stop;
+	double start;
+
+	while ((arg < argc) && (argv[arg][0] == '-')) { /* command line arg */
+		if ((strcmp(argv[arg],"-mem") == 0) && (arg + 1 < argc)) {
+			memsize = atoi( argv[++arg] );
+		} else if ((strcmp(argv[arg],"-print") == 0) && (arg + 1 < argc)) {
+			print_fd = fopen( argv[++arg], "w" );
+			if (print_fd == NULL) {
+				fprintf( stderr, "%s %s: invalid print file\n",
+					 argv[0], argv[arg] );
+				exit(-1);
+			}
+		} else if ((strcmp(argv[arg],"-switches") == 0) && (arg + 1 < argc)) {
+			switches = strtol( argv[++arg], NULL, 16 );
+		} else if ((strcmp(argv[arg],"-limit") == 0) && (arg + 1 < argc)) {
+			limit = atoll( argv[++arg] );
+		} else if (strcmp(argv[arg],"-stats") == 0) {
+			stats = 1;
+		} else if (strcmp(argv[arg],"-bench") == 0) {
+			passes = 10000000;
+			if ((arg + 1 < argc) && (argv[arg + 1][0] != '-'))
+				passes = atol( argv[++arg] );
+		} else if (strcmp(argv[arg],"-help") == 0) {
+			usage( argv[0] );
+		} else {
+			fprintf( stderr, "%s: unknown option %s;"
+					 " -help available\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+		arg++;
+	}
+
+	if (passes > 0) {
+		double rate;
+		if (passes > 32767000) passes = 32767000;
+		rate = bench( m, passes );
+		printf( "%lld instructions\n", m->count );
+		printf( "%.0f instructions/s\n", rate );
+		exit(0);
+	}
+
+	if ( (argc - arg) > 1 ) { /* too many arguments */
+		fprintf( stderr, "%s: too many arguments\n", argv[0] );
+		exit(-1);
+	}
+	if ( (argc - arg) == 1 ) {
+		deck_fd = fopen( argv[arg], "r" );
+		if (deck_fd == NULL) {
+			fprintf( stderr, "%s %s: invalid card file\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+	}
+	deck = read_all( deck_fd, &len );
+	if (deck == NULL) {
+		fprintf( stderr, "%s: out of memory\n", argv[0] );
+		exit(-1);
+	}
+
+	sim1130_init( m, memsize );
+	m->printer = print_fd;
+	m->switches = switches;
+	err = sim1130_attach_deck( m, deck, len );
+	if (err != CARD_OK) {
+		fprintf( stderr, "%s: %s\n", argv[0], card_strerror( err ) );
+		exit(-1);
+	}
+
+	start = now();
+	stop = sim1130_program_load( m );
+	if (stop == SIM1130_WAIT) stop = sim1130_run( m, limit );
+	else m->error = "no cards to load";
+	if (stats) {
+		double elapsed = now() - start;
+		fprintf( stderr, "%lld instructions, %.3f s, %.0f instructions/s\n",
+			 m->count, elapsed,
+			 (elapsed > 0) ? m->count / elapsed : 0.0 );
+		fprintf( stderr, "%ld cards read\n", m->next_card );
+	}
+
+	fflush( print_fd );
+	switch (stop) {
+	case SIM1130_WAIT:
+		fprintf( stderr, "wait, IAR = %04X, ACC = %04X\n", m->iar, m->acc );
+		exit(0);
+	case SIM1130_LIMIT:
+		fprintf( stderr, "instruction limit, IAR = %04X\n", m->iar );
+		exit(1);
+	default:
+		fprintf( stderr, "%s at %04X\n", m->error, m->iar );
+		exit(-1);
+	}
+}
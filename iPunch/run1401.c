@@ -0,0 +1,271 @@
+/* run1401.c -- run a card deck on an emulated IBM 1401.
+ *
+ * operation:  run run1401 -help for instructions
+ *
+ * build: cc -o run1401 run1401.c sim1401.c simevent.c spool.c cardconv.c
+ *        cardcodec.c
+ *
+ * input  -- a card-image file, as made by cardmake, holding a
+ *           self-loading 1401 object deck and any data cards after it
+ * output -- the printer, as text with a form feed at each page, and
+ *           the punch, as a card-image file
+ *
+ * The deck goes into the hopper of a virtual 1402 and the LOAD key is
+ * pressed: the first card is read into 001-080, 001 gets a word mark,
+ * and the machine starts at 001.  It runs until it halts, reads with
+ * an empty hopper, or does something invalid.
+ *
+ * Decks for the 1401 were punched on the 026; cardmake -026comm makes
+ * the right codes, and for programs that use only letters, digits and
+ * the , . / # @ $ * - & characters, -029 does as well.
+ *
+ * -index writes the printer's page index, for going straight to any
+ * page of a long listing; see spool.h.
+ *
+ * The reader, punch and printer take as long as a 1402 and a 1403 did,
+ * in simulated time; -unthrottled makes them take none, and -stats
+ * reports the simulated time and how much of it was I/O.
+ *
+ * -bench ignores any deck and runs a small counting loop, first with
+ * the decoded instruction cache and then without, and reports
+ * instructions per second for each.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sim1401.h"
+#include "cardconv.h"
+
+static double now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* ASCII text into storage from addr up, with a word mark on the first */
+static void put_text( struct sim1401 *m, int addr, const char *s )
+{
+	int first = 1;
+	for (; *s != '\0'; s++, addr++) {
+		m->mem[addr] = sim1401_from_ascii( *s ) | (first ? SIM1401_WM : 0);
+		first = 0;
+	}
+}
+
+/* add 1 to a six digit counter until it matches a limit; four
+   instructions a pass, all of them variable length and chained */
+static double bench( struct sim1401 *m, long passes, int use_cache )
+{
+	char limit[8];
+	double start;
+
+	sim1401_init( m, 4000 );
+	m->use_cache = use_cache;
+	sprintf( limit, "%06ld", passes );
+	put_text( m, 500, "000000" );		/* counter */
+	put_text( m, 510, "1" );		/* increment */
+	put_text( m, 520, limit );
+	put_text( m, 600, "000000" );		/* copy of the counter */
+	put_text( m, 400, "A510505" );		/* counter += 1 */
+	put_text( m, 407, "M505605" );		/* copy it */
+	put_text( m, 414, "C525505" );		/* compare with limit */
+	put_text( m, 421, "B400/" );		/* loop while unequal */
+	put_text( m, 426, "." );		/* halt */
+	put_text( m, 427, " " );
+	m->I = 400;
+
+	start = now();
+	if (sim1401_run( m, -1 ) != SIM1401_HALT) {
+		fprintf( stderr, "run1401: benchmark failed, %s\n", m->error );
+		exit(-1);
+	}
+	return m->count / (now() - start);
+}
+
+static unsigned char *read_all( FILE *f, size_t *len )
+{
+	size_t cap = 1 << 16, got;
+	unsigned char *buf = malloc( cap );
+
+	*len = 0;
+	while ((buf != NULL) && ((got = fread( buf + *len, 1, cap - *len, f )) > 0)) {
+		*len += got;
+		if (*len == cap) buf = realloc( buf, cap *= 2 );
+	}
+	return buf;
+}
+
+static void usage( const char *progname )
+{
+	fprintf( stderr, "\n%s [options] [deck]\n\n", progname );
+	fprintf( stderr,
+	"Load and run a card deck on an emulated IBM 1401.  If the\n"
+	"deck is missing, read it from stdin.  The options are:\n\n"
+	" -mem n          storage size, 1400 to 16000 (16000)\n"
+	" -print file     printer output (stdout)\n"
+	" -index file     the printer's page index\n"
+	" -form n         lines on a page (66)\n"
+	" -punch file     punched cards, as a card-image file\n"
+	" -H80 -H82       punched card format (H80)\n"
+	" -limit n        stop after n instructions\n"
+	" -nocache        decode every instruction every time\n"
+	" -unthrottled    the reader, punch and printer take no time\n"
+	" -stats          report instructions and time on stderr\n\n"
+	" -bench [n]      time n passes of a loop instead (100000)\n\n"
+	);
+	exit(-1);
+}
+
+int main( int argc, char *argv[] )
+{
+	static struct sim1401 machine;
+	struct sim1401 *m = &machine;
+	FILE *deck_fd = stdin, *print_fd = stdout, *punch_fd = NULL;
+	FILE *index_fd = NULL;
+	struct spool printer;
+	unsigned char *deck;
+	size_t len;
+	long long limit = -1;
+	long passes = 0;
+	int memsize = SIM1401_MAXMEM, use_cache = 1, stats = 0, format = 80;
+	int unthrottled = 0, form = SPOOL_FORM;
+	int arg = 1, err, stop;
+	double start;
+
+	while ((arg < argc) && (argv[arg][0] == '-')) { /* command line arg */
+		if ((strcmp(argv[arg],"-mem") == 0) && (arg + 1 < argc)) {
+			memsize = atoi( argv[++arg] );
+		} else if ((strcmp(argv[arg],"-print") == 0) && (arg + 1 < argc)) {
+			print_fd = fopen( argv[++arg], "w" );
+			if (print_fd == NULL) {
+				fprintf( stderr, "%s %s: invalid print file\n",
+					 argv[0], argv[arg] );
+				exit(-1);
+			}
+		} else if ((strcmp(argv[arg],"-index") == 0) && (arg + 1 < argc)) {
+			index_fd = fopen( argv[++arg], "wb" );
+			if (index_fd == NULL) {
+				fprintf( stderr, "%s %s: invalid index file\n",
+					 argv[0], argv[arg] );
+				exit(-1);
+			}
+		} else if ((strcmp(argv[arg],"-form") == 0) && (arg + 1 < argc)) {
+			form = atoi( argv[++arg] );
+		} else if ((strcmp(argv[arg],"-punch") == 0) && (arg + 1 < argc)) {
+			punch_fd = fopen( argv[++arg], "w" );
+			if (punch_fd == NULL) {
+				fprintf( stderr, "%s %s: invalid punch file\n",
+					 argv[0], argv[arg] );
+				exit(-1);
+			}
+		} else if (strcmp(argv[arg],"-H80") == 0) {
+			format = 80;
+		} else if (strcmp(argv[arg],"-H82") == 0) {
+			format = 82;
+		} else if ((strcmp(argv[arg],"-limit") == 0) && (arg + 1 < argc)) {
+			limit = atoll( argv[++arg] );
+		} else if (strcmp(argv[arg],"-nocache") == 0) {
+			use_cache = 0;
+		} else if (strcmp(argv[arg],"-unthrottled") == 0) {
+			unthrottled = 1;
+		} else if (strcmp(argv[arg],"-stats") == 0) {
+			stats = 1;
+		} else if (strcmp(argv[arg],"-bench") == 0) {
+			passes = 100000;
+			if ((arg + 1 < argc) && (argv[arg + 1][0] != '-'))
+				passes = atol( argv[++arg] );
+		} else if (strcmp(argv[arg],"-help") == 0) {
+			usage( argv[0] );
+		} else {
+			fprintf( stderr, "%s: unknown option %s;"
+					 " -help available\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+		arg++;
+	}
+
+	if (passes > 0) {
+		double cached, uncached;
+		if (passes > 999999) passes = 999999;
+		cached = bench( m, passes, 1 );
+		uncached = bench( m, passes, 0 );
+		printf( "%lld instructions per run\n", m->count );
+		printf( "cached      %12.0f instructions/s\n", cached );
+		printf( "uncached    %12.0f instructions/s\n", uncached );
+		printf( "speedup     %12.2f\n", cached / uncached );
+		exit(0);
+	}
+
+	if ( (argc - arg) > 1 ) { /* too many arguments */
+		fprintf( stderr, "%s: too many arguments\n", argv[0] );
+		exit(-1);
+	}
+	if ( (argc - arg) == 1 ) {
+		deck_fd = fopen( argv[arg], "r" );
+		if (deck_fd == NULL) {
+			fprintf( stderr, "%s %s: invalid card file\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+	}
+	deck = read_all( deck_fd, &len );
+	if (deck == NULL) {
+		fprintf( stderr, "%s: out of memory\n", argv[0] );
+		exit(-1);
+	}
+
+	sim1401_init( m, memsize );
+	m->use_cache = use_cache;
+	if (unthrottled) m->wheel.mode = SIM_UNTHROTTLED;
+	if (spool_open( &printer, print_fd, form ) != 0) {
+		fprintf( stderr, "%s: out of memory\n", argv[0] );
+		exit(-1);
+	}
+	m->printer = &printer;
+	m->punch = punch_fd;
+	m->punch_opt.format = format;
+	err = sim1401_attach_deck( m, deck, len );
+	if (err != CARD_OK) {
+		fprintf( stderr, "%s: %s\n", argv[0], card_strerror( err ) );
+		exit(-1);
+	}
+
+	start = now();
+	stop = sim1401_load( m );
+	if (stop == SIM1401_HALT) stop = sim1401_run( m, limit );
+	if (stats) {
+		double elapsed = now() - start;
+		fprintf( stderr, "%lld instructions, %.3f s, %.0f instructions/s\n",
+			 m->count, elapsed,
+			 (elapsed > 0) ? m->count / elapsed : 0.0 );
+		fprintf( stderr, "%.3f s simulated, %.3f s of it I/O\n",
+			 sim1401_time( m ) * 1e-9, m->io_wait * 1e-9 );
+		fprintf( stderr, "%ld cards read, %ld punched, %ld lines printed"
+				 " on %ld pages\n", m->next_card, m->punched,
+			 m->printed, printer.npages );
+	}
+
+	if (punch_fd != NULL) fclose( punch_fd );
+	if (spool_close( &printer, index_fd ) != 0)
+		fprintf( stderr, "%s: error writing the printer\n", argv[0] );
+	if (index_fd != NULL) fclose( index_fd );
+	switch (stop) {
+	case SIM1401_HALT:
+		fprintf( stderr, "halt, I = %05d\n", m->I );
+		exit(0);
+	case SIM1401_HOPPER:
+		fprintf( stderr, "reader empty, I = %05d\n", m->I );
+		exit(0);
+	case SIM1401_LIMIT:
+		fprintf( stderr, "instruction limit, I = %05d\n", m->I );
+		exit(1);
+	default:
+		fprintf( stderr, "%s at %05d\n", m->error, m->I );
+		exit(-1);
+	}
+}
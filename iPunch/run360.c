@@ -0,0 +1,491 @@
+/* run360.c -- run an object deck on an emulated IBM System/360.
+ *
+ * operation:  run run360 -help for instructions
+ *
+ * build: cc -o run360 run360.c sim360.c simevent.c spool.c ebcdic.c
+ *        cardconv.c cardcodec.c -lpthread
+ *
+ * input  -- a card-image file holding an object deck, as an assembler
+ *           punches it, and any data cards after it
+ * output -- WTO messages, as text with a form feed at each page
+ *
+ * The deck goes into the hopper of a virtual 2540 and is loaded; the
+ * program is entered at the END card's entry point and runs until it
+ * returns, issues SVC 3 or SVC 13, loads a wait PSW, or takes a
+ * program check with no program to handle it.  Cards must be punched
+ * in the System/360 card code, as cardmake -EBCDIC punches them.
+ *
+ * -index writes the printer's page index, for going straight to any
+ * page of a long listing; see spool.h.
+ *
+ * -save writes a snapshot of the machine when it stops, for whatever
+ * reason; -restore starts from one instead of loading the deck, with
+ * the reader at the card it had reached, so a deck that boots into a
+ * warm state can be saved once and each run after that starts there.
+ * See sim360.h.
+ *
+ * The reader and printer run at the speeds of a 2540 and a 1403, in
+ * simulated time; -unthrottled makes them take none, and -stats
+ * reports the simulated time and how much of it went to waiting.
+ *
+ * -bench ignores any deck.  It punches an object deck for a compute
+ * loop (a linear congruential generator driving a table of counters),
+ * loads and runs it through the reader, first with the block cache and
+ * then decoding every instruction, checks the answer both times, and
+ * reports instructions per second for each; then the same for a loop
+ * that stores its counter in the 64 bytes its code is in, as programs
+ * with their data beside their code do.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sim360.h"
+#include "cardconv.h"
+#include "ebcdic.h"
+
+static double now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* the benchmark program, assembled at 1000 with R12 as base, 1002 */
+static const unsigned char bench_code[] = {
+	0x05, 0xC0,				/* 1000 BALR 12,0 */
+	0x58, 0x30, 0xC0, 0xFE,			/* 1002 L    3,COUNT */
+	0x58, 0x50, 0xC1, 0x02,			/* 1006 L    5,SEED */
+	0x1B, 0x44,				/* 100A SR   4,4 */
+	0x18, 0x75,				/* 100C LOOP LR 7,5 */
+	0x5C, 0x60, 0xC1, 0x06,			/* 100E M    6,MULT */
+	0x5E, 0x70, 0xC1, 0x0A,			/* 1012 AL   7,INC */
+	0x18, 0x57,				/* 1016 LR   5,7 */
+	0x88, 0x70, 0x00, 0x18,			/* 1018 SRL  7,24 */
+	0x1B, 0x88,				/* 101C SR   8,8 */
+	0x43, 0x87, 0xC1, 0xFE,			/* 101E IC   8,TABLE(7) */
+	0x17, 0x45,				/* 1022 XR   4,5 */
+	0x1E, 0x48,				/* 1024 ALR  4,8 */
+	0x41, 0x88, 0x00, 0x01,			/* 1026 LA   8,1(8) */
+	0x42, 0x87, 0xC1, 0xFE,			/* 102A STC  8,TABLE(7) */
+	0x46, 0x30, 0xC0, 0x0A,			/* 102E BCT  3,LOOP */
+	0x50, 0x40, 0xC1, 0x12,			/* 1032 ST   4,RESULT */
+	0x54, 0x40, 0xC1, 0x0E,			/* 1036 N    4,MASK */
+	0x4E, 0x40, 0xC1, 0x16,			/* 103A CVD  4,DW */
+	0xF3, 0xE7, 0xC1, 0x2B, 0xC1, 0x16,	/* 103E UNPK OUT(15),DW */
+	0x96, 0xF0, 0xC1, 0x39,			/* 1044 OI   OUT+14,X'F0' */
+	0x41, 0x10, 0xC1, 0x1E,			/* 1048 LA   1,MSG */
+	0x0A, 0x23,				/* 104C SVC  35 */
+	0x1B, 0xFF,				/* 104E SR   15,15 */
+	0x07, 0xFE,				/* 1050 BR   14 */
+};
+
+#define ORIGIN	0x1000
+#define COUNT	0x1100
+#define SEED	0x1104
+#define MULT	0x1108
+#define INC	0x110C
+#define MASK	0x1110
+#define RESULT	0x1114
+#define MSG	0x1120	/* WTO list: length, flags, "CHECKSUM ", OUT */
+#define TABLE	0x1200
+#define END	0x1300
+
+/* a counting loop storing its counter in the line its code is in, as
+   an assembler lays out code and data; assembled at 1400, base 1402 */
+static const unsigned char near_code[] = {
+	0x05, 0xC0,				/* 1400 BALR 12,0 */
+	0x58, 0x30, 0xC0, 0x1A,			/* 1402 L    3,NCOUNT */
+	0x1B, 0x44,				/* 1406 SR   4,4 */
+	0x41, 0x44, 0x00, 0x01,			/* 1408 LOOP LA 4,1(4) */
+	0x50, 0x40, 0xC0, 0x16,			/* 140C ST   4,CTR */
+	0x46, 0x30, 0xC0, 0x06,			/* 1410 BCT  3,LOOP */
+	0x1B, 0xFF,				/* 1414 SR   15,15 */
+	0x07, 0xFE,				/* 1416 BR   14 */
+};
+
+#define NEAR	0x1400
+#define CTR	0x1418
+#define NCOUNT	0x141C
+#define NEAR_END 0x1420
+
+static void put_word( unsigned char *p, unsigned long v )
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+/* one card of EBCDIC bytes onto the end of an H80 deck */
+static void punch( struct card_buf *deck, const unsigned char *card )
+{
+	struct card_options opt;
+	unsigned char *p;
+	int i, c0, c1;
+
+	card_options_init( &opt );
+	if (card_buf_reserve( deck, deck->len + 3 + 123 ) != CARD_OK) {
+		fprintf( stderr, "run360: out of memory\n" );
+		exit(-1);
+	}
+	p = deck->data + deck->len;
+	if (deck->len == 0) {
+		memcpy( p, "H80", 3 );
+		p += 3;
+	}
+	*p++ = 0x80 | (opt.color << 3) | (opt.corner << 2) | opt.cut;
+	*p++ = 0x80 | (opt.interp << 6) | (opt.punch << 3) | opt.form;
+	*p++ = 0x80 | opt.logo;
+	for (i = 0; i < 80; i += 2) {
+		c0 = ebcdic_to_hollerith( card[i] );
+		c1 = ebcdic_to_hollerith( card[i + 1] );
+		*p++ = c0 >> 4;
+		*p++ = ((c0 & 017) << 4) | (c1 >> 8);
+		*p++ = c1 & 0377;
+	}
+	deck->len = p - deck->data;
+}
+
+/* a fresh object deck card: X'02', the type, blanks, the sequence */
+static void start_card( unsigned char *card, const char *type, int seq )
+{
+	char id[9];
+	int i;
+
+	memset( card, 0x40, 80 );
+	card[0] = 0x02;
+	for (i = 0; i < 3; i++) card[1 + i] = ebcdic_from_ascii( type[i] );
+	sprintf( id, "BENC%04d", seq % 10000 );
+	for (i = 0; i < 8; i++) card[72 + i] = ebcdic_from_ascii( id[i] );
+}
+
+/* punch storage from..to-1 as an object deck: ESD, TXT, END */
+static void object_deck( struct card_buf *deck, const unsigned char *mem,
+			 unsigned long from, unsigned long to,
+			 unsigned long entry )
+{
+	static const char name[] = "BENCH   ";
+	unsigned char card[80];
+	unsigned long addr;
+	int i, seq = 1;
+
+	start_card( card, "ESD", seq++ );
+	card[10] = 0;
+	card[11] = 16;
+	card[14] = 0;
+	card[15] = 1;
+	for (i = 0; i < 8; i++) card[16 + i] = ebcdic_from_ascii( name[i] );
+	put_word( card + 24, from );		/* type SD, the address */
+	put_word( card + 28, to - from );	/* and the length */
+	card[24] = 0x00;
+	card[28] = 0x40;
+	punch( deck, card );
+
+	for (addr = from; addr < to; addr += 56) {
+		int count = (to - addr < 56) ? to - addr : 56;
+		start_card( card, "TXT", seq++ );
+		put_word( card + 4, addr );
+		card[4] = 0x40;
+		card[10] = 0;
+		card[11] = count;
+		card[14] = 0;
+		card[15] = 1;
+		memcpy( card + 16, mem + addr, count );
+		punch( deck, card );
+	}
+
+	start_card( card, "END", seq++ );
+	put_word( card + 4, entry );
+	card[4] = 0x40;
+	card[14] = 0;
+	card[15] = 1;
+	punch( deck, card );
+}
+
+/* the answer the benchmark should get */
+static unsigned long reference( long passes, unsigned long seed,
+				const unsigned char *table )
+{
+	unsigned char t[256];
+	unsigned long sum = 0;
+	int i;
+
+	memcpy( t, table, 256 );
+	for (; passes > 0; passes--) {
+		seed = (seed * 0x41C64E6DUL + 12345) & 0xFFFFFFFFUL;
+		i = seed >> 24;
+		sum = ((sum ^ seed) + t[i]) & 0xFFFFFFFFUL;
+		t[i]++;
+	}
+	return sum;
+}
+
+static double bench( struct sim360 *m, const struct card_buf *deck,
+		     int use_cache, unsigned long result, unsigned long expect )
+{
+	unsigned long got;
+	double start;
+	int stop;
+
+	if ((sim360_init( m, 64 << 10 ) != CARD_OK)
+	 || (sim360_attach_deck( m, deck->data, deck->len ) != CARD_OK)) {
+		fprintf( stderr, "run360: out of memory\n" );
+		exit(-1);
+	}
+	m->use_cache = use_cache;
+	if (sim360_load( m ) != 0) {
+		fprintf( stderr, "run360: benchmark deck, %s\n", m->error );
+		exit(-1);
+	}
+
+	start = now();
+	stop = sim360_run( m, -1 );
+	start = now() - start;
+	got = ((unsigned long)m->mem[result] << 24) | (m->mem[result + 1] << 16)
+	    | (m->mem[result + 2] << 8) | m->mem[result + 3];
+	if ((stop != SIM360_EXIT) || (got != expect)) {
+		fprintf( stderr, "run360: benchmark failed, stop %d, %s,"
+				 " checksum %08lX, not %08lX\n",
+			 stop, m->error ? m->error : "no error", got, expect );
+		exit(-1);
+	}
+	return m->count / start;
+}
+
+static void run_bench( struct sim360 *m, long passes )
+{
+	static const char text[] = "CHECKSUM ";
+	static unsigned char mem[NEAR_END];
+	struct card_buf deck = { NULL, 0, 0 }, near = { NULL, 0, 0 };
+	unsigned long expect;
+	double cached, naive, near_cached, near_naive;
+	int i;
+
+	memcpy( mem + ORIGIN, bench_code, sizeof bench_code );
+	put_word( mem + COUNT, passes );
+	put_word( mem + SEED, 1 );
+	put_word( mem + MULT, 0x41C64E6DUL );
+	put_word( mem + INC, 12345 );
+	put_word( mem + MASK, 0x7FFFFFFFUL );
+	mem[MSG + 1] = 4 + 9 + 15;
+	for (i = 0; i < 9; i++) mem[MSG + 4 + i] = ebcdic_from_ascii( text[i] );
+	for (i = 0; i < 256; i++) mem[TABLE + i] = i * 7;
+	object_deck( &deck, mem, ORIGIN, END, ORIGIN );
+	expect = reference( passes, 1, mem + TABLE );
+	memcpy( mem + NEAR, near_code, sizeof near_code );
+	put_word( mem + NCOUNT, passes );
+	object_deck( &near, mem, NEAR, NEAR_END, NEAR );
+
+	cached = bench( m, &deck, 1, RESULT, expect );
+	printf( "%lld instructions, checksum %08lX\n", m->count, expect );
+	sim360_free( m );
+	naive = bench( m, &deck, 0, RESULT, expect );
+	sim360_free( m );
+	near_cached = bench( m, &near, 1, CTR, passes );
+	sim360_free( m );
+	near_naive = bench( m, &near, 0, CTR, passes );
+	sim360_free( m );
+	printf( "%.0f instructions/s with the block cache\n", cached );
+	printf( "%.0f instructions/s decoding each instruction\n", naive );
+	printf( "%.2f times faster\n", cached / naive );
+	printf( "storing into the line of the code, %.0f and %.0f,"
+		" %.2f times faster\n", near_cached, near_naive,
+		near_cached / near_naive );
+	card_buf_free( &deck );
+	card_buf_free( &near );
+}
+
+static unsigned char *read_all( FILE *f, size_t *len )
+{
+	size_t cap = 1 << 16, got;
+	unsigned char *buf = malloc( cap );
+
+	*len = 0;
+	while ((buf != NULL) && ((got = fread( buf + *len, 1, cap - *len, f )) > 0)) {
+		*len += got;
+		if (*len == cap) buf = realloc( buf, cap *= 2 );
+	}
+	return buf;
+}
+
+static void usage( const char *progname )
+{
+	fprintf( stderr, "\n%s [options] [deck]\n\n", progname );
+	fprintf( stderr,
+	"Load and run an object deck on an emulated IBM System/360.\n"
+	"If the deck is missing, read it from stdin.  The options are:\n\n"
+	" -mem n          storage in K, 4 to 16384 (256)\n"
+	" -print file     WTO output (stdout)\n"
+	" -index file     the printer's page index\n"
+	" -form n         lines on a page (66)\n"
+	" -limit n        stop after n instructions\n"
+	" -save file      write a snapshot of the machine when it stops\n"
+	" -restore file   start from a snapshot instead of loading\n"
+	" -nocache        decode every instruction every time\n"
+	" -unthrottled    the reader and printer take no time\n"
+	" -stats          report instructions and time on stderr\n\n"
+	" -bench [n]      time n passes of a loop instead (1000000)\n\n"
+	);
+	exit(-1);
+}
+
+int main( int argc, char *argv[] )
+{
+	static struct sim360 machine;
+	struct sim360 *m = &machine;
+	FILE *deck_fd = stdin, *print_fd = stdout, *index_fd = NULL;
+	FILE *save_fd = NULL;
+	const char *restore = NULL;
+	struct spool printer;
+	unsigned char *deck;
+	size_t len;
+	long long limit = -1;
+	long passes = 0, memk = 256;
+	int use_cache = 1, unthrottled = 0, stats = 0, form = SPOOL_FORM;
+	int arg = 1, err, stop;
+	double start;
+
+	while ((arg < argc) && (argv[arg][0] == '-')) { /* command line arg */
+		if ((strcmp(argv[arg],"-mem") == 0) && (arg + 1 < argc)) {
+			memk = atol( argv[++arg] );
+		} else if ((strcmp(argv[arg],"-print") == 0) && (arg + 1 < argc)) {
+			print_fd = fopen( argv[++arg], "w" );
+			if (print_fd == NULL) {
+				fprintf( stderr, "%s %s: invalid print file\n",
+					 argv[0], argv[arg] );
+				exit(-1);
+			}
+		} else if ((strcmp(argv[arg],"-index") == 0) && (arg + 1 < argc)) {
+			index_fd = fopen( argv[++arg], "wb" );
+			if (index_fd == NULL) {
+				fprintf( stderr, "%s %s: invalid index file\n",
+					 argv[0], argv[arg] );
+				exit(-1);
+			}
+		} else if ((strcmp(argv[arg],"-form") == 0) && (arg + 1 < argc)) {
+			form = atoi( argv[++arg] );
+		} else if ((strcmp(argv[arg],"-limit") == 0) && (arg + 1 < argc)) {
+			limit = atoll( argv[++arg] );
+		} else if ((strcmp(argv[arg],"-save") == 0) && (arg + 1 < argc)) {
+			save_fd = fopen( argv[++arg], "wb" );
+			if (save_fd == NULL) {
+				fprintf( stderr, "%s %s: invalid snapshot file\n",
+					 argv[0], argv[arg] );
+				exit(-1);
+			}
+		} else if ((strcmp(argv[arg],"-restore") == 0) && (arg + 1 < argc)) {
+			restore = argv[++arg];
+		} else if (strcmp(argv[arg],"-nocache") == 0) {
+			use_cache = 0;
+		} else if (strcmp(argv[arg],"-unthrottled") == 0) {
+			unthrottled = 1;
+		} else if (strcmp(argv[arg],"-stats") == 0) {
+			stats = 1;
+		} else if (strcmp(argv[arg],"-bench") == 0) {
+			passes = 1000000;
+			if ((arg + 1 < argc) && (argv[arg + 1][0] != '-'))
+				passes = atol( argv[++arg] );
+		} else if (strcmp(argv[arg],"-help") == 0) {
+			usage( argv[0] );
+		} else {
+			fprintf( stderr, "%s: unknown option %s;"
+					 " -help available\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+		arg++;
+	}
+
+	if (passes > 0) {
+		run_bench( m, passes );
+		exit(0);
+	}
+
+	if ( (argc - arg) > 1 ) { /* too many arguments */
+		fprintf( stderr, "%s: too many arguments\n", argv[0] );
+		exit(-1);
+	}
+	if ( (argc - arg) == 1 ) {
+		deck_fd = fopen( argv[arg], "r" );
+		if (deck_fd == NULL) {
+			fprintf( stderr, "%s %s: invalid card file\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+	}
+	deck = read_all( deck_fd, &len );
+	if ((deck == NULL) || (memk < 4) || (memk > 16384)
+	 || (sim360_init( m, memk << 10 ) != CARD_OK)
+	 || (spool_open( &printer, print_fd, form ) != 0)) {
+		fprintf( stderr, "%s: out of memory\n", argv[0] );
+		exit(-1);
+	}
+	m->use_cache = use_cache;
+	if (unthrottled) m->wheel.mode = SIM_UNTHROTTLED;
+	m->printer = &printer;
+	err = sim360_attach_deck( m, deck, len );
+	if (err != CARD_OK) {
+		fprintf( stderr, "%s: %s\n", argv[0], card_strerror( err ) );
+		exit(-1);
+	}
+	start = now();
+	if (((restore != NULL) ? sim360_restore( m, restore )
+			       : sim360_load( m )) != 0) {
+		fprintf( stderr, "%s: %s\n", argv[0], m->error );
+		exit(-1);
+	}
+	if (stats && (restore != NULL))
+		fprintf( stderr, "restored in %.1f us\n", (now() - start) * 1e6 );
+
+	start = now();
+	stop = sim360_run( m, limit );
+	if ((save_fd != NULL)
+	 && ((sim360_save( m, save_fd ) != 0) || (fclose( save_fd ) != 0)))
+		fprintf( stderr, "%s: error writing the snapshot\n", argv[0] );
+	if (stats) {
+		double elapsed = now() - start;
+		fprintf( stderr, "%lld instructions, %.3f s, %.0f instructions/s\n",
+			 m->count, elapsed,
+			 (elapsed > 0) ? m->count / elapsed : 0.0 );
+		fprintf( stderr, "%.3f s simulated, %.3f s of it waiting for"
+				 " the reader, %.3f s for the printer\n",
+			 sim360_time( m ) * 1e-9, m->reader.waited * 1e-9,
+			 m->print_unit.waited * 1e-9 );
+		fprintf( stderr, "%ld cards read, %ld lines printed on %ld pages\n",
+			 m->next_card, m->print_unit.ops, printer.npages );
+	}
+
+	if (spool_close( &printer, index_fd ) != 0)
+		fprintf( stderr, "%s: error writing the printer\n", argv[0] );
+	if (index_fd != NULL) fclose( index_fd );
+	switch (stop) {
+	case SIM360_EXIT:
+		if (m->r[15] != 0)
+			fprintf( stderr, "return code %lu\n",
+				 (unsigned long)m->r[15] );
+		exit(m->r[15] ? 1 : 0);
+	case SIM360_LIMIT:
+		fprintf( stderr, "instruction limit, PSW address %06lX\n",
+			 (unsigned long)m->ia );
+		exit(1);
+	case SIM360_WAIT:
+		fprintf( stderr, "wait state, PSW address %06lX\n",
+			 (unsigned long)m->ia );
+		exit(1);
+	case SIM360_ABEND:
+		fprintf( stderr, "abend, completion code %06lX\n",
+			 (unsigned long)m->abend );
+		exit(-1);
+	default:
+		if (m->interruption)
+			fprintf( stderr, "%s, interruption code %d, PSW address"
+					 " %06lX\n", m->error, m->interruption,
+				 (unsigned long)m->ia );
+		else	fprintf( stderr, "%s, PSW address %06lX\n", m->error,
+				 (unsigned long)m->ia );
+		exit(-1);
+	}
+}
@@ -0,0 +1,354 @@
+/* runftn.c -- compile and run a FORTRAN deck.
+ *
+ * operation:  run runftn -help for instructions
+ *
+ * build: cc -o runftn runftn.c ftncomp.c ftnvm.c ftncache.c spool.c
+ *        cardconv.c cardcodec.c -lm
+ *
+ * input  -- a FORTRAN program followed by its data cards, as a card-image
+ *           file or as plain text, one card per line
+ * output -- what the program writes, as text
+ *
+ * This stands in for sending the deck to a compile service: the program
+ * is compiled to bytecode and run here, with no network, in a small
+ * fraction of the time a round trip would take.
+ *
+ * With -cache, compiled programs are kept in a directory, keyed by their
+ * program cards, and a deck whose program is there is not compiled
+ * again; see ftncache.h.
+ *
+ * With -spool, output goes to a spooled 1403 listing, the first
+ * character of each line taking the carriage where it says, as in the
+ * FORMATs of the day: 1H1 for a new page, 1H0 to double space, 1H for
+ * the next line; -index writes the listing's page index.  See spool.h.
+ *
+ * -bench compiles and runs a built-in program n times and reports the
+ * average time of each step, through the cache if one is given.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ftn.h"
+#include "ftncache.h"
+#include "cardconv.h"
+
+static double now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static const char *op_names[FTN_NOPS] = {
+	"MOV", "IADD", "ISUB", "IMUL", "IDIV", "IMOD", "IPOW", "INEG",
+	"FADD", "FSUB", "FMUL", "FDIV", "FMOD", "FPOW", "FPOWI", "FNEG",
+	"ITOF", "FTOI", "IEQ", "INE", "ILT", "ILE", "IGT", "IGE",
+	"FEQ", "FNE", "FLT", "FLE", "FGT", "FGE", "AND", "OR", "NOT",
+	"IABS", "FABS", "IMAX", "IMIN", "FMAX", "FMIN", "ISIGN", "FSIGN",
+	"SQRT", "SIN", "COS", "TAN", "ATAN", "EXP", "LOG", "LOG10",
+	"ALOAD", "ASTORE", "JMP", "JZ", "IIF", "FIF", "CGOTO", "LOOP",
+	"WBEGIN", "WINT", "WREAL", "WEND", "RBEGIN", "RINT", "RREAL",
+	"REND", "WTEXT", "PAUSE", "STOP"
+};
+
+/* the built-in benchmark: primes by sieve, and a table of roots */
+static const char bench_deck[] =
+"C     BENCHMARK FOR RUNFTN\n"
+"      DIMENSION KEEP(5000), ROOT(20,20)\n"
+"      N = 5000\n"
+"      DO 10 I = 1, N\n"
+"   10 KEEP(I) = 1\n"
+"      KEEP(1) = 0\n"
+"      DO 30 I = 2, 70\n"
+"      IF (KEEP(I) .EQ. 0) GO TO 30\n"
+"      DO 20 J = I * I, N, I\n"
+"   20 KEEP(J) = 0\n"
+"   30 CONTINUE\n"
+"      NP = 0\n"
+"      DO 40 I = 1, N\n"
+"   40 NP = NP + KEEP(I)\n"
+"      SCALE = 4.0 * ATAN(1.0) / 180.0\n"
+"      DO 60 J = 1, 20\n"
+"      DO 50 I = 1, 20\n"
+"   50 ROOT(I,J) = SQRT(FLOAT(I*J)) * COS(SCALE * FLOAT(J))\n"
+"   60 CONTINUE\n"
+"      SUM = 0.0\n"
+"      DO 70 J = 1, 20\n"
+"      DO 70 I = 1, 20\n"
+"   70 SUM = SUM + ROOT(I,J)\n"
+"      WRITE (6,100) NP, SUM\n"
+"  100 FORMAT (1X, 6HPRIMES, I6, 5X, 3HSUM, F12.4)\n"
+"      STOP\n"
+"      END\n";
+
+static unsigned char *read_all( FILE *f, size_t *len )
+{
+	size_t cap = 1 << 16, got;
+	unsigned char *buf = malloc( cap );
+
+	*len = 0;
+	while ((buf != NULL) && ((got = fread( buf + *len, 1, cap - *len, f )) > 0)) {
+		*len += got;
+		if (*len == cap) buf = realloc( buf, cap *= 2 );
+	}
+	return buf;
+}
+
+static void list_code( const struct ftn_program *prog, FILE *f )
+{
+	int i;
+
+	for (i = 0; i < prog->ncode; i++) {
+		const struct ftn_insn *insn = &prog->code[i];
+		fprintf( f, "%5d  card %-4d %-7s %d, %d, %d\n", i, prog->card[i],
+			 ((insn->op >= 0) && (insn->op < FTN_NOPS))
+			 ? op_names[insn->op] : "?", insn->a, insn->b, insn->c );
+	}
+	fprintf( f, "%d instructions, %d registers, %d array elements,"
+		    " %d operations folded, %d expressions hoisted\n",
+		 prog->ncode, prog->nregs, prog->memsize, prog->folded,
+		 prog->hoisted );
+}
+
+static void bench( long n, struct ftn_cache *cache )
+{
+	struct card_options opt;
+	struct card_codec codec;
+	struct ftn_deck deck;
+	double compile = 0.0, run = 0.0, start;
+	long i;
+	FILE *null = fopen( "/dev/null", "w" );
+
+	card_options_init( &opt );
+	card_codec_init( &codec, &opt );
+	if ((null == NULL) || (ftn_read_deck( &deck, (const unsigned char *)bench_deck,
+			sizeof bench_deck - 1, &codec ) != CARD_OK)) {
+		fprintf( stderr, "runftn: out of memory\n" );
+		exit(-1);
+	}
+	for (i = 0; i < n; i++) {
+		struct ftn_program prog;
+		struct ftn_run r;
+
+		start = now();
+		if (((cache != NULL)
+		     ? ftn_cache_compile( cache, &prog, &deck, ftn_program_cards( &deck ) )
+		     : ftn_compile( &prog, &deck, ftn_program_cards( &deck ) )) < 0) {
+			fprintf( stderr, "runftn: %s\n", prog.error );
+			exit(-1);
+		}
+		compile += now() - start;
+
+		memset( &r, 0, sizeof r );
+		r.out = (i == 0) ? stdout : null;
+		start = now();
+		if (ftn_run( &prog, &r ) < 0) {
+			fprintf( stderr, "runftn: %s\n", r.error );
+			exit(-1);
+		}
+		run += now() - start;
+		if (i == 0) {
+			printf( "%d instructions, %d folded, %d hoisted;"
+				" %lld executed\n", prog.ncode, prog.folded,
+				prog.hoisted, r.count );
+		}
+		ftn_free( &prog );
+	}
+	printf( "%ld runs: %.1f us to compile, %.1f us to run, on average\n",
+		n, compile / n * 1e6, run / n * 1e6 );
+	if (cache != NULL) {
+		printf( "cache: %ld hits, %ld misses\n", cache->hits,
+			cache->misses );
+	}
+	ftn_free_deck( &deck );
+	fclose( null );
+}
+
+static void usage( const char *progname )
+{
+	fprintf( stderr, "\n%s [options] [deck]\n\n", progname );
+	fprintf( stderr,
+	"Compile and run a FORTRAN deck: the program, through its END card,\n"
+	"and then its data cards.  If the deck is missing, read it from\n"
+	"stdin.  It may be a card-image file or text.  The options are:\n\n"
+	" -026comm        what translation table to use\n"
+	" -029 -026ftn    for a card-image deck (029 default)\n"
+	" -EBCDIC\n\n"
+	" -print file     program output (stdout)\n"
+	" -spool          print it as a listing, column 1 carriage control\n"
+	" -index file     the listing's page index, for -spool\n"
+	" -form n         lines on a page (66), for -spool\n"
+	" -code           list the compiled code on stderr\n"
+	" -stats          report compile and run time on stderr\n\n"
+	" -cache dir      keep compiled programs in dir\n"
+	" -cachesize n    remove the least recently used programs to keep\n"
+	"                 the cache under n kilobytes (10240; 0 no limit)\n\n"
+	" -bench [n]      time compiling and running a built-in program\n"
+	"                 n times instead (1000)\n\n"
+	);
+	exit(-1);
+}
+
+int main( int argc, char *argv[] )
+{
+	FILE *deck_fd = stdin, *print_fd = stdout;
+	struct card_options opt;
+	struct card_codec codec;
+	struct ftn_deck deck;
+	struct ftn_program prog;
+	struct ftn_run run;
+	struct ftn_cache cache;
+	const char *cache_dir = NULL;
+	long long cache_size = 10240;
+	unsigned char *buf;
+	size_t len;
+	long nbench = 0, ncards;
+	int code = 0, stats = 0, spooled = 0, form = SPOOL_FORM;
+	FILE *index_fd = NULL;
+	struct spool listing;
+	int arg = 1, err, status;
+	double start, compiled;
+
+	card_options_init( &opt );
+	while ((arg < argc) && (argv[arg][0] == '-')) { /* command line arg */
+		if (card_list_option( &opt, argv[arg] )) {
+			/* translation table */
+		} else if ((strcmp(argv[arg],"-print") == 0) && (arg + 1 < argc)) {
+			print_fd = fopen( argv[++arg], "w" );
+			if (print_fd == NULL) {
+				fprintf( stderr, "%s %s: invalid print file\n",
+					 argv[0], argv[arg] );
+				exit(-1);
+			}
+		} else if (strcmp(argv[arg],"-spool") == 0) {
+			spooled = 1;
+		} else if ((strcmp(argv[arg],"-index") == 0) && (arg + 1 < argc)) {
+			index_fd = fopen( argv[++arg], "wb" );
+			if (index_fd == NULL) {
+				fprintf( stderr, "%s %s: invalid index file\n",
+					 argv[0], argv[arg] );
+				exit(-1);
+			}
+			spooled = 1;
+		} else if ((strcmp(argv[arg],"-form") == 0) && (arg + 1 < argc)) {
+			form = atoi( argv[++arg] );
+		} else if ((strcmp(argv[arg],"-cache") == 0) && (arg + 1 < argc)) {
+			cache_dir = argv[++arg];
+		} else if ((strcmp(argv[arg],"-cachesize") == 0) && (arg + 1 < argc)) {
+			cache_size = atoll( argv[++arg] );
+		} else if (strcmp(argv[arg],"-code") == 0) {
+			code = 1;
+		} else if (strcmp(argv[arg],"-stats") == 0) {
+			stats = 1;
+		} else if (strcmp(argv[arg],"-bench") == 0) {
+			nbench = 1000;
+			if ((arg + 1 < argc) && (argv[arg + 1][0] != '-'))
+				nbench = atol( argv[++arg] );
+		} else if (strcmp(argv[arg],"-help") == 0) {
+			usage( argv[0] );
+		} else {
+			fprintf( stderr, "%s: unknown option %s;"
+					 " -help available\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+		arg++;
+	}
+
+	if ((cache_dir != NULL)
+	 && (ftn_cache_open( &cache, cache_dir, cache_size * 1024 ) != 0)) {
+		fprintf( stderr, "%s %s: invalid cache directory\n",
+			 argv[0], cache_dir );
+		exit(-1);
+	}
+
+	if (nbench > 0) {
+		bench( nbench, (cache_dir != NULL) ? &cache : NULL );
+		exit(0);
+	}
+
+	if ( (argc - arg) > 1 ) { /* too many arguments */
+		fprintf( stderr, "%s: too many arguments\n", argv[0] );
+		exit(-1);
+	}
+	if ( (argc - arg) == 1 ) {
+		deck_fd = fopen( argv[arg], "r" );
+		if (deck_fd == NULL) {
+			fprintf( stderr, "%s %s: invalid card file\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+	}
+	buf = read_all( deck_fd, &len );
+	if (buf == NULL) {
+		fprintf( stderr, "%s: out of memory\n", argv[0] );
+		exit(-1);
+	}
+	card_codec_init( &codec, &opt );
+	err = ftn_read_deck( &deck, buf, len, &codec );
+	if (err != CARD_OK) {
+		fprintf( stderr, "%s: %s\n", argv[0], card_strerror( err ) );
+		exit(-1);
+	}
+	free( buf );
+
+	start = now();
+	ncards = ftn_program_cards( &deck );
+	if (((cache_dir != NULL) ? ftn_cache_compile( &cache, &prog, &deck, ncards )
+				 : ftn_compile( &prog, &deck, ncards )) < 0) {
+		fprintf( stderr, "%s: %s\n", argv[0], prog.error );
+		exit(-1);
+	}
+	compiled = now();
+	if (code) list_code( &prog, stderr );
+
+	memset( &run, 0, sizeof run );
+	run.out = print_fd;
+	if (spooled) {
+		if (spool_open( &listing, print_fd, form ) != 0) {
+			fprintf( stderr, "%s: out of memory\n", argv[0] );
+			exit(-1);
+		}
+		run.spool = &listing;
+	}
+	run.deck = &deck;
+	run.next_card = ncards;
+	status = ftn_run( &prog, &run );
+	if (spooled) {
+		if (stats)
+			fprintf( stderr, "%lld lines printed on %ld pages\n",
+				 listing.printed, listing.npages );
+		if (spool_close( &listing, index_fd ) != 0)
+			fprintf( stderr, "%s: error writing the listing\n",
+				 argv[0] );
+		if (index_fd != NULL) fclose( index_fd );
+	}
+	if (stats) {
+		fprintf( stderr, "%ld program cards, %ld data cards read;"
+				 " %.3f ms to compile, %.3f ms to run,"
+				 " %lld instructions\n",
+			 ncards, run.next_card - ncards,
+			 (compiled - start) * 1e3, (now() - compiled) * 1e3,
+			 run.count );
+		if (cache_dir != NULL) {
+			long files;
+			long long bytes;
+			ftn_cache_usage( &cache, &files, &bytes );
+			fprintf( stderr, "cache %s %s; %ld evicted (%lld bytes);"
+					 " %ld programs, %lld bytes in %s\n",
+				 cache.last_hit ? "hit" : "miss", cache.last_key,
+				 cache.evictions, cache.evicted_bytes,
+				 files, bytes, cache_dir );
+		}
+	}
+	if (status < 0) {
+		fprintf( stderr, "%s: %s\n", argv[0], run.error );
+		exit(1);
+	}
+	ftn_free( &prog );
+	ftn_free_deck( &deck );
+	exit(0);
+}
@@ -0,0 +1,320 @@
+/* runpdp8.c -- run a card job on an emulated PDP-8/E.
+ *
+ * operation:  run runpdp8 -help for instructions
+ *
+ * build: cc -o runpdp8 runpdp8.c simpdp8.c simevent.c cardconv.c
+ *        cardcodec.c -lpthread
+ *
+ * input  -- a card-image file for the CR8-E, punched with the DEC 029
+ *           code (cardmake -029), and optionally a BIN format program
+ * output -- the teleprinter, as text
+ *
+ * With no -bin program, a small card lister is loaded at 0200: it reads
+ * each card in alphanumeric mode and types it on the teleprinter.  The
+ * run ends when the program halts or waits for a device that has
+ * nothing more to give it.
+ *
+ * -unthrottled runs the devices at no speed at all: the teleprinter
+ * types and the reader reads as fast as the program can take them.
+ *
+ * -bench makes a deck of n cards, lists it with the idle detector,
+ * without it, and unthrottled, and reports simulated and host time for
+ * each.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "simpdp8.h"
+#include "cardconv.h"
+
+static double now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* the card lister, at 0200; the card buffer is 0300-0417 */
+static const uint16_t lister[] = {
+	07300,	/* 0200 START, CLA CLL */
+	06046,	/* 0201        TLS		/ the printer flag comes up */
+	06672,	/* 0202 NEXT,  RCSE		/ feed a card */
+	07402,	/* 0203        HLT		/ hopper empty */
+	01247,	/* 0204        TAD BUFP */
+	03010,	/* 0205        DCA 10 */
+	01250,	/* 0206        TAD M80 */
+	03251,	/* 0207        DCA CNT */
+	06631,	/* 0210 COL,   RCSF */
+	05210,	/* 0211        JMP .-1 */
+	06632,	/* 0212        RCRA */
+	03410,	/* 0213        DCA I 10 */
+	02251,	/* 0214        ISZ CNT */
+	05210,	/* 0215        JMP COL */
+	01247,	/* 0216        TAD BUFP */
+	03010,	/* 0217        DCA 10 */
+	01250,	/* 0220        TAD M80 */
+	03251,	/* 0221        DCA CNT */
+	01410,	/* 0222 PR,    TAD I 10		/ six bit to ASCII */
+	03252,	/* 0223        DCA CH */
+	01252,	/* 0224        TAD CH */
+	00253,	/* 0225        AND K40 */
+	07650,	/* 0226        SNA CLA */
+	01254,	/* 0227        TAD K100 */
+	01252,	/* 0230        TAD CH */
+	04241,	/* 0231        JMS TYPE */
+	02251,	/* 0232        ISZ CNT */
+	05222,	/* 0233        JMP PR */
+	01255,	/* 0234        TAD KCR */
+	04241,	/* 0235        JMS TYPE */
+	01256,	/* 0236        TAD KLF */
+	04241,	/* 0237        JMS TYPE */
+	05202,	/* 0240        JMP NEXT */
+	00000,	/* 0241 TYPE,  0 */
+	06041,	/* 0242        TSF */
+	05242,	/* 0243        JMP .-1 */
+	06046,	/* 0244        TLS */
+	07200,	/* 0245        CLA */
+	05641,	/* 0246        JMP I TYPE */
+	00277,	/* 0247 BUFP,  0277 */
+	07660,	/* 0250 M80,   -120 */
+	00000,	/* 0251 CNT,   0 */
+	00000,	/* 0252 CH,    0 */
+	00040,	/* 0253 K40,   40 */
+	00100,	/* 0254 K100,  100 */
+	00015,	/* 0255 KCR,   15 */
+	00012,	/* 0256 KLF,   12 */
+};
+
+static unsigned char *read_all( FILE *f, size_t *len )
+{
+	size_t cap = 1 << 16, got;
+	unsigned char *buf = malloc( cap );
+
+	*len = 0;
+	while ((buf != NULL) && ((got = fread( buf + *len, 1, cap - *len, f )) > 0)) {
+		*len += got;
+		if (*len == cap) buf = realloc( buf, cap *= 2 );
+	}
+	return buf;
+}
+
+static void bench( struct simpdp8 *m, long ncards )
+{
+	struct card_options opt;
+	struct card_codec codec;
+	struct card_buf text = { NULL, 0, 0 }, deck = { NULL, 0, 0 };
+	long i;
+	int pass;
+
+	card_options_init( &opt );
+	opt.table = CARD_029;
+	card_codec_init( &codec, &opt );
+	for (i = 0; i < ncards; i++) {
+		if (card_buf_reserve( &text, text.len + 81 ) != CARD_OK) {
+			fprintf( stderr, "runpdp8: out of memory\n" );
+			exit(-1);
+		}
+		text.len += sprintf( (char *)text.data + text.len,
+				     "C CARD %05ld OF THE BENCHMARK DECK\n", i + 1 );
+	}
+	if (card_make_buffer( &codec, text.data, text.len, &deck ) != CARD_OK) {
+		fprintf( stderr, "runpdp8: out of memory\n" );
+		exit(-1);
+	}
+
+	for (pass = 0; pass < 3; pass++) {
+		double start, host;
+		int stop;
+
+		simpdp8_init( m );
+		m->idle_detect = (pass != 1);
+		if (pass == 2) m->wheel.mode = SIM_UNTHROTTLED;
+		memcpy( m->mem + 0200, lister, sizeof lister );
+		if (simpdp8_attach_deck( m, deck.data, deck.len ) != CARD_OK) {
+			fprintf( stderr, "runpdp8: out of memory\n" );
+			exit(-1);
+		}
+		start = now();
+		stop = simpdp8_run( m, -1 );
+		host = now() - start;
+		if ((stop != SIMPDP8_HALT) || (m->next_card != ncards)
+		 || (m->cr_missed != 0)) {
+			fprintf( stderr, "runpdp8: benchmark failed\n" );
+			exit(-1);
+		}
+		printf( "%s: %.1f s simulated, %.3f s host, %lld instructions\n",
+			(pass == 0) ? "idle detection"
+			: (pass == 1) ? "no idle detection" : "unthrottled",
+			m->time * 1e-9, host, m->count );
+		simpdp8_detach_deck( m );
+	}
+	card_buf_free( &text );
+	card_buf_free( &deck );
+}
+
+static void usage( const char *progname )
+{
+	fprintf( stderr, "\n%s [options] [deck]\n\n", progname );
+	fprintf( stderr,
+	"Run a card job on an emulated PDP-8/E with a CR8-E reader.\n"
+	"If the deck is missing, read it from stdin.  The options are:\n\n"
+	" -bin file       load a BIN format program instead of the lister\n"
+	" -start n        start address, in octal, field in the high\n"
+	"                 three bits of five digits (200)\n"
+	" -switches n     switch register, in octal (0)\n"
+	" -keyboard file  characters typed on the keyboard\n"
+	" -print file     teleprinter output (stdout)\n"
+	" -noidle         run device wait loops instruction by instruction\n"
+	" -unthrottled    devices take no time\n"
+	" -limit n        stop after n instructions\n"
+	" -stats          report instructions and time on stderr\n\n"
+	" -bench [n]      time listing n cards instead (20)\n\n"
+	);
+	exit(-1);
+}
+
+int main( int argc, char *argv[] )
+{
+	static struct simpdp8 machine;
+	struct simpdp8 *m = &machine;
+	FILE *deck_fd = stdin, *print_fd = stdout, *kb_fd = NULL;
+	const char *bin = NULL;
+	unsigned char *deck;
+	size_t len;
+	long long limit = -1;
+	long start_addr = 0200, switches = 0, ncards = 0;
+	int idle_detect = 1, unthrottled = 0, stats = 0;
+	int arg = 1, err, stop;
+	double start;
+
+	while ((arg < argc) && (argv[arg][0] == '-')) { /* command line arg */
+		if ((strcmp(argv[arg],"-bin") == 0) && (arg + 1 < argc)) {
+			bin = argv[++arg];
+		} else if ((strcmp(argv[arg],"-start") == 0) && (arg + 1 < argc)) {
+			start_addr = strtol( argv[++arg], NULL, 8 ) & 077777;
+		} else if ((strcmp(argv[arg],"-switches") == 0) && (arg + 1 < argc)) {
+			switches = strtol( argv[++arg], NULL, 8 ) & 07777;
+		} else if ((strcmp(argv[arg],"-keyboard") == 0) && (arg + 1 < argc)) {
+			kb_fd = fopen( argv[++arg], "r" );
+			if (kb_fd == NULL) {
+				fprintf( stderr, "%s %s: invalid keyboard file\n",
+					 argv[0], argv[arg] );
+				exit(-1);
+			}
+		} else if ((strcmp(argv[arg],"-print") == 0) && (arg + 1 < argc)) {
+			print_fd = fopen( argv[++arg], "w" );
+			if (print_fd == NULL) {
+				fprintf( stderr, "%s %s: invalid print file\n",
+					 argv[0], argv[arg] );
+				exit(-1);
+			}
+		} else if (strcmp(argv[arg],"-noidle") == 0) {
+			idle_detect = 0;
+		} else if (strcmp(argv[arg],"-unthrottled") == 0) {
+			unthrottled = 1;
+		} else if ((strcmp(argv[arg],"-limit") == 0) && (arg + 1 < argc)) {
+			limit = atoll( argv[++arg] );
+		} else if (strcmp(argv[arg],"-stats") == 0) {
+			stats = 1;
+		} else if (strcmp(argv[arg],"-bench") == 0) {
+			ncards = 20;
+			if ((arg + 1 < argc) && (argv[arg + 1][0] != '-'))
+				ncards = atol( argv[++arg] );
+		} else if (strcmp(argv[arg],"-help") == 0) {
+			usage( argv[0] );
+		} else {
+			fprintf( stderr, "%s: unknown option %s;"
+					 " -help available\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+		arg++;
+	}
+
+	if (ncards > 0) {
+		bench( m, ncards );
+		exit(0);
+	}
+
+	if ( (argc - arg) > 1 ) { /* too many arguments */
+		fprintf( stderr, "%s: too many arguments\n", argv[0] );
+		exit(-1);
+	}
+	if ( (argc - arg) == 1 ) {
+		deck_fd = fopen( argv[arg], "r" );
+		if (deck_fd == NULL) {
+			fprintf( stderr, "%s %s: invalid card file\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+	}
+	deck = read_all( deck_fd, &len );
+	if (deck == NULL) {
+		fprintf( stderr, "%s: out of memory\n", argv[0] );
+		exit(-1);
+	}
+
+	simpdp8_init( m );
+	m->idle_detect = idle_detect;
+	if (unthrottled) m->wheel.mode = SIM_UNTHROTTLED;
+	m->printer = print_fd;
+	m->sr = switches;
+	simpdp8_attach_keyboard( m, kb_fd );
+	if (bin != NULL) {
+		FILE *f = fopen( bin, "rb" );
+		unsigned char *tape;
+		size_t tape_len;
+		if ((f == NULL) || ((tape = read_all( f, &tape_len )) == NULL)) {
+			fprintf( stderr, "%s %s: invalid BIN file\n",
+				 argv[0], bin );
+			exit(-1);
+		}
+		if (simpdp8_load_bin( m, tape, tape_len ) < 0) {
+			fprintf( stderr, "%s %s: bad BIN format or checksum\n",
+				 argv[0], bin );
+			exit(-1);
+		}
+		fclose( f );
+		free( tape );
+	} else {
+		memcpy( m->mem + 0200, lister, sizeof lister );
+	}
+	m->pc = start_addr & 07777;
+	m->ifield = m->ib = m->dfield = (start_addr >> 12) << 12;
+
+	err = simpdp8_attach_deck( m, deck, len );
+	if (err != CARD_OK) {
+		fprintf( stderr, "%s: %s\n", argv[0], card_strerror( err ) );
+		exit(-1);
+	}
+
+	start = now();
+	stop = simpdp8_run( m, limit );
+	if (stats) {
+		double elapsed = now() - start;
+		fprintf( stderr, "%lld instructions, %.3f s host, %.3f s"
+				 " simulated, %.3f s of it skipped idle\n",
+			 m->count, elapsed, m->time * 1e-9, m->idle_time * 1e-9 );
+		fprintf( stderr, "%ld cards read, %ld columns missed\n",
+			 m->next_card, m->cr_missed );
+	}
+
+	fflush( print_fd );
+	switch (stop) {
+	case SIMPDP8_HALT:
+		fprintf( stderr, "halt, PC = %o%04o, AC = %04o\n",
+			 m->ifield >> 12, m->pc, m->ac );
+		exit(0);
+	case SIMPDP8_IDLE:
+		fprintf( stderr, "waiting with nothing to come, PC = %o%04o\n",
+			 m->ifield >> 12, m->pc );
+		exit(0);
+	default:
+		fprintf( stderr, "instruction limit, PC = %o%04o\n",
+			 m->ifield >> 12, m->pc );
+		exit(1);
+	}
+}
@@ -0,0 +1,671 @@
+/* sim1130.c -- IBM 1130 emulator core.
+ *
+ * The full 1130 instruction set, the six interrupt levels, the 1442
+ * reader, the console printer and the console entry switches.  There
+ * is no disk, so DM2 itself cannot be loaded; decks that are complete
+ * in themselves, such as cold start and stand-alone programs, can.
+ *
+ * The console printer takes EBCDIC in bits 0-7 of the output word, not
+ * the printer's own tilt and rotate code.
+ *
+ * see sim1130.h for the reader and the dispatch scheme.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "sim1130.h"
+#include "cardconv.h"
+#include "ebcdic.h"
+
+#if defined(__GNUC__) && !defined(SIM1130_NO_THREADS)
+#define SIM1130_THREADED
+#endif
+
+/* op codes, bits 0-4 of the first word */
+#define OP_XIO	001
+#define OP_SL	002	/* SLA SLCA SLT SLC */
+#define OP_SR	003	/* SRA SRT RTE */
+#define OP_LDS	004
+#define OP_STS	005
+#define OP_WAIT	006
+#define OP_BSI	010
+#define OP_BSC	011
+#define OP_LDX	014
+#define OP_STX	015
+#define OP_MDX	016
+#define OP_A	020
+#define OP_AD	021
+#define OP_S	022
+#define OP_SD	023
+#define OP_M	024
+#define OP_D	025
+#define OP_LD	030
+#define OP_LDD	031
+#define OP_STO	032
+#define OP_STD	033
+#define OP_AND	034
+#define OP_OR	035
+#define OP_EOR	036
+
+#define F_LONG	0x0400	/* two word instruction */
+#define IA	0x0080	/* indirect, long form */
+#define BOSC	0x0040	/* branch out: end the active interrupt level */
+
+/* branch and skip conditions */
+#define C_ZERO	0x20
+#define C_MINUS	0x10
+#define C_PLUS	0x08
+#define C_EVEN	0x04
+#define C_CARRY	0x02	/* carry off */
+#define C_OVER	0x01	/* overflow off */
+
+void sim1130_init( struct sim1130 *m, int memsize )
+{
+	memset( m, 0, sizeof *m );
+	if ((memsize <= 0) || (memsize > SIM1130_MAXMEM)
+	||  (memsize & (memsize - 1))) {
+		memsize = SIM1130_MAXMEM;
+	}
+	m->memsize = memsize;
+	m->cr_dsw = SIM1130_CR_NOT_READY;
+}
+
+int sim1130_attach_deck( struct sim1130 *m, const unsigned char *deck,
+			 size_t len )
+{
+	long ncards, card;
+	int err, col;
+	size_t card_bytes;
+
+	err = card_validate_buffer( deck, len, &ncards );
+	if (err != CARD_OK) return err;
+	card_bytes = (deck[2] == '0') ? 3 + 120 : 3 + 123;
+
+	sim1130_detach_deck( m );
+	m->deck = malloc( (ncards ? ncards : 1) * 80 * sizeof(uint16_t) );
+	if (m->deck == NULL) return CARD_ENOMEM;
+	for (card = 0; card < ncards; card++) {
+		const unsigned char *p = deck + 3 + card * card_bytes + 3;
+		uint16_t cols[82];
+		int n = (card_bytes == 3 + 120) ? 80 : 82;
+		for (col = 0; col < n; col += 2, p += 3) {
+			cols[col] = (p[0] << 4) | (p[1] >> 4);
+			cols[col + 1] = ((p[1] & 0017) << 8) | p[2];
+		}
+		memcpy( m->deck + card * 80, cols + ((n == 82) ? 1 : 0),
+			80 * sizeof(uint16_t) );
+	}
+	m->ncards = ncards;
+	m->next_card = 0;
+	m->cr_dsw = ncards ? 0 : SIM1130_CR_NOT_READY;
+	return CARD_OK;
+}
+
+void sim1130_detach_deck( struct sim1130 *m )
+{
+	free( m->deck );
+	m->deck = NULL;
+	m->ncards = m->next_card = 0;
+	m->card = NULL;
+	m->cr_dsw = SIM1130_CR_NOT_READY;
+}
+
+/* can a requested level be taken now?  Levels in service hold off
+   themselves and every level below them */
+static void update_attention( struct sim1130 *m )
+{
+	int level;
+	m->attention = 0;
+	for (level = 0; level < 6; level++) {
+		if (m->active & (1 << level)) return;
+		if (m->ilsw[level] != 0) {
+			m->attention = 1;
+			return;
+		}
+	}
+}
+
+static void request( struct sim1130 *m, int level, uint16_t bit )
+{
+	m->ilsw[level] |= bit;
+	update_attention( m );
+}
+
+static void release( struct sim1130 *m, int level, uint16_t bit )
+{
+	m->ilsw[level] &= ~bit;
+	update_attention( m );
+}
+
+/* feed the next card; its columns follow one per read response */
+static void cr_feed( struct sim1130 *m )
+{
+	if (m->next_card >= m->ncards) {
+		m->cr_dsw |= SIM1130_CR_NOT_READY;
+		return;
+	}
+	m->card = m->deck + m->next_card++ * 80;
+	m->column = 0;
+	m->cr_dsw |= SIM1130_CR_BUSY | SIM1130_CR_READ_RESPONSE;
+	if (m->next_card == m->ncards) m->cr_dsw |= SIM1130_CR_LAST_CARD;
+	request( m, 0, SIM1130_ILSW_1442 );
+}
+
+/* the column after a response is reset, or the end of the card */
+static void cr_advance( struct sim1130 *m )
+{
+	if (m->card == NULL) return;
+	if (m->column < 80) {
+		m->cr_dsw |= SIM1130_CR_READ_RESPONSE;
+		request( m, 0, SIM1130_ILSW_1442 );
+	} else {
+		m->card = NULL;
+		m->cr_dsw &= ~SIM1130_CR_BUSY;
+		m->cr_dsw |= SIM1130_CR_OP_COMPLETE;
+		if (m->next_card >= m->ncards) m->cr_dsw |= SIM1130_CR_NOT_READY;
+		request( m, 4, SIM1130_ILSW_1442 );
+	}
+}
+
+/* execute the I/O control command at iocc; returns -1 if invalid */
+static int xio( struct sim1130 *m, int iocc )
+{
+	int mask = m->memsize - 1;
+	int wca = m->mem[iocc & ~1 & mask];
+	int cmd = m->mem[(iocc | 1) & mask];
+	int area = cmd >> 11, func = (cmd >> 8) & 7, mod = cmd & 0xFF;
+
+	if (func == 3) { /* sense interrupt level */
+		int level;
+		for (level = 0; level < 6; level++)
+			if (m->active & (1 << level)) break;
+		m->acc = (level < 6) ? m->ilsw[level] : 0;
+		return 0;
+	}
+	switch (area) {
+	case SIM1130_1442:
+		switch (func) {
+		case 2: /* read a column, which resets its response */
+			if ((m->card == NULL) || (m->column >= 80)) break;
+			m->mem[wca & mask] = m->card[m->column++] << 4;
+			if (m->cr_dsw & SIM1130_CR_READ_RESPONSE) {
+				m->cr_dsw &= ~SIM1130_CR_READ_RESPONSE;
+				release( m, 0, SIM1130_ILSW_1442 );
+				cr_advance( m );
+			}
+			break;
+		case 4: /* control: 0x40 starts a read */
+			if ((mod & 0x40) && !(m->cr_dsw & SIM1130_CR_BUSY))
+				cr_feed( m );
+			break;
+		case 7: /* sense; 0x02 resets the response, 0x01 op complete */
+			m->acc = m->cr_dsw;
+			if ((mod & 0x02) && (m->cr_dsw & SIM1130_CR_READ_RESPONSE)) {
+				m->cr_dsw &= ~SIM1130_CR_READ_RESPONSE;
+				release( m, 0, SIM1130_ILSW_1442 );
+				cr_advance( m );
+			}
+			if ((mod & 0x01) && (m->cr_dsw & SIM1130_CR_OP_COMPLETE)) {
+				m->cr_dsw &= ~SIM1130_CR_OP_COMPLETE;
+				release( m, 4, SIM1130_ILSW_1442 );
+			}
+			break;
+		default:
+			return -1;
+		}
+		return 0;
+
+	case SIM1130_CONSOLE:
+		switch (func) {
+		case 1: /* print the character in bits 0-7 */
+			if (m->printer != NULL) {
+				int ch = m->mem[wca & mask] >> 8;
+				if ((ch == 0x15) || (ch == 0x25)) putc( '\n', m->printer );
+				else putc( ebcdic_to_ascii( ch ), m->printer );
+			}
+			m->tt_dsw |= SIM1130_TT_RESPONSE;
+			request( m, 4, SIM1130_ILSW_CONSOLE );
+			break;
+		case 4:
+			break;
+		case 7:
+			m->acc = m->tt_dsw;
+			if ((mod & 0x01) && (m->tt_dsw & SIM1130_TT_RESPONSE)) {
+				m->tt_dsw &= ~SIM1130_TT_RESPONSE;
+				release( m, 4, SIM1130_ILSW_CONSOLE );
+			}
+			break;
+		default:
+			return -1;
+		}
+		return 0;
+
+	case SIM1130_SWITCH:
+		if (func != 2) return -1;
+		m->mem[wca & mask] = m->switches;
+		return 0;
+
+	default:
+		return -1;
+	}
+}
+
+/* program load: the first card goes to words 0-79 and the machine
+   starts at 0.  Each column becomes one word: rows 12-3 give bits 0-5,
+   a 4 punch also sets bits 6-9, and rows 4-9 give bits 10-15 */
+int sim1130_program_load( struct sim1130 *m )
+{
+	const uint16_t *col;
+	int i;
+
+	if (m->next_card >= m->ncards) return SIM1130_ERROR;
+	col = m->deck + m->next_card++ * 80;
+	for (i = 0; i < 80; i++) {
+		m->mem[i] = ((col[i] >> 6) << 10)
+			  | ((col[i] & 040) ? 0x03C0 : 0)
+			  | (col[i] & 077);
+	}
+	if (m->next_card >= m->ncards) m->cr_dsw |= SIM1130_CR_NOT_READY;
+	m->iar = 0;
+	return SIM1130_WAIT;
+}
+
+/* does any of the conditions in the low 6 bits hold?  Testing overflow
+   turns it off */
+static int condition( struct sim1130 *m, int cond )
+{
+	int16_t acc = (int16_t)m->acc;
+	int hit = 0;
+
+	if ((cond & C_ZERO) && (acc == 0)) hit = 1;
+	if ((cond & C_MINUS) && (acc < 0)) hit = 1;
+	if ((cond & C_PLUS) && (acc > 0)) hit = 1;
+	if ((cond & C_EVEN) && !(acc & 1)) hit = 1;
+	if ((cond & C_CARRY) && !m->carry) hit = 1;
+	if (cond & C_OVER) {
+		if (!m->overflow) hit = 1;
+		m->overflow = 0;
+	}
+	return hit;
+}
+
+static void end_level( struct sim1130 *m )
+{
+	int level;
+	for (level = 0; level < 6; level++) {
+		if (m->active & (1 << level)) {
+			m->active &= ~(1 << level);
+			break;
+		}
+	}
+	update_attention( m );
+}
+
+static void shift( struct sim1130 *m, int w, int right )
+{
+	int tag = (w >> 8) & 3;
+	int kind = (w >> 6) & 3;
+	int n = (tag ? m->mem[tag] : w) & 077;
+	uint32_t pair = ((uint32_t)m->acc << 16) | m->ext;
+	int i;
+
+	if (!right) {
+		switch (kind) {
+		case 0: /* SLA */
+			for (i = 0; i < n; i++) {
+				m->carry = (m->acc & 0x8000) != 0;
+				m->acc <<= 1;
+			}
+			break;
+		case 1: /* SLCA, count left in the index register */
+			for (; (n > 0) && !(m->acc & 0x8000); n--) {
+				m->carry = 0;
+				m->acc <<= 1;
+			}
+			if (tag) m->mem[tag] = (m->mem[tag] & ~077) | n;
+			break;
+		case 2: /* SLT */
+			for (i = 0; i < n; i++) {
+				m->carry = (pair & 0x80000000u) != 0;
+				pair <<= 1;
+			}
+			break;
+		case 3: /* SLC */
+			for (; (n > 0) && !(pair & 0x80000000u); n--) {
+				m->carry = 0;
+				pair <<= 1;
+			}
+			if (tag) m->mem[tag] = (m->mem[tag] & ~077) | n;
+			break;
+		}
+	} else {
+		switch (kind) {
+		case 0: /* SRA */
+			m->acc = (n >= 16) ? ((m->acc & 0x8000) ? 0xFFFF : 0)
+					   : (uint16_t)((int16_t)m->acc >> n);
+			break;
+		case 2: /* SRT */
+			pair = (n >= 32) ? ((pair & 0x80000000u) ? 0xFFFFFFFFu : 0)
+					 : (uint32_t)((int32_t)pair >> n);
+			break;
+		case 3: /* RTE */
+			n &= 31;
+			if (n != 0) pair = (pair >> n) | (pair << (32 - n));
+			break;
+		}
+	}
+	if (kind >= 2) {
+		m->acc = pair >> 16;
+		m->ext = pair & 0xFFFF;
+	}
+}
+
+/* one instruction per label; every one ends by dispatching the next */
+int sim1130_run( struct sim1130 *m, long long limit )
+{
+	uint16_t *mem = m->mem;
+	int mask = m->memsize - 1;
+	unsigned iar = m->iar;
+	uint16_t acc = m->acc, ext = m->ext;
+	unsigned w, ea, tag;
+	long long budget = (limit < 0) ? -1 : limit;
+	long long done = 0;
+	uint32_t u;
+	int16_t x;
+
+#ifdef SIM1130_THREADED
+	static const void *const dispatch[64] = {
+#define L(name) &&name##_s, &&name##_l
+		L(bad),  L(xio), L(sl),  L(sr),  L(lds), L(sts), L(wait), L(bad),
+		L(bsi),  L(bsc), L(bad), L(bad), L(ldx), L(stx), L(mdx),  L(bad),
+		L(a),    L(ad),  L(s),   L(sd),  L(m),   L(d),   L(bad),  L(bad),
+		L(ld),   L(ldd), L(sto), L(std), L(and), L(or),  L(eor),  L(bad)
+#undef L
+	};
+#define OP(name, code, form) name##_##form:
+#define DISPATCH() goto *dispatch[w >> 10]
+#else
+#define FORM_s 0
+#define FORM_l 1
+#define OP(name, code, form) case ((code) << 1) | FORM_##form:
+#define DISPATCH() goto top
+#endif
+
+/* fetch the next word; stop for the limit.  Only xio and end_level
+   can make an interrupt takeable, so only the instructions that call
+   them look for one */
+#define NEXT() do { \
+	if (done == budget) goto service; \
+	w = mem[iar]; \
+	iar = (iar + 1) & mask; \
+	done++; \
+	DISPATCH(); \
+} while (0)
+#define NEXT_ATTEND() do { \
+	if ((done == budget) || m->attention) goto service; \
+	w = mem[iar]; \
+	iar = (iar + 1) & mask; \
+	done++; \
+	DISPATCH(); \
+} while (0)
+
+/* the accumulator and extension are kept here, out of the way of the
+   stores to mem, and put back for the functions that use them */
+#define SPILL() (m->acc = acc, m->ext = ext)
+#define FILL() (acc = m->acc, ext = m->ext)
+
+/* effective addresses; the short form is relative to the next word */
+#define EA_SHORT() (tag = (w >> 8) & 3, \
+	ea = ((tag ? mem[tag] : iar) + (int8_t)(w & 0xFF)) & mask)
+#define EA_LONG() (tag = (w >> 8) & 3, \
+	ea = mem[iar], iar = (iar + 1) & mask, \
+	ea = (ea + (tag ? mem[tag] : 0)) & mask, \
+	ea = (w & IA) ? mem[ea] & mask : ea)
+
+/* one body, a short and a long entry */
+#define MEMOP(name, code, body) \
+	OP(name, code, s) EA_SHORT(); body; NEXT(); \
+	OP(name, code, l) EA_LONG(); body; NEXT();
+
+#define ADD16(value, sub) do { \
+	uint16_t v_ = (sub) ? (uint16_t)~(value) : (value); \
+	u = (uint32_t)acc + v_ + (sub); \
+	if (!((acc ^ v_) & 0x8000) && ((acc ^ u) & 0x8000)) \
+		m->overflow = 1; \
+	m->carry = (sub) ? !(u >> 16) : (u >> 16); \
+	acc = u; \
+} while (0)
+
+#define ADD32(sub) do { \
+	uint32_t a_ = ((uint32_t)acc << 16) | ext; \
+	uint32_t b_ = ((uint32_t)mem[ea & ~1] << 16) | mem[ea | 1]; \
+	uint64_t r_; \
+	if (sub) b_ = ~b_; \
+	r_ = (uint64_t)a_ + b_ + (sub); \
+	if (!((a_ ^ b_) & 0x80000000u) && ((a_ ^ (uint32_t)r_) & 0x80000000u)) \
+		m->overflow = 1; \
+	m->carry = (sub) ? !(r_ >> 32) : (int)(r_ >> 32); \
+	acc = (uint32_t)r_ >> 16; \
+	ext = (uint32_t)r_ & 0xFFFF; \
+} while (0)
+
+	NEXT_ATTEND();
+#ifndef SIM1130_THREADED
+top:
+	switch (w >> 10) {
+#endif
+
+	MEMOP( ld, OP_LD, acc = mem[ea] )
+	MEMOP( ldd, OP_LDD, (acc = mem[ea & ~1], ext = mem[ea | 1]) )
+	MEMOP( sto, OP_STO, mem[ea] = acc )
+	MEMOP( std, OP_STD, (mem[ea & ~1] = acc, mem[ea | 1] = ext) )
+	MEMOP( a, OP_A, ADD16( mem[ea], 0 ) )
+	MEMOP( s, OP_S, ADD16( mem[ea], 1 ) )
+	MEMOP( ad, OP_AD, ADD32( 0 ) )
+	MEMOP( sd, OP_SD, ADD32( 1 ) )
+	MEMOP( and, OP_AND, acc &= mem[ea] )
+	MEMOP( or, OP_OR, acc |= mem[ea] )
+	MEMOP( eor, OP_EOR, acc ^= mem[ea] )
+
+	MEMOP( m, OP_M, (u = (uint32_t)((int32_t)(int16_t)acc
+					* (int16_t)mem[ea]),
+			 acc = u >> 16, ext = u & 0xFFFF) )
+
+	MEMOP( d, OP_D, {
+		int32_t dividend = (int32_t)(((uint32_t)acc << 16) | ext);
+		int32_t divisor = (int16_t)mem[ea];
+		int32_t q;
+		if ((divisor == 0)
+		||  ((dividend == INT32_MIN) && (divisor == -1))) {
+			m->overflow = 1;
+		} else if (((q = dividend / divisor) > 32767) || (q < -32768)) {
+			m->overflow = 1;
+		} else {
+			acc = q;
+			ext = dividend % divisor;
+		}
+	} )
+
+	/* status: carry in bit 14, overflow in bit 15 */
+	OP(lds, OP_LDS, s)
+	OP(lds, OP_LDS, l)
+		m->carry = (w >> 1) & 1;
+		m->overflow = w & 1;
+		NEXT();
+
+	MEMOP( sts, OP_STS, (mem[ea] = (mem[ea] & 0xFF00)
+				     | (m->carry << 1) | m->overflow,
+			     m->carry = m->overflow = 0) )
+
+	/* shifts: the count is in the word, or in the index register */
+	OP(sl, OP_SL, s)
+	OP(sl, OP_SL, l)
+		SPILL();
+		shift( m, w, 0 );
+		FILL();
+		NEXT();
+	OP(sr, OP_SR, s)
+	OP(sr, OP_SR, l)
+		SPILL();
+		shift( m, w, 1 );
+		FILL();
+		NEXT();
+
+	/* the tag names the register; the address is never indexed */
+	OP(ldx, OP_LDX, s)
+		tag = (w >> 8) & 3;
+		if (tag) mem[tag] = (uint16_t)(int8_t)(w & 0xFF);
+		else iar = (uint16_t)(int8_t)(w & 0xFF) & mask;
+		NEXT();
+	OP(ldx, OP_LDX, l)
+		tag = (w >> 8) & 3;
+		ea = mem[iar];
+		iar = (iar + 1) & mask;
+		if (w & IA) ea = mem[ea & mask];
+		if (tag) mem[tag] = ea;
+		else iar = ea & mask;
+		NEXT();
+
+	OP(stx, OP_STX, s)
+		tag = (w >> 8) & 3;
+		ea = (iar + (int8_t)(w & 0xFF)) & mask;
+		mem[ea] = tag ? mem[tag] : iar;
+		NEXT();
+	OP(stx, OP_STX, l)
+		tag = (w >> 8) & 3;
+		ea = mem[iar] & mask;
+		iar = (iar + 1) & mask;
+		if (w & IA) ea = mem[ea] & mask;
+		mem[ea] = tag ? mem[tag] : iar;
+		NEXT();
+
+	/* modify index and skip if the result is zero or changes sign */
+	OP(mdx, OP_MDX, s)
+		tag = (w >> 8) & 3;
+		x = (int8_t)(w & 0xFF);
+		if (tag == 0) {
+			iar = (iar + x) & mask;
+		} else {
+			uint16_t old = mem[tag], new = old + x;
+			mem[tag] = new;
+			if ((new == 0) || ((old ^ new) & 0x8000))
+				iar = (iar + 1) & mask;
+		}
+		NEXT();
+	OP(mdx, OP_MDX, l)
+		tag = (w >> 8) & 3;
+		ea = mem[iar];
+		iar = (iar + 1) & mask;
+		{
+			uint16_t old, new, *where;
+			if (tag == 0) { /* memory += signed bits 8-15 */
+				where = &mem[ea & mask];
+				x = (int8_t)(w & 0xFF);
+			} else {
+				where = &mem[tag];
+				x = (w & IA) ? mem[ea & mask] : ea;
+			}
+			old = *where;
+			new = old + x;
+			*where = new;
+			if ((new == 0) || ((old ^ new) & 0x8000))
+				iar = (iar + 1) & mask;
+		}
+		NEXT();
+
+	/* short: skip a word if a condition holds; long: branch unless one
+	   does */
+	OP(bsc, OP_BSC, s)
+		SPILL();
+		if (condition( m, w )) iar = (iar + 1) & mask;
+		if (w & BOSC) end_level( m );
+		NEXT_ATTEND();
+	OP(bsc, OP_BSC, l)
+		EA_LONG();
+		SPILL();
+		if (!condition( m, w )) {
+			iar = ea;
+			if (w & BOSC) end_level( m );
+		}
+		NEXT_ATTEND();
+
+	OP(bsi, OP_BSI, s)
+		EA_SHORT();
+		mem[ea] = iar;
+		iar = (ea + 1) & mask;
+		NEXT();
+	OP(bsi, OP_BSI, l)
+		EA_LONG();
+		SPILL();
+		if (!condition( m, w )) {
+			mem[ea] = iar;
+			iar = (ea + 1) & mask;
+		}
+		NEXT();
+
+	OP(xio, OP_XIO, s)
+		EA_SHORT();
+		goto do_xio;
+	OP(xio, OP_XIO, l)
+		EA_LONG();
+	do_xio:
+		SPILL();
+		if (xio( m, ea ) != 0) {
+			FILL();
+			m->error = "invalid I/O command";
+			goto error;
+		}
+		FILL();
+		NEXT_ATTEND();
+
+	/* an interrupt would have been taken before this; nothing can
+	   end the wait but the caller */
+	OP(wait, OP_WAIT, s)
+	OP(wait, OP_WAIT, l)
+		SPILL();
+		m->iar = iar;
+		m->count += done;
+		return SIM1130_WAIT;
+
+#ifndef SIM1130_THREADED
+	default:
+#endif
+	OP(bad, 0, s)
+	OP(bad, 0, l)
+		m->error = "invalid operation";
+		goto error;
+
+#ifndef SIM1130_THREADED
+	}
+#endif
+
+service:
+	/* the limit, or an interrupt: a forced BSI through 8 + level */
+	if (done == budget) {
+		SPILL();
+		m->iar = iar;
+		m->count += done;
+		return SIM1130_LIMIT;
+	}
+	if (m->attention) {
+		int level;
+		for (level = 0; m->ilsw[level] == 0; level++)
+			;
+		m->active |= 1 << level;
+		ea = mem[8 + level] & mask;
+		mem[ea] = iar;
+		iar = (ea + 1) & mask;
+		update_attention( m );
+	}
+	w = mem[iar];
+	iar = (iar + 1) & mask;
+	done++;
+	DISPATCH();
+
+error:
+	SPILL();
+	m->iar = (iar - 1) & mask;
+	m->count += done;
+	return SIM1130_ERROR;
+}
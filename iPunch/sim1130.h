@@ -0,0 +1,86 @@
+/* sim1130.h -- IBM 1130 emulator core.
+ *
+ * Storage is up to 32K 16-bit words; index registers 1-3 live in words
+ * 1-3 as on the real machine.  The interpreter is threaded: every
+ * instruction ends by fetching the next and jumping through a table of
+ * label addresses, so there is no central dispatch switch.  Compilers
+ * without computed goto, or builds with SIM1130_NO_THREADS, get the
+ * switch anyway.
+ *
+ * The 1442 reader is fed from a card-image deck, unpacked once when it
+ * is attached.  Columns are delivered column-binary, as the 1130 reads
+ * them: the 12 rows in bits 0-11 of the word (row 12 in bit 0, which is
+ * the high-order bit).  A column is ready as soon as the program has
+ * taken the one before; there is no mechanical delay to wait out.
+ *
+ */
+
+#ifndef SIM1130_H
+#define SIM1130_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define SIM1130_MAXMEM	32768
+
+/* why sim1130_run returned */
+#define SIM1130_WAIT	0	/* a wait with no interrupt to take */
+#define SIM1130_LIMIT	1	/* the instruction limit ran out */
+#define SIM1130_ERROR	2	/* invalid instruction or I/O */
+
+/* device areas */
+#define SIM1130_CONSOLE	1	/* console printer */
+#define SIM1130_1442	2	/* card read punch */
+#define SIM1130_SWITCH	7	/* console entry switches */
+
+/* 1442 device status word */
+#define SIM1130_CR_READ_RESPONSE	0x8000	/* a column is ready, level 0 */
+#define SIM1130_CR_LAST_CARD		0x1000
+#define SIM1130_CR_OP_COMPLETE		0x0800	/* card done, level 4 */
+#define SIM1130_CR_BUSY			0x0002
+#define SIM1130_CR_NOT_READY		0x0001
+
+/* console printer device status word */
+#define SIM1130_TT_RESPONSE		0x8000	/* character done, level 4 */
+
+/* interrupt level status word bits, level 0 and level 4 */
+#define SIM1130_ILSW_1442		0x8000
+#define SIM1130_ILSW_CONSOLE		0x1000
+
+struct sim1130 {
+	uint16_t mem[SIM1130_MAXMEM];
+	int memsize;
+	uint16_t iar;		/* instruction address register */
+	uint16_t acc, ext;	/* accumulator and extension */
+	int carry, overflow;
+
+	/* interrupts: a level is requested while its ILSW is nonzero */
+	uint16_t ilsw[6];
+	int active;		/* levels in service, bit n for level n */
+	int attention;		/* an interrupt may be taken */
+
+	/* the 1442 */
+	uint16_t *deck;		/* 80 columns per card */
+	long ncards;
+	long next_card;
+	const uint16_t *card;	/* the card being read */
+	int column;		/* next column of it, 0-79 */
+	uint16_t cr_dsw;
+
+	/* the console */
+	FILE *printer;
+	uint16_t tt_dsw;
+	uint16_t switches;	/* console entry switches */
+
+	long long count;	/* instructions executed */
+	const char *error;	/* why SIM1130_ERROR */
+};
+
+void sim1130_init( struct sim1130 *m, int memsize );
+int sim1130_attach_deck( struct sim1130 *m, const unsigned char *deck,
+			 size_t len );
+void sim1130_detach_deck( struct sim1130 *m );
+int sim1130_program_load( struct sim1130 *m );
+int sim1130_run( struct sim1130 *m, long long limit );
+
+#endif /* SIM1130_H */
@@ -0,0 +1,925 @@
+/* sim1401.c -- IBM 1401 emulator core.
+ *
+ * The instruction set is the basic 1401 with the advanced programming
+ * features (index registers, store address register, move and load
+ * characters) but without multiply-divide.  The collating sequence and
+ * the editing rules are simplified; see the comments at compare and
+ * edit.  The character set is the one in SimH's "old" chart.
+ *
+ * see sim1401.h for the storage layout and the instruction cache.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "sim1401.h"
+#include "cardconv.h"
+
+#define ZONE	060
+#define ZONE_A	020
+#define ZONE_B	040
+#define DIGIT	017
+#define ZERO	012	/* the BCD digit 0 */
+
+/* op codes, as BCD */
+#define OP_R	001	/* 1 read a card into 001-080 */
+#define OP_W	002	/* 2 print 201-332 */
+#define OP_WR	003	/* 3 print and read */
+#define OP_P	004	/* 4 punch 101-180 */
+#define OP_RP	005	/* 5 read and punch */
+#define OP_WP	006	/* 6 print and punch */
+#define OP_WRP	007	/* 7 print, read and punch */
+#define OP_MA	013	/* # modify address */
+#define OP_CS	021	/* / clear storage */
+#define OP_S	022	/* S subtract */
+#define OP_BWZ	025	/* V branch on word mark or zone */
+#define OP_MZ	030	/* Y move zone */
+#define OP_MCS	031	/* Z move characters and suppress zeros */
+#define OP_SW	033	/* , set word mark */
+#define OP_SS	042	/* K select stacker */
+#define OP_MLC	043	/* L move and load characters */
+#define OP_MCW	044	/* M move characters to word mark */
+#define OP_NOP	045	/* N no operation */
+#define OP_SAR	050	/* Q store A register */
+#define OP_ZS	052	/* ! zero and subtract */
+#define OP_A	061	/* A add */
+#define OP_B	062	/* B branch, branch on indicator, branch if equal */
+#define OP_C	063	/* C compare */
+#define OP_MN	064	/* D move numeric */
+#define OP_MCE	065	/* E move characters and edit */
+#define OP_CC	066	/* F control carriage */
+#define OP_SBR	070	/* H store B register */
+#define OP_ZA	072	/* ? zero and add */
+#define OP_H	073	/* . halt */
+#define OP_CW	074	/* lozenge, clear word mark */
+
+/* the BCD code for each ASCII character of this chart, by position */
+static const char bcd_ascii[64] =
+	" 1234567890#@:>("
+	"^/STUVWXYZ',%=\\+"
+	"-JKLMNOPQR!$*];_"
+	"&ABCDEFGHI?.)[<\"";
+
+int sim1401_to_ascii( int bcd )
+{
+	return bcd_ascii[bcd & SIM1401_BCD];
+}
+
+/* the BCD code for an ASCII character, blank if there is none */
+int sim1401_from_ascii( int ch )
+{
+	const char *p;
+	if ((ch >= 'a') && (ch <= 'z')) ch -= 'a' - 'A';
+	if ((ch == 0) || ((p = memchr( bcd_ascii, ch, 64 )) == NULL)) return 0;
+	return p - bcd_ascii;
+}
+
+/* the reader's translation: 12-0-9 punches to B A 8 4 2 1 bits.
+   rows 1-9 are 0400 down to 0001, 0 is 01000, 11 02000, 12 04000 */
+int sim1401_from_hollerith( int col )
+{
+	int digits = col & 0777;
+	int num = 0, row;
+
+	if (digits & 02) { /* 8 and another row, or 8 alone */
+		num = 8;
+		digits &= ~02;
+	}
+	for (row = 1; row <= 9; row++) {
+		if (digits & (01000 >> row)) {
+			num += row;
+			break;
+		}
+	}
+	if (col & 04000) {
+		if ((num == 0) && (col & 01000)) return ZONE | ZERO;	/* 12-0 */
+		return ZONE | num;
+	}
+	if (col & 02000) {
+		if ((num == 0) && (col & 01000)) return ZONE_B | ZERO; /* 11-0 */
+		return ZONE_B | num;
+	}
+	if (col & 01000) {
+		if (num == 0) return ZERO;	/* 0 alone is the digit */
+		return ZONE_A | num;
+	}
+	return num;
+}
+
+/* the punch's translation, the inverse of sim1401_from_hollerith */
+int sim1401_to_hollerith( int bcd )
+{
+	int zone = bcd & ZONE, num = bcd & DIGIT;
+	int col = 0;
+
+	if (num == ZERO) {
+		switch (zone) {
+		case 0:		return 01000;
+		case ZONE_A:	return 01000 | 02 | 0200; /* 0-8-2 */
+		case ZONE_B:	return 02000 | 01000;
+		default:	return 04000 | 01000;
+		}
+	}
+	if (num > 8) {
+		col = 02;
+		num -= 8;
+	}
+	if (num != 0) col |= 01000 >> num;
+	switch (zone) {
+	case ZONE_A:	col |= 01000; break;
+	case ZONE_B:	col |= 02000; break;
+	case ZONE:	col |= 04000; break;
+	}
+	return col;
+}
+
+static int digit_value( int ch )
+{
+	ch &= DIGIT;
+	return (ch == ZERO) ? 0 : ch;
+}
+
+/* a three character address whose last character is at p[2]; zones on
+   the hundreds and units digits extend it to 15999, and the zone on the
+   tens digit names an index register.  -1 if a digit is invalid */
+static int split_address( const uint8_t *p, int *index )
+{
+	int h = p[0] & DIGIT, t = p[1] & DIGIT, u = p[2] & DIGIT;
+
+	if ((h > ZERO) || (t > ZERO) || (u > ZERO)) return -1;
+	*index = (p[1] & ZONE) >> 4;
+	return digit_value( h ) * 100 + digit_value( t ) * 10 + digit_value( u )
+	     + ((p[0] & ZONE) >> 4) * 1000 + ((p[2] & ZONE) >> 4) * 4000;
+}
+
+int sim1401_address( const struct sim1401 *m, int units )
+{
+	uint8_t p[3];
+	int index;
+
+	if ((units < 2) || (units >= m->memsize)) return -1;
+	p[0] = m->mem[units - 2];
+	p[1] = m->mem[units - 1];
+	p[2] = m->mem[units];
+	return split_address( p, &index );
+}
+
+/* stores that may hit cached instructions drop them */
+static void invalidate( struct sim1401 *m, int addr )
+{
+	int from = (addr >= 8) ? addr - 8 : 0;
+	while (from <= addr) m->cache[from++].valid = 0;
+}
+
+#define STORE( m, addr, ch ) do { \
+	(m)->mem[(addr)] = (ch); \
+	if ((m)->live[(addr) >> 3]) invalidate( (m), (addr) ); \
+} while (0)
+
+#define DOWN( m, r ) ((r) = ((r) == 0) ? (m)->memsize - 1 : (r) - 1)
+
+void sim1401_put_address( struct sim1401 *m, int units, int addr )
+{
+	int h = (addr / 100) % 10, t = (addr / 10) % 10, u = addr % 10;
+	int thousands = (addr / 1000) % 4, fours = addr / 4000;
+
+	STORE( m, units - 2, (m->mem[units - 2] & SIM1401_WM)
+			     | (thousands << 4) | (h ? h : ZERO) );
+	STORE( m, units - 1, (m->mem[units - 1] & SIM1401_WM) | (t ? t : ZERO) );
+	STORE( m, units, (m->mem[units] & SIM1401_WM)
+			 | (fours << 4) | (u ? u : ZERO) );
+}
+
+void sim1401_init( struct sim1401 *m, int memsize )
+{
+	memset( m, 0, sizeof *m );
+	if ((memsize <= 0) || (memsize > SIM1401_MAXMEM))
+		memsize = SIM1401_MAXMEM;
+	m->memsize = memsize;
+	m->use_cache = 1;
+	m->carriage = 1;
+	card_options_init( &m->punch_opt );
+	sim_wheel_init( &m->wheel, SIM_PERIOD, SIM_SHIFT );
+	sim_unit_init( &m->reader, SIM_1402_READ );
+	sim_unit_init( &m->punch_unit, SIM_1402_PUNCH );
+	sim_unit_init( &m->print_unit, SIM_1403_2 );
+}
+
+long long sim1401_time( const struct sim1401 *m )
+{
+	return m->count * SIM1401_INSN + m->io_wait;
+}
+
+/* the cards of a card-image file go into the hopper */
+int sim1401_attach_deck( struct sim1401 *m, const unsigned char *deck,
+			 size_t len )
+{
+	long ncards, card;
+	int err, col;
+	size_t card_bytes;
+
+	err = card_validate_buffer( deck, len, &ncards );
+	if (err != CARD_OK) return err;
+	card_bytes = (deck[2] == '0') ? 3 + 120 : 3 + 123;
+
+	sim1401_detach_deck( m );
+	m->deck = malloc( (ncards ? ncards : 1) * 80 * sizeof(uint16_t) );
+	if (m->deck == NULL) return CARD_ENOMEM;
+	for (card = 0; card < ncards; card++) {
+		const unsigned char *p = deck + 3 + card * card_bytes + 3;
+		uint16_t cols[82];
+		int n = (card_bytes == 3 + 120) ? 80 : 82;
+		for (col = 0; col < n; col += 2, p += 3) {
+			cols[col] = (p[0] << 4) | (p[1] >> 4);
+			cols[col + 1] = ((p[1] & 0017) << 8) | p[2];
+		}
+		/* H82 carries the two edge columns; the reader sees 1-80 */
+		memcpy( m->deck + card * 80, cols + ((n == 82) ? 1 : 0),
+			80 * sizeof(uint16_t) );
+	}
+	m->ncards = ncards;
+	m->next_card = 0;
+	return CARD_OK;
+}
+
+void sim1401_detach_deck( struct sim1401 *m )
+{
+	free( m->deck );
+	m->deck = NULL;
+	m->ncards = m->next_card = 0;
+}
+
+/* start the units an I/O op code names together, and wait for them all */
+static void io_cycle( struct sim1401 *m, int op )
+{
+	long long now = sim1401_time( m ), t = now;
+
+	if (op & OP_W) sim_unit_start( &m->wheel, &m->print_unit, now );
+	if (op & OP_R) sim_unit_start( &m->wheel, &m->reader, now );
+	if (op & OP_P) sim_unit_start( &m->wheel, &m->punch_unit, now );
+	if (op & OP_W) t = sim_unit_wait( &m->wheel, &m->print_unit, t );
+	if (op & OP_R) t = sim_unit_wait( &m->wheel, &m->reader, t );
+	if (op & OP_P) t = sim_unit_wait( &m->wheel, &m->punch_unit, t );
+	m->io_wait += t - now;
+}
+
+static void read_card( struct sim1401 *m )
+{
+	const uint16_t *col = m->deck + m->next_card++ * 80;
+	int i;
+	for (i = 1; i <= 80; i++) {
+		STORE( m, i, (m->mem[i] & SIM1401_WM)
+			     | sim1401_from_hollerith( col[i - 1] ) );
+	}
+}
+
+/* space lines, or skip to channel -n */
+static void carriage( struct sim1401 *m, int n )
+{
+	if (n > 0) spool_space( m->printer, n );
+	else spool_skip( m->printer, -n );
+}
+
+static void print_line( struct sim1401 *m )
+{
+	char line[133];
+	int n = 0, i;
+
+	for (i = 201; (i <= 332) && (i < m->memsize); i++)
+		line[n++] = sim1401_to_ascii( m->mem[i] );
+	while ((n > 0) && (line[n - 1] == ' ')) n--;
+	line[n] = '\0';
+	m->printed++;
+	if ((m->max_printed > 0) && (m->printed > m->max_printed)) return;
+	if (m->printer != NULL) {
+		spool_print( m->printer, line, n );
+		carriage( m, m->carriage );
+	}
+	m->carriage = 1;
+}
+
+static void punch_card( struct sim1401 *m )
+{
+	const struct card_options *opt = &m->punch_opt;
+	uint16_t cols[82];
+	int n = (opt->format == 80) ? 80 : 82;
+	int first = (n == 82) ? 1 : 0;
+	int i;
+
+	m->punched++;
+	if ((m->max_punched > 0) && (m->punched > m->max_punched)) return;
+	if (m->punch == NULL) return;
+	if (m->punched == 1) {
+		putc( 'H', m->punch );
+		putc( '8', m->punch );
+		putc( (n == 80) ? '0' : '2', m->punch );
+	}
+	memset( cols, 0, sizeof cols );
+	for (i = 0; i < 80; i++)
+		cols[first + i] = sim1401_to_hollerith( m->mem[101 + i] );
+
+	putc( 0x80 | (opt->color << 3) | (opt->corner << 2) | opt->cut, m->punch );
+	putc( 0x80 | (opt->interp << 6) | (opt->punch << 3) | opt->form,
+	      m->punch );
+	putc( 0x80 | opt->logo, m->punch );
+	for (i = 0; i < n; i += 2) {
+		putc( cols[i] >> 4, m->punch );
+		putc( ((cols[i] & 017) << 4) | (cols[i + 1] >> 8), m->punch );
+		putc( cols[i + 1] & 0377, m->punch );
+	}
+}
+
+/* the LOAD key: read a card into 001-080, word mark 001, go to 001 */
+int sim1401_load( struct sim1401 *m )
+{
+	int i;
+	if (m->next_card >= m->ncards) return SIM1401_HOPPER;
+	for (i = 1; i <= 80; i++) STORE( m, i, m->mem[i] & SIM1401_BCD );
+	io_cycle( m, OP_R );
+	read_card( m );
+	STORE( m, 1, m->mem[1] | SIM1401_WM );
+	m->I = 1;
+	return SIM1401_HALT;
+}
+
+/* the most characters an instruction with this op code can have;
+   fetch stops there even without a word mark, so that a load card's
+   set word mark instructions can sit end to end */
+static int max_length( int op )
+{
+	switch (op) {
+	case OP_B: case OP_BWZ: case OP_NOP:
+		return 8;
+	case OP_R: case OP_W: case OP_WR: case OP_P:
+	case OP_RP: case OP_WP: case OP_WRP:
+		return 4;
+	case OP_SS:
+		return 2;
+	case OP_CC:
+		return 5;
+	default:
+		return 7;
+	}
+}
+
+static int decode( struct sim1401 *m, int at, struct sim1401_inst *in )
+{
+	uint8_t ch[8];
+	int n = 1, limit;
+
+	ch[0] = m->mem[at] & SIM1401_BCD;
+	limit = max_length( ch[0] );
+	while ((n < limit) && (at + n < m->memsize)
+	&&     !(m->mem[at + n] & SIM1401_WM)) {
+		ch[n] = m->mem[at + n] & SIM1401_BCD;
+		n++;
+	}
+	in->op = ch[0];
+	in->len = n;
+	in->fields = 0;
+	in->ax = in->bx = 0;
+	in->a = in->b = 0;
+	switch (n) {
+	case 1:
+		break;
+	case 2:
+		in->fields = SIM1401_FD;
+		in->d = ch[1];
+		break;
+	case 5:
+		in->fields = SIM1401_FD;
+		in->d = ch[4];
+		/* fall through */
+	case 4:
+		in->fields |= SIM1401_FA;
+		break;
+	case 8:
+		in->fields = SIM1401_FD;
+		in->d = ch[7];
+		/* fall through */
+	case 7:
+		in->fields |= SIM1401_FA | SIM1401_FB;
+		break;
+	default:
+		m->error = "invalid instruction length";
+		return -1;
+	}
+	if (in->fields & SIM1401_FA) {
+		int a = split_address( ch + 1, &n );
+		if (a < 0) goto bad;
+		in->a = a;
+		in->ax = n;
+	}
+	if (in->fields & SIM1401_FB) {
+		int b = split_address( ch + 4, &n );
+		if (b < 0) goto bad;
+		in->b = b;
+		in->bx = n;
+	}
+	return 0;
+bad:
+	m->error = "invalid address";
+	return -1;
+}
+
+/* an instruction address plus its index register, if any */
+static int effective( struct sim1401 *m, int addr, int index )
+{
+	if (index != 0) {
+		int x = sim1401_address( m, 84 + 5 * index ); /* 089 094 099 */
+		if (x < 0) return -1;
+		addr = (addr + x) % SIM1401_MAXMEM;
+	}
+	return (addr < m->memsize) ? addr : -1;
+}
+
+/* characters from units back to the word mark, word mark included */
+static int field_length( struct sim1401 *m, int units )
+{
+	int n = 1;
+	while (!(m->mem[units] & SIM1401_WM)) {
+		DOWN( m, units );
+		if (++n > m->memsize) return -1;
+	}
+	return n;
+}
+
+static int negative( int ch )
+{
+	return (ch & ZONE) == ZONE_B;
+}
+
+/* A, S, ZA and ZS: the B field gets B plus or minus A, or just A */
+static int arithmetic( struct sim1401 *m, int subtract, int zero )
+{
+	uint8_t *a = m->scratch[0], *b = m->scratch[1];
+	int na = field_length( m, m->A ), nb = field_length( m, m->B );
+	int aneg = negative( m->mem[m->A] ), bneg = negative( m->mem[m->B] );
+	int bzone = m->mem[m->B] & ZONE;
+	int i, addr, carry, rneg;
+
+	if ((na < 0) || (nb < 0)) {
+		m->error = "no word mark ends the field";
+		return -1;
+	}
+	for (i = 0, addr = m->A; i < nb; i++) {
+		a[i] = (i < na) ? digit_value( m->mem[addr] ) : 0;
+		DOWN( m, addr );
+	}
+	for (i = 0, addr = m->B; i < nb; i++) {
+		b[i] = zero ? 0 : digit_value( m->mem[addr] );
+		DOWN( m, addr );
+	}
+	if (subtract) aneg = !aneg;
+	if (zero) bneg = aneg;
+
+	if (aneg == bneg) { /* true add */
+		for (i = 0, carry = 0; i < nb; i++) {
+			int d = a[i] + b[i] + carry;
+			carry = d >= 10;
+			b[i] = carry ? d - 10 : d;
+		}
+		if (carry) m->overflow = 1;
+		rneg = bneg;
+	} else { /* complement add, recomplemented if B was the smaller */
+		for (i = 0, carry = 0; i < nb; i++) {
+			int d = b[i] - a[i] - carry;
+			carry = d < 0;
+			b[i] = carry ? d + 10 : d;
+		}
+		rneg = bneg;
+		if (carry) {
+			for (i = 0, carry = 0; i < nb; i++) {
+				int d = -b[i] - carry;
+				carry = d < 0;
+				b[i] = carry ? d + 10 : d;
+			}
+			rneg = !bneg;
+		}
+	}
+
+	for (i = 0, addr = m->B; i < nb; i++) {
+		int ch = m->mem[addr], zone;
+		if (i == 0) {
+			if (rneg) zone = ZONE_B;
+			else if (zero || (bzone == ZONE_B)) zone = ZONE;
+			else zone = bzone;
+		} else {
+			zone = zero ? 0 : (ch & ZONE);
+		}
+		STORE( m, addr, (ch & SIM1401_WM) | zone | (b[i] ? b[i] : ZERO) );
+		DOWN( m, addr );
+	}
+	while (na-- > 0) DOWN( m, m->A );
+	m->B = addr;
+	return 0;
+}
+
+/* the order compare uses: blank, then the specials in BCD order, then
+   the letters, then the digits.  The real 1401 sequence interleaves the
+   specials differently; programs that only compare letters and digits
+   see no difference */
+static int collate( int ch )
+{
+	int zone = ch & ZONE, num = ch & DIGIT;
+
+	ch &= SIM1401_BCD;
+	if ((num >= 1) && (num <= ZERO)) {
+		if (zone == 0) return 130 + ((num == ZERO) ? 0 : num);
+		if (num == ZERO) return ch;
+		if (zone == ZONE) return 100 + num;
+		if (zone == ZONE_B) return 110 + num;
+		return 120 + num;
+	}
+	return ch;
+}
+
+static int compare( struct sim1401 *m )
+{
+	int result = 0, n = 0;
+
+	for (;;) {
+		int ca = m->mem[m->A], cb = m->mem[m->B];
+		int ra = collate( ca ), rb = collate( cb );
+		if (ra != rb) result = (rb < ra) ? -1 : 1;
+		DOWN( m, m->A );
+		DOWN( m, m->B );
+		if (cb & SIM1401_WM) break;
+		if (ca & SIM1401_WM) { /* B is the longer field */
+			result = 1;
+			break;
+		}
+		if (++n > m->memsize) {
+			m->error = "no word mark ends the field";
+			return -1;
+		}
+	}
+	m->equal = (result == 0);
+	m->low = (result < 0);
+	m->high = (result > 0);
+	return 0;
+}
+
+/* edit A into the control word at B.  Right to left, blanks and zeros
+   in the control word take digits from A, ampersands become blanks, and
+   a CR or minus right of the digits stays only if A is negative.  Then,
+   if the control word had a zero, the positions left of it lose their
+   leading zeros and commas */
+static int edit( struct sim1401 *m )
+{
+	int nb = field_length( m, m->B );
+	int aneg = negative( m->mem[m->A] );
+	int addr = m->B, hi, zero_at = -1, body = 0, a_done = 0, i;
+
+	if (nb < 0) {
+		m->error = "no word mark ends the field";
+		return -1;
+	}
+	for (i = 0; i < nb; i++) {
+		int ch = m->mem[addr], c = ch & SIM1401_BCD;
+		if ((c == 0) || (c == ZERO)) {
+			int ca = m->mem[m->A];
+			if (a_done) break;
+			if (c == ZERO) zero_at = addr;
+			STORE( m, addr, (ch & SIM1401_WM) | (ca & DIGIT) );
+			DOWN( m, m->A );
+			a_done = (ca & SIM1401_WM) != 0;
+			body = 1;
+		} else if (c == ZONE) { /* & */
+			STORE( m, addr, ch & SIM1401_WM );
+		} else if (!body && !aneg
+			   && ((c == ZONE_B) || (c == 063) || (c == 051))) {
+			STORE( m, addr, ch & SIM1401_WM ); /* -, C, R */
+		}
+		DOWN( m, addr );
+	}
+	hi = m->B;
+	for (i = 1; i < nb; i++) DOWN( m, hi );
+	m->B = hi;
+	DOWN( m, m->B );
+
+	if (zero_at >= 0) {
+		for (addr = hi; ; addr = (addr + 1) % m->memsize) {
+			int ch = m->mem[addr], c = ch & SIM1401_BCD;
+			if ((c == ZERO) || (c == 033) || (c == 0))
+				STORE( m, addr, ch & SIM1401_WM );
+			else
+				break;
+			if (addr == zero_at) break;
+		}
+	}
+	return 0;
+}
+
+/* the d-modifier of F: 1-9 0 # @ skip to channel 1-12 now, A-I ? . )
+   after the next print; J K L space 1-3 now, / S T after */
+static void control( struct sim1401 *m, int d )
+{
+	int now = 0, n = 0;
+
+	if ((d >= 001) && (d <= 014)) {
+		now = 1;
+		n = -d;
+	} else if ((d >= 061) && (d <= 074)) {
+		n = -(d - 060);
+	} else if ((d >= 041) && (d <= 043)) {
+		now = 1;
+		n = d - 040;
+	} else if ((d >= 021) && (d <= 023)) {
+		n = d - 020;
+	} else {
+		return;
+	}
+	if (!now) m->carriage = n;
+	else if (m->printer != NULL) carriage( m, n );
+}
+
+static int indicator( struct sim1401 *m, int d )
+{
+	switch (d) {
+	case 0:		return 1;		/* blank, unconditional */
+	case 021:	return !m->equal;	/* / unequal */
+	case 022:	return m->equal;	/* S equal */
+	case 023:	return m->low;		/* T low */
+	case 024:	return m->high;		/* U high */
+	case 031:				/* Z overflow, then reset */
+		d = m->overflow;
+		m->overflow = 0;
+		return d;
+	case 061:				/* A last card */
+		return m->next_card >= m->ncards;
+	case 011:				/* 9 carriage channel 9 */
+		return (m->printer != NULL)
+		    && (m->printer->passed & SPOOL_CHANNEL( 9 ));
+	case 014:				/* @ carriage channel 12 */
+		return (m->printer != NULL)
+		    && (m->printer->passed & SPOOL_CHANNEL( 12 ));
+	default:	return 0;
+	}
+}
+
+int sim1401_run( struct sim1401 *m, long long limit )
+{
+	long long stop = (limit < 0) ? -1 : m->count + limit;
+
+	for (;;) {
+		struct sim1401_inst local, *in;
+		int at = m->I, a = 0, b = 0, i, n;
+
+		if (m->count == stop) return SIM1401_LIMIT;
+		if (at >= m->memsize) {
+			m->error = "instruction address out of range";
+			return SIM1401_ERROR;
+		}
+		in = &local;
+		if (m->use_cache) {
+			in = &m->cache[at];
+			if (!in->valid) {
+				if (decode( m, at, in ) != 0) return SIM1401_ERROR;
+				in->valid = 1;
+				for (i = at >> 3; i <= (at + in->len) >> 3; i++)
+					m->live[i] = 1;
+			}
+		} else if (decode( m, at, in ) != 0) {
+			return SIM1401_ERROR;
+		}
+		if (in->fields & SIM1401_FA) {
+			a = effective( m, in->a, in->ax );
+			if (a < 0) goto bad_address;
+		}
+		if (in->fields & SIM1401_FB) {
+			b = effective( m, in->b, in->bx );
+			if (b < 0) goto bad_address;
+		}
+		m->count++;
+		m->op = in->op;
+		m->I = at + in->len;
+
+/* most instructions take both registers from the fields they have */
+#define LOAD_AB() do { \
+	if (in->fields & SIM1401_FB) { m->A = a; m->B = b; } \
+	else if (in->fields & SIM1401_FA) { m->A = m->B = a; } \
+} while (0)
+
+		switch (in->op) {
+		case OP_A:
+		case OP_S:
+		case OP_ZA:
+		case OP_ZS:
+			LOAD_AB();
+			if (arithmetic( m, (in->op == OP_S) || (in->op == OP_ZS),
+					(in->op == OP_ZA) || (in->op == OP_ZS) ) != 0)
+				goto error;
+			break;
+
+		case OP_MCW:
+			LOAD_AB();
+			for (n = 0; ; n++) {
+				int ca = m->mem[m->A], cb = m->mem[m->B];
+				STORE( m, m->B, (cb & SIM1401_WM) | (ca & SIM1401_BCD) );
+				DOWN( m, m->A );
+				DOWN( m, m->B );
+				if ((ca | cb) & SIM1401_WM) break;
+				if (n > m->memsize) goto no_mark;
+			}
+			break;
+
+		case OP_MLC:
+			LOAD_AB();
+			for (n = 0; ; n++) {
+				int ca = m->mem[m->A];
+				STORE( m, m->B, ca );
+				DOWN( m, m->A );
+				DOWN( m, m->B );
+				if (ca & SIM1401_WM) break;
+				if (n > m->memsize) goto no_mark;
+			}
+			break;
+
+		case OP_MCS: {
+			int units, c;
+			LOAD_AB();
+			units = m->B;
+			for (n = 0; ; n++) {
+				int ca = m->mem[m->A];
+				STORE( m, m->B, ca & SIM1401_BCD );
+				DOWN( m, m->A );
+				DOWN( m, m->B );
+				if (ca & SIM1401_WM) break;
+				if (n > m->memsize) goto no_mark;
+			}
+			STORE( m, units, m->mem[units] & DIGIT );
+			/* leading zeros and commas become blanks */
+			for (i = (m->B + 1) % m->memsize; ; i = (i + 1) % m->memsize) {
+				c = m->mem[i];
+				if ((c != ZERO) && (c != 033) && (c != 0)) break;
+				STORE( m, i, 0 );
+				if (i == units) break;
+			}
+			break;
+		}
+
+		case OP_MN:
+		case OP_MZ: {
+			int ca, cb, keep;
+			LOAD_AB();
+			ca = m->mem[m->A];
+			cb = m->mem[m->B];
+			keep = (in->op == OP_MN) ? SIM1401_WM | ZONE
+						 : SIM1401_WM | DIGIT;
+			STORE( m, m->B, (cb & keep) | (ca & ~keep & SIM1401_BCD) );
+			DOWN( m, m->A );
+			DOWN( m, m->B );
+			break;
+		}
+
+		case OP_MCE:
+			LOAD_AB();
+			if (edit( m ) != 0) goto error;
+			break;
+
+		case OP_C:
+			LOAD_AB();
+			if (compare( m ) != 0) goto error;
+			break;
+
+		case OP_B: {
+			int take;
+			if (!(in->fields & SIM1401_FA)) goto bad_op;
+			if (!(in->fields & SIM1401_FD)) {
+				take = 1;
+			} else if (in->fields & SIM1401_FB) { /* branch if equal */
+				take = (m->mem[b] & SIM1401_BCD) == in->d;
+				m->B = b;
+				DOWN( m, m->B );
+			} else {
+				take = indicator( m, in->d );
+			}
+			m->A = a;
+			if (take) {
+				m->B = m->I;
+				m->I = a;
+			}
+			break;
+		}
+
+		case OP_BWZ: {
+			int ch, take;
+			if ((in->fields & (SIM1401_FA | SIM1401_FB | SIM1401_FD))
+			    != (SIM1401_FA | SIM1401_FB | SIM1401_FD))
+				goto bad_op;
+			ch = m->mem[b];
+			if (in->d & ZONE) {
+				take = (ch & ZONE) == (in->d & ZONE);
+			} else {
+				take = (((in->d & 1) && (ch & SIM1401_WM))
+				     || ((in->d & 2) && !(ch & ZONE)));
+			}
+			m->A = a;
+			m->B = b;
+			DOWN( m, m->B );
+			if (take) {
+				m->B = m->I;
+				m->I = a;
+			}
+			break;
+		}
+
+		case OP_SW:
+		case OP_CW:
+			LOAD_AB();
+			if (in->op == OP_SW) {
+				STORE( m, m->A, m->mem[m->A] | SIM1401_WM );
+				STORE( m, m->B, m->mem[m->B] | SIM1401_WM );
+			} else {
+				STORE( m, m->A, m->mem[m->A] & SIM1401_BCD );
+				STORE( m, m->B, m->mem[m->B] & SIM1401_BCD );
+			}
+			DOWN( m, m->A );
+			DOWN( m, m->B );
+			break;
+
+		case OP_CS:
+			/* CS B clears B down to the hundred, CS I,B then
+			   branches to I */
+			if (in->fields & SIM1401_FB) m->B = b;
+			else if (in->fields & SIM1401_FA) m->B = a;
+			do {
+				STORE( m, m->B, 0 );
+			} while ((m->B-- % 100) != 0);
+			if (m->B < 0) m->B = m->memsize - 1;
+			if (in->fields & SIM1401_FB) m->I = a;
+			break;
+
+		case OP_R:
+		case OP_W:
+		case OP_WR:
+		case OP_P:
+		case OP_RP:
+		case OP_WP:
+		case OP_WRP:
+			if ((in->op & OP_R) && (m->next_card >= m->ncards)) {
+				m->I = at;	/* the reader waits for cards */
+				m->count--;
+				return SIM1401_HOPPER;
+			}
+			io_cycle( m, in->op );
+			if (in->op & OP_W) print_line( m );
+			if (in->op & OP_R) read_card( m );
+			if (in->op & OP_P) punch_card( m );
+			if (in->fields & SIM1401_FA) {
+				m->B = m->I;
+				m->I = a;
+			}
+			break;
+
+		case OP_CC:
+			if (in->fields & SIM1401_FD) control( m, in->d );
+			if (in->fields & SIM1401_FA) m->I = a;
+			break;
+
+		case OP_SS:
+		case OP_NOP:
+			break;
+
+		case OP_SAR:
+		case OP_SBR:
+			if (!(in->fields & SIM1401_FA) || (a < 2)) goto bad_op;
+			sim1401_put_address( m, a, (in->op == OP_SAR) ? m->A : m->B );
+			m->A = (a >= 3) ? a - 3 : a - 3 + m->memsize;
+			break;
+
+		case OP_MA: {
+			int va, vb, tens;
+			LOAD_AB();
+			va = sim1401_address( m, m->A );
+			vb = sim1401_address( m, m->B );
+			if ((va < 0) || (vb < 0) || (m->B < 3)) goto bad_address;
+			tens = m->mem[m->B - 1] & ZONE; /* keep the index tag */
+			sim1401_put_address( m, m->B, (va + vb) % SIM1401_MAXMEM );
+			STORE( m, m->B - 1, m->mem[m->B - 1] | tens );
+			m->A = (m->A >= 3) ? m->A - 3 : m->A - 3 + m->memsize;
+			m->B -= 3;
+			break;
+		}
+
+		case OP_H:
+			if (in->fields & SIM1401_FA) m->I = a;
+			return SIM1401_HALT;
+
+		default:
+			goto bad_op;
+		}
+	}
+
+bad_op:
+	m->error = "invalid operation";
+	goto error;
+bad_address:
+	m->error = "invalid address";
+	goto error;
+no_mark:
+	m->error = "no word mark ends the field";
+error:
+	return SIM1401_ERROR;
+}
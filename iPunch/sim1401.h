@@ -0,0 +1,115 @@
+/* sim1401.h -- IBM 1401 emulator core.
+ *
+ * Storage holds one character per byte: the six BCD bits (B A 8 4 2 1)
+ * in the low bits, and the word mark in SIM1401_WM.  Check bits are not
+ * kept.  The reader is a virtual 1402 fed from a card-image deck; the
+ * print area goes to a 1403 spooled by spool.h, and the punch to a
+ * card-image file.  Control carriage (F) skips to a channel or spaces
+ * at once or after the next print, and branches test channels 9 and 12.
+ *
+ * Decoded instructions are cached by address, so a loop decodes each
+ * of its instructions once.  Any store within eight characters after
+ * the start of a cached instruction drops it, so programs that modify
+ * their own addresses, as 1401 programs routinely do, still run right.
+ *
+ * Simulated time is SIM1401_INSN ns an instruction, about eight storage
+ * cycles, plus the time spent in I/O.  The 1402 reads at 800 cards a
+ * minute and punches at 250, the 1403 prints 600 lines a minute, and
+ * the processor waits for every read, punch and print to finish; those
+ * in one instruction, such as 7 for print, read and punch, overlap.
+ * The devices are on a simevent.h wheel; set its mode to
+ * SIM_UNTHROTTLED after sim1401_init and I/O takes no time.
+ *
+ */
+
+#ifndef SIM1401_H
+#define SIM1401_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "cardcodec.h"
+#include "simevent.h"
+#include "spool.h"
+
+#define SIM1401_MAXMEM	16000
+#define SIM1401_WM	0100	/* word mark */
+#define SIM1401_BCD	0077	/* the character itself */
+#define SIM1401_INSN	92000LL	/* ns an instruction, on average */
+
+/* why sim1401_run returned */
+#define SIM1401_HALT	0	/* a halt instruction */
+#define SIM1401_LIMIT	1	/* the instruction limit ran out */
+#define SIM1401_HOPPER	2	/* read with no cards left */
+#define SIM1401_ERROR	3	/* invalid instruction or address */
+
+/* one decoded instruction */
+struct sim1401_inst {
+	uint8_t valid;
+	uint8_t op;	/* BCD op code */
+	uint8_t fields;	/* SIM1401_Fxxx, which fields are present */
+	uint8_t d;	/* d-modifier */
+	uint8_t ax, bx;	/* index register for A and B, 0 for none */
+	uint16_t len;	/* characters, op code included */
+	uint16_t a, b;	/* addresses before indexing */
+};
+
+#define SIM1401_FA	1
+#define SIM1401_FB	2
+#define SIM1401_FD	4
+
+struct sim1401 {
+	uint8_t mem[SIM1401_MAXMEM];
+	int memsize;
+	int I;			/* instruction address register */
+	int A, B;		/* A and B address registers */
+	int op;			/* op code of the last instruction */
+
+	/* indicators */
+	int equal, low, high;
+	int overflow;
+
+	/* the decoded instruction cache */
+	int use_cache;
+	struct sim1401_inst cache[SIM1401_MAXMEM];
+	uint8_t live[SIM1401_MAXMEM / 8 + 1];	/* blocks with cached code */
+
+	/* the 1402 reader and punch, and the printer */
+	uint16_t *deck;		/* 80 columns per card */
+	long ncards;
+	long next_card;
+	struct spool *printer;	/* or NULL */
+	int carriage;		/* after the next print: lines to space,
+				   or -channel to skip to */
+	FILE *punch;
+	struct card_options punch_opt;	/* header of punched cards */
+	long punched;
+	long printed;
+	long max_punched, max_printed;	/* past these, cards and lines are
+					   counted but not made; 0 for none */
+	struct sim_wheel wheel;
+	struct sim_unit reader, punch_unit, print_unit;
+
+	long long count;	/* instructions executed */
+	long long io_wait;	/* ns of simulated time in I/O */
+	const char *error;	/* why SIM1401_ERROR */
+
+	uint8_t scratch[2][SIM1401_MAXMEM];	/* arithmetic digits */
+};
+
+void sim1401_init( struct sim1401 *m, int memsize );
+int sim1401_attach_deck( struct sim1401 *m, const unsigned char *deck,
+			 size_t len );
+void sim1401_detach_deck( struct sim1401 *m );
+int sim1401_load( struct sim1401 *m );
+int sim1401_run( struct sim1401 *m, long long limit );
+long long sim1401_time( const struct sim1401 *m );
+
+int sim1401_from_ascii( int ch );
+int sim1401_to_ascii( int bcd );
+int sim1401_from_hollerith( int col );
+int sim1401_to_hollerith( int bcd );
+
+int sim1401_address( const struct sim1401 *m, int units );
+void sim1401_put_address( struct sim1401 *m, int units, int addr );
+
+#endif /* SIM1401_H */
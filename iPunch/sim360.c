@@ -0,0 +1,1207 @@
+/* sim360.c -- IBM System/360 emulator core.
+ *
+ * see sim360.h for what is and is not emulated, for the monitor that
+ * stands in for an operating system, and for the block cache.
+ *
+ * The loader reads object deck cards, all in EBCDIC with X'02' in
+ * column 1: TXT cards put the byte count in columns 11-12 of data from
+ * column 17 at the address in columns 6-8, and the END card gives the
+ * entry point in columns 6-8, or leaves it blank for the first TXT
+ * address.  ESD and RLD cards are read and skipped; decks are loaded
+ * where they were assembled, not relocated.  The program is entered as
+ * OS/360 enters a job step: R15 holds the entry point, R14 a return
+ * address (an SVC 3) and R13 an 18 word save area.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sim360.h"
+#include "cardconv.h"
+#include "ebcdic.h"
+
+#define AMASK	0xFFFFFFu	/* 24-bit addresses */
+#define SIGN	0x80000000u
+
+/* what execute returns besides program interruption codes */
+#define X_SVC	0x100	/* | the SVC number */
+#define X_WAIT	0x200
+
+/* fixed storage */
+#define SVC_OLD		0x20
+#define PGM_OLD		0x28
+#define SVC_NEW		0x60
+#define PGM_NEW		0x68
+#define EXIT_ADDR	0x80	/* an SVC 3, where R14 points at entry */
+#define SAVE_AREA	0x88	/* 18 words, where R13 points */
+
+#define LINES( m )	(((m)->memsize >> SIM360_LINE) + 1)
+
+static uint32_t get2( const struct sim360 *m, uint32_t a )
+{
+	return (m->mem[a] << 8) | m->mem[a + 1];
+}
+
+static uint32_t get4( const struct sim360 *m, uint32_t a )
+{
+	const uint8_t *p = m->mem + a;
+	return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static void put4( struct sim360 *m, uint32_t a, uint32_t v )
+{
+	uint8_t *p = m->mem + a;
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+/* a block's place in the lists of the lines it touches; a list entry
+   n is block (n - 1) / SIM360_SPAN, at line (n - 1) % SIM360_SPAN of it */
+#define ENTRY( m, b, k )	((int32_t)((b) - (m)->blocks) * SIM360_SPAN + (k) + 1)
+#define BLOCK( m, n )		(&(m)->blocks[((n) - 1) / SIM360_SPAN])
+
+static void link_block( struct sim360 *m, struct sim360_block *b )
+{
+	uint32_t line = b->start >> SIM360_LINE, last = (b->end - 1) >> SIM360_LINE;
+	int k;
+
+	for (k = 0; line <= last; line++, k++) {
+		int32_t head = m->code[line];
+		b->next[k] = head;
+		b->prev[k] = 0;
+		if (head) BLOCK( m, head )->prev[(head - 1) % SIM360_SPAN] = ENTRY( m, b, k );
+		m->code[line] = ENTRY( m, b, k );
+	}
+}
+
+/* take a block out of its lists and empty it */
+static void drop_block( struct sim360 *m, struct sim360_block *b )
+{
+	uint32_t line = b->start >> SIM360_LINE, last = (b->end - 1) >> SIM360_LINE;
+	int k;
+
+	for (k = 0; line <= last; line++, k++) {
+		int32_t next = b->next[k], prev = b->prev[k];
+		if (prev) BLOCK( m, prev )->next[(prev - 1) % SIM360_SPAN] = next;
+		else m->code[line] = next;
+		if (next) BLOCK( m, next )->prev[(next - 1) % SIM360_SPAN] = prev;
+	}
+	b->start = 1;
+	b->end = 0;
+}
+
+/* drop the cached blocks holding any of a to a + len - 1 */
+static void drop_code( struct sim360 *m, uint32_t a, uint32_t len )
+{
+	uint32_t line = a >> SIM360_LINE, last = (a + len - 1) >> SIM360_LINE;
+
+	for (; line <= last; line++) {
+		int32_t n = m->code[line];
+		while (n) {
+			struct sim360_block *b = BLOCK( m, n );
+			n = b->next[(n - 1) % SIM360_SPAN];
+			if ((b->start < a + len) && (b->end > a)) {
+				drop_block( m, b );
+				m->smc = 1;
+			}
+		}
+	}
+}
+
+/* every store ends with this; len is at least 1 */
+static void stored( struct sim360 *m, uint32_t a, uint32_t len )
+{
+	uint32_t line = a >> SIM360_LINE, last = (a + len - 1) >> SIM360_LINE;
+	for (; line <= last; line++) {
+		if (m->code[line]) {
+			drop_code( m, a, len );
+			return;
+		}
+	}
+}
+
+#define STORED1( m, a ) do { \
+	if ((m)->code[(a) >> SIM360_LINE]) drop_code( (m), (a), 1 ); \
+} while (0)
+
+int sim360_init( struct sim360 *m, uint32_t memsize )
+{
+	int i;
+
+	memset( m, 0, sizeof *m );
+	if ((memsize < 4096) || (memsize > SIM360_MAXMEM)) memsize = 256 << 10;
+	m->memsize = memsize & ~3u;
+	m->mem = calloc( m->memsize + 8, 1 );	/* slack for a last fetch */
+	m->code = calloc( LINES( m ), sizeof *m->code );
+	m->blocks = malloc( SIM360_BLOCKS * sizeof *m->blocks );
+	if ((m->mem == NULL) || (m->code == NULL) || (m->blocks == NULL)) {
+		sim360_free( m );
+		return CARD_ENOMEM;
+	}
+	for (i = 0; i < SIM360_BLOCKS; i++) {
+		m->blocks[i].start = 1;
+		m->blocks[i].end = 0;
+	}
+	m->use_cache = 1;
+	sim_wheel_init( &m->wheel, SIM_PERIOD, SIM_SHIFT );
+	sim_unit_init( &m->reader, SIM_2540_READ );
+	sim_unit_init( &m->print_unit, SIM_1403_N1 );
+	return CARD_OK;
+}
+
+long long sim360_time( const struct sim360 *m )
+{
+	return m->count * SIM360_INSN + m->io_wait;
+}
+
+static void free_mem( struct sim360 *m )
+{
+	if (m->mapped) munmap( m->mem, m->mapped );
+	else free( m->mem );
+	m->mapped = 0;
+}
+
+void sim360_free( struct sim360 *m )
+{
+	sim360_detach_deck( m );
+	free_mem( m );
+	free( m->code );
+	free( m->blocks );
+	m->mem = NULL;
+	m->code = NULL;
+	m->blocks = NULL;
+}
+
+int sim360_attach_deck( struct sim360 *m, const unsigned char *deck,
+			size_t len )
+{
+	long ncards, card;
+	int err, col;
+	size_t card_bytes;
+
+	err = card_validate_buffer( deck, len, &ncards );
+	if (err != CARD_OK) return err;
+	card_bytes = (deck[2] == '0') ? 3 + 120 : 3 + 123;
+
+	sim360_detach_deck( m );
+	m->deck = malloc( (ncards ? ncards : 1) * 80 * sizeof(uint16_t) );
+	if (m->deck == NULL) return CARD_ENOMEM;
+	for (card = 0; card < ncards; card++) {
+		const unsigned char *p = deck + 3 + card * card_bytes + 3;
+		uint16_t cols[82];
+		int n = (card_bytes == 3 + 120) ? 80 : 82;
+		for (col = 0; col < n; col += 2, p += 3) {
+			cols[col] = (p[0] << 4) | (p[1] >> 4);
+			cols[col + 1] = ((p[1] & 0017) << 8) | p[2];
+		}
+		/* H82 carries the two edge columns; the reader sees 1-80 */
+		memcpy( m->deck + card * 80, cols + ((n == 82) ? 1 : 0),
+			80 * sizeof(uint16_t) );
+	}
+	m->ncards = ncards;
+	m->next_card = 0;
+	return CARD_OK;
+}
+
+void sim360_detach_deck( struct sim360 *m )
+{
+	free( m->deck );
+	m->deck = NULL;
+	m->ncards = m->next_card = 0;
+}
+
+/* start an operation on a unit, and wait for it to finish if asked */
+static void wait_for( struct sim360 *m, struct sim_unit *u, int finish )
+{
+	long long now = sim360_time( m ), t;
+
+	t = sim_unit_start( &m->wheel, u, now );
+	if (finish) t = sim_unit_wait( &m->wheel, u, t );
+	m->io_wait += t - now;
+}
+
+/* the next card, as EBCDIC; punches no byte has read as blank */
+static int read_card( struct sim360 *m, uint8_t *buf )
+{
+	const uint16_t *col;
+	int i;
+
+	if (m->next_card >= m->ncards) return 0;
+	wait_for( m, &m->reader, 1 );
+	col = m->deck + m->next_card++ * 80;
+	for (i = 0; i < 80; i++) {
+		int byte = ebcdic_from_hollerith( col[i] );
+		buf[i] = (byte < 0) ? 0x40 : byte;
+	}
+	return 1;
+}
+
+static int card_type( const uint8_t *card, const char *type )
+{
+	int i;
+	if (card[0] != 0x02) return 0;
+	for (i = 0; i < 3; i++)
+		if (ebcdic_to_ascii( card[1 + i] ) != type[i]) return 0;
+	return 1;
+}
+
+int sim360_load( struct sim360 *m )
+{
+	uint8_t card[80];
+	uint32_t lowest = AMASK + 1, entry;
+
+	for (;;) {
+		if (!read_card( m, card )) {
+			m->error = "no END card in the object deck";
+			return -1;
+		}
+		if (card_type( card, "TXT" )) {
+			uint32_t addr = (card[5] << 16) | (card[6] << 8) | card[7];
+			uint32_t count = (card[10] << 8) | card[11];
+			if ((count > 56) || (addr + count > m->memsize)) {
+				m->error = "TXT card outside storage";
+				return -1;
+			}
+			memcpy( m->mem + addr, card + 16, count );
+			if (count > 0) stored( m, addr, count );
+			if (addr < lowest) lowest = addr;
+		} else if (card_type( card, "END" )) {
+			break;
+		} else if (!card_type( card, "ESD" ) && !card_type( card, "RLD" )) {
+			m->error = "not an object deck card";
+			return -1;
+		}
+	}
+	if ((card[5] == 0x40) && (card[6] == 0x40) && (card[7] == 0x40))
+		entry = lowest;
+	else	entry = (card[5] << 16) | (card[6] << 8) | card[7];
+	if (entry > AMASK) {
+		m->error = "object deck has no text";
+		return -1;
+	}
+
+	m->mem[EXIT_ADDR] = 0x0A;
+	m->mem[EXIT_ADDR + 1] = SIM360_SVC_EXIT;
+	stored( m, EXIT_ADDR, 2 );
+	m->r[15] = m->ia = entry;
+	m->r[14] = EXIT_ADDR;
+	m->r[13] = SAVE_AREA;
+	return 0;
+}
+
+/* basic control mode PSWs */
+static void store_psw( struct sim360 *m, uint32_t a, int code, int ilc )
+{
+	m->mem[a] = m->sysmask;
+	m->mem[a + 1] = (m->key << 4) | (m->wait << 1) | m->problem;
+	m->mem[a + 2] = code >> 8;
+	m->mem[a + 3] = code;
+	put4( m, a + 4, ((uint32_t)ilc << 30) | ((uint32_t)m->cc << 28)
+			| ((uint32_t)m->progmask << 24) | m->ia );
+	stored( m, a, 8 );
+}
+
+static void load_psw( struct sim360 *m, uint32_t a )
+{
+	uint32_t w = get4( m, a + 4 );
+	m->sysmask = m->mem[a];
+	m->key = m->mem[a + 1] >> 4;
+	m->wait = (m->mem[a + 1] >> 1) & 1;
+	m->problem = m->mem[a + 1] & 1;
+	m->cc = (w >> 28) & 3;
+	m->progmask = (w >> 24) & 15;
+	m->ia = w & AMASK;
+}
+
+static int zero_psw( const struct sim360 *m, uint32_t a )
+{
+	return (get4( m, a ) | get4( m, a + 4 )) == 0;
+}
+
+/* decode the instruction at ia; an interruption code if it cannot be
+   fetched.  mod is ORed into the second byte, for EX */
+static int fetch( const struct sim360 *m, uint32_t ia, int mod,
+		  struct sim360_op *op )
+{
+	const uint8_t *p = m->mem + ia;
+
+	if (ia & 1) return SIM360_PGM_SPECIFICATION;
+	if (ia + 2 > m->memsize) return SIM360_PGM_ADDRESSING;
+	op->op = p[0];
+	op->len = (p[0] < 0x40) ? 2 : (p[0] < 0xC0) ? 4 : 6;
+	if (ia + op->len > m->memsize) return SIM360_PGM_ADDRESSING;
+	op->l = p[1] | mod;
+	op->r1 = op->l >> 4;
+	op->r2 = op->l & 15;
+	op->b1 = op->b2 = 0;
+	op->d1 = op->d2 = 0;
+	if (op->len == 4) {
+		op->b2 = p[2] >> 4;
+		op->d2 = ((p[2] & 15) << 8) | p[3];
+	} else if (op->len == 6) {
+		op->b1 = p[2] >> 4;
+		op->d1 = ((p[2] & 15) << 8) | p[3];
+		op->b2 = p[4] >> 4;
+		op->d2 = ((p[4] & 15) << 8) | p[5];
+	}
+	op->ia = ia;
+	return 0;
+}
+
+/* the instructions that end a block: branches, SVC, EX and LPSW */
+static int ends_block( int op )
+{
+	switch (op) {
+	case 0x05: case 0x06: case 0x07: case 0x0A:
+	case 0x44: case 0x45: case 0x46: case 0x47:
+	case 0x82: case 0x86: case 0x87:
+		return 1;
+	}
+	return 0;
+}
+
+/* the cached block starting at ia, translated now if need be; NULL
+   and an interruption code if its first instruction cannot be fetched */
+static struct sim360_block *lookup( struct sim360 *m, int *code )
+{
+	struct sim360_block *b = &m->blocks[(m->ia >> 1) & (SIM360_BLOCKS - 1)];
+	uint32_t ia = m->ia;
+
+	if (b->start == ia) return b;
+
+	if (b->start <= b->end) drop_block( m, b );
+	b->n = 0;
+	do {
+		struct sim360_op *op = &b->op[b->n];
+		if (fetch( m, ia, 0, op ) != 0) break;
+		ia += op->len;
+		b->n++;
+	} while ((b->n < SIM360_BLOCK) && !ends_block( b->op[b->n - 1].op ));
+	if (b->n == 0) {
+		*code = fetch( m, ia, 0, &b->op[0] );
+		b->start = 1;
+		b->end = 0;
+		return NULL;
+	}
+	b->start = m->ia;
+	b->end = ia;
+	link_block( m, b );
+	return b;
+}
+
+#define B( x )		((x) ? m->r[(x)] : 0)
+#define ADDR1		((op->d1 + B( op->b1 )) & AMASK)
+#define ADDR2		((op->d2 + B( op->b2 )) & AMASK)
+#define ADDRX		((op->d2 + B( op->r2 ) + B( op->b2 )) & AMASK)
+#define CHECK( a, n, align ) do { \
+	if ((a) & ((align) - 1)) return SIM360_PGM_SPECIFICATION; \
+	if ((a) + (n) > m->memsize) return SIM360_PGM_ADDRESSING; \
+} while (0)
+#define EVEN( r )	do { if ((r) & 1) return SIM360_PGM_SPECIFICATION; } while (0)
+#define BRANCH( a )	(m->ia = (a) & AMASK)
+
+static int arith_cc( uint32_t v )
+{
+	return (v == 0) ? 0 : (v & SIGN) ? 1 : 2;
+}
+
+static int overflow( struct sim360 *m )
+{
+	m->cc = 3;
+	return (m->progmask & 8) ? SIM360_PGM_OVERFLOW : 0;
+}
+
+static int add( struct sim360 *m, int r1, uint32_t b )
+{
+	uint32_t a = m->r[r1], s = a + b;
+	m->r[r1] = s;
+	if (~(a ^ b) & (a ^ s) & SIGN) return overflow( m );
+	m->cc = arith_cc( s );
+	return 0;
+}
+
+static int subtract( struct sim360 *m, int r1, uint32_t b )
+{
+	uint32_t a = m->r[r1], s = a - b;
+	m->r[r1] = s;
+	if ((a ^ b) & (a ^ s) & SIGN) return overflow( m );
+	m->cc = arith_cc( s );
+	return 0;
+}
+
+/* logical add and subtract: bit 1 of the cc is the carry */
+static void add_logical( struct sim360 *m, int r1, uint32_t b, int carry )
+{
+	uint64_t s = (uint64_t)m->r[r1] + b + carry;
+	m->r[r1] = s;
+	m->cc = ((uint32_t)s != 0) | (int)((s >> 32) << 1);
+}
+
+static int compare( int32_t a, int32_t b )
+{
+	return (a == b) ? 0 : (a < b) ? 1 : 2;
+}
+
+static int compare_logical( uint32_t a, uint32_t b )
+{
+	return (a == b) ? 0 : (a < b) ? 1 : 2;
+}
+
+static int multiply( struct sim360 *m, int r1, uint32_t b )
+{
+	int64_t p;
+	EVEN( r1 );
+	p = (int64_t)(int32_t)m->r[r1 + 1] * (int32_t)b;
+	m->r[r1] = (uint64_t)p >> 32;
+	m->r[r1 + 1] = p;
+	return 0;
+}
+
+static int divide( struct sim360 *m, int r1, uint32_t b )
+{
+	int64_t n, q;
+	EVEN( r1 );
+	n = (int64_t)(((uint64_t)m->r[r1] << 32) | m->r[r1 + 1]);
+	if ((b == 0) || ((n == INT64_MIN) && ((int32_t)b == -1)))
+		return SIM360_PGM_DIVIDE;
+	q = n / (int32_t)b;
+	if ((q > INT32_MAX) || (q < INT32_MIN)) return SIM360_PGM_DIVIDE;
+	m->r[r1] = n % (int32_t)b;
+	m->r[r1 + 1] = q;
+	return 0;
+}
+
+/* shift the 31 numeric bits left, keeping the sign; 64 for double */
+static int shift_left_arith( struct sim360 *m, uint64_t *v, int bits, int n )
+{
+	uint64_t sign = (uint64_t)1 << (bits - 1), ovf = 0;
+	for (; n > 0; n--) {
+		ovf |= ((*v << 1) ^ *v) & sign;
+		*v = (*v & sign) | ((*v << 1) & (sign - 1));
+	}
+	if (ovf) return overflow( m );
+	m->cc = (*v == 0) ? 0 : (*v & sign) ? 1 : 2;
+	return 0;
+}
+
+static int convert_to_binary( struct sim360 *m, int r1, uint32_t a )
+{
+	int64_t v = 0;
+	int i, sign = m->mem[a + 7] & 15;
+
+	for (i = 0; i < 15; i++) {
+		int d = (m->mem[a + i / 2] >> ((i & 1) ? 0 : 4)) & 15;
+		if (d > 9) return SIM360_PGM_DATA;
+		v = v * 10 + d;
+	}
+	if (sign < 10) return SIM360_PGM_DATA;
+	if ((sign == 0xB) || (sign == 0xD)) v = -v;
+	m->r[r1] = v;
+	if ((v > INT32_MAX) || (v < INT32_MIN)) return SIM360_PGM_DIVIDE;
+	return 0;
+}
+
+static void convert_to_decimal( struct sim360 *m, int r1, uint32_t a )
+{
+	int64_t v = (int32_t)m->r[r1];
+	int i;
+
+	m->mem[a + 7] = (v < 0) ? 0x0D : 0x0C;
+	if (v < 0) v = -v;
+	for (i = 14; i >= 0; i--, v /= 10) {
+		uint8_t *p = m->mem + a + i / 2;
+		if (i & 1) *p = v % 10;
+		else *p |= (v % 10) << 4;
+	}
+	stored( m, a, 8 );
+}
+
+static void pack( struct sim360 *m, uint32_t a1, int l1, uint32_t a2, int l2 )
+{
+	int i = l1, j = l2;
+	uint8_t b = m->mem[a2 + j--];
+
+	m->mem[a1 + i--] = (b << 4) | (b >> 4);
+	while (i >= 0) {
+		uint8_t d = 0;
+		if (j >= 0) d = m->mem[a2 + j--] & 15;
+		if (j >= 0) d |= (m->mem[a2 + j--] & 15) << 4;
+		m->mem[a1 + i--] = d;
+	}
+}
+
+static void unpack( struct sim360 *m, uint32_t a1, int l1, uint32_t a2, int l2 )
+{
+	int i = l1, j = l2;
+	uint8_t b = m->mem[a2 + j--];
+
+	m->mem[a1 + i--] = (b << 4) | (b >> 4);
+	while (i >= 0) {
+		b = (j >= 0) ? m->mem[a2 + j--] : 0;
+		m->mem[a1 + i--] = 0xF0 | (b & 15);
+		if (i >= 0) m->mem[a1 + i--] = 0xF0 | (b >> 4);
+	}
+}
+
+static int execute( struct sim360 *m, const struct sim360_op *op );
+
+/* EX: run the instruction at a with its second byte ORed with R1 */
+static int execute_target( struct sim360 *m, const struct sim360_op *op,
+			   uint32_t a )
+{
+	struct sim360_op target;
+	int code = fetch( m, a, op->r1 ? m->r[op->r1] & 0xFF : 0, &target );
+
+	if (code != 0) return code;
+	if (target.op == 0x44) return SIM360_PGM_EXECUTE;
+	return execute( m, &target );
+}
+
+/* run one instruction, with m->ia already past it; 0, a program
+   interruption code, X_SVC or X_WAIT */
+static int execute( struct sim360 *m, const struct sim360_op *op )
+{
+	uint32_t *r = m->r;
+	uint32_t a, v;
+	int i, n;
+
+	switch (op->op) {
+
+	/* RR */
+	case 0x04: /* SPM */
+		m->cc = (r[op->r1] >> 28) & 3;
+		m->progmask = (r[op->r1] >> 24) & 15;
+		return 0;
+	case 0x05: /* BALR */
+		a = r[op->r2];
+		r[op->r1] = (1u << 30) | ((uint32_t)m->cc << 28)
+			  | ((uint32_t)m->progmask << 24) | m->ia;
+		if (op->r2) BRANCH( a );
+		return 0;
+	case 0x06: /* BCTR */
+		a = r[op->r2];
+		if ((--r[op->r1] != 0) && op->r2) BRANCH( a );
+		return 0;
+	case 0x07: /* BCR */
+		if ((op->r1 & (8 >> m->cc)) && op->r2) BRANCH( r[op->r2] );
+		return 0;
+	case 0x0A: /* SVC */
+		return X_SVC | op->l;
+	case 0x10: /* LPR */
+		v = r[op->r2];
+		if (v == SIGN) { r[op->r1] = v; return overflow( m ); }
+		r[op->r1] = (v & SIGN) ? -v : v;
+		m->cc = arith_cc( r[op->r1] );
+		return 0;
+	case 0x11: /* LNR */
+		v = r[op->r2];
+		r[op->r1] = (v & SIGN) ? v : -v;
+		m->cc = r[op->r1] ? 1 : 0;
+		return 0;
+	case 0x12: /* LTR */
+		r[op->r1] = r[op->r2];
+		m->cc = arith_cc( r[op->r1] );
+		return 0;
+	case 0x13: /* LCR */
+		v = r[op->r2];
+		r[op->r1] = -v;
+		if (v == SIGN) return overflow( m );
+		m->cc = arith_cc( r[op->r1] );
+		return 0;
+	case 0x14: /* NR */
+		m->cc = (r[op->r1] &= r[op->r2]) != 0;
+		return 0;
+	case 0x15: /* CLR */
+		m->cc = compare_logical( r[op->r1], r[op->r2] );
+		return 0;
+	case 0x16: /* OR */
+		m->cc = (r[op->r1] |= r[op->r2]) != 0;
+		return 0;
+	case 0x17: /* XR */
+		m->cc = (r[op->r1] ^= r[op->r2]) != 0;
+		return 0;
+	case 0x18: /* LR */
+		r[op->r1] = r[op->r2];
+		return 0;
+	case 0x19: /* CR */
+		m->cc = compare( r[op->r1], r[op->r2] );
+		return 0;
+	case 0x1A: /* AR */
+		return add( m, op->r1, r[op->r2] );
+	case 0x1B: /* SR */
+		return subtract( m, op->r1, r[op->r2] );
+	case 0x1C: /* MR */
+		return multiply( m, op->r1, r[op->r2] );
+	case 0x1D: /* DR */
+		return divide( m, op->r1, r[op->r2] );
+	case 0x1E: /* ALR */
+		add_logical( m, op->r1, r[op->r2], 0 );
+		return 0;
+	case 0x1F: /* SLR */
+		add_logical( m, op->r1, ~r[op->r2], 1 );
+		return 0;
+
+	/* RX */
+	case 0x40: /* STH */
+		a = ADDRX;
+		CHECK( a, 2, 2 );
+		m->mem[a] = r[op->r1] >> 8;
+		m->mem[a + 1] = r[op->r1];
+		STORED1( m, a );
+		return 0;
+	case 0x41: /* LA */
+		r[op->r1] = ADDRX;
+		return 0;
+	case 0x42: /* STC */
+		a = ADDRX;
+		CHECK( a, 1, 1 );
+		m->mem[a] = r[op->r1];
+		STORED1( m, a );
+		return 0;
+	case 0x43: /* IC */
+		a = ADDRX;
+		CHECK( a, 1, 1 );
+		r[op->r1] = (r[op->r1] & ~0xFFu) | m->mem[a];
+		return 0;
+	case 0x44: /* EX */
+		return execute_target( m, op, ADDRX );
+	case 0x45: /* BAL */
+		a = ADDRX;
+		r[op->r1] = (2u << 30) | ((uint32_t)m->cc << 28)
+			  | ((uint32_t)m->progmask << 24) | m->ia;
+		BRANCH( a );
+		return 0;
+	case 0x46: /* BCT */
+		a = ADDRX;
+		if (--r[op->r1] != 0) BRANCH( a );
+		return 0;
+	case 0x47: /* BC */
+		if (op->r1 & (8 >> m->cc)) BRANCH( ADDRX );
+		return 0;
+	case 0x48: /* LH */
+		a = ADDRX;
+		CHECK( a, 2, 2 );
+		r[op->r1] = (int16_t)get2( m, a );
+		return 0;
+	case 0x49: /* CH */
+		a = ADDRX;
+		CHECK( a, 2, 2 );
+		m->cc = compare( r[op->r1], (int16_t)get2( m, a ) );
+		return 0;
+	case 0x4A: /* AH */
+		a = ADDRX;
+		CHECK( a, 2, 2 );
+		return add( m, op->r1, (int16_t)get2( m, a ) );
+	case 0x4B: /* SH */
+		a = ADDRX;
+		CHECK( a, 2, 2 );
+		return subtract( m, op->r1, (int16_t)get2( m, a ) );
+	case 0x4C: /* MH */
+		a = ADDRX;
+		CHECK( a, 2, 2 );
+		r[op->r1] = (int32_t)r[op->r1] * (int16_t)get2( m, a );
+		return 0;
+	case 0x4E: /* CVD */
+		a = ADDRX;
+		CHECK( a, 8, 8 );
+		convert_to_decimal( m, op->r1, a );
+		return 0;
+	case 0x4F: /* CVB */
+		a = ADDRX;
+		CHECK( a, 8, 8 );
+		return convert_to_binary( m, op->r1, a );
+	case 0x50: /* ST */
+		a = ADDRX;
+		CHECK( a, 4, 4 );
+		put4( m, a, r[op->r1] );
+		STORED1( m, a );
+		return 0;
+	case 0x54: /* N */
+	case 0x56: /* O */
+	case 0x57: /* X */
+		a = ADDRX;
+		CHECK( a, 4, 4 );
+		v = get4( m, a );
+		if (op->op == 0x54) r[op->r1] &= v;
+		else if (op->op == 0x56) r[op->r1] |= v;
+		else r[op->r1] ^= v;
+		m->cc = r[op->r1] != 0;
+		return 0;
+	case 0x55: /* CL */
+		a = ADDRX;
+		CHECK( a, 4, 4 );
+		m->cc = compare_logical( r[op->r1], get4( m, a ) );
+		return 0;
+	case 0x58: /* L */
+		a = ADDRX;
+		CHECK( a, 4, 4 );
+		r[op->r1] = get4( m, a );
+		return 0;
+	case 0x59: /* C */
+		a = ADDRX;
+		CHECK( a, 4, 4 );
+		m->cc = compare( r[op->r1], get4( m, a ) );
+		return 0;
+	case 0x5A: /* A */
+		a = ADDRX;
+		CHECK( a, 4, 4 );
+		return add( m, op->r1, get4( m, a ) );
+	case 0x5B: /* S */
+		a = ADDRX;
+		CHECK( a, 4, 4 );
+		return subtract( m, op->r1, get4( m, a ) );
+	case 0x5C: /* M */
+		a = ADDRX;
+		CHECK( a, 4, 4 );
+		return multiply( m, op->r1, get4( m, a ) );
+	case 0x5D: /* D */
+		a = ADDRX;
+		CHECK( a, 4, 4 );
+		return divide( m, op->r1, get4( m, a ) );
+	case 0x5E: /* AL */
+		a = ADDRX;
+		CHECK( a, 4, 4 );
+		add_logical( m, op->r1, get4( m, a ), 0 );
+		return 0;
+	case 0x5F: /* SL */
+		a = ADDRX;
+		CHECK( a, 4, 4 );
+		add_logical( m, op->r1, ~get4( m, a ), 1 );
+		return 0;
+
+	/* RS and SI */
+	case 0x82: /* LPSW */
+		if (m->problem) return SIM360_PGM_PRIVILEGED;
+		a = ADDR2;
+		CHECK( a, 8, 8 );
+		load_psw( m, a );
+		return m->wait ? X_WAIT : 0;
+	case 0x86: /* BXH */
+	case 0x87: /* BXLE */
+		a = ADDR2;
+		v = r[op->r2 | 1];		/* the comparand */
+		r[op->r1] += r[op->r2];
+		if ((op->op == 0x86) ? ((int32_t)r[op->r1] > (int32_t)v)
+				     : ((int32_t)r[op->r1] <= (int32_t)v))
+			BRANCH( a );
+		return 0;
+	case 0x88: /* SRL */
+		n = ADDR2 & 63;
+		r[op->r1] = (n > 31) ? 0 : r[op->r1] >> n;
+		return 0;
+	case 0x89: /* SLL */
+		n = ADDR2 & 63;
+		r[op->r1] = (n > 31) ? 0 : r[op->r1] << n;
+		return 0;
+	case 0x8A: /* SRA */
+		n = ADDR2 & 63;
+		r[op->r1] = (int32_t)r[op->r1] >> ((n > 31) ? 31 : n);
+		m->cc = arith_cc( r[op->r1] );
+		return 0;
+	case 0x8B: { /* SLA */
+		uint64_t w = r[op->r1];
+		int code = shift_left_arith( m, &w, 32, ADDR2 & 63 );
+		r[op->r1] = w;
+		return code;
+	}
+	case 0x8C: /* SRDL */
+	case 0x8D: /* SLDL */
+	case 0x8E: /* SRDA */
+	case 0x8F: { /* SLDA */
+		uint64_t w;
+		int code = 0;
+		EVEN( op->r1 );
+		w = ((uint64_t)r[op->r1] << 32) | r[op->r1 + 1];
+		n = ADDR2 & 63;
+		switch (op->op) {
+		case 0x8C: w >>= n; break;
+		case 0x8D: w <<= n; break;
+		case 0x8E:
+			w = (uint64_t)((int64_t)w >> n);
+			m->cc = ((int64_t)w == 0) ? 0 : ((int64_t)w < 0) ? 1 : 2;
+			break;
+		default:
+			code = shift_left_arith( m, &w, 64, n );
+		}
+		r[op->r1] = w >> 32;
+		r[op->r1 + 1] = w;
+		return code;
+	}
+	case 0x90: /* STM */
+	case 0x98: /* LM */
+		a = ADDR2;
+		n = ((op->r2 - op->r1) & 15) + 1;
+		CHECK( a, 4 * (uint32_t)n, 4 );
+		for (i = 0; i < n; i++) {
+			if (op->op == 0x90) put4( m, a + 4 * i, r[(op->r1 + i) & 15] );
+			else r[(op->r1 + i) & 15] = get4( m, a + 4 * i );
+		}
+		if (op->op == 0x90) stored( m, a, 4 * n );
+		return 0;
+	case 0x91: /* TM */
+		a = ADDR2;
+		CHECK( a, 1, 1 );
+		v = m->mem[a] & op->l;
+		m->cc = (v == 0) ? 0 : (v == op->l) ? 3 : 1;
+		return 0;
+	case 0x92: /* MVI */
+	case 0x94: /* NI */
+	case 0x96: /* OI */
+	case 0x97: /* XI */
+		a = ADDR2;
+		CHECK( a, 1, 1 );
+		switch (op->op) {
+		case 0x92: m->mem[a] = op->l; break;
+		case 0x94: m->cc = (m->mem[a] &= op->l) != 0; break;
+		case 0x96: m->cc = (m->mem[a] |= op->l) != 0; break;
+		default:   m->cc = (m->mem[a] ^= op->l) != 0; break;
+		}
+		STORED1( m, a );
+		return 0;
+	case 0x95: /* CLI */
+		a = ADDR2;
+		CHECK( a, 1, 1 );
+		m->cc = compare_logical( m->mem[a], op->l );
+		return 0;
+
+	/* SS */
+	case 0xD2: /* MVC */
+	case 0xD4: /* NC */
+	case 0xD5: /* CLC */
+	case 0xD6: /* OC */
+	case 0xD7: /* XC */
+	case 0xDC: /* TR */
+	case 0xDD: { /* TRT */
+		uint32_t a1 = ADDR1, a2 = ADDR2;
+		int any = 0;
+		n = op->l + 1;
+		CHECK( a1, (uint32_t)n, 1 );
+		CHECK( a2, (uint32_t)((op->op >= 0xDC) ? 256 : n), 1 );
+		switch (op->op) {
+		case 0xD2:
+			/* a byte at a time, so an overlap propagates */
+			for (i = 0; i < n; i++) m->mem[a1 + i] = m->mem[a2 + i];
+			break;
+		case 0xD5:
+			m->cc = 0;
+			for (i = 0; i < n; i++) {
+				if (m->mem[a1 + i] != m->mem[a2 + i]) {
+					m->cc = (m->mem[a1 + i] < m->mem[a2 + i]) ? 1 : 2;
+					break;
+				}
+			}
+			return 0;
+		case 0xDC:
+			for (i = 0; i < n; i++)
+				m->mem[a1 + i] = m->mem[a2 + m->mem[a1 + i]];
+			break;
+		case 0xDD:
+			m->cc = 0;
+			for (i = 0; i < n; i++) {
+				uint8_t f = m->mem[a2 + m->mem[a1 + i]];
+				if (f != 0) {
+					r[1] = (r[1] & ~AMASK) | (a1 + i);
+					r[2] = (r[2] & ~0xFFu) | f;
+					m->cc = (i == n - 1) ? 2 : 1;
+					break;
+				}
+			}
+			return 0;
+		default:
+			for (i = 0; i < n; i++) {
+				uint8_t *p = m->mem + a1 + i, b = m->mem[a2 + i];
+				if (op->op == 0xD4) *p &= b;
+				else if (op->op == 0xD6) *p |= b;
+				else *p ^= b;
+				any |= *p;
+			}
+			m->cc = any != 0;
+		}
+		stored( m, a1, n );
+		return 0;
+	}
+	case 0xF2: /* PACK */
+	case 0xF3: { /* UNPK */
+		uint32_t a1 = ADDR1, a2 = ADDR2;
+		int l1 = op->r1, l2 = op->r2;
+		CHECK( a1, (uint32_t)l1 + 1, 1 );
+		CHECK( a2, (uint32_t)l2 + 1, 1 );
+		if (op->op == 0xF2) pack( m, a1, l1, a2, l2 );
+		else unpack( m, a1, l1, a2, l2 );
+		stored( m, a1, l1 + 1 );
+		return 0;
+	}
+	}
+	return SIM360_PGM_OPERATION;
+}
+
+/* the monitor, for SVCs with no new PSW to take them */
+static int monitor( struct sim360 *m, int svc )
+{
+	uint32_t a = m->r[1] & AMASK;
+	uint8_t card[80];
+	uint32_t len, i;
+
+	switch (svc) {
+	case SIM360_SVC_READ:
+		if (a + 80 > m->memsize) break;
+		if (!read_card( m, card )) {
+			m->r[15] = 4;
+			return -1;
+		}
+		memcpy( m->mem + a, card, 80 );
+		stored( m, a, 80 );
+		m->r[15] = 0;
+		return -1;
+	case SIM360_SVC_EXIT:
+		return SIM360_EXIT;
+	case SIM360_SVC_ABEND:
+		m->abend = m->r[1] & AMASK;
+		return SIM360_ABEND;
+	case SIM360_SVC_WTO:
+		if (a + 4 > m->memsize) break;
+		len = get2( m, a );
+		if ((len < 4) || (a + len > m->memsize)) break;
+		wait_for( m, &m->print_unit, 0 );
+		if ((m->printer != NULL) && ((m->max_printed <= 0)
+		 || (m->print_unit.ops <= m->max_printed))) {
+			char line[SPOOL_WIDTH];
+			for (i = 4; (i < len) && (i - 4 < SPOOL_WIDTH); i++)
+				line[i - 4] = ebcdic_to_ascii( m->mem[a + i] );
+			spool_print( m->printer, line, i - 4 );
+			spool_space( m->printer, 1 );
+		}
+		return -1;
+	default:
+		m->error = "SVC not supported by the monitor";
+		return SIM360_ERROR;
+	}
+	m->error = "SVC parameters outside storage";
+	return SIM360_ERROR;
+}
+
+/* take the interruption execute asked for; -1 to go on running */
+static int interrupt( struct sim360 *m, int code, int ilc )
+{
+	if (code == X_WAIT) return SIM360_WAIT;
+	if (code & X_SVC) {
+		if (zero_psw( m, SVC_NEW )) return monitor( m, code & 0xFF );
+		store_psw( m, SVC_OLD, code & 0xFF, ilc );
+		load_psw( m, SVC_NEW );
+	} else {
+		store_psw( m, PGM_OLD, code, ilc );
+		if (zero_psw( m, PGM_NEW )) {
+			m->interruption = code;
+			m->error = "program check";
+			return SIM360_ERROR;
+		}
+		load_psw( m, PGM_NEW );
+	}
+	return m->wait ? SIM360_WAIT : -1;
+}
+
+int sim360_run( struct sim360 *m, long long limit )
+{
+	long long end = (limit < 0) ? (long long)(-1ULL >> 1) : m->count + limit;
+	struct sim360_op decoded;
+	int code, ilc, stop;
+
+	if (m->wait) return SIM360_WAIT;
+	for (;;) {
+		ilc = 0;
+		if (m->use_cache) {
+			const struct sim360_block *b = lookup( m, &code );
+			const struct sim360_op *op;
+			if (b == NULL) goto trap;
+			code = 0;
+			for (op = b->op; op < b->op + b->n; op++) {
+				if (m->count >= end) return SIM360_LIMIT;
+				m->ia = op->ia + op->len;
+				m->count++;
+				if ((code = execute( m, op )) != 0) {
+					ilc = op->len / 2;
+					break;
+				}
+				if (m->smc) break;
+			}
+			m->smc = 0;
+			if (code == 0) continue;
+		} else {
+			if ((code = fetch( m, m->ia, 0, &decoded )) != 0) goto trap;
+			if (m->count >= end) return SIM360_LIMIT;
+			m->ia += decoded.len;
+			m->count++;
+			if ((code = execute( m, &decoded )) == 0) continue;
+			ilc = decoded.len / 2;
+		}
+	trap:
+		stop = interrupt( m, code, ilc );
+		if (stop >= 0) return stop;
+	}
+}
+
+/* snapshots: the header, then storage at SNAP_ALIGN, which is a
+   multiple of any host's page size so that it can be mapped */
+
+#define SNAP_MAGIC	"S360"
+#define SNAP_ALIGN	65536
+
+struct snap_unit {
+	int64_t when;		/* when the operation under way ends */
+	int64_t ops, waited;
+	int32_t busy, spare;
+};
+
+struct snapshot {
+	char magic[4];
+	int32_t version;
+	uint32_t memsize;
+	uint32_t storage;	/* offset of storage in the file */
+	uint32_t r[16];
+	uint32_t ia;
+	int32_t sysmask, key, problem, wait, cc, progmask;
+	int64_t next_card;
+	int64_t count, io_wait;
+	int64_t now;		/* on the wheel */
+	struct snap_unit reader, print_unit;
+};
+
+static void save_unit( struct snap_unit *s, const struct sim_unit *u )
+{
+	memset( s, 0, sizeof *s );
+	s->when = u->done.when;
+	s->ops = u->ops;
+	s->waited = u->waited;
+	s->busy = u->busy;
+}
+
+/* the unit's operation under way ends when it did, on this wheel */
+static void restore_unit( struct sim360 *m, struct sim_unit *u,
+			  const struct snap_unit *s )
+{
+	sim_unit_init( u, u->cycle );
+	u->ops = s->ops;
+	u->waited = s->waited;
+	if (s->busy) {
+		u->busy = 1;
+		sim_at( &m->wheel, &u->done, s->when );
+	}
+}
+
+int sim360_save( const struct sim360 *m, FILE *f )
+{
+	static const char zero[4096];
+	struct snapshot s;
+	long pad;
+
+	memset( &s, 0, sizeof s );
+	memcpy( s.magic, SNAP_MAGIC, 4 );
+	s.version = SIM360_SNAP_VERSION;
+	s.memsize = m->memsize;
+	s.storage = SNAP_ALIGN;
+	memcpy( s.r, m->r, sizeof s.r );
+	s.ia = m->ia;
+	s.sysmask = m->sysmask;
+	s.key = m->key;
+	s.problem = m->problem;
+	s.wait = m->wait;
+	s.cc = m->cc;
+	s.progmask = m->progmask;
+	s.next_card = m->next_card;
+	s.count = m->count;
+	s.io_wait = m->io_wait;
+	s.now = m->wheel.now;
+	save_unit( &s.reader, &m->reader );
+	save_unit( &s.print_unit, &m->print_unit );
+
+	if (fwrite( &s, sizeof s, 1, f ) != 1) return -1;
+	for (pad = SNAP_ALIGN - sizeof s; pad > 0; pad -= sizeof zero)
+		if (fwrite( zero, 1, (pad < (long)sizeof zero) ? (size_t)pad
+				     : sizeof zero, f ) == 0) return -1;
+	if (fwrite( m->mem, 1, m->memsize + 8, f ) != m->memsize + 8)
+		return -1;
+	return (fflush( f ) == 0) ? 0 : -1;
+}
+
+/* storage is mapped from the file copy on write, so it costs nothing
+   until the program touches it, and then only the pages it stores in;
+   the deck stays attached and the reader goes on from the card it had
+   reached */
+int sim360_restore( struct sim360 *m, const char *path )
+{
+	struct snapshot s;
+	struct stat st;
+	uint8_t *mem;
+	int32_t *code = m->code;
+	int fd, i;
+
+	fd = open( path, O_RDONLY );
+	if (fd < 0) {
+		m->error = "cannot open the snapshot";
+		return -1;
+	}
+	if ((read( fd, &s, sizeof s ) != (ssize_t)sizeof s)
+	 || (memcmp( s.magic, SNAP_MAGIC, 4 ) != 0)
+	 || (s.version != SIM360_SNAP_VERSION)
+	 || (s.memsize < 4096) || (s.memsize > SIM360_MAXMEM)
+	 || (s.storage % SNAP_ALIGN != 0) || (fstat( fd, &st ) != 0)
+	 || (st.st_size < (off_t)s.storage + s.memsize + 8)) {
+		close( fd );
+		m->error = "not a System/360 snapshot";
+		return -1;
+	}
+	mem = mmap( NULL, s.memsize + 8, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+		    fd, s.storage );
+	close( fd );
+	if (mem == MAP_FAILED) {
+		m->error = "cannot map the snapshot";
+		return -1;
+	}
+	if (s.memsize != m->memsize) {
+		code = realloc( m->code, ((s.memsize >> SIM360_LINE) + 1)
+					 * sizeof *code );
+		if (code == NULL) {
+			munmap( mem, s.memsize + 8 );
+			m->error = "out of memory";
+			return -1;
+		}
+	}
+
+	free_mem( m );
+	m->mem = mem;
+	m->mapped = s.memsize + 8;
+	m->memsize = s.memsize;
+	m->code = code;
+	memset( m->code, 0, LINES( m ) * sizeof *m->code );
+	for (i = 0; i < SIM360_BLOCKS; i++) {
+		m->blocks[i].start = 1;
+		m->blocks[i].end = 0;
+	}
+	m->smc = 0;
+
+	memcpy( m->r, s.r, sizeof m->r );
+	m->ia = s.ia;
+	m->sysmask = s.sysmask;
+	m->key = s.key;
+	m->problem = s.problem;
+	m->wait = s.wait;
+	m->cc = s.cc;
+	m->progmask = s.progmask;
+	m->next_card = (s.next_card < m->ncards) ? s.next_card : m->ncards;
+	m->count = s.count;
+	m->io_wait = s.io_wait;
+	m->interruption = 0;
+	m->abend = 0;
+	m->error = NULL;
+	sim_wheel_init( &m->wheel, m->wheel.mode, SIM_SHIFT );
+	m->wheel.now = s.now;
+	restore_unit( m, &m->reader, &s.reader );
+	restore_unit( m, &m->print_unit, &s.print_unit );
+	return 0;
+}
@@ -0,0 +1,165 @@
+/* sim360.h -- IBM System/360 emulator core.
+ *
+ * The CPU is a System/360 model with the standard instruction set:
+ * binary arithmetic, logical, branching, shifts, and the character
+ * instructions of the decimal feature that programs use for I/O (MVC,
+ * CLC, TR, PACK, UNPK, CVB, CVD and friends).  There is no floating
+ * point, no decimal arithmetic, no storage protection and no channel;
+ * I/O goes through a small monitor, below.  Storage is big-endian,
+ * byte addressed, with 24-bit addresses.
+ *
+ * Object decks, as an assembler punches them, are read from a virtual
+ * 2540 reader fed from a card-image deck and loaded at their assembled
+ * addresses.  Cards after the END card stay in the hopper for the
+ * program to read.
+ *
+ * Instructions are decoded a basic block at a time: a straight run of
+ * up to SIM360_BLOCK instructions ending at the first one that can
+ * branch.  Decoded blocks are cached by their starting address, so a
+ * loop is decoded once and then run from the cache.  Storage is divided
+ * into 64-byte lines, each with a list of the cached blocks in it; a
+ * store into such a line drops the blocks holding the bytes stored, and
+ * only those, and ends the block being run, so self-modifying programs
+ * see their changes, while data kept beside code costs a short walk of
+ * its line's list.
+ *
+ * Simulated time is SIM360_INSN ns an instruction, a model 40's
+ * average, plus the time spent waiting on I/O.  The 2540 reader takes
+ * a card cycle for each card, and a program waits for the card it
+ * reads; WTO lines go to a 1403, which prints while the program goes
+ * on, so only a line started while the last is still printing waits.
+ * The 1403 is spooled by spool.h; a line is printed and the form spaced
+ * one, and text past print position 132 is lost.
+ * The devices are on a simevent.h wheel; set its mode to
+ * SIM_UNTHROTTLED after sim360_init and I/O takes no time.
+ *
+ * sim360_save writes the state of the machine to a snapshot file: the
+ * registers and PSW, the counts and simulated time, the card the
+ * reader has reached and any operation the devices have under way,
+ * then all of storage, page aligned.  sim360_restore puts a machine
+ * back in that state by mapping the file's storage copy on write, so
+ * that many runs can start from one warm state, each in microseconds
+ * and each with its own storage, and the file is never written.  The
+ * deck attached stays in the hopper; the reader goes on from the card
+ * it had reached when the snapshot was made.  Snapshots are in host
+ * byte order.
+ *
+ */
+
+#ifndef SIM360_H
+#define SIM360_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "simevent.h"
+#include "spool.h"
+
+#define SIM360_MAXMEM	(16 << 20)
+#define SIM360_BLOCK	32	/* instructions in a cached block, at most */
+#define SIM360_BLOCKS	1024	/* blocks in the cache */
+#define SIM360_LINE	6	/* log2 of the code tracking granule */
+#define SIM360_SPAN	4	/* lines a block can touch: SIM360_BLOCK
+				   6-byte instructions, from anywhere
+				   in a line */
+#define SIM360_INSN	12000LL	/* ns an instruction, on average */
+#define SIM360_SNAP_VERSION 1
+
+/* why sim360_run returned */
+#define SIM360_EXIT	0	/* SVC 3, or a return to the loader */
+#define SIM360_LIMIT	1	/* the instruction limit ran out */
+#define SIM360_WAIT	2	/* a PSW with the wait bit was loaded */
+#define SIM360_ABEND	3	/* SVC 13 */
+#define SIM360_ERROR	4	/* a program check with no new PSW, or
+				   an SVC the monitor does not know */
+
+/* the monitor: SVCs taken while the SVC new PSW is zero */
+#define SIM360_SVC_READ	0	/* read a card into 80 bytes at R1;
+				   R15 = 0, or 4 at end of file */
+#define SIM360_SVC_EXIT	3	/* end the job, return code in R15 */
+#define SIM360_SVC_ABEND 13	/* end the job abnormally, code in R1 */
+#define SIM360_SVC_WTO	35	/* write to operator, R1 -> a length
+				   halfword, a flags halfword, the text */
+
+/* program interruption codes */
+#define SIM360_PGM_OPERATION	1
+#define SIM360_PGM_PRIVILEGED	2
+#define SIM360_PGM_EXECUTE	3
+#define SIM360_PGM_ADDRESSING	5
+#define SIM360_PGM_SPECIFICATION 6
+#define SIM360_PGM_DATA		7
+#define SIM360_PGM_OVERFLOW	8
+#define SIM360_PGM_DIVIDE	9
+
+/* one decoded instruction; SI and S formats keep their operand in b2
+   and d2, SI its immediate byte in l, RX its index register in r2 */
+struct sim360_op {
+	uint8_t op;
+	uint8_t len;		/* bytes, 2, 4 or 6 */
+	uint8_t r1, r2;
+	uint8_t l;		/* the whole second byte */
+	uint8_t b1, b2;
+	uint16_t d1, d2;
+	uint32_t ia;		/* address of the instruction */
+};
+
+struct sim360_block {
+	uint32_t start;		/* address of the first instruction */
+	uint32_t end;		/* just past the last; start > end if empty */
+	int n;
+	/* the lists of blocks in each line it touches, line k from its
+	   start's: block * SIM360_SPAN + k + 1 of the next and previous
+	   blocks, or 0 */
+	int32_t next[SIM360_SPAN], prev[SIM360_SPAN];
+	struct sim360_op op[SIM360_BLOCK];
+};
+
+struct sim360 {
+	uint8_t *mem;
+	uint32_t memsize;
+	size_t mapped;		/* bytes mapped from a snapshot, or 0 */
+	uint32_t r[16];		/* general registers */
+
+	/* the basic control mode PSW */
+	uint8_t sysmask, key;
+	int problem, wait;
+	int cc;			/* condition code, 0-3 */
+	int progmask;		/* fixed overflow, decimal, exponent, sig. */
+	uint32_t ia;		/* instruction address */
+
+	/* the block cache */
+	int use_cache;
+	struct sim360_block *blocks;	/* SIM360_BLOCKS of them */
+	int32_t *code;			/* for each line, the first of its
+					   list of cached blocks, as in
+					   sim360_block, or 0 */
+	int smc;			/* a store dropped cached code */
+
+	/* the 2540 reader and the 1403 that WTO prints on */
+	uint16_t *deck;		/* 80 columns per card */
+	long ncards;
+	long next_card;
+	struct spool *printer;	/* or NULL */
+	long max_printed;	/* past this, lines are counted in print_unit.ops
+				   but not printed; 0 for none */
+	struct sim_wheel wheel;
+	struct sim_unit reader, print_unit;
+
+	long long count;	/* instructions executed */
+	long long io_wait;	/* ns of simulated time waiting on I/O */
+	int interruption;	/* program interruption code, for errors */
+	uint32_t abend;		/* completion code of SVC 13 */
+	const char *error;	/* why SIM360_ERROR, or a load failure */
+};
+
+int sim360_init( struct sim360 *m, uint32_t memsize );
+void sim360_free( struct sim360 *m );
+int sim360_attach_deck( struct sim360 *m, const unsigned char *deck,
+			size_t len );
+void sim360_detach_deck( struct sim360 *m );
+int sim360_load( struct sim360 *m );
+int sim360_run( struct sim360 *m, long long limit );
+long long sim360_time( const struct sim360 *m );
+int sim360_save( const struct sim360 *m, FILE *f );
+int sim360_restore( struct sim360 *m, const char *path );
+
+#endif /* SIM360_H */
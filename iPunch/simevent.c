@@ -0,0 +1,150 @@
+/* simevent.c -- device events on simulated time, for the emulators.
+ *
+ * see simevent.h
+ *
+ */
+
+#include <string.h>
+#include "simevent.h"
+
+#define MASK	(SIM_SLOTS - 1)
+
+void sim_wheel_init( struct sim_wheel *w, int mode, int shift )
+{
+	memset( w, 0, sizeof *w );
+	w->next = SIM_NEVER;
+	w->mode = mode;
+	w->shift = shift;
+}
+
+void sim_event_init( struct sim_event *ev,
+		     void (*fire)( struct sim_event *ev, void *arg ),
+		     void *arg )
+{
+	memset( ev, 0, sizeof *ev );
+	ev->when = SIM_NEVER;
+	ev->fire = fire;
+	ev->arg = arg;
+}
+
+/* the earliest event: nothing is before now, so the first slot from
+   now's whose head falls in this turn of the wheel holds it */
+static void find_next( struct sim_wheel *w )
+{
+	long long tick = w->now >> w->shift;
+	long long best = SIM_NEVER;
+	int k;
+
+	if (w->pending == 0) {
+		w->next = SIM_NEVER;
+		return;
+	}
+	for (k = 0; k < SIM_SLOTS; k++) {
+		const struct sim_event *head = w->slot[(tick + k) & MASK];
+		if (head == NULL) continue;
+		if ((head->when >> w->shift) == tick + k) {
+			w->next = head->when;
+			return;
+		}
+		if (head->when < best) best = head->when;
+	}
+
+	/* everything is a turn or more away */
+	w->next = best;
+}
+
+void sim_at( struct sim_wheel *w, struct sim_event *ev, long long when )
+{
+	struct sim_event **p;
+
+	if (ev->pending) sim_cancel( w, ev );
+	if (when < w->now) when = w->now;
+	ev->when = when;
+	for (p = &w->slot[(when >> w->shift) & MASK]; *p != NULL; p = &(*p)->next)
+		if ((*p)->when > when) break;
+	ev->next = *p;
+	*p = ev;
+	ev->pending = 1;
+	w->pending++;
+	if (when < w->next) w->next = when;
+}
+
+void sim_cancel( struct sim_wheel *w, struct sim_event *ev )
+{
+	struct sim_event **p;
+
+	if (!ev->pending) return;
+	for (p = &w->slot[(ev->when >> w->shift) & MASK]; *p != ev; p = &(*p)->next)
+		;
+	*p = ev->next;
+	ev->next = NULL;
+	ev->pending = 0;
+	w->pending--;
+	if (ev->when == w->next) find_next( w );
+}
+
+/* fire everything due by until, in time order; an event may schedule
+   others, and those that fall due by until fire too */
+void sim_advance( struct sim_wheel *w, long long until )
+{
+	while (w->next <= until) {
+		struct sim_event **p = &w->slot[(w->next >> w->shift) & MASK];
+		struct sim_event *ev = *p;
+
+		*p = ev->next;
+		ev->next = NULL;
+		ev->pending = 0;
+		w->pending--;
+		w->now = ev->when;
+		w->fired++;
+		find_next( w );
+		ev->fire( ev, ev->arg );
+	}
+	if (until > w->now) w->now = until;
+}
+
+long long sim_delay( const struct sim_wheel *w, long long ns )
+{
+	return (w->mode == SIM_UNTHROTTLED) ? 0 : ns;
+}
+
+static void unit_done( struct sim_event *ev, void *arg )
+{
+	struct sim_unit *u = arg;
+
+	(void)ev;
+	u->busy = 0;
+}
+
+void sim_unit_init( struct sim_unit *u, long long cycle )
+{
+	memset( u, 0, sizeof *u );
+	u->cycle = cycle;
+	sim_event_init( &u->done, unit_done, u );
+}
+
+/* wait out the last operation, if need be, and start another; returns
+   the time it started */
+long long sim_unit_start( struct sim_wheel *w, struct sim_unit *u,
+			  long long now )
+{
+	now = sim_unit_wait( w, u, now );
+	u->busy = 1;
+	u->ops++;
+	sim_at( w, &u->done, now + sim_delay( w, u->cycle ) );
+	return now;
+}
+
+/* the time the unit is free, from now */
+long long sim_unit_wait( struct sim_wheel *w, struct sim_unit *u,
+			 long long now )
+{
+	sim_advance( w, now );
+	if (u->busy) {
+		long long t = u->done.when;
+		u->waited += t - now;
+		sim_advance( w, t );
+		now = t;
+	}
+	return now;
+}
@@ -0,0 +1,90 @@
+/* simevent.h -- device events on simulated time, for the emulators.
+ *
+ * Each emulator keeps simulated time in nanoseconds, and its devices
+ * say what happens next by scheduling events on a timing wheel: a
+ * feed that finishes, a column that comes under the brushes, a line
+ * that has been printed.  The processor moves the wheel along to its
+ * own time, and the events that are due fire in time order, ties in
+ * the order they were scheduled.
+ *
+ * The wheel has SIM_SLOTS slots, each 1 << shift ns wide, and an event
+ * goes in the slot for its time modulo one turn of the wheel, kept in
+ * time order there.  Scheduling touches one short list whatever the
+ * number of events; finding the next event walks forward from the
+ * current slot, usually no further than the next device's slot.  The
+ * time of the next event is kept in the wheel, so the processor can
+ * compare its clock with it before every instruction.
+ *
+ * A wheel runs in one of two modes.  In SIM_PERIOD, devices take as
+ * long as the real ones did, and programs see the same overlap and
+ * waits they would have seen.  In SIM_UNTHROTTLED, sim_delay makes
+ * every device delay zero, so I/O finishes as soon as it is started
+ * and a job is limited only by its processor time.
+ *
+ * A sim_unit is a unit-record device that does one thing at a time, a
+ * card or a line: the processor waits for it if it is still busy with
+ * the last one, and may go on while it works or wait for it to finish.
+ *
+ */
+
+#ifndef SIMEVENT_H
+#define SIMEVENT_H
+
+#define SIM_NEVER	((long long)(-1ULL >> 1))	/* nothing scheduled */
+
+#define SIM_PERIOD	0	/* devices at the speed of the real ones */
+#define SIM_UNTHROTTLED	1	/* I/O finishes when it is started */
+
+#define SIM_SLOTS	256	/* slots in a wheel, a power of two */
+#define SIM_SHIFT	20	/* default slot width, about a millisecond */
+
+/* unit-record speeds, in ns a card or a line */
+#define SIM_2540_READ	60000000LL	/* 1000 cards a minute */
+#define SIM_2540_PUNCH	200000000LL	/* 300 cards a minute */
+#define SIM_1402_READ	75000000LL	/* 800 cards a minute */
+#define SIM_1402_PUNCH	240000000LL	/* 250 cards a minute */
+#define SIM_1403_N1	54545454LL	/* 1100 lines a minute */
+#define SIM_1403_2	100000000LL	/* 600 lines a minute */
+
+struct sim_event {
+	long long when;
+	void (*fire)( struct sim_event *ev, void *arg );
+	void *arg;
+	struct sim_event *next;		/* in its slot */
+	int pending;
+};
+
+struct sim_wheel {
+	long long now;		/* where the wheel has got to */
+	long long next;		/* the earliest event, or SIM_NEVER */
+	int shift;		/* a slot is 1 << shift ns */
+	int mode;		/* SIM_PERIOD or SIM_UNTHROTTLED */
+	long pending;		/* events scheduled */
+	long long fired;
+	struct sim_event *slot[SIM_SLOTS];
+};
+
+struct sim_unit {
+	long long cycle;	/* ns an operation takes, at period speed */
+	int busy;
+	long ops;		/* operations started */
+	long long waited;	/* ns the processor waited for the unit */
+	struct sim_event done;
+};
+
+void sim_wheel_init( struct sim_wheel *w, int mode, int shift );
+void sim_event_init( struct sim_event *ev,
+		     void (*fire)( struct sim_event *ev, void *arg ),
+		     void *arg );
+void sim_at( struct sim_wheel *w, struct sim_event *ev, long long when );
+void sim_cancel( struct sim_wheel *w, struct sim_event *ev );
+void sim_advance( struct sim_wheel *w, long long until );
+long long sim_delay( const struct sim_wheel *w, long long ns );
+
+void sim_unit_init( struct sim_unit *u, long long cycle );
+long long sim_unit_start( struct sim_wheel *w, struct sim_unit *u,
+			  long long now );
+long long sim_unit_wait( struct sim_wheel *w, struct sim_unit *u,
+			 long long now );
+
+#endif /* SIMEVENT_H */
@@ -0,0 +1,584 @@
+/* simpdp8.c -- DEC PDP-8/E emulator core.
+ *
+ * The processor is a PDP-8/E with KM8-E memory extension and without
+ * EAE; group 3 operate instructions do only CLA, MQA, MQL and SWP.
+ * see simpdp8.h for the dispatch table, the devices and idle waits.
+ *
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "simpdp8.h"
+#include "cardconv.h"
+
+/* period speeds, in ns */
+#define CYCLE		1200LL		/* memory cycle */
+#define TTY_CHAR	100000000LL	/* ASR 33, 10 characters a second */
+#define CR_PICK		40000000LL	/* card feed to column 1 */
+#define CR_COLUMN	2000000LL	/* 300 cards a minute in all */
+
+#define NEVER		SIMPDP8_NEVER
+#define PAGE( m )	(((m)->pc - 1) & 07600)
+
+typedef void (*handler)( struct simpdp8 *m, int ir );
+
+static handler dispatch[4096];
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+/* start ev delay ns from now, or at once when unthrottled */
+static void after( struct simpdp8 *m, struct sim_event *ev, long long delay )
+{
+	sim_at( &m->wheel, ev, m->time + sim_delay( &m->wheel, delay ) );
+}
+
+static int irq( const struct simpdp8 *m )
+{
+	return (m->tty_ie && (m->tp_flag || m->kb_flag))
+	    || m->cr_data || m->cr_done;
+}
+
+/* a wait loop was detected: go straight to the next event, unless one
+   came just before the branch, too late for the skip to see it */
+static void idle( struct simpdp8 *m )
+{
+	if (m->event_at == m->count - 1) {
+		return;
+	} else if (m->wheel.next == NEVER) {
+		m->stop = SIMPDP8_IDLE;
+	} else if (m->wheel.next > m->time) {
+		m->idle_time += m->wheel.next - m->time;
+		m->time = m->wheel.next;
+	}
+}
+
+static void tp_done( struct sim_event *ev, void *arg )
+{
+	struct simpdp8 *m = arg;
+
+	(void)ev;
+	m->tp_flag = 1;
+}
+
+static void kb_next( struct sim_event *ev, void *arg )
+{
+	struct simpdp8 *m = arg;
+	int c = getc( m->keyboard );
+
+	(void)ev;
+	if (c != EOF) {
+		m->kb_buffer = 0200 | ((c == '\n') ? '\r' : (c & 0177));
+		m->kb_flag = 1;
+	}
+}
+
+/* the next column comes under the brushes, or the card is done; when
+   unthrottled, the next column waits for the program to take this one */
+static void cr_next( struct sim_event *ev, void *arg )
+{
+	struct simpdp8 *m = arg;
+
+	if (m->column < 80) {
+		if (m->cr_data) m->cr_missed++;
+		m->cr_buffer = m->deck[(m->next_card - 1) * 80 + m->column++];
+		m->cr_data = 1;
+		if (m->wheel.mode == SIM_PERIOD)
+			sim_at( &m->wheel, ev, m->wheel.now + CR_COLUMN );
+	} else {
+		m->cr_done = 1;
+		m->column = -1;
+	}
+}
+
+static void events( struct simpdp8 *m )
+{
+	m->event_at = m->count;
+	sim_advance( &m->wheel, m->time );
+}
+
+static void cr_taken( struct simpdp8 *m )
+{
+	m->cr_data = 0;
+	if ((m->wheel.mode == SIM_UNTHROTTLED) && (m->column >= 0))
+		after( m, &m->cr_event, 0 );
+}
+
+/* memory reference: operand address in ea, its field in fld */
+#define OPERAND( ind, cur ) \
+	int ea = (cur) ? (PAGE( m ) | (ir & 0177)) : (ir & 0177); \
+	int fld = m->ifield; \
+	if (ind) { \
+		int p = m->ifield | ea; \
+		if ((ea & 07770) == 00010) m->mem[p] = (m->mem[p] + 1) & 07777; \
+		ea = m->mem[p]; \
+		fld = m->dfield; \
+		m->time += CYCLE; \
+	}
+
+#define MEMREF( name, ind, cur, body ) \
+static void name( struct simpdp8 *m, int ir ) \
+{ \
+	OPERAND( ind, cur ) \
+	(void)fld; \
+	body \
+}
+
+/* each operation in its four addressing modes: page zero or current
+   page, direct or indirect */
+#define MEMREF4( name, body ) \
+	MEMREF( name##_dz, 0, 0, body ) \
+	MEMREF( name##_dc, 0, 1, body ) \
+	MEMREF( name##_iz, 1, 0, body ) \
+	MEMREF( name##_ic, 1, 1, body )
+
+MEMREF4( op_and,
+	m->ac &= m->mem[fld | ea];
+	m->time += CYCLE;
+)
+
+MEMREF4( op_tad,
+	int v = ((m->link | m->ac) + m->mem[fld | ea]) & 017777;
+	m->link = v & 010000;
+	m->ac = v & 07777;
+	m->time += CYCLE;
+)
+
+MEMREF4( op_isz,
+	int v = (m->mem[fld | ea] + 1) & 07777;
+	m->mem[fld | ea] = v;
+	if (v == 0) m->pc = (m->pc + 1) & 07777;
+	m->time += CYCLE;
+)
+
+MEMREF4( op_dca,
+	m->mem[fld | ea] = m->ac;
+	m->ac = 0;
+	m->time += CYCLE;
+)
+
+MEMREF4( op_jms,
+	m->ifield = m->ib;
+	m->inhibit = 0;
+	m->mem[m->ifield | ea] = m->pc;
+	m->pc = (ea + 1) & 07777;
+	m->time += CYCLE;
+)
+
+MEMREF4( op_jmp,
+	int from = m->pc;
+	int same = (m->ib == m->ifield);
+	m->ifield = m->ib;
+	m->inhibit = 0;
+	m->pc = ea;
+	/* JMP .-1 back to a skip IOT, or JMP . with interrupts on */
+	if (m->idle_detect && same && !(ir & 0400)) {
+		if ((ea == ((from - 2) & 07777))
+		 && ((m->mem[m->ifield | ea] & 07000) == 06000))
+			idle( m );
+		else if (ea == ((from - 1) & 07777)) {
+			if (m->ion) idle( m );
+			else m->stop = SIMPDP8_IDLE;
+		}
+	}
+)
+
+#define SKIP( m )	((m)->pc = ((m)->pc + 1) & 07777)
+
+/* group 1: CLA CLL, then CMA CML, then IAC, then the rotates */
+static void opr1( struct simpdp8 *m, int ir )
+{
+	int v = m->link | m->ac;
+
+	if (ir & 0200) v &= 010000;
+	if (ir & 0100) v &= 07777;
+	if (ir & 0040) v ^= 07777;
+	if (ir & 0020) v ^= 010000;
+	if (ir & 0001) v = (v + 1) & 017777;
+	switch (ir & 0016) {
+	case 0002: /* BSW */
+		v = (v & 010000) | ((v & 077) << 6) | ((v >> 6) & 077);
+		break;
+	case 0006: /* RTL */
+		v = ((v << 1) | (v >> 12)) & 017777;
+		/* fall through */
+	case 0004: /* RAL */
+		v = ((v << 1) | (v >> 12)) & 017777;
+		break;
+	case 0012: /* RTR */
+		v = (v >> 1) | ((v & 1) << 12);
+		/* fall through */
+	case 0010: /* RAR */
+		v = (v >> 1) | ((v & 1) << 12);
+		break;
+	}
+	m->link = v & 010000;
+	m->ac = v & 07777;
+}
+
+/* group 2: the skips, then CLA, then OSR, then HLT */
+static void opr2( struct simpdp8 *m, int ir )
+{
+	int skip = 0;
+
+	if ((ir & 0100) && (m->ac & 04000)) skip = 1;	/* SMA */
+	if ((ir & 0040) && (m->ac == 0)) skip = 1;	/* SZA */
+	if ((ir & 0020) && m->link) skip = 1;		/* SNL */
+	if (ir & 0010) skip = !skip;			/* SPA SNA SZL SKP */
+	if (skip) SKIP( m );
+	if (ir & 0200) m->ac = 0;
+	if (ir & 0004) m->ac |= m->sr;
+	if (ir & 0002) m->stop = SIMPDP8_HALT;
+}
+
+/* group 3, without EAE: CLA, then MQA and MQL */
+static void opr3( struct simpdp8 *m, int ir )
+{
+	uint16_t ac = (ir & 0200) ? 0 : m->ac, mq = m->mq;
+
+	if ((ir & 0120) == 0120) {		/* SWP */
+		m->ac = mq;
+		m->mq = ac;
+	} else if (ir & 0100) {			/* MQA */
+		m->ac = ac | mq;
+	} else if (ir & 0020) {			/* MQL */
+		m->mq = ac;
+		m->ac = 0;
+	} else {
+		m->ac = ac;
+	}
+}
+
+static void interrupt( struct simpdp8 *m )
+{
+	m->sf = ((m->ifield >> 12) << 3) | (m->dfield >> 12);
+	m->mem[0] = m->pc;
+	m->pc = 1;
+	m->ifield = m->dfield = m->ib = 0;
+	m->ion = 0;
+	m->time += CYCLE;
+}
+
+/* 600x, the processor */
+static void iot_cpu( struct simpdp8 *m, int ir )
+{
+	switch (ir & 7) {
+	case 0: /* SKON */
+		if (m->ion) SKIP( m );
+		m->ion = 0;
+		break;
+	case 1: /* ION */
+		m->ion = 1;
+		m->ion_delay = 1;
+		break;
+	case 2: /* IOF */
+		m->ion = 0;
+		break;
+	case 3: /* SRQ */
+		if (irq( m )) SKIP( m );
+		break;
+	case 4: /* GTF */
+		m->ac = (m->link >> 1) | (irq( m ) ? 01000 : 0)
+		      | (m->inhibit ? 0400 : 0) | (m->ion ? 0200 : 0) | m->sf;
+		break;
+	case 5: /* RTF */
+		m->link = (m->ac & 04000) << 1;
+		m->ib = ((m->ac >> 3) & 7) << 12;
+		m->dfield = (m->ac & 7) << 12;
+		m->ion = 1;
+		m->ion_delay = 1;
+		m->inhibit = 1;
+		break;
+	case 7: /* CAF */
+		m->ac = m->link = 0;
+		m->ion = 0;
+		m->tp_flag = m->kb_flag = 0;
+		m->cr_data = m->cr_done = 0;
+		m->tty_ie = 1;
+		break;
+	}
+}
+
+/* 62Nx, memory extension */
+static void iot_mem( struct simpdp8 *m, int ir )
+{
+	int n = (ir >> 3) & 7;
+
+	if (ir & 1) m->dfield = n << 12;		/* CDF */
+	if (ir & 2) {					/* CIF */
+		m->ib = n << 12;
+		m->inhibit = 1;
+	}
+	if ((ir & 7) != 4) return;
+	switch (n) {
+	case 1: m->ac |= (m->dfield >> 12) << 3; break;	/* RDF */
+	case 2: m->ac |= (m->ifield >> 12) << 3; break;	/* RIF */
+	case 3: m->ac |= m->sf; break;			/* RIB */
+	case 4:						/* RMF */
+		m->ib = ((m->sf >> 3) & 7) << 12;
+		m->dfield = (m->sf & 7) << 12;
+		m->inhibit = 1;
+		break;
+	}
+}
+
+/* 603x, the keyboard */
+static void iot_kb( struct simpdp8 *m, int ir )
+{
+	if ((ir & 1) && m->kb_flag) SKIP( m );		/* KSF */
+	if (ir & 2) {					/* KCC */
+		m->ac = 0;
+		if (m->kb_flag && (m->keyboard != NULL))
+			after( m, &m->kb_event, TTY_CHAR );
+		m->kb_flag = 0;
+	}
+	if (ir & 4) {
+		if ((ir & 7) == 5) m->tty_ie = m->ac & 1;	/* KIE */
+		else m->ac |= m->kb_buffer;		/* KRS */
+	}
+}
+
+/* 604x, the teleprinter */
+static void iot_tp( struct simpdp8 *m, int ir )
+{
+	int c;
+
+	switch (ir & 7) {
+	case 0: m->tp_flag = 1; return;				/* SPF */
+	case 1: if (m->tp_flag) SKIP( m ); return;		/* TSF */
+	case 2: m->tp_flag = 0; return;				/* TCF */
+	case 5: if (m->tp_flag || m->kb_flag) SKIP( m ); return; /* TSK */
+	case 4:							/* TPC */
+	case 6:							/* TLS */
+		break;
+	default:
+		return;
+	}
+	/* the carriage return ends the line; line feeds are dropped */
+	c = m->ac & 0177;
+	if (c == '\r') c = '\n';
+	else if (c == '\n') c = 0;
+	if ((m->printer != NULL) && (c != 0) && (c != 0177))
+		putc( c, m->printer );
+	if ((ir & 7) == 6) m->tp_flag = 0;
+	after( m, &m->tp_event, TTY_CHAR );
+}
+
+/* 663x, the CR8-E data */
+static void iot_cr_data( struct simpdp8 *m, int ir )
+{
+	int c;
+
+	switch (ir & 7) {
+	case 1: /* RCSF */
+		if (m->cr_data) SKIP( m );
+		break;
+	case 2: /* RCRA */
+		c = card_decode( &m->codec, m->cr_buffer );
+		m->ac = ((c == '~') ? '?' : c) & 077;
+		cr_taken( m );
+		break;
+	case 4: /* RCRB */
+		m->ac = m->cr_buffer;
+		cr_taken( m );
+		break;
+	}
+}
+
+/* 667x, the CR8-E control */
+static void iot_cr_control( struct simpdp8 *m, int ir )
+{
+	switch (ir & 7) {
+	case 1: /* RCSD */
+		if (m->cr_done) SKIP( m );
+		break;
+	case 2: /* RCSE */
+		if ((m->column >= 0) || (m->next_card >= m->ncards)) break;
+		m->next_card++;
+		m->column = 0;
+		m->cr_done = 0;
+		after( m, &m->cr_event, CR_PICK );
+		SKIP( m );
+		break;
+	case 4: /* RCRD */
+		m->cr_done = 0;
+		break;
+	case 5: /* RCSI */
+		if (m->cr_data || m->cr_done) SKIP( m );
+		break;
+	}
+}
+
+/* devices that are not there do nothing */
+static void iot_none( struct simpdp8 *m, int ir )
+{
+	(void)m;
+	(void)ir;
+}
+
+static void build( void )
+{
+	static const handler memref[6][4] = {
+		{ op_and_dz, op_and_dc, op_and_iz, op_and_ic },
+		{ op_tad_dz, op_tad_dc, op_tad_iz, op_tad_ic },
+		{ op_isz_dz, op_isz_dc, op_isz_iz, op_isz_ic },
+		{ op_dca_dz, op_dca_dc, op_dca_iz, op_dca_ic },
+		{ op_jms_dz, op_jms_dc, op_jms_iz, op_jms_ic },
+		{ op_jmp_dz, op_jmp_dc, op_jmp_iz, op_jmp_ic },
+	};
+	int ir;
+
+	for (ir = 0; ir < 06000; ir++)
+		dispatch[ir] = memref[ir >> 9][(ir >> 7) & 3];
+	for (ir = 06000; ir < 07000; ir++) {
+		int dev = (ir >> 3) & 077;
+		if (dev == 000) dispatch[ir] = iot_cpu;
+		else if ((dev & 070) == 020) dispatch[ir] = iot_mem;
+		else if (dev == 003) dispatch[ir] = iot_kb;
+		else if (dev == 004) dispatch[ir] = iot_tp;
+		else if (dev == 063) dispatch[ir] = iot_cr_data;
+		else if (dev == 067) dispatch[ir] = iot_cr_control;
+		else dispatch[ir] = iot_none;
+	}
+	for (ir = 07000; ir < 010000; ir++) {
+		if ((ir & 0400) == 0) dispatch[ir] = opr1;
+		else if ((ir & 1) == 0) dispatch[ir] = opr2;
+		else dispatch[ir] = opr3;
+	}
+}
+
+void simpdp8_init( struct simpdp8 *m )
+{
+	struct card_options opt;
+
+	pthread_once( &once, build );
+	memset( m, 0, sizeof *m );
+	m->pc = 0200;
+	m->stop = -1;
+	m->tty_ie = 1;
+	m->idle_detect = 1;
+	sim_wheel_init( &m->wheel, SIM_PERIOD, SIM_SHIFT );
+	sim_event_init( &m->tp_event, tp_done, m );
+	sim_event_init( &m->kb_event, kb_next, m );
+	sim_event_init( &m->cr_event, cr_next, m );
+	m->column = -1;
+	card_options_init( &opt );
+	opt.table = CARD_029;
+	card_codec_init( &m->codec, &opt );
+}
+
+int simpdp8_attach_deck( struct simpdp8 *m, const unsigned char *deck,
+			 size_t len )
+{
+	long ncards, card;
+	int err, col;
+	size_t card_bytes;
+
+	err = card_validate_buffer( deck, len, &ncards );
+	if (err != CARD_OK) return err;
+	card_bytes = (deck[2] == '0') ? 3 + 120 : 3 + 123;
+
+	simpdp8_detach_deck( m );
+	m->deck = malloc( (ncards ? ncards : 1) * 80 * sizeof(uint16_t) );
+	if (m->deck == NULL) return CARD_ENOMEM;
+	for (card = 0; card < ncards; card++) {
+		const unsigned char *p = deck + 3 + card * card_bytes + 3;
+		uint16_t cols[82];
+		int n = (card_bytes == 3 + 120) ? 80 : 82;
+		for (col = 0; col < n; col += 2, p += 3) {
+			cols[col] = (p[0] << 4) | (p[1] >> 4);
+			cols[col + 1] = ((p[1] & 0017) << 8) | p[2];
+		}
+		/* H82 carries the two edge columns; the reader sees 1-80 */
+		memcpy( m->deck + card * 80, cols + ((n == 82) ? 1 : 0),
+			80 * sizeof(uint16_t) );
+	}
+	m->ncards = ncards;
+	m->next_card = 0;
+	return CARD_OK;
+}
+
+void simpdp8_detach_deck( struct simpdp8 *m )
+{
+	free( m->deck );
+	m->deck = NULL;
+	m->ncards = m->next_card = 0;
+	m->column = -1;
+	sim_cancel( &m->wheel, &m->cr_event );
+}
+
+/* keyboard input, typed at 10 characters a second */
+void simpdp8_attach_keyboard( struct simpdp8 *m, FILE *keyboard )
+{
+	m->keyboard = keyboard;
+	if (keyboard != NULL) after( m, &m->kb_event, TTY_CHAR );
+	else sim_cancel( &m->wheel, &m->kb_event );
+}
+
+/* a BIN format paper tape: leader, then field settings (11 fff 000),
+   origins (01 and six bits, then six bits) and data words (two six bit
+   frames), the last of which is the checksum of the frames before it,
+   then trailer.  Leader and trailer are 0200; rubouts bracket comments */
+int simpdp8_load_bin( struct simpdp8 *m, const unsigned char *tape,
+		      size_t len )
+{
+	size_t i = 0;
+	int field = 0, addr = 0, sum = 0, rubout = 0;
+	int pending = 0, word = 0, frames = 0, origin = 0, words = 0;
+
+	while ((i < len) && (tape[i] == 0200)) i++;
+	for (; i < len; i++) {
+		int c = tape[i];
+		if (c == 0377) {
+			rubout = !rubout;
+			continue;
+		}
+		if (rubout) continue;
+		if (c == 0200) break;
+		if ((c & 0300) == 0300) {
+			field = (c >> 3) & 7;
+			continue;
+		}
+		if ((i + 1 >= len) || (tape[i + 1] & 0300)) return -1;
+
+		/* the word before this one is not the checksum after all */
+		if (pending) {
+			sum += frames;
+			if (origin) addr = word;
+			else {
+				m->mem[(field << 12) | addr] = word;
+				addr = (addr + 1) & 07777;
+				words++;
+			}
+		}
+		origin = (c & 0100) != 0;
+		word = ((c & 077) << 6) | (tape[i + 1] & 077);
+		frames = c + tape[i + 1];
+		pending = 1;
+		i++;
+	}
+	if (!pending || origin || ((sum & 07777) != word)) return -1;
+	return words;
+}
+
+int simpdp8_run( struct simpdp8 *m, long long limit )
+{
+	long long end = (limit < 0) ? NEVER : m->count + limit;
+
+	m->stop = -1;
+	while (m->stop < 0) {
+		int ir;
+
+		if (m->count >= end) return SIMPDP8_LIMIT;
+		if (m->time >= m->wheel.next) events( m );
+		if (m->ion) {
+			if (m->ion_delay) m->ion_delay = 0;
+			else if (!m->inhibit && irq( m )) interrupt( m );
+		}
+		ir = m->mem[m->ifield | m->pc];
+		m->pc = (m->pc + 1) & 07777;
+		m->time += CYCLE;
+		m->count++;
+		dispatch[ir]( m, ir );
+	}
+	return m->stop;
+}
@@ -0,0 +1,108 @@
+/* simpdp8.h -- DEC PDP-8/E emulator core.
+ *
+ * Storage is 32K 12-bit words in eight fields, with the KM8-E memory
+ * extension.  Dispatch is by table: each of the 4096 instruction words
+ * has its own entry, so a memory reference instruction goes straight to
+ * the code for its operation and addressing mode, and an IOT straight
+ * to its device.
+ *
+ * Devices run on simulated time, kept in nanoseconds, at the speeds of
+ * the real ones: a 1.2 us memory cycle, a 10 character per second
+ * console teleprinter, and a CR8-E card reader at 300 cards a minute.
+ * A program that waits for a device in a loop such as
+ *
+ *	TSF		/ skip if the printer is done
+ *	JMP .-1
+ *
+ * or in JMP . with interrupts on, is detected when it branches back,
+ * and time is advanced straight to the next device event; a wait with
+ * no event to come stops the run.  Programs therefore see period speed
+ * devices but take almost no host time.
+ *
+ * The device events are on a simevent.h timing wheel.  Set its mode to
+ * SIM_UNTHROTTLED after simpdp8_init and the teleprinter and keyboard
+ * take no time, and the CR8-E moves on to the next column as soon as
+ * the program has read the last, so no column is ever lost.
+ *
+ * The CR8-E is fed from a card-image deck.  Columns arrive one at a
+ * time, and one not read before the next arrives is lost.  Its IOTs:
+ *
+ *	6631 RCSF  skip if a column is ready
+ *	6632 RCRA  read the column into AC as six-bit DEC code, that is,
+ *		   the low six bits of its ASCII under the DEC 029 code
+ *	6634 RCRB  read the column into AC as twelve rows, row 12 high
+ *	6671 RCSD  skip if the card is done
+ *	6672 RCSE  start the next card, and skip if there is one
+ *	6674 RCRD  clear card done
+ *	6675 RCSI  skip if the reader is requesting an interrupt
+ *
+ */
+
+#ifndef SIMPDP8_H
+#define SIMPDP8_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "cardcodec.h"
+#include "simevent.h"
+
+#define SIMPDP8_MAXMEM	32768
+
+/* why simpdp8_run returned */
+#define SIMPDP8_HALT	0	/* HLT */
+#define SIMPDP8_LIMIT	1	/* the instruction limit ran out */
+#define SIMPDP8_IDLE	2	/* waiting for a device with nothing to come */
+
+#define SIMPDP8_NEVER	SIM_NEVER	/* no event scheduled */
+
+struct simpdp8 {
+	uint16_t mem[SIMPDP8_MAXMEM];
+	uint16_t pc, ac, mq;
+	uint16_t link;		/* 0 or 010000, just above AC */
+	uint16_t ifield, dfield;	/* field << 12 */
+	uint16_t ib;		/* instruction buffer, for CIF */
+	uint16_t sf;		/* save field, at interrupts */
+	uint16_t sr;		/* console switch register */
+	int ion;		/* interrupts enabled */
+	int ion_delay;		/* instructions until ION takes effect */
+	int inhibit;		/* after CIF, until the JMP or JMS */
+	int stop;		/* SIMPDP8_xxx, or -1 while running */
+
+	/* simulated time, in ns, and the device events */
+	long long time;
+	struct sim_wheel wheel;
+	long long idle_time;	/* skipped over by the idle detector */
+	long long event_at;	/* instruction count at the last event */
+	int idle_detect;
+
+	/* the console teleprinter; the keyboard reads a file, if any */
+	FILE *printer;
+	FILE *keyboard;
+	int tp_flag, kb_flag, tty_ie;
+	uint16_t kb_buffer;
+	struct sim_event tp_event, kb_event;
+
+	/* the CR8-E */
+	struct card_codec codec;	/* for alphanumeric reads */
+	uint16_t *deck;			/* 80 columns per card */
+	long ncards;
+	long next_card;
+	int column;		/* next column of the card moving, or -1 */
+	uint16_t cr_buffer;
+	int cr_data, cr_done;
+	struct sim_event cr_event;
+	long cr_missed;		/* columns overrun */
+
+	long long count;	/* instructions executed */
+};
+
+void simpdp8_init( struct simpdp8 *m );
+int simpdp8_attach_deck( struct simpdp8 *m, const unsigned char *deck,
+			 size_t len );
+void simpdp8_detach_deck( struct simpdp8 *m );
+void simpdp8_attach_keyboard( struct simpdp8 *m, FILE *keyboard );
+int simpdp8_load_bin( struct simpdp8 *m, const unsigned char *tape,
+		      size_t len );
+int simpdp8_run( struct simpdp8 *m, long long limit );
+
+#endif /* SIMPDP8_H */
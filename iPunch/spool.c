@@ -0,0 +1,286 @@
+/* spool.c -- a 1403 line printer, spooled to a text file.
+ *
+ * see spool.h
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "spool.h"
+
+#define MAXPAGES	(1L << 30)	/* sanity limit on a loaded index */
+
+struct header {
+	char magic[4];		/* SPIX */
+	int32_t version;
+	int32_t form;
+	int32_t spare;
+	int64_t npages;
+};
+
+static void emit( struct spool *sp, const char *s, size_t n )
+{
+	sp->offset += n;
+	if (sp->out == NULL) return;
+	if (sp->used + n > SPOOL_BUFFER) spool_flush( sp );
+	memcpy( sp->buf + sp->used, s, n );
+	sp->used += n;
+}
+
+/* a form feed starts every page after the first */
+static void new_page( struct spool *sp )
+{
+	if (sp->npages == sp->maxpages) {
+		long max = sp->maxpages ? sp->maxpages * 2 : 256;
+		struct spool_page *more = realloc( sp->page, max * sizeof *more );
+		if (more == NULL) {
+			sp->error = 1;
+			return;
+		}
+		sp->page = more;
+		sp->maxpages = max;
+	}
+	sp->page[sp->npages].offset = sp->offset;
+	sp->page[sp->npages].line = sp->lines;
+	if (sp->npages++ > 0) emit( sp, "\f", 1 );
+	sp->line = 1;
+	sp->passed = sp->tape[1];
+	sp->fresh = 1;
+}
+
+/* end the line under the print head */
+static void end_line( struct spool *sp )
+{
+	while ((sp->len > 0) && (sp->text[sp->len - 1] == ' ')) sp->len--;
+	emit( sp, sp->text, sp->len );
+	emit( sp, "\n", 1 );
+	sp->len = 0;
+	sp->lines++;
+}
+
+/* the form moves up a line, onto the next page after the last */
+static void feed( struct spool *sp )
+{
+	end_line( sp );
+	if (sp->line < sp->form) {
+		sp->line++;
+		sp->passed |= sp->tape[sp->line];
+	} else {
+		new_page( sp );
+	}
+}
+
+int spool_open( struct spool *sp, FILE *out, int form )
+{
+	memset( sp, 0, sizeof *sp );
+	if ((form < 1) || (form > SPOOL_MAXFORM)) form = SPOOL_FORM;
+	sp->form = form;
+	sp->out = out;
+	if (out != NULL) {
+		sp->buf = malloc( SPOOL_BUFFER );
+		if (sp->buf == NULL) return -1;
+	}
+	spool_tape( sp, 1, 1 );
+	if (form > 6) spool_tape( sp, form - 6, 12 );
+	new_page( sp );
+	return sp->error ? -1 : 0;
+}
+
+/* punch a hole in the tape at line for channel, or clear the line for 0 */
+void spool_tape( struct spool *sp, int line, int channel )
+{
+	if ((line < 1) || (line > sp->form)) return;
+	if (channel == 0) sp->tape[line] = 0;
+	else if ((channel >= 1) && (channel <= SPOOL_CHANNELS))
+		sp->tape[line] |= SPOOL_CHANNEL( channel );
+}
+
+void spool_print( struct spool *sp, const char *text, int len )
+{
+	int i;
+
+	if (len > SPOOL_WIDTH) len = SPOOL_WIDTH;
+	for (i = 0; i < len; i++) {
+		if (i >= sp->len) sp->text[i] = text[i];
+		else if (text[i] != ' ') sp->text[i] = text[i];
+	}
+	if (len > sp->len) sp->len = len;
+	sp->printed++;
+	sp->fresh = 0;
+}
+
+void spool_space( struct spool *sp, int lines )
+{
+	while (lines-- > 0) feed( sp );
+}
+
+/* to the next line punched for channel; a page that has had nothing
+   printed on it is not skipped, nor is the whole form when the channel
+   is not punched at all */
+void spool_skip( struct spool *sp, int channel )
+{
+	unsigned short bit;
+	int line;
+
+	if ((channel < 1) || (channel > SPOOL_CHANNELS)) return;
+	bit = SPOOL_CHANNEL( channel );
+	if (sp->fresh && (sp->len == 0) && (sp->tape[sp->line] & bit)) return;
+	for (line = sp->line + 1; line <= sp->form; line++)
+		if (sp->tape[line] & bit) break;
+	if (line <= sp->form) {
+		spool_space( sp, line - sp->line );
+		return;
+	}
+
+	/* over the foot of the form, without the blank lines to it */
+	if (sp->len > 0) end_line( sp );
+	new_page( sp );
+	for (line = 1; line <= sp->form; line++)
+		if (sp->tape[line] & bit) break;
+	if (line <= sp->form) spool_space( sp, line - 1 );
+}
+
+void spool_asa( struct spool *sp, const char *text, int len )
+{
+	int c = (len > 0) ? text[0] : ' ';
+
+	/* the first line of all goes where the carriage starts */
+	if ((sp->offset == 0) && (sp->len == 0) && (sp->line == 1)
+	 && ((c == ' ') || (c == '0') || (c == '-'))) c = '+';
+	switch (c) {
+	case '+':
+		break;
+	case '0':
+		spool_space( sp, 2 );
+		break;
+	case '-':
+		spool_space( sp, 3 );
+		break;
+	case 'A': case 'B': case 'C':
+		spool_skip( sp, c - 'A' + 10 );
+		break;
+	default:
+		if ((c >= '1') && (c <= '9')) spool_skip( sp, c - '0' );
+		else spool_space( sp, 1 );
+		break;
+	}
+	if (len > 1) spool_print( sp, text + 1, len - 1 );
+	else spool_print( sp, "", 0 );
+}
+
+int spool_flush( struct spool *sp )
+{
+	if (sp->out != NULL) {
+		if ((sp->used > 0)
+		 && (fwrite( sp->buf, 1, sp->used, sp->out ) != sp->used))
+			sp->error = 1;
+		sp->used = 0;
+		if (fflush( sp->out ) != 0) sp->error = 1;
+	}
+	return sp->error ? -1 : 0;
+}
+
+/* end the last line, write the spool out, and the index if wanted */
+int spool_close( struct spool *sp, FILE *index )
+{
+	if (sp->len > 0) end_line( sp );
+	spool_flush( sp );
+	if (index != NULL) {
+		struct header h;
+
+		memset( &h, 0, sizeof h );
+		memcpy( h.magic, "SPIX", 4 );
+		h.version = SPOOL_VERSION;
+		h.form = sp->form;
+		h.npages = sp->npages;
+		if ((fwrite( &h, sizeof h, 1, index ) != 1)
+		 || (fwrite( sp->page, sizeof *sp->page, sp->npages, index )
+		     != (size_t)sp->npages)
+		 || (fflush( index ) != 0)) sp->error = 1;
+	}
+	free( sp->buf );
+	free( sp->page );
+	sp->buf = NULL;
+	sp->page = NULL;
+	return sp->error ? -1 : 0;
+}
+
+int spool_index_read( struct spool_index *ix, FILE *f )
+{
+	struct header h;
+
+	memset( ix, 0, sizeof *ix );
+	if ((fread( &h, sizeof h, 1, f ) != 1)
+	 || (memcmp( h.magic, "SPIX", 4 ) != 0)
+	 || (h.version != SPOOL_VERSION)
+	 || (h.npages < 1) || (h.npages > MAXPAGES)) return -1;
+	ix->page = malloc( h.npages * sizeof *ix->page );
+	if ((ix->page == NULL)
+	 || (fread( ix->page, sizeof *ix->page, h.npages, f )
+	     != (size_t)h.npages)) {
+		spool_index_free( ix );
+		return -1;
+	}
+	ix->form = h.form;
+	ix->npages = h.npages;
+	return 0;
+}
+
+/* the index of a listing that has none: a page at every form feed */
+int spool_index_scan( struct spool_index *ix, FILE *f )
+{
+	long max = 256;
+	long long offset = 0, lines = 0;
+	int c;
+
+	memset( ix, 0, sizeof *ix );
+	ix->page = malloc( max * sizeof *ix->page );
+	if (ix->page == NULL) return -1;
+	ix->page[0].offset = 0;
+	ix->page[0].line = 0;
+	ix->npages = 1;
+	while ((c = getc( f )) != EOF) {
+		if ((c == '\f') && (offset > 0)) {
+			if (ix->npages == max) {
+				struct spool_page *more;
+				more = realloc( ix->page, 2 * max * sizeof *more );
+				if (more == NULL) {
+					spool_index_free( ix );
+					return -1;
+				}
+				ix->page = more;
+				max *= 2;
+			}
+			ix->page[ix->npages].offset = offset;
+			ix->page[ix->npages].line = lines;
+			ix->npages++;
+		} else if (c == '\n') {
+			lines++;
+		}
+		offset++;
+	}
+	return 0;
+}
+
+void spool_index_free( struct spool_index *ix )
+{
+	free( ix->page );
+	ix->page = NULL;
+	ix->npages = 0;
+}
+
+/* the page holding line, counting from 0 */
+long spool_find_line( const struct spool_index *ix, long long line )
+{
+	long lo = 0, hi = ix->npages - 1;
+
+	if (hi < 0) return -1;
+	while (lo < hi) {
+		long mid = (lo + hi + 1) / 2;
+		if (ix->page[mid].line <= line) lo = mid;
+		else hi = mid - 1;
+	}
+	return lo;
+}
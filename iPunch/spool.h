@@ -0,0 +1,101 @@
+/* spool.h -- a 1403 line printer, spooled to a text file.
+ *
+ * The printer prints a line where the carriage is, then moves the
+ * form: it spaces one to three lines, or skips to the next line with a
+ * hole in a given channel of the carriage control tape.  The tape is
+ * as long as the form, and channel 1 conventionally marks the first
+ * line of a page and channel 12 the overflow line near its foot; the
+ * channels the carriage has reached on a page are kept for programs to
+ * test, as the 1401 tests channels 9 and 12.
+ * Printing twice without moving overprints; in the text the last
+ * nonblank character in each column wins.
+ *
+ * Programs that write with ASA carriage control, as FORTRAN does, give
+ * the movement before the line in its first character:
+ *
+ *	blank	space one line		+	no space, overprint
+ *	0	space two lines		1-9 A B C  skip to channel 1-12
+ *	-	space three lines
+ *
+ * The spool is text: a line per printed or blank line, and a form feed
+ * where each page after the first begins, which is what listing
+ * printers and text to PDF converters expect.  Lines are gathered in a
+ * buffer of SPOOL_BUFFER bytes and written a buffer at a time.
+ *
+ * As each page begins, its offset in the file and the number of lines
+ * of text before it go into a page index, which spool_close can write
+ * to a file of its own.  A reader with the index goes straight to any
+ * page, or to the page holding any line of the listing, without
+ * reading the pages before it.  Page n runs from its offset to the
+ * next page's, form feed first.  The index file is
+ *
+ *	"SPIX", version, form length, pages, then for each page
+ *	its offset and the lines before it, all in host order
+ *
+ * A spool with no file only counts; spool_index_scan makes an index
+ * for a listing that has none, by reading it once.
+ *
+ */
+
+#ifndef SPOOL_H
+#define SPOOL_H
+
+#include <stdio.h>
+
+#define SPOOL_VERSION	1
+#define SPOOL_WIDTH	132		/* print positions */
+#define SPOOL_FORM	66		/* lines on a form, 11 inches at 6 */
+#define SPOOL_MAXFORM	132
+#define SPOOL_CHANNELS	12
+#define SPOOL_BUFFER	(1 << 20)
+#define SPOOL_CHANNEL( n )	(1 << ((n) - 1))	/* in tape and passed */
+
+struct spool_page {
+	long long offset;	/* of the page's first byte in the spool */
+	long long line;		/* lines of text before the page */
+};
+
+struct spool {
+	FILE *out;
+	int form;			/* lines on a form */
+	unsigned short tape[SPOOL_MAXFORM + 1];	/* channels, by line */
+	int line;			/* where the carriage is, 1 to form */
+	unsigned short passed;		/* channels reached on this page */
+	int fresh;			/* nothing printed on this page yet */
+
+	char text[SPOOL_WIDTH + 1];	/* the line under the print head */
+	int len;			/* 0 if nothing printed there */
+
+	char *buf;			/* lines not yet written */
+	size_t used;
+	long long offset;		/* bytes in the spool so far */
+	long long lines;		/* lines of text so far */
+	int error;			/* a write failed */
+
+	struct spool_page *page;	/* the index */
+	long npages, maxpages;
+	long long printed;		/* lines printed, overprints too */
+};
+
+/* an index read back from a file */
+struct spool_index {
+	int form;
+	long npages;
+	struct spool_page *page;
+};
+
+int spool_open( struct spool *sp, FILE *out, int form );
+void spool_tape( struct spool *sp, int line, int channel );
+void spool_print( struct spool *sp, const char *text, int len );
+void spool_space( struct spool *sp, int lines );
+void spool_skip( struct spool *sp, int channel );
+void spool_asa( struct spool *sp, const char *text, int len );
+int spool_flush( struct spool *sp );
+int spool_close( struct spool *sp, FILE *index );
+
+int spool_index_read( struct spool_index *ix, FILE *f );
+int spool_index_scan( struct spool_index *ix, FILE *f );
+void spool_index_free( struct spool_index *ix );
+long spool_find_line( const struct spool_index *ix, long long line );
+
+#endif /* SPOOL_H */
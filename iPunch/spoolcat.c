@@ -0,0 +1,132 @@
+/* spoolcat.c -- print pages of a spooled printer listing.
+ *
+ * operation:  run spoolcat -help for instructions
+ *
+ * build: cc -o spoolcat spoolcat.c spool.c
+ *
+ * input  -- a listing, as the emulators' printers spool it, and its
+ *           page index, if it has one
+ * output -- the pages asked for, as they are in the listing
+ *
+ * With the index written beside the listing, spoolcat seeks straight to
+ * the first page wanted and reads only the pages it prints, however
+ * long the listing; without one, it reads the listing through once to
+ * find the form feeds.  See spool.h.
+ *
+ */
+
+#define _FILE_OFFSET_BITS 64
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include "spool.h"
+
+static void usage( const char *progname )
+{
+	fprintf( stderr, "\n%s [options] listing\n\n", progname );
+	fprintf( stderr,
+	"Print pages of a listing spooled by run1401, run360 or runftn.\n"
+	"The options are:\n\n"
+	" -index file     the listing's page index; without it the\n"
+	"                 listing is read through to find its pages\n"
+	" -page n         the first page to print (1)\n"
+	" -line n         start at the page holding line n instead\n"
+	" -pages n        how many pages to print (1), 0 for all the rest\n"
+	" -info           report the number of pages instead\n\n"
+	);
+	exit(-1);
+}
+
+int main( int argc, char *argv[] )
+{
+	struct spool_index ix;
+	FILE *in, *index_fd = NULL;
+	long page = 1, npages = 1, last;
+	long long line = 0, from, to;
+	int info = 0;
+	int arg = 1, err;
+	char buf[65536];
+
+	while ((arg < argc) && (argv[arg][0] == '-')) { /* command line arg */
+		if ((strcmp(argv[arg],"-index") == 0) && (arg + 1 < argc)) {
+			index_fd = fopen( argv[++arg], "rb" );
+			if (index_fd == NULL) {
+				fprintf( stderr, "%s %s: invalid index file\n",
+					 argv[0], argv[arg] );
+				exit(-1);
+			}
+		} else if ((strcmp(argv[arg],"-page") == 0) && (arg + 1 < argc)) {
+			page = atol( argv[++arg] );
+		} else if ((strcmp(argv[arg],"-line") == 0) && (arg + 1 < argc)) {
+			line = atoll( argv[++arg] );
+		} else if ((strcmp(argv[arg],"-pages") == 0) && (arg + 1 < argc)) {
+			npages = atol( argv[++arg] );
+		} else if (strcmp(argv[arg],"-info") == 0) {
+			info = 1;
+		} else if (strcmp(argv[arg],"-help") == 0) {
+			usage( argv[0] );
+		} else {
+			fprintf( stderr, "%s: unknown option %s;"
+					 " -help available\n",
+				 argv[0], argv[arg] );
+			exit(-1);
+		}
+		arg++;
+	}
+	if ( (argc - arg) != 1 ) {
+		fprintf( stderr, "%s: one listing, please; -help available\n",
+			 argv[0] );
+		exit(-1);
+	}
+	in = fopen( argv[arg], "rb" );
+	if (in == NULL) {
+		fprintf( stderr, "%s %s: invalid listing\n", argv[0], argv[arg] );
+		exit(-1);
+	}
+
+	if (index_fd != NULL) {
+		err = spool_index_read( &ix, index_fd );
+		fclose( index_fd );
+	} else {
+		err = spool_index_scan( &ix, in );
+	}
+	if (err != 0) {
+		fprintf( stderr, "%s: bad page index\n", argv[0] );
+		exit(-1);
+	}
+	if (info) {
+		printf( "%ld pages, the last starting at line %lld\n",
+			ix.npages, ix.page[ix.npages - 1].line + 1 );
+		exit(0);
+	}
+
+	if (line > 0) page = spool_find_line( &ix, line - 1 ) + 1;
+	if ((page < 1) || (page > ix.npages)) {
+		fprintf( stderr, "%s: no page %ld; there are %ld\n",
+			 argv[0], page, ix.npages );
+		exit(-1);
+	}
+	last = page - 1 + npages;
+	if ((npages <= 0) || (last > ix.npages)) last = ix.npages;
+
+	/* from the first page wanted to the page after the last */
+	if (fseeko( in, 0, SEEK_END ) != 0) {
+		fprintf( stderr, "%s %s: cannot seek\n", argv[0], argv[arg] );
+		exit(-1);
+	}
+	to = (last < ix.npages) ? ix.page[last].offset : (long long)ftello( in );
+	from = ix.page[page - 1].offset;
+	fseeko( in, from, SEEK_SET );
+	while (from < to) {
+		size_t n = (to - from < (long long)sizeof buf)
+			   ? (size_t)(to - from) : sizeof buf;
+		n = fread( buf, 1, n, in );
+		if (n == 0) break;
+		fwrite( buf, 1, n, stdout );
+		from += n;
+	}
+	spool_index_free( &ix );
+	fclose( in );
+	exit(0);
+}
@@ -0,0 +1,298 @@
+/* cardrendertest.c -- test drawing a card being edited column by column.
+ *
+ * operation:  cardrendertest [assets]
+ *
+ * build: cc -o cardrendertest cardrendertest.c ../iPunch/cardcache.c
+ *        ../iPunch/cardrender.c ../iPunch/cardimage.c ../iPunch/cardconv.c
+ *        ../iPunch/cardcodec.c -I../iPunch -lz
+ *
+ * input  -- the app's assets, ../iPunch/Assets unless given
+ * output -- a line for each check that fails, and a summary, on stderr;
+ *           the exit status is 1 if any failed
+ *
+ * A card_view redraws only the columns that changed since it last drew;
+ * these check that it finds exactly those, that the rectangle it gives
+ * covers them and no more, and that its bitmap is always what drawing
+ * the whole card afresh gives, whatever is typed, deleted or pasted,
+ * printed or not, from the plain and the @2x assets.  A card_cache
+ * must give the drawing card_render gives, whole or shrunk, for a card
+ * it has and one it has not, keep to its budget, and drop the card
+ * drawn least recently; a card with other header bits or printing is
+ * another card.  The time of an update that changes one column is
+ * reported, typing at the start of a card and at its end, and of
+ * drawing the whole card, for comparison.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "cardconv.h"
+#include "cardcache.h"
+
+static int checks = 0, failures = 0;
+
+static void check( int ok, const char *what, int step )
+{
+	checks++;
+	if (ok) return;
+	failures++;
+	fprintf( stderr, "FAIL: %s, at step %d\n", what, step );
+}
+
+static double now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long seed = 1;
+
+static int below( int n )
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+	return (int)((seed >> 11) % n);
+}
+
+/* the view is just as drawing cols afresh would be, and its last update
+   changed exactly the columns that differ from was */
+static void check_view( const struct card_view *view, const uint16_t *was,
+			const uint16_t *cols, int n, unsigned char *fresh,
+			int step )
+{
+	const struct card_atlas *a = view->atlas;
+	int differ = 0, first = -1, last = -1, flags = 1, c;
+
+	for (c = 0; c < 80; c++) {
+		int d = (was[c] != cols[c]);
+		if (view->changed[c] != d) flags = 0;
+		if (!d) continue;
+		if (first < 0) first = c;
+		last = c;
+		differ++;
+	}
+	check( n == differ, "count of columns redrawn", step );
+	check( flags, "columns marked changed", step );
+	check( memcmp( view->cols, cols, sizeof view->cols ) == 0,
+	       "columns kept", step );
+	if (differ == 0) {
+		check( view->width == 0 && view->height == 0, "empty rectangle", step );
+	} else {
+		int z = a->zoom;
+		check( view->x == (17 + 6 * first) * z
+		    && view->width == (last - first + 1) * 6 * z,
+		       "rectangle across", step );
+		check( view->y == 8 * z && view->y + view->height
+		       == (20 + 17 * 11) * z + a->hole_height, "rectangle down", step );
+	}
+	card_render( a, cols, view->print, fresh );
+	check( memcmp( view->rgba, fresh, (size_t)a->width * a->height * 4 ) == 0,
+	       "bitmap as drawn afresh", step );
+}
+
+/* edits such as the editor makes, checked one after another */
+static void edits( const struct card_atlas *atlas, const struct card_codec *codec,
+		   int steps )
+{
+	static const char text[] = "      PRINT *, 'HELLO WORLD'  ABCXYZ0123456789+-*/=(),.$";
+	struct card_view view;
+	uint16_t was[80], cols[80];
+	unsigned char *fresh = malloc( (size_t)atlas->width * atlas->height * 4 );
+	int step, c, n;
+
+	if ((fresh == NULL) || (card_view_init( &view, atlas, codec ) != CARD_OK)) {
+		check( 0, "card_view_init", 0 );
+		free( fresh );
+		return;
+	}
+	memset( cols, 0, sizeof cols );
+	check( view.x == 0 && view.y == 0 && view.width == atlas->width
+	    && view.height == atlas->height, "whole card shown at first", 0 );
+
+	/* nothing typed changes nothing */
+	memcpy( was, view.cols, sizeof was );
+	n = card_view_update( &view, cols );
+	check_view( &view, was, cols, n, fresh, 0 );
+
+	/* typing a line, a character at a time, changes a column at a time */
+	for (c = 0; c < 80; c++) {
+		memcpy( was, cols, sizeof was );
+		cols[c] = card_encode( codec, (unsigned char)text[c % (sizeof text - 1)] );
+		n = card_view_update( &view, cols );
+		check( n == ((was[c] != cols[c]) ? 1 : 0), "one column a keystroke", c );
+		check_view( &view, was, cols, n, fresh, c );
+	}
+
+	/* and then anything: keystrokes, deletions that shift the rest of
+	   the line, pastes, and the printing turned off and on */
+	for (step = 1; step <= steps; step++) {
+		int kind = below( 10 );
+		memcpy( was, cols, sizeof was );
+		if (kind < 5) {
+			cols[below( 80 )] = card_encode( codec, ' ' + below( 64 ) );
+		} else if (kind < 7) {
+			int at = below( 80 );
+			memmove( cols + at, cols + at + 1, (79 - at) * sizeof *cols );
+			cols[79] = 0;
+		} else if (kind < 9) {
+			int at = below( 80 ), len = 1 + below( 80 - at );
+			for (c = at; c < at + len; c++) cols[c] = below( 010000 );
+		} else {
+			card_view_set_print( &view, (view.print == NULL) ? codec : NULL );
+			check( view.width == atlas->width && view.height == atlas->height,
+			       "whole card shown when the printing changes", step );
+			card_render( atlas, view.cols, view.print, fresh );
+			check( memcmp( view.rgba, fresh,
+				       (size_t)atlas->width * atlas->height * 4 ) == 0,
+			       "bitmap when the printing changes", step );
+			continue;
+		}
+		n = card_view_update( &view, cols );
+		check_view( &view, was, cols, n, fresh, step );
+	}
+	card_view_free( &view );
+	free( fresh );
+}
+
+/* the cache draws cards as card_render does, and forgets the oldest */
+static void cached( const struct card_atlas *atlas, const struct card_codec *codec,
+		    int shrink )
+{
+	static const unsigned char plain[3] = { 0x80, 0x80, 0x80 };
+	static const unsigned char pink[3] = { 0x80 | 3 << 3, 0x80, 0x80 };
+	static const unsigned char fortran[3] = { 0x80, 0x86, 0x80 };
+	struct card_cache cache;
+	uint16_t deck[8][80];
+	unsigned char *fresh = malloc( (size_t)atlas->width * atlas->height * 4 );
+	const unsigned char *got;
+	size_t each;
+	int i, c, step = 0;
+
+	if ((fresh == NULL) || (card_cache_init( &cache, atlas, shrink, 1 ) != CARD_OK)) {
+		check( 0, "card_cache_init", 0 );
+		free( fresh );
+		return;
+	}
+	check( cache.capacity == 1, "a cache of at least one card", 0 );
+	card_cache_free( &cache );
+
+	/* room for four cards */
+	each = (size_t)(atlas->width >> shrink) * (atlas->height >> shrink) * 4;
+	if (card_cache_init( &cache, atlas, shrink, 4 * each + 4096 ) != CARD_OK) {
+		check( 0, "card_cache_init", 0 );
+		free( fresh );
+		return;
+	}
+	check( cache.capacity == 4, "four cards in the budget", 0 );
+	for (i = 0; i < 8; i++)
+		for (c = 0; c < 80; c++) deck[i][c] = below( 010000 );
+
+	/* each card drawn twice, then the first again, long gone */
+	for (i = 0; i < 8; i++) {
+		int k;
+		for (k = 0; k < 2; k++, step++) {
+			got = card_cache_draw( &cache, deck[i], plain,
+					       (i & 1) ? codec : NULL );
+			card_render( atlas, deck[i], (i & 1) ? codec : NULL, fresh );
+			card_render_shrink( fresh, atlas->width, atlas->height, shrink );
+			check( memcmp( got, fresh, cache.bitmap ) == 0,
+			       "cached drawing as drawn afresh", step );
+		}
+	}
+	check( cache.hits == 8 && cache.misses == 8, "hits and misses", step );
+	check( cache.cards == 4 && cache.evictions == 4
+	    && cache.evicted_bytes == 4 * (long long)each, "evictions", step );
+	card_cache_draw( &cache, deck[0], plain, NULL );
+	check( cache.misses == 9, "the oldest card forgotten", step );
+
+	/* using card 5 keeps it when 6, 7 and another come */
+	card_cache_draw( &cache, deck[5], plain, codec );
+	card_cache_draw( &cache, deck[1], plain, codec );
+	card_cache_draw( &cache, deck[2], plain, NULL );
+	check( cache.hits == 9 && cache.misses == 11, "the newest kept", step );
+	card_cache_draw( &cache, deck[5], plain, codec );
+	check( cache.hits == 10, "a card used lately kept", step );
+
+	/* the same columns are another card in another color, form or
+	   printing */
+	card_cache_draw( &cache, deck[3], pink, codec );
+	card_cache_draw( &cache, deck[3], fortran, codec );
+	card_cache_draw( &cache, deck[3], plain, NULL );
+	check( cache.misses == 14, "header bits and printing in the key", step );
+	card_cache_draw( &cache, deck[3], pink, codec );
+	check( cache.hits == 11, "a card in color found again", step );
+
+	card_cache_clear( &cache );
+	card_cache_draw( &cache, deck[3], pink, codec );
+	check( cache.misses == 15 && cache.cards == 1, "cleared", step );
+	card_cache_free( &cache );
+	free( fresh );
+}
+
+/* the time of an update changing column c, typed back and forth */
+static double keystroke( struct card_view *view, const struct card_codec *codec,
+			 int c, int times )
+{
+	uint16_t cols[80];
+	double start;
+	int i;
+
+	for (i = 0; i < 80; i++) cols[i] = card_encode( codec, 'A' + i % 26 );
+	card_view_update( view, cols );
+	start = now();
+	for (i = 0; i < times; i++) {
+		cols[c] = card_encode( codec, (i & 1) ? 'X' : 'Y' );
+		card_view_update( view, cols );
+	}
+	return (now() - start) / times;
+}
+
+int main( int argc, char *argv[] )
+{
+	const char *assets = (argc > 1) ? argv[1] : "../iPunch/Assets";
+	struct card_options opt;
+	struct card_codec codec;
+	struct card_atlas atlas;
+	struct card_view view;
+	uint16_t cols[80];
+	unsigned char *fresh;
+	double start, first, end, whole;
+	int zoom, i, err;
+
+	card_options_init( &opt );
+	card_codec_init( &codec, &opt );
+	for (zoom = 1; zoom <= 2; zoom++) {
+		err = card_atlas_load( &atlas, assets, zoom );
+		if (err != CARD_OK) {
+			fprintf( stderr, "%s %s: %s\n", argv[0], assets, card_strerror( err ) );
+			exit(-1);
+		}
+		edits( &atlas, &codec, (zoom == 1) ? 2000 : 500 );
+		cached( &atlas, &codec, 0 );
+		cached( &atlas, &codec, 2 );
+
+		if ((card_view_init( &view, &atlas, &codec ) != CARD_OK)
+		 || ((fresh = malloc( (size_t)atlas.width * atlas.height * 4 )) == NULL)) {
+			fprintf( stderr, "%s: out of memory\n", argv[0] );
+			exit(-1);
+		}
+		first = keystroke( &view, &codec, 0, 20000 );
+		end = keystroke( &view, &codec, 79, 20000 );
+		for (i = 0; i < 80; i++) cols[i] = card_encode( &codec, 'A' + i % 26 );
+		start = now();
+		for (i = 0; i < 2000; i++) card_render( &atlas, cols, &codec, fresh );
+		whole = (now() - start) / 2000;
+		fprintf( stderr, "%dx%d: a keystroke %.2f us in column 1, %.2f us in"
+			 " column 80; the whole card %.2f us\n", atlas.width,
+			 atlas.height, first * 1e6, end * 1e6, whole * 1e6 );
+		card_view_free( &view );
+		free( fresh );
+		card_atlas_free( &atlas );
+	}
+	fprintf( stderr, "%d checks, %d failed\n", checks, failures );
+	exit(failures ? 1 : 0);
+}
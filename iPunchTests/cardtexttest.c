@@ -0,0 +1,240 @@
+/* cardtexttest.c -- test the editor's text, punched a line at a time.
+ *
+ * operation:  cardtexttest
+ *
+ * build: cc -o cardtexttest cardtexttest.c ../iPunch/cardtext.c
+ *        ../iPunch/cardconv.c ../iPunch/cardcodec.c -I../iPunch
+ *
+ * output -- a line for each check that fails, and a summary, on stderr;
+ *           the exit status is 1 if any failed
+ *
+ * A card_text punches only the lines an edit changes; these check that
+ * whatever is typed, deleted, pasted or joined, its lines are the text
+ * as a plain string edited the same way has them, and its deck is byte
+ * for byte what card_make_buffer makes of that string, in H80 and H82,
+ * with lines of every length, tabs, blank lines, and with and without
+ * a newline at the end, and that each character of a line is on the
+ * card and in the column card_text_card_at says.  A keystroke must
+ * punch one line, in a program of 5 lines or of 5000; the time of one
+ * is reported for both.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "cardtext.h"
+
+static int checks = 0, failures = 0;
+
+static void check( int ok, const char *what, int step )
+{
+	checks++;
+	if (ok) return;
+	failures++;
+	fprintf( stderr, "FAIL: %s, at step %d\n", what, step );
+}
+
+static double now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long seed = 1;
+
+static int below( int n )
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+	return (int)((seed >> 11) % n);
+}
+
+/* the text as a plain string, edited as the card_text is */
+static unsigned char plain[1 << 16];
+static size_t plain_len;
+
+static void replace( size_t at, size_t remove, const unsigned char *s,
+		     size_t n )
+{
+	if (at > plain_len) at = plain_len;
+	if (remove > plain_len - at) remove = plain_len - at;
+	memmove( plain + at + n, plain + at + remove, plain_len - at - remove );
+	memcpy( plain + at, s, n );
+	plain_len += n - remove;
+}
+
+/* the card_text has the plain string's lines and cards */
+static void check_text( struct card_text *text, const struct card_codec *codec,
+			struct card_buf *made, struct card_buf *deck, int step )
+{
+	const unsigned char *p = plain, *end = plain + plain_len;
+	long i = 0;
+	int same = 1;
+
+	for (;;) {
+		const unsigned char *nl = memchr( p, '\n', end - p );
+		size_t len = ((nl != NULL) ? nl : end) - p;
+		int got;
+		const unsigned char *t;
+		if (i >= text->nlines) {
+			same = 0;
+			break;
+		}
+		t = card_text_line( text, i++, &got );
+		if ((size_t)got != len || ((len > 0) && (memcmp( t, p, len ) != 0)))
+			same = 0;
+		if (nl == NULL) break;
+		p = nl + 1;
+	}
+	check( same && (i == text->nlines), "lines as in the string", step );
+
+	check( card_make_buffer( codec, plain, plain_len, made ) == CARD_OK,
+	       "card_make_buffer", step );
+	check( card_text_deck( text, deck ) == CARD_OK, "card_text_deck", step );
+	check( (deck->len == made->len)
+	    && (memcmp( deck->data, made->data, made->len ) == 0),
+	       "deck as card_make_buffer makes it", step );
+	check( text->cards * (long)((codec->opt.format == 80) ? 123 : 126) + 3
+	       == (long)made->len, "cards counted", step );
+	check( text->nchanged == 0, "nothing changed after a flush", step );
+
+	/* the first line's columns, as the editor shows them: each
+	   character on the card and in the column card_text_card_at says,
+	   and a tab blank */
+	if (plain_len > 0 && plain[0] != '\n') {
+		uint16_t cols[80];
+		const unsigned char *at = memchr( plain, '\n', plain_len );
+		int k, card, column, shown = -1, same = 1;
+		int len = (at != NULL) ? (int)(at - plain) : (int)plain_len;
+		for (k = 0; k < len; k++) {
+			card = card_text_card_at( text, 0, k, &column );
+			if ((card != shown)
+			 && (card_text_columns( text, 0, card, cols ) == NULL)) {
+				same = 0;
+				break;
+			}
+			shown = card;
+			if (cols[column] != card_encode( codec, (plain[k] == '\t')
+							   ? ' ' : plain[k] ))
+				same = 0;
+		}
+		check( same, "columns as typed", step );
+		card = card_text_card_at( text, 0, len, &column );
+		check( (card == card_text_card_at( text, 0, len - 1, &k ))
+		    && (column >= k), "the end of a line on its last card", step );
+	}
+}
+
+/* edits such as the editor makes, checked one after another */
+static void edits( const struct card_codec *codec, int steps )
+{
+	static const unsigned char keys[] =
+		"ABCXYZ abcxyz 0123456789 +-*/=(),.$' \t\t\n\n\n\n";
+	struct card_text text;
+	struct card_buf made = { 0 }, deck = { 0 };
+	unsigned char s[300];
+	int step;
+
+	plain_len = 0;
+	if (card_text_init( &text, codec ) != CARD_OK) {
+		check( 0, "card_text_init", 0 );
+		return;
+	}
+	check_text( &text, codec, &made, &deck, 0 );
+	for (step = 1; step <= steps; step++) {
+		int kind = below( 10 ), n = 0, i;
+		size_t at = below( (int)plain_len + 2 ), remove = 0;
+		if (kind < 5) {
+			/* a keystroke, at the cursor as it was, or near */
+			n = 1;
+			s[0] = keys[below( sizeof keys - 1 )];
+		} else if (kind < 7) {
+			remove = 1 + below( 3 );
+		} else if (kind < 8) {
+			/* a long line, to go on more than one card */
+			n = 60 + below( 200 );
+			for (i = 0; i < n; i++) s[i] = keys[below( 30 )];
+		} else if (kind < 9) {
+			remove = below( 200 );
+			n = below( 100 );
+			for (i = 0; i < n; i++) s[i] = keys[below( sizeof keys - 1 )];
+		} else {
+			/* lines of exactly 80, which cardmake follows with a blank card */
+			n = 81;
+			for (i = 0; i < 80; i++) s[i] = 'A' + i % 26;
+			s[80] = '\n';
+		}
+		if (plain_len + n > sizeof plain) break;
+		check( card_text_replace( &text, at, remove, s, n ) == CARD_OK,
+		       "card_text_replace", step );
+		replace( at, remove, s, n );
+		if ((step % 7 == 0) || (plain_len < 200)) {
+			check_text( &text, codec, &made, &deck, step );
+		}
+	}
+	card_text_free( &text );
+	card_buf_free( &made );
+	card_buf_free( &deck );
+}
+
+/* the time of a keystroke in the middle line of a program of nlines,
+   and that it punches only that line */
+static double keystroke( const struct card_codec *codec, long nlines, int times )
+{
+	static const unsigned char line[] = "      X = X + 1.0\n";
+	struct card_text text;
+	struct card_buf deck = { 0 };
+	size_t at;
+	double start;
+	long i, punched;
+	int col, ncards, ok = 1;
+
+	card_text_init( &text, codec );
+	for (i = 0; i < nlines; i++)
+		card_text_replace( &text, i * (sizeof line - 1), 0, line,
+				   sizeof line - 1 );
+	card_text_deck( &text, &deck );
+	at = (nlines / 2) * (sizeof line - 1) + 6;
+	punched = text.punched;
+	start = now();
+	for (i = 0; i < times; i++) {
+		unsigned char ch = (i & 1) ? 'Y' : 'X';
+		card_text_replace( &text, at, 1, &ch, 1 );
+		if (card_text_card( &text, card_text_line_at( &text, at, &col ),
+				    &ncards ) == NULL)
+			ok = 0;
+	}
+	start = now() - start;
+	check( ok && (text.punched - punched == times) && (text.nchanged == 0),
+	       "a keystroke punches one line", (int)nlines );
+	card_text_free( &text );
+	card_buf_free( &deck );
+	return start / times;
+}
+
+int main( void )
+{
+	struct card_options opt;
+	struct card_codec codec;
+	double small, large;
+
+	card_options_init( &opt );
+	card_codec_init( &codec, &opt );
+	edits( &codec, 4000 );
+	opt.format = 82;
+	card_codec_init( &codec, &opt );
+	edits( &codec, 2000 );
+
+	opt.format = 80;
+	card_codec_init( &codec, &opt );
+	small = keystroke( &codec, 5, 200000 );
+	large = keystroke( &codec, 5000, 200000 );
+	fprintf( stderr, "a keystroke %.2f us in 5 lines, %.2f us in 5000\n",
+		 small * 1e6, large * 1e6 );
+	fprintf( stderr, "%d checks, %d failed\n", checks, failures );
+	exit(failures ? 1 : 0);
+}
@@ -0,0 +1,153 @@
+/* ftncomptest.c -- test the FORTRAN compiler's loop optimizations.
+ *
+ * operation:  ftncomptest
+ *
+ * build: cc -o ftncomptest ftncomptest.c ../iPunch/ftncomp.c
+ *        ../iPunch/ftnvm.c ../iPunch/spool.c ../iPunch/cardconv.c
+ *        ../iPunch/cardcodec.c -I../iPunch -lm
+ *
+ * output -- a line for each check that fails, and a summary, on stderr;
+ *           the exit status is 1 if any failed
+ *
+ * Expressions a DO loop never changes are computed once, ahead of it;
+ * these check that a program prints the same whether or not that is
+ * done, and that one that could stop the run, a division by zero or a
+ * real too big for an integer, is left where it was, so a loop that
+ * never reaches it, or reaches it only inside a logical IF that is
+ * false, runs as it would with no optimizing at all.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ftn.h"
+#include "cardconv.h"
+
+static int checks = 0, failures = 0;
+
+static void check( int ok, const char *what, const char *name )
+{
+	checks++;
+	if (ok) return;
+	failures++;
+	fprintf( stderr, "FAIL: %s, in %s\n", what, name );
+}
+
+struct test {
+	const char *name;
+	const char *program;
+	const char *output;	/* what it prints, carriage control and all */
+	int hoisted;		/* expressions it should hoist, at least */
+};
+
+static const struct test tests[] = {
+	{ "INT of a big real in a false IF, in a loop",
+	  "      X = 1.0E20\n"
+	  "      J = 0\n"
+	  "      DO 10 I = 1, 3\n"
+	  "      IF (X .LT. 100.0) J = INT(X)\n"
+	  "   10 CONTINUE\n"
+	  "      PRINT 20, J\n"
+	  "   20 FORMAT (1H ,I5)\n"
+	  "      STOP\n"
+	  "      END\n",
+	  "     0\n", 0 },
+	{ "the same IF outside a loop",
+	  "      X = 1.0E20\n"
+	  "      J = 0\n"
+	  "      IF (X .LT. 100.0) J = INT(X)\n"
+	  "      PRINT 20, J\n"
+	  "   20 FORMAT (1H ,I5)\n"
+	  "      STOP\n"
+	  "      END\n",
+	  "     0\n", 0 },
+	{ "a division by zero in a false IF, in a loop",
+	  "      K = 0\n"
+	  "      J = 0\n"
+	  "      DO 10 I = 1, 3\n"
+	  "      IF (K .NE. 0) J = 10 / K\n"
+	  "   10 CONTINUE\n"
+	  "      PRINT 20, J\n"
+	  "   20 FORMAT (1H ,I5)\n"
+	  "      STOP\n"
+	  "      END\n",
+	  "     0\n", 0 },
+	{ "INT of a real the loop does not change",
+	  "      X = 2.5\n"
+	  "      J = 0\n"
+	  "      DO 10 I = 1, 3\n"
+	  "      IF (X .LT. 100.0) J = J + INT(X) * I\n"
+	  "   10 CONTINUE\n"
+	  "      PRINT 20, J\n"
+	  "   20 FORMAT (1H ,I5)\n"
+	  "      STOP\n"
+	  "      END\n",
+	  "    12\n", 0 },
+	{ "an expression the loop does not change",
+	  "      A = 3.0\n"
+	  "      B = 4.0\n"
+	  "      S = 0.0\n"
+	  "      DO 10 I = 1, 4\n"
+	  "   10 S = S + (A * B + 1.0) * FLOAT(I)\n"
+	  "      PRINT 20, S\n"
+	  "   20 FORMAT (1H ,F8.1)\n"
+	  "      STOP\n"
+	  "      END\n",
+	  "    130.0\n", 1 },
+};
+
+static void run( const struct card_codec *codec, const struct test *t )
+{
+	struct ftn_deck deck;
+	struct ftn_program prog;
+	struct ftn_run r;
+	char got[1000];
+	size_t n;
+	FILE *out = tmpfile();
+
+	if ((out == NULL) || (ftn_read_deck( &deck, (const unsigned char *)t->program,
+					     strlen( t->program ), codec ) != CARD_OK)) {
+		check( 0, "ftn_read_deck", t->name );
+		if (out != NULL) fclose( out );
+		return;
+	}
+	if (ftn_compile( &prog, &deck, ftn_program_cards( &deck ) ) < 0) {
+		fprintf( stderr, "%s\n", prog.error );
+		check( 0, "ftn_compile", t->name );
+		ftn_free_deck( &deck );
+		fclose( out );
+		return;
+	}
+	check( prog.hoisted >= t->hoisted, "expressions hoisted", t->name );
+	memset( &r, 0, sizeof r );
+	r.out = out;
+	r.deck = &deck;
+	r.next_card = ftn_program_cards( &deck );
+	r.limit = 1000000;
+	if (ftn_run( &prog, &r ) < 0) {
+		fprintf( stderr, "%s\n", r.error );
+		check( 0, "ftn_run", t->name );
+	}
+	rewind( out );
+	n = fread( got, 1, sizeof got - 1, out );
+	got[n] = '\0';
+	check( strcmp( got, t->output ) == 0, "what it prints", t->name );
+	ftn_free( &prog );
+	ftn_free_deck( &deck );
+	fclose( out );
+}
+
+int main( void )
+{
+	struct card_options opt;
+	struct card_codec codec;
+	size_t i;
+
+	card_options_init( &opt );
+	card_codec_init( &codec, &opt );
+	for (i = 0; i < sizeof tests / sizeof tests[0]; i++)
+		run( &codec, &tests[i] );
+	fprintf( stderr, "%d checks, %d failed\n", checks, failures );
+	exit(failures ? 1 : 0);
+}